@@ -10,6 +10,12 @@
 #include <curl/curl.h>
 #include <boost/optional.hpp>
 #include <boost/filesystem.hpp>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
 #include "export.h"
 
 
@@ -29,6 +35,64 @@ namespace leatherman { namespace curl {
         static void cleanup(CURL* curl);
     };
 
+    /**
+     * Resource for a cURL share handle, through which clients share their
+     * DNS cache, TLS session cache and connection cache.
+     * Requests from any of these clients to a host already reached by one
+     * of them then skip the name resolution, and the TCP and TLS handshakes
+     * while an idle connection to it remains open.
+     * The caches are locked while in use, so that clients on different
+     * threads can share DNS entries and TLS sessions; libcurl doesn't
+     * support sharing connections between clients used concurrently.
+     * The clients it is set on hold a reference to it, so that it outlives
+     * them.
+     */
+    struct LEATHERMAN_CURL_EXPORT curl_share
+    {
+        /**
+         * Constructs a cURL share handle.
+         * @param share_connections Whether to share the connection cache, in
+         *        addition to the DNS and TLS session caches; pass false for
+         *        clients used on different threads.
+         */
+        explicit curl_share(bool share_connections = true);
+
+        /**
+         * Cleans up the cURL share handle.
+         */
+        ~curl_share();
+
+        /**
+         * Gets the cURL share handle.
+         * @return Returns the cURL share handle.
+         */
+        operator CURLSH*() const;
+
+     private:
+        curl_share(curl_share const&) = delete;
+        curl_share& operator=(curl_share const&) = delete;
+
+        static void lock(CURL* handle, curl_lock_data data, curl_lock_access access, void* ptr);
+        static void unlock(CURL* handle, curl_lock_data data, void* ptr);
+
+        CURLSH* _handle;
+        std::mutex _locks[CURL_LOCK_DATA_LAST];
+    };
+
+    /**
+     * Resource for a cURL multi handle.
+     */
+    struct LEATHERMAN_CURL_EXPORT curl_multi_handle : util::scoped_resource<CURLM*>
+    {
+        /**
+         * Constructs a cURL multi handle.
+         */
+        curl_multi_handle();
+
+     private:
+        static void cleanup(CURLM* multi);
+    };
+
     /**
      * Resource for a cURL linked-list.
      */
@@ -161,12 +225,143 @@ namespace leatherman { namespace curl {
         std::string _temp_path;
     };
 
+    /**
+     * The content encodings a request body may be compressed with.
+     */
+    enum struct content_encoding
+    {
+        /**
+         * The body is sent as is.
+         */
+        identity,
+        /**
+         * The body is compressed in the zlib format.
+         */
+        deflate,
+        /**
+         * The body is compressed in the gzip format.
+         */
+        gzip
+    };
+
+    /**
+     * The policy for retrying failed requests.
+     * A request is retried when cURL fails with one of the retryable errors, or
+     * the server responds with one of the retryable statuses. Before each retry
+     * the client waits for a random delay of up to the backoff, which doubles
+     * with each attempt ("full jitter"), so that clients failing together don't
+     * retry together; a Retry-After header given by the server is honored instead.
+     */
+    struct LEATHERMAN_CURL_EXPORT retry_policy
+    {
+        /**
+         * The maximum number of attempts, including the first; 1 disables retries.
+         */
+        unsigned int max_attempts = 1;
+
+        /**
+         * The backoff before the first retry.
+         */
+        std::chrono::milliseconds base_delay { 100 };
+
+        /**
+         * The maximum backoff, or time given by a Retry-After header, before a retry.
+         */
+        std::chrono::milliseconds max_delay { 30000 };
+
+        /**
+         * The time allowed for all the attempts together, or 0 for no limit.
+         * No retry is made that would wait past it, and the timeout of each
+         * attempt is shortened to end with it.
+         */
+        std::chrono::milliseconds deadline { 0 };
+
+        /**
+         * The cURL errors to retry on.
+         */
+        std::set<CURLcode> retryable_errors {
+            CURLE_COULDNT_RESOLVE_HOST,
+            CURLE_COULDNT_CONNECT,
+            CURLE_OPERATION_TIMEDOUT,
+            CURLE_SEND_ERROR,
+            CURLE_RECV_ERROR,
+            CURLE_GOT_NOTHING,
+            CURLE_PARTIAL_FILE,
+        };
+
+        /**
+         * The HTTP statuses to retry on.
+         */
+        std::set<int> retryable_statuses { 408, 429, 500, 502, 503, 504 };
+
+        /**
+         * Whether to wait for the time given by a Retry-After header rather than the backoff.
+         * A request isn't retried when the time given is longer than max_delay.
+         */
+        bool honor_retry_after = true;
+
+        /**
+         * Gets a random backoff before retrying after the given attempt.
+         * @param attempt The attempt that failed, starting from 1.
+         * @return Returns a delay of up to base_delay doubled for each attempt after the first, and at most max_delay.
+         */
+        std::chrono::milliseconds backoff(unsigned int attempt) const;
+    };
+
+    /**
+     * Options for downloading a file.
+     */
+    struct LEATHERMAN_CURL_EXPORT download_options
+    {
+        /**
+         * Whether to keep a failed download's partial file, at the file path
+         * with ".part" appended, and to resume from it on the next download.
+         */
+        bool resume = false;
+
+        /**
+         * The number of ranges of the file to download concurrently, if the
+         * server supports range requests; 1 downloads it in a single transfer.
+         * The ranges are written in place into a file preallocated to the size
+         * given by the server. A segmented download can't be resumed by a
+         * later download, though each range resumes within it.
+         */
+        unsigned int segments = 1;
+
+        /**
+         * The minimum size of a range downloaded concurrently.
+         */
+        uint64_t min_segment_size = 1024 * 1024;
+
+        /**
+         * The CRC-32 the downloaded file must have, if set. The checksum is
+         * computed as the file is written, and a file that doesn't match is
+         * removed.
+         */
+        boost::optional<uint32_t> crc32;
+    };
+
     /**
      * Implements a client for HTTP.
      * Note: this class is not thread-safe.
      */
     struct LEATHERMAN_CURL_EXPORT client
     {
+        /**
+         * The function receiving the chunks of a response body as they arrive.
+         * It is given the response, whose status code and headers are already set,
+         * and returns true to continue the transfer or false to abort it.
+         */
+        using body_callback = std::function<bool(response const& res, char const* data, size_t size)>;
+
+        /**
+         * The function observing the transfers of every client, e.g. to feed a metrics system.
+         * It is given the request, the response with its status, headers, sizes and
+         * metrics but not its body, and the result of the transfer, which is CURLE_OK
+         * unless the transfer failed.
+         */
+        using transfer_observer = std::function<void(request const& req, response const& res, CURLcode result)>;
+
         /**
          * Constructs an HTTP client.
          */
@@ -206,6 +401,36 @@ namespace leatherman { namespace curl {
          */
         response put(request const& req);
 
+        /**
+         * Performs a GET with the given request, streaming the response body.
+         * The body is passed to on_body as it arrives rather than kept in the
+         * response, so memory use doesn't depend on its size.
+         * If on_body returns false, the transfer stops and the response is returned
+         * as received so far; exceptions thrown by on_body are rethrown.
+         * @param req The HTTP request to perform.
+         * @param on_body The function to call with each chunk of the response body.
+         * @return Returns the HTTP response, without its body.
+         */
+        response get(request const& req, body_callback const& on_body);
+
+        /**
+         * Performs a POST with the given request, streaming the response body.
+         * See get for how the body is passed to on_body.
+         * @param req The HTTP request to perform.
+         * @param on_body The function to call with each chunk of the response body.
+         * @return Returns the HTTP response, without its body.
+         */
+        response post(request const& req, body_callback const& on_body);
+
+        /**
+         * Performs a PUT with the given request, streaming the response body.
+         * See get for how the body is passed to on_body.
+         * @param req The HTTP request to perform.
+         * @param on_body The function to call with each chunk of the response body.
+         * @return Returns the HTTP response, without its body.
+         */
+        response put(request const& req, body_callback const& on_body);
+
         /**
          * Downloads the file from the specified url.
          * Throws http_file_download_exception if anything goes wrong.
@@ -217,6 +442,22 @@ namespace leatherman { namespace curl {
                            std::string const& file_path,
                            boost::optional<boost::filesystem::perms> perms = {});
 
+        /**
+         * Downloads the file from the specified url, with the given options.
+         * Throws http_file_download_exception if anything goes wrong; the
+         * exception's temp_path is that of the partial file if it's kept.
+         * With options set, the download fails if the server responds with
+         * an error status, rather than writing the error to the file.
+         * @param req The HTTP request to perform.
+         * @param file_path The file that the downloaded contents will be written to.
+         * @param options The options of the download.
+         * @param perms The file permissions to apply when writing to file_path. Ignored on Windows.
+         */
+        void download_file(request const& req,
+                           std::string const& file_path,
+                           download_options const& options,
+                           boost::optional<boost::filesystem::perms> perms = {});
+
         /**
          * Sets the path to the CA certificate file.
          * @param cert_file The path to the CA certificate file.
@@ -237,7 +478,60 @@ namespace leatherman { namespace curl {
          */
         void set_supported_protocols(long client_protocols);
 
+        /**
+         * Shares the caches of the given share handle with the other clients
+         * it is set on, so that their connections are reused.
+         * Connections are kept alive between the requests of a client; the
+         * share extends that reuse to the clients created for each request
+         * or task.
+         * @param share The share handle, or nullptr to stop sharing.
+         */
+        void set_share(std::shared_ptr<curl_share> share);
+
+        /**
+         * Sets the content encodings to accept for response bodies, which
+         * are decoded as they are received.
+         * By default, every encoding cURL supports is accepted.
+         * @param encodings The comma-separated encodings to accept, an empty string
+         *        to accept all the supported ones, or "identity" to accept none.
+         */
+        void set_accept_encoding(std::string encodings);
+
+        /**
+         * Sets the encoding to compress request bodies with as they are sent.
+         * A compressed body is sent with chunked transfer encoding, as its
+         * size isn't known in advance; the server must accept the encoding.
+         * @param encoding The encoding to compress request bodies with.
+         * @param level The compression level, from 0 (none) to 9 (best), or -1 for the default.
+         */
+        void set_body_compression(content_encoding encoding, int level = -1);
+
+        /**
+         * Sets the policy for retrying failed requests and downloads.
+         * By default, requests are not retried.
+         * A request is not retried once a body read in order has been sent, or
+         * once the response body has been passed to a body callback; the bodies
+         * of responses with a retryable status aren't passed while retries remain.
+         * An interrupted download resumes from the last byte received, if the
+         * server supports range requests.
+         * @param policy The retry policy.
+         */
+        void set_retry_policy(retry_policy policy);
+
+        /**
+         * Sets the observer of the transfers of every client, including those of
+         * multi_clients and downloads. It is called on the thread performing each
+         * transfer once it completes, for every attempt of a retried request.
+         * Exceptions thrown by the observer are logged and otherwise ignored.
+         * @param observer The transfer observer, or nullptr to remove it.
+         */
+        static void set_transfer_observer(transfer_observer observer);
+
      private:
+        friend struct multi_client;
+
+        struct download_segment;
+
         client(client const&) = delete;
         client& operator=(client const&) = delete;
 
@@ -259,19 +553,42 @@ namespace leatherman { namespace curl {
 
             request const& req;
             response& res;
-            size_t read_offset;
+            uint64_t read_offset;
             curl_list request_headers;
             std::string response_buffer;
+            // Receives the response body instead of the buffer, if set
+            body_callback const* on_body = nullptr;
+            bool aborted = false;
+            // Thrown by the request or response body callbacks during the transfer
+            std::exception_ptr body_error;
+            // The source the request body is read from, if not the request's string body
+            std::shared_ptr<body_source> upload;
+            // The size of the response body received, once decoded
+            uint64_t body_size = 0;
+            // The statuses whose response body is discarded as the request will be retried
+            std::set<int> const* retry_statuses = nullptr;
+            // The time left before the retry deadline, or 0 if none
+            long deadline_timeout = 0;
+            // Set when the response body is written to a file rather than the buffer
+            bool download = false;
         };
 
         std::string _ca_cert;
         std::string _client_cert;
         std::string _client_key;
         long _client_protocols = CURLPROTO_ALL;
-
-        response perform(http_method method, request const& req);
+        std::string _accept_encoding;
+        content_encoding _body_encoding = content_encoding::identity;
+        int _body_compression_level = -1;
+        retry_policy _retry;
+        // Declared before the handle, which must be cleaned up first
+        std::shared_ptr<curl_share> _share;
+
+        response perform(http_method method, request const& req, body_callback const* on_body = nullptr);
+        LEATHERMAN_CURL_NO_EXPORT void prepare(context& ctx, http_method method);
         LEATHERMAN_CURL_NO_EXPORT void set_method(context& ctx, http_method method);
         LEATHERMAN_CURL_NO_EXPORT void set_url(context& ctx);
+        LEATHERMAN_CURL_NO_EXPORT void set_body_encoding(context& ctx);
         LEATHERMAN_CURL_NO_EXPORT void set_headers(context& ctx);
         LEATHERMAN_CURL_NO_EXPORT void set_cookies(context& ctx);
         LEATHERMAN_CURL_NO_EXPORT void set_body(context& ctx, http_method method);
@@ -280,6 +597,19 @@ namespace leatherman { namespace curl {
         LEATHERMAN_CURL_NO_EXPORT void set_client_info(context &ctx);
         LEATHERMAN_CURL_NO_EXPORT void set_ca_info(context& ctx);
         LEATHERMAN_CURL_NO_EXPORT void set_client_protocols(context& ctx);
+        LEATHERMAN_CURL_NO_EXPORT void set_connection_reuse(context& ctx);
+        LEATHERMAN_CURL_NO_EXPORT void set_transfer_info(context& ctx);
+        LEATHERMAN_CURL_NO_EXPORT void complete_transfer(context& ctx, CURLcode result);
+        LEATHERMAN_CURL_NO_EXPORT void download_file_impl(request const& req,
+                                                          std::string const& file_path,
+                                                          download_options const* options,
+                                                          boost::optional<boost::filesystem::perms> perms);
+        LEATHERMAN_CURL_NO_EXPORT void prepare_download(context& ctx, download_segment& segment);
+        LEATHERMAN_CURL_NO_EXPORT boost::optional<uint64_t> ranged_size(request const& req);
+        LEATHERMAN_CURL_NO_EXPORT uint32_t download_segments(request const& req, FILE* fp, uint64_t size, download_options const& options);
+        LEATHERMAN_CURL_NO_EXPORT void start_attempt(context& ctx, unsigned int attempt, std::chrono::steady_clock::time_point start);
+        LEATHERMAN_CURL_NO_EXPORT boost::optional<std::chrono::milliseconds> retry_delay(
+            context const& ctx, CURLcode result, unsigned int attempt, std::chrono::steady_clock::time_point start) const;
 
         template <typename ParamType>
         LEATHERMAN_CURL_NO_EXPORT void curl_easy_setopt_maybe(
@@ -297,7 +627,7 @@ namespace leatherman { namespace curl {
         static int seek_body(void* ptr, curl_off_t offset, int origin);
         static size_t write_header(char* buffer, size_t size, size_t count, void* ptr);
         static size_t write_body(char* buffer, size_t size, size_t count, void* ptr);
-        static size_t write_file(char *buffer, size_t size, size_t count, void* ptr);
+        static size_t write_segment(char *buffer, size_t size, size_t count, void* ptr);
         static int debug(CURL* handle, curl_infotype type, char* data, size_t size, void* ptr);
 
         curl_handle _handle;
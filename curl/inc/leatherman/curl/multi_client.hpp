@@ -0,0 +1,185 @@
+/**
+* @file
+* Declares the concurrent HTTP client.
+*/
+#pragma once
+
+#include "client.hpp"
+#include "request.hpp"
+#include "response.hpp"
+#include <curl/curl.h>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "export.h"
+
+namespace leatherman { namespace curl {
+
+    /**
+     * Implements a client for HTTP that performs many requests concurrently
+     * on the calling thread.
+     * Requests are queued with get, post and put, and run by perform. The
+     * requests share one connection cache. The requests in progress to a
+     * host are capped, and so are the connections open to it; requests over
+     * HTTP/2 are multiplexed on a single connection.
+     * Note: this class is not thread-safe.
+     */
+    struct LEATHERMAN_CURL_EXPORT multi_client
+    {
+        /**
+         * The function called with the response of a request.
+         */
+        using response_callback = std::function<void(response)>;
+
+        /**
+         * The function called with the error of a failed request.
+         */
+        using error_callback = std::function<void(http_request_exception const&)>;
+
+        /**
+         * The default limit of requests in progress to a host.
+         */
+        static constexpr size_t default_max_host_connections = 8;
+
+        /**
+         * Constructs a concurrent HTTP client.
+         */
+        multi_client();
+
+        /**
+         * Destroys the client, abandoning any request still queued.
+         */
+        ~multi_client();
+
+        /**
+         * Queues a GET with the given request.
+         * @param req The HTTP request to perform.
+         * @param on_response The function to call with the response.
+         * @param on_error The function to call if the request fails; if empty, perform throws the error.
+         */
+        void get(request req, response_callback on_response, error_callback on_error = nullptr);
+
+        /**
+         * Queues a POST with the given request.
+         * @param req The HTTP request to perform.
+         * @param on_response The function to call with the response.
+         * @param on_error The function to call if the request fails; if empty, perform throws the error.
+         */
+        void post(request req, response_callback on_response, error_callback on_error = nullptr);
+
+        /**
+         * Queues a PUT with the given request.
+         * @param req The HTTP request to perform.
+         * @param on_response The function to call with the response.
+         * @param on_error The function to call if the request fails; if empty, perform throws the error.
+         */
+        void put(request req, response_callback on_response, error_callback on_error = nullptr);
+
+        /**
+         * Performs the queued requests until all of them are complete, calling
+         * their callbacks as they complete.
+         * Callbacks may queue further requests, which are performed in turn.
+         * If a request without an error callback fails, its error is thrown;
+         * calling perform again resumes the remaining requests.
+         */
+        void perform();
+
+        /**
+         * Gets the number of requests queued or in progress.
+         * @return Returns the number of requests not yet completed.
+         */
+        size_t pending() const;
+
+        /**
+         * Sets the path to the CA certificate file.
+         * @param cert_file The path to the CA certificate file.
+         */
+        void set_ca_cert(std::string const& cert_file);
+
+        /**
+         * Set client SSL certificate and key.
+         * @param client_cert The path to the client's certificate file.
+         * @param client_key The path to the client's key file.
+         */
+        void set_client_cert(std::string const& client_cert, std::string const& client_key);
+
+        /**
+         * Set and limit what protocols curl will support
+         * @param client_protocols bitmask of CURLPROTO_*
+         *        (see more: http://curl.haxx.se/libcurl/c/CURLOPT_PROTOCOLS.html)
+         */
+        void set_supported_protocols(long client_protocols);
+
+        /**
+         * Sets the content encodings to accept for response bodies.
+         * See client::set_accept_encoding.
+         * @param encodings The comma-separated encodings to accept, an empty string
+         *        to accept all the supported ones, or "identity" to accept none.
+         */
+        void set_accept_encoding(std::string encodings);
+
+        /**
+         * Sets the encoding to compress request bodies with as they are sent.
+         * See client::set_body_compression.
+         * @param encoding The encoding to compress request bodies with.
+         * @param level The compression level, from 0 (none) to 9 (best), or -1 for the default.
+         */
+        void set_body_compression(content_encoding encoding, int level = -1);
+
+        /**
+         * Limits the requests in progress to a single host, and so the
+         * connections open to it; further requests wait in the queue.
+         * @param max_connections The maximum number of requests to a host, or 0 for no limit.
+         */
+        void set_max_host_connections(size_t max_connections);
+
+        /**
+         * Limits the requests in progress in total, and so the connections open.
+         * @param max_connections The maximum number of requests, or 0 for no limit.
+         */
+        void set_max_connections(size_t max_connections);
+
+     private:
+        multi_client(multi_client const&) = delete;
+        multi_client& operator=(multi_client const&) = delete;
+
+        struct transfer;
+
+        std::string _ca_cert;
+        std::string _client_cert;
+        std::string _client_key;
+        long _client_protocols = CURLPROTO_ALL;
+        std::string _accept_encoding;
+        content_encoding _body_encoding = content_encoding::identity;
+        int _body_compression_level = -1;
+        size_t _max_host_transfers = default_max_host_connections;
+        size_t _max_transfers = 0;
+
+        curl_multi_handle _handle;
+        // Clients of completed transfers, kept to be reused
+        std::vector<std::unique_ptr<client>> _idle;
+        // Requests waiting for the number in progress to fall below the limits
+        std::deque<std::unique_ptr<transfer>> _queued;
+        std::map<CURL*, std::unique_ptr<transfer>> _transfers;
+        std::map<std::string, size_t> _host_transfers;
+
+        LEATHERMAN_CURL_NO_EXPORT void add(client::http_method method, request req, response_callback on_response, error_callback on_error);
+        LEATHERMAN_CURL_NO_EXPORT void start_queued();
+        LEATHERMAN_CURL_NO_EXPORT void start(std::unique_ptr<transfer> t);
+        LEATHERMAN_CURL_NO_EXPORT void complete(CURL* handle, CURLcode result);
+        LEATHERMAN_CURL_NO_EXPORT void finish(transfer& t);
+        LEATHERMAN_CURL_NO_EXPORT void fail(transfer& t, http_request_exception const& error);
+
+    protected:
+        /**
+         * Returns a reference to the cURL multi handle resource performing the requests.
+         * This is primarily exposed for testing.
+         * @return Returns a const reference to the cURL multi handle resource.
+         */
+        curl_multi_handle const& get_handle();
+    };
+
+}}  // namespace leatherman::curl
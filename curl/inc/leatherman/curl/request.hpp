@@ -6,11 +6,48 @@
 
 #include <string>
 #include <map>
+#include <memory>
 #include <functional>
+#include <cstdint>
 #include "export.h"
 
 namespace leatherman { namespace curl {
 
+    /**
+     * Source of a request body that is read as it is sent, rather than held
+     * in memory by the request.
+     */
+    struct LEATHERMAN_CURL_EXPORT body_source
+    {
+        /**
+         * Destroys the body source.
+         */
+        virtual ~body_source() = default;
+
+        /**
+         * Gets the size of the body.
+         * @return Returns the size of the body in bytes, or -1 if unknown; a
+         *         body of unknown size is sent with chunked transfer encoding.
+         */
+        virtual int64_t size() const = 0;
+
+        /**
+         * Reads part of the body.
+         * @param buffer The buffer to read into.
+         * @param size The size of the buffer.
+         * @param offset The offset in the body to read from.
+         * @return Returns the number of bytes read, or 0 at the end of the body.
+         */
+        virtual size_t read(char* buffer, size_t size, uint64_t offset) = 0;
+
+        /**
+         * Gets whether the body can be read again from an earlier offset, as
+         * cURL does to send it again after a redirect.
+         * @return Returns true if the body can be read from any offset, or false if only in order.
+         */
+        virtual bool seekable() const = 0;
+    };
+
     /**
      * Implements the HTTP request.
      */
@@ -90,10 +127,58 @@ namespace leatherman { namespace curl {
         /**
          * Gets the body of the request.
          * The type of the content is represented by the Content-Type header.
-         * @return Returns the body of the request.
+         * @return Returns the body of the request, or an empty string if the body is streamed.
          */
         std::string const& body() const;
 
+        /**
+         * Sets the body of the request to be read from the given source as it is sent.
+         * @param source The source of the body.
+         * @param content_type The type of content (sets the Content-Type header).
+         */
+        void body(std::shared_ptr<body_source> source, std::string content_type);
+
+        /**
+         * Sets the body of the request to the contents of a file, read as it is sent.
+         * The file is opened now, throwing http_exception if it can't be; its
+         * size when opened is the size of the body.
+         * @param path The path of the file.
+         * @param content_type The type of content (sets the Content-Type header).
+         */
+        void body_file(std::string const& path, std::string content_type);
+
+        /**
+         * Sets the body of the request to a region of memory, such as a
+         * memory-mapped file, sent without copying it into the request.
+         * The region must remain valid until the request is performed.
+         * @param data The start of the region.
+         * @param size The size of the region.
+         * @param content_type The type of content (sets the Content-Type header).
+         */
+        void body_memory(char const* data, size_t size, std::string content_type);
+
+        /**
+         * The function called to read the next part of a streamed body; it
+         * returns the number of bytes written to the buffer, or 0 at the end
+         * of the body.
+         */
+        using body_reader = std::function<size_t(char* buffer, size_t size)>;
+
+        /**
+         * Sets the body of the request to the data returned by a function as it is sent.
+         * The body is read only once, in order.
+         * @param reader The function to read the body from.
+         * @param content_type The type of content (sets the Content-Type header).
+         * @param size The size of the body, or -1 if unknown to send it with chunked transfer encoding.
+         */
+        void body_stream(body_reader reader, std::string content_type, int64_t size = -1);
+
+        /**
+         * Gets the source of a streamed body.
+         * @return Returns the source of the body, or nullptr if the body is not streamed.
+         */
+        std::shared_ptr<body_source> const& streamed_body() const;
+
         /**
          * Gets the overall request timeout, in milliseconds.
          * @return Returns the overall request timeout, in milliseconds.
@@ -121,6 +206,7 @@ namespace leatherman { namespace curl {
      private:
         std::string _url;
         std::string _body;
+        std::shared_ptr<body_source> _body_source;
         long _timeout;
         long _connection_timeout;
         std::map<std::string, std::string> _headers;
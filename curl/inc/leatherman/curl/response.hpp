@@ -4,15 +4,120 @@
 */
 #pragma once
 
+#include <chrono>
 #include <string>
 #include <functional>
-#include <map>
+#include <utility>
+#include <vector>
+#include <cstdint>
 #include "export.h"
 
 namespace leatherman { namespace curl {
 
+    /**
+     * The size of a body and the size it was transferred as, after its content encoding.
+     */
+    struct LEATHERMAN_CURL_EXPORT transfer_sizes
+    {
+        /**
+         * The size of the body, in bytes.
+         */
+        uint64_t body = 0;
+
+        /**
+         * The size of the body as transferred, in bytes.
+         */
+        uint64_t transferred = 0;
+
+        /**
+         * Gets the compression ratio of the body.
+         * @return Returns the size of the body over the size transferred, or 1 if nothing was transferred.
+         */
+        double compression_ratio() const;
+    };
+
+    /**
+     * The timings and measures of the transfer of a response.
+     * The times are from the start of the transfer until each phase completed,
+     * and include those of any redirects followed.
+     */
+    struct LEATHERMAN_CURL_EXPORT transfer_metrics
+    {
+        /**
+         * The time until the host name was resolved.
+         */
+        std::chrono::microseconds name_lookup { 0 };
+
+        /**
+         * The time until the connection to the host, or proxy, was made.
+         */
+        std::chrono::microseconds connect { 0 };
+
+        /**
+         * The time until the TLS handshake completed, or 0 if none was made.
+         */
+        std::chrono::microseconds app_connect { 0 };
+
+        /**
+         * The time until the request was about to be sent.
+         */
+        std::chrono::microseconds pre_transfer { 0 };
+
+        /**
+         * The time until the first byte of the response was received.
+         */
+        std::chrono::microseconds start_transfer { 0 };
+
+        /**
+         * The time until the transfer completed.
+         */
+        std::chrono::microseconds total { 0 };
+
+        /**
+         * The time taken by the redirects followed before the final transfer.
+         */
+        std::chrono::microseconds redirect { 0 };
+
+        /**
+         * The number of redirects followed.
+         */
+        long redirects = 0;
+
+        /**
+         * The size of the requests sent, in bytes, including their headers.
+         */
+        uint64_t request_size = 0;
+
+        /**
+         * The size of the response headers received, in bytes.
+         */
+        uint64_t header_size = 0;
+
+        /**
+         * The average upload speed, in bytes per second.
+         */
+        uint64_t upload_speed = 0;
+
+        /**
+         * The average download speed, in bytes per second.
+         */
+        uint64_t download_speed = 0;
+
+        /**
+         * Whether the transfer reused a connection rather than opening one.
+         */
+        bool connection_reused = false;
+
+        /**
+         * The HTTP version of the connection, as a CURL_HTTP_VERSION_* value, or 0 if unknown.
+         */
+        long http_version = 0;
+    };
+
     /**
      * Implements the HTTP response.
+     * Headers are kept in the order they were received, and their names are
+     * compared case-insensitively, as HTTP/2 sends them in lower case.
      */
     struct LEATHERMAN_CURL_EXPORT response
     {
@@ -22,7 +127,8 @@ namespace leatherman { namespace curl {
         response();
 
         /**
-         * Adds a header to the response.
+         * Adds a header to the response. A repeated header is added again, and
+         * header returns its first value.
          * @param name The header name.
          * @param value The header value.
          */
@@ -35,14 +141,14 @@ namespace leatherman { namespace curl {
         void each_header(std::function<bool(std::string const&, std::string const&)> callback) const;
 
         /**
-         * Gets a header by name.
+         * Gets a header by name, ignoring case.
          * @param name The header name to get.
-         * @return Returns a pointer to the header's value or nullptr if the header is not present.
+         * @return Returns a pointer to the first value of the header or nullptr if the header is not present.
          */
         const std::string* header(std::string const& name) const;
 
         /**
-         * Removes a header from the response.
+         * Removes a header from the response, ignoring case.
          * @param name The name of the header to remove.
          */
         void remove_header(std::string const& name);
@@ -71,10 +177,49 @@ namespace leatherman { namespace curl {
          */
         int status_code() const;
 
+        /**
+         * Sets the sizes of the request body sent for the response.
+         * @param sizes The sizes of the request body.
+         */
+        void request_sizes(transfer_sizes sizes);
+
+        /**
+         * Gets the sizes of the request body sent for the response.
+         * @return Returns the size of the request body and the size it was sent as.
+         */
+        transfer_sizes const& request_sizes() const;
+
+        /**
+         * Sets the sizes of the response body.
+         * @param sizes The sizes of the response body.
+         */
+        void response_sizes(transfer_sizes sizes);
+
+        /**
+         * Gets the sizes of the response body.
+         * @return Returns the size of the response body once decoded and the size it was received as.
+         */
+        transfer_sizes const& response_sizes() const;
+
+        /**
+         * Sets the timings and measures of the response's transfer.
+         * @param metrics The metrics of the transfer.
+         */
+        void metrics(transfer_metrics metrics);
+
+        /**
+         * Gets the timings and measures of the response's transfer.
+         * @return Returns the metrics of the transfer.
+         */
+        transfer_metrics const& metrics() const;
+
      private:
         int _status_code;
+        transfer_sizes _request_sizes;
+        transfer_sizes _response_sizes;
+        transfer_metrics _metrics;
         std::string _body;
-        std::map<std::string, std::string> _headers;
+        std::vector<std::pair<std::string, std::string>> _headers;
     };
 
 }}  // namespace leatherman::curl
@@ -1,13 +1,34 @@
 #include <leatherman/curl/client.hpp>
 #include <leatherman/curl/request.hpp>
 #include <leatherman/curl/response.hpp>
-#include <leatherman/util/regex.hpp>
 #include <leatherman/logging/logging.hpp>
 #include <leatherman/locale/locale.hpp>
+#include <leatherman/util/scope_exit.hpp>
 #include <boost/utility/string_ref.hpp>
 #include <boost/algorithm/string.hpp>
+#include <boost/format.hpp>
 #include <boost/nowide/cstdio.hpp>
+#include <boost/nowide/fstream.hpp>
+#include <zlib.h>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <random>
 #include <sstream>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 // Mark string for translation (alias for leatherman::locale::format)
 using leatherman::locale::_;
@@ -41,14 +62,20 @@ namespace leatherman { namespace curl {
         CURLcode _result;
     };
 
-    curl_handle::curl_handle() :
-        scoped_resource(nullptr, cleanup)
+    // Globally initializes curl on first use
+    static void global_init()
     {
-        // Perform initialization
         static curl_init_helper init_helper;
         if (init_helper.result() != CURLE_OK) {
             throw http_exception(curl_easy_strerror(init_helper.result()));
         }
+    }
+
+    curl_handle::curl_handle() :
+        scoped_resource(nullptr, cleanup)
+    {
+        // Perform initialization
+        global_init();
 
         _resource = curl_easy_init();
     }
@@ -60,6 +87,81 @@ namespace leatherman { namespace curl {
         }
     }
 
+    curl_share::curl_share(bool share_connections) :
+        _handle(nullptr)
+    {
+        global_init();
+
+        _handle = curl_share_init();
+        if (!_handle) {
+            throw http_exception(_("failed to create cURL share handle."));
+        }
+
+        vector<curl_lock_data> shared { CURL_LOCK_DATA_DNS, CURL_LOCK_DATA_SSL_SESSION };
+        if (share_connections) {
+            shared.push_back(CURL_LOCK_DATA_CONNECT);
+        }
+
+        CURLSHcode result = CURLSHE_OK;
+        for (auto data : shared) {
+            if (result == CURLSHE_OK) {
+                result = curl_share_setopt(_handle, CURLSHOPT_SHARE, data);
+            }
+        }
+        if (result == CURLSHE_OK) {
+            result = curl_share_setopt(_handle, CURLSHOPT_LOCKFUNC, lock);
+        }
+        if (result == CURLSHE_OK) {
+            result = curl_share_setopt(_handle, CURLSHOPT_UNLOCKFUNC, unlock);
+        }
+        if (result == CURLSHE_OK) {
+            result = curl_share_setopt(_handle, CURLSHOPT_USERDATA, this);
+        }
+
+        if (result != CURLSHE_OK) {
+            curl_share_cleanup(_handle);
+            throw http_exception(curl_share_strerror(result));
+        }
+    }
+
+    curl_share::~curl_share()
+    {
+        curl_share_cleanup(_handle);
+    }
+
+    curl_share::operator CURLSH*() const
+    {
+        return _handle;
+    }
+
+    void curl_share::lock(CURL* handle, curl_lock_data data, curl_lock_access access, void* ptr)
+    {
+        // Shared and exclusive accesses are both exclusive; the caches
+        // are only held for short lookups and updates
+        reinterpret_cast<curl_share*>(ptr)->_locks[data].lock();
+    }
+
+    void curl_share::unlock(CURL* handle, curl_lock_data data, void* ptr)
+    {
+        reinterpret_cast<curl_share*>(ptr)->_locks[data].unlock();
+    }
+
+    curl_multi_handle::curl_multi_handle() :
+        scoped_resource(nullptr, cleanup)
+    {
+        // Perform initialization
+        global_init();
+
+        _resource = curl_multi_init();
+    }
+
+    void curl_multi_handle::cleanup(CURLM* multi)
+    {
+        if (multi) {
+            curl_multi_cleanup(multi);
+        }
+    }
+
     curl_list::curl_list() :
         scoped_resource(nullptr, cleanup)
     {
@@ -93,6 +195,180 @@ namespace leatherman { namespace curl {
         }
     }
 
+    chrono::milliseconds retry_policy::backoff(unsigned int attempt) const
+    {
+        // Double the base delay for each attempt after the first, up to the maximum
+        long long ceiling = base_delay.count();
+        for (unsigned int i = 1; i < attempt && ceiling < max_delay.count(); ++i) {
+            ceiling *= 2;
+        }
+        ceiling = min<long long>(ceiling, max_delay.count());
+        if (ceiling <= 0) {
+            return chrono::milliseconds(0);
+        }
+
+        static thread_local mt19937_64 engine { random_device{}() };
+        return chrono::milliseconds(uniform_int_distribution<long long>(0, ceiling)(engine));
+    }
+
+    // Gets the delay given by a Retry-After header, in seconds or as an HTTP date
+    static boost::optional<chrono::milliseconds> parse_retry_after(string const& value)
+    {
+        if (!value.empty() && all_of(value.begin(), value.end(), [](char c) { return isdigit(static_cast<unsigned char>(c)); })) {
+            try {
+                auto seconds = stoll(value);
+                if (seconds > chrono::milliseconds::max().count() / 1000) {
+                    return chrono::milliseconds::max();
+                }
+                return chrono::milliseconds(seconds * 1000);
+            } catch (out_of_range&) {
+                return chrono::milliseconds::max();
+            } catch (logic_error&) {
+                return boost::none;
+            }
+        }
+
+        // For example "Wed, 21 Oct 2015 07:28:00 GMT"
+        static char const* const months[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+        int day, year, hour, minute, second;
+        char month_name[4] = {};
+        if (sscanf(value.c_str(), "%*3s, %2d %3s %4d %2d:%2d:%2d GMT", &day, month_name, &year, &hour, &minute, &second) != 6) {
+            return boost::none;
+        }
+        auto month = find_if(begin(months), end(months), [&](char const* name) { return strcmp(name, month_name) == 0; }) - begin(months) + 1;
+        if (month > 12) {
+            return boost::none;
+        }
+
+        // Count the days since the epoch of the date in the proleptic Gregorian calendar
+        long long y = year - (month <= 2 ? 1 : 0);
+        long long era = (y >= 0 ? y : y - 399) / 400;
+        long long year_of_era = y - era * 400;
+        long long day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+        long long day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+        long long days = era * 146097 + day_of_era - 719468;
+
+        // Count in seconds, as a far-future date overflows the clock's time points
+        auto now = chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch());
+        auto seconds = ((days * 24 + hour) * 60 + minute) * 60 + second;
+        if (seconds > chrono::milliseconds::max().count() / 1000) {
+            return chrono::milliseconds::max();
+        }
+        return max(chrono::milliseconds(seconds * 1000) - now, chrono::milliseconds(0));
+    }
+
+    // Compresses the request body as cURL reads it, holding only a buffer of its input
+    struct deflate_body_source : body_source
+    {
+        deflate_body_source(request const& req, content_encoding encoding, int level) :
+            _req(req),
+            _encoding(encoding),
+            _level(level)
+        {
+            init();
+        }
+
+        ~deflate_body_source()
+        {
+            deflateEnd(&_stream);
+        }
+
+        int64_t size() const override
+        {
+            return -1;
+        }
+
+        size_t read(char* buffer, size_t size, uint64_t offset) override
+        {
+            // Compress the body again up to the offset cURL rewound to
+            if (offset < _produced) {
+                deflateEnd(&_stream);
+                init();
+            }
+            while (_produced < offset) {
+                char discarded[4096];
+                if (next(discarded, static_cast<size_t>(std::min<uint64_t>(sizeof(discarded), offset - _produced))) == 0) {
+                    return 0;
+                }
+            }
+            return next(buffer, size);
+        }
+
+        bool seekable() const override
+        {
+            auto const& source = _req.streamed_body();
+            return !source || source->seekable();
+        }
+
+        uint64_t consumed() const
+        {
+            return _consumed;
+        }
+
+     private:
+        void init()
+        {
+            _stream = z_stream();
+            _consumed = 0;
+            _produced = 0;
+            _finished = false;
+
+            // Add 16 to the window bits for a gzip header rather than a zlib one
+            int window_bits = _encoding == content_encoding::gzip ? 15 + 16 : 15;
+            if (deflateInit2(&_stream, _level, Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+                throw http_request_exception(_req, _("failed to initialize request body compression."));
+            }
+        }
+
+        size_t next(char* buffer, size_t size)
+        {
+            _stream.next_out = reinterpret_cast<Bytef*>(buffer);
+            _stream.avail_out = static_cast<uInt>(size);
+            while (_stream.avail_out > 0 && !_finished) {
+                bool end = false;
+                if (_stream.avail_in == 0) {
+                    auto read = read_input(_input, sizeof(_input), _consumed);
+                    _consumed += read;
+                    end = read == 0;
+                    _stream.next_in = reinterpret_cast<Bytef*>(_input);
+                    _stream.avail_in = static_cast<uInt>(read);
+                }
+                auto result = deflate(&_stream, end ? Z_FINISH : Z_NO_FLUSH);
+                if (result == Z_STREAM_END) {
+                    _finished = true;
+                } else if (result != Z_OK && result != Z_BUF_ERROR) {
+                    throw http_request_exception(_req, _("failed to compress request body."));
+                }
+            }
+            size_t produced = size - _stream.avail_out;
+            _produced += produced;
+            return produced;
+        }
+
+        size_t read_input(char* buffer, size_t size, uint64_t offset)
+        {
+            if (auto const& source = _req.streamed_body()) {
+                return source->read(buffer, size, offset);
+            }
+            auto const& body = _req.body();
+            if (offset >= body.size()) {
+                return 0;
+            }
+            size = std::min(size, static_cast<size_t>(body.size() - offset));
+            memcpy(buffer, body.data() + offset, size);
+            return size;
+        }
+
+        request const& _req;
+        content_encoding _encoding;
+        int _level;
+        z_stream _stream;
+        uint64_t _consumed;
+        uint64_t _produced;
+        bool _finished;
+        char _input[16 * 1024];
+    };
+
     client::client()
     {
         if (!_handle) {
@@ -107,7 +383,17 @@ namespace leatherman { namespace curl {
 
     client &client::operator=(client && other)
     {
+        _ca_cert = move(other._ca_cert);
+        _client_cert = move(other._client_cert);
+        _client_key = move(other._client_key);
+        _client_protocols = other._client_protocols;
+        _accept_encoding = move(other._accept_encoding);
+        _body_encoding = other._body_encoding;
+        _body_compression_level = other._body_compression_level;
+        _retry = other._retry;
+        // The previous handle is cleaned up before its share is released
         _handle = move(other._handle);
+        _share = move(other._share);
         return *this;
     }
 
@@ -126,11 +412,60 @@ namespace leatherman { namespace curl {
         return perform(http_method::put, req);
     }
 
-    response client::perform(http_method method, request const& req)
+    response client::get(request const& req, body_callback const& on_body)
     {
-        response res;
-        context ctx(req, res);
+        return perform(http_method::get, req, &on_body);
+    }
+
+    response client::post(request const& req, body_callback const& on_body)
+    {
+        return perform(http_method::post, req, &on_body);
+    }
+
+    response client::put(request const& req, body_callback const& on_body)
+    {
+        return perform(http_method::put, req, &on_body);
+    }
+
+    response client::perform(http_method method, request const& req, body_callback const* on_body)
+    {
+        auto start = chrono::steady_clock::now();
+        for (unsigned int attempt = 1;; ++attempt) {
+            response res;
+            context ctx(req, res);
+            ctx.on_body = on_body;
+            start_attempt(ctx, attempt, start);
+
+            prepare(ctx, method);
+
+            // Perform the request
+            auto result = curl_easy_perform(_handle);
+            complete_transfer(ctx, result);
+            if (ctx.body_error) {
+                rethrow_exception(ctx.body_error);
+            }
+            if (ctx.aborted) {
+                LOG_DEBUG("request aborted while receiving the response body (status {1}).", res.status_code());
+                return res;
+            }
+            if (auto delay = retry_delay(ctx, result, attempt, start)) {
+                this_thread::sleep_for(*delay);
+                continue;
+            }
+            if (result != CURLE_OK) {
+                throw http_request_exception(req, curl_easy_strerror(result));
+            }
 
+            LOG_DEBUG("request completed (status {1}).", res.status_code());
+
+            // Set the body of the response
+            res.body(move(ctx.response_buffer));
+            return res;
+        }
+    }
+
+    void client::prepare(context& ctx, http_method method)
+    {
         // Reset the options
         curl_easy_reset(_handle);
 
@@ -147,6 +482,7 @@ namespace leatherman { namespace curl {
         // Setup the request
         set_method(ctx, method);
         set_url(ctx);
+        set_body_encoding(ctx);
         set_headers(ctx);
         set_cookies(ctx);
         set_body(ctx, method);
@@ -155,35 +491,184 @@ namespace leatherman { namespace curl {
         set_ca_info(ctx);
         set_client_info(ctx);
         set_client_protocols(ctx);
+        set_connection_reuse(ctx);
+    }
 
-        // Perform the request
-        auto result = curl_easy_perform(_handle);
-        if (result != CURLE_OK) {
-            throw http_request_exception(req, curl_easy_strerror(result));
+    // A file, or a range of it, being downloaded
+    struct client::download_segment
+    {
+        FILE* fp = nullptr;
+        // The range of the file written, or 0 to the maximum if not a range request
+        uint64_t start = 0;
+        uint64_t end = numeric_limits<uint64_t>::max();
+        uint64_t position = 0;
+        // The CRC-32 of the data written, from the start of the range
+        uLong crc = crc32(0, Z_NULL, 0);
+        bool ranged = false;
+        // Whether the bodies of error responses are written to the file
+        bool write_errors = true;
+        context* ctx = nullptr;
+        char errbuf[CURL_ERROR_SIZE] = { '\0' };
+
+        // For concurrent ranges, the client performing the range and its attempt
+        unique_ptr<client> handle;
+        unique_ptr<response> res;
+        unique_ptr<context> attempt_ctx;
+        unsigned int attempt = 0;
+        chrono::steady_clock::time_point retry_at;
+        bool done = false;
+    };
+
+    // Writes to the file at the given offset, so concurrent ranges can be written in place
+    static bool write_at(FILE* fp, char const* data, size_t size, uint64_t offset)
+    {
+#ifdef _WIN32
+        // Windows has no pwrite; the ranges are written on a single thread
+        int fd = ::_fileno(fp);
+        if (::_lseeki64(fd, static_cast<__int64>(offset), SEEK_SET) < 0) {
+            return false;
+        }
+        while (size > 0) {
+            auto written = ::_write(fd, data, static_cast<unsigned int>(min<size_t>(size, INT_MAX)));
+            if (written <= 0) {
+                return false;
+            }
+            data += written;
+            size -= written;
+        }
+#else
+        int fd = ::fileno(fp);
+        while (size > 0) {
+            auto written = ::pwrite(fd, data, size, static_cast<off_t>(offset));
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            data += written;
+            size -= written;
+            offset += written;
+        }
+#endif
+        return true;
+    }
+
+    // Allocates the file's blocks up front, so concurrent ranges don't fragment it
+    static void preallocate(FILE* fp, uint64_t size)
+    {
+#ifdef _WIN32
+        if (::_chsize_s(::_fileno(fp), static_cast<__int64>(size)) != 0) {
+            throw runtime_error(_("failed to allocate {1} bytes for the download.", size));
+        }
+#else
+        int fd = ::fileno(fp);
+#ifdef __linux__
+        int result = ::posix_fallocate(fd, 0, static_cast<off_t>(size));
+        if (result == 0) {
+            return;
+        }
+        // Not every file system supports allocating blocks; just size the file then
+        if (result != EINVAL && result != EOPNOTSUPP) {
+            throw runtime_error(_("failed to allocate {1} bytes for the download: {2}.", size, strerror(result)));
+        }
+#endif
+        if (::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+            throw runtime_error(_("failed to allocate {1} bytes for the download: {2}.", size, strerror(errno)));
+        }
+#endif
+    }
+
+    // Computes the CRC-32 of the start of a file, as a resumed download continues it
+    static uLong file_crc32(fs::path const& path, uint64_t size)
+    {
+        uLong crc = crc32(0, Z_NULL, 0);
+        boost::nowide::ifstream in(path.string(), ios::binary);
+        vector<char> buffer(64 * 1024);
+        while (size > 0 && in.read(buffer.data(), static_cast<streamsize>(min<uint64_t>(buffer.size(), size)))) {
+            crc = crc32(crc, reinterpret_cast<Bytef*>(buffer.data()), static_cast<uInt>(in.gcount()));
+            size -= in.gcount();
         }
+        return crc;
+    }
 
-        LOG_DEBUG("request completed (status {1}).", res.status_code());
+    // Gets the total size of a file from the Content-Range of a response, e.g. "bytes */1234"
+    static boost::optional<uint64_t> content_range_size(response const& res)
+    {
+        auto range = res.header("Content-Range");
+        if (!range) {
+            return boost::none;
+        }
+        auto pos = range->rfind('/');
+        if (pos != string::npos) {
+            try {
+                return stoull(range->substr(pos + 1));
+            } catch (logic_error&) {
+            }
+        }
+        return boost::none;
+    }
 
-        // Set the body of the response
-        res.body(move(ctx.response_buffer));
-        return res;
+    // Throws the exception of a failed download, removing its temporary file unless it is kept to be resumed
+    [[noreturn]] static void fail_download(request const& req, string const& file_path, fs::path const& temp_path,
+                                           bool discard, char const* message)
+    {
+        if (!discard) {
+            throw http_file_download_exception(req, file_path, temp_path.string(), message);
+        }
+        boost::system::error_code ec;
+        fs::remove(temp_path, ec);
+        if (ec) {
+            throw http_file_download_exception(req, file_path, temp_path.string(),
+                                               _("{1} and failed to remove temporary file {2}", message, temp_path.string()));
+        }
+        throw http_file_download_exception(req, file_path, message);
     }
 
     void client::download_file(request const& req, std::string const& file_path, boost::optional<fs::perms> perms)
     {
-        response res;
-        context ctx(req, res);
+        download_file_impl(req, file_path, nullptr, perms);
+    }
 
-        // Reset the options
-        curl_easy_reset(_handle);
+    void client::download_file(request const& req, std::string const& file_path, download_options const& options, boost::optional<fs::perms> perms)
+    {
+        download_file_impl(req, file_path, &options, perms);
+    }
 
-        CURLcode result = CURLE_OK;
-        char errbuf[CURL_ERROR_SIZE] = { '\0' };
+    void client::download_file_impl(request const& req, std::string const& file_path, download_options const* options, boost::optional<fs::perms> perms)
+    {
+        bool keep = options && options->resume;
+        bool discard = !keep;
         FILE* fp = nullptr;
         fs::path temp_path = fs::path("");
         try {
-            temp_path = fs::path(file_path).parent_path() / fs::unique_path("temp_file_%%%%-%%%%-%%%%-%%%%");
-            fp = boost::nowide::fopen(temp_path.string().c_str(), "wb");
+            uint64_t resume_from = 0;
+            if (keep) {
+                temp_path = fs::path(file_path + ".part");
+                boost::system::error_code ec;
+                auto size = fs::file_size(temp_path, ec);
+                if (!ec) {
+                    resume_from = size;
+                }
+            } else {
+                temp_path = fs::path(file_path).parent_path() / fs::unique_path("temp_file_%%%%-%%%%-%%%%-%%%%");
+            }
+
+            // Download concurrent ranges if the server supports them, and the file is large enough
+            boost::optional<uint64_t> ranged;
+            if (options && options->segments > 1) {
+                ranged = ranged_size(req);
+                if (ranged && *ranged < 2 * max<uint64_t>(options->min_segment_size, 1)) {
+                    ranged = boost::none;
+                }
+            }
+            if (ranged) {
+                // The ranges written aren't known to a later download, so a failed one can't be resumed
+                resume_from = 0;
+                discard = true;
+            }
+
+            fp = boost::nowide::fopen(temp_path.string().c_str(), resume_from > 0 ? "ab" : "wb");
             if (!fp) {
                 throw http_file_download_exception(req, file_path, _("Failed to open temporary file for writing"));
             }
@@ -196,27 +681,88 @@ namespace leatherman { namespace curl {
                 }
             }
 
-            curl_easy_setopt_maybe(ctx, CURLOPT_NOPROGRESS, 1);
-            curl_easy_setopt_maybe(ctx, CURLOPT_WRITEFUNCTION, write_file);
-            curl_easy_setopt_maybe(ctx, CURLOPT_WRITEDATA, fp);
-
-            // Setup the remaining request
-            set_url(ctx);
-            set_headers(ctx);
-            set_timeouts(ctx);
-            set_ca_info(ctx);
-            set_client_info(ctx);
-            set_client_protocols(ctx);
+            uLong crc = 0;
+            if (ranged) {
+                crc = download_segments(req, fp, *ranged, *options);
+            } else {
+                download_segment segment;
+                segment.fp = fp;
+                segment.position = resume_from;
+                segment.write_errors = !options;
+                if (resume_from > 0 && options->crc32) {
+                    segment.crc = file_crc32(temp_path, resume_from);
+                }
 
-            // More detailed error messages
-            curl_easy_setopt_maybe(ctx, CURLOPT_ERRORBUFFER, errbuf);
+                auto start = chrono::steady_clock::now();
+                for (unsigned int attempt = 1;; ++attempt) {
+                    response res;
+                    context ctx(req, res);
+                    ctx.download = true;
+                    start_attempt(ctx, attempt, start);
+                    segment.ctx = &ctx;
+
+                    prepare_download(ctx, segment);
+
+                    // Perform the request
+                    auto result = curl_easy_perform(_handle);
+                    complete_transfer(ctx, result);
+
+                    // The file is complete if the server has nothing past what was already received
+                    if (segment.position > 0 && res.status_code() == 416 && content_range_size(res) == segment.position) {
+                        LOG_DEBUG("download of {1} was already complete.", req.url());
+                        break;
+                    }
+
+                    // Start again from the first byte if the server doesn't support ranges;
+                    // this isn't counted as an attempt, as it happens once at most
+                    bool restart = segment.position > 0 && (result == CURLE_RANGE_ERROR || res.status_code() == 416);
+                    auto delay = restart ? boost::make_optional(chrono::milliseconds(0)) : retry_delay(ctx, result, attempt, start);
+                    if (!delay) {
+                        if (result != CURLE_OK) {
+                            throw http_request_exception(req, segment.errbuf[0] ? segment.errbuf : curl_easy_strerror(result));
+                        }
+                        if (options && res.status_code() >= 400) {
+                            throw http_request_exception(req, _("download failed with HTTP status {1}.", res.status_code()));
+                        }
+                        break;
+                    }
+                    if (restart) {
+                        --attempt;
+                    }
+
+                    // Discard what was written only when it isn't part of the file: after a restart, or
+                    // the body of a retried response if it was written; any other failure, including
+                    // a retried status whose body was kept out of the file, is resumed from the last byte
+                    if (fflush(fp) != 0) {
+                        throw http_request_exception(req, _("Failed to write to temporary file"));
+                    }
+                    if (restart || (segment.write_errors && res.status_code() >= 300)) {
+                        fclose(fp);
+                        fp = segment.fp = boost::nowide::fopen(temp_path.string().c_str(), "wb");
+                        if (!fp) {
+                            throw http_file_download_exception(req, file_path, _("Failed to open temporary file for writing"));
+                        }
+                        segment.position = 0;
+                        segment.crc = crc32(0, Z_NULL, 0);
+                    } else {
+                        LOG_DEBUG("resuming download from byte {1}.", segment.position);
+                    }
+                    this_thread::sleep_for(*delay);
+                }
+                crc = segment.crc;
+            }
+            if (fclose(fp) != 0) {
+                fp = nullptr;
+                throw http_request_exception(req, _("Failed to write to temporary file"));
+            }
+            fp = nullptr;
 
-            // Perform the request
-            result = curl_easy_perform(_handle);
-            if (result != CURLE_OK) {
-                throw http_request_exception(req, errbuf);
+            if (options && options->crc32 && crc != *options->crc32) {
+                discard = true;
+                throw http_request_exception(req, _("the downloaded file's CRC-32 {1} doesn't match the expected {2}.",
+                                                    (boost::format("%08x") % crc).str(),
+                                                    (boost::format("%08x") % *options->crc32).str()));
             }
-            fclose(fp);
 
             LOG_DEBUG("download completed, now writing result to file {1}", file_path);
             fs::rename(temp_path, file_path);
@@ -224,17 +770,229 @@ namespace leatherman { namespace curl {
             // so that the code in the lower catch block is not hit
             throw e;
         } catch (http_request_exception& e) {
-            fclose(fp);
-            boost::system::error_code ec;
-            fs::remove(temp_path, ec);
-            if (ec) {
-                throw http_file_download_exception(e.req(), file_path, temp_path.string(),
-                                                   _("{1} and failed to remove temporary file {2}", e.what(), temp_path.string()));
-            }
-            throw http_file_download_exception(e.req(), file_path, e.what());
+            if (fp) {
+                fclose(fp);
+            }
+            fail_download(e.req(), file_path, temp_path, discard, e.what());
         } catch (fs::filesystem_error& e) {
             throw http_file_download_exception(req, file_path, e.what());
+        } catch (runtime_error& e) {
+            if (fp) {
+                fclose(fp);
+            }
+            fail_download(req, file_path, temp_path, discard, e.what());
+        }
+    }
+
+    void client::prepare_download(context& ctx, download_segment& segment)
+    {
+        // Reset the options
+        curl_easy_reset(_handle);
+
+        curl_easy_setopt_maybe(ctx, CURLOPT_NOPROGRESS, 1);
+        curl_easy_setopt_maybe(ctx, CURLOPT_HEADERFUNCTION, write_header);
+        curl_easy_setopt_maybe(ctx, CURLOPT_HEADERDATA, &ctx);
+        curl_easy_setopt_maybe(ctx, CURLOPT_WRITEFUNCTION, write_segment);
+        curl_easy_setopt_maybe(ctx, CURLOPT_WRITEDATA, &segment);
+        if (segment.ranged) {
+            auto range = to_string(segment.position) + "-" + to_string(segment.end - 1);
+            curl_easy_setopt_maybe(ctx, CURLOPT_RANGE, range.c_str());
+        } else if (segment.position > 0) {
+            curl_easy_setopt_maybe(ctx, CURLOPT_RESUME_FROM_LARGE, static_cast<curl_off_t>(segment.position));
+        }
+
+        // Setup the remaining request
+        set_url(ctx);
+        set_headers(ctx);
+        set_timeouts(ctx);
+        set_ca_info(ctx);
+        set_client_info(ctx);
+        set_client_protocols(ctx);
+        set_connection_reuse(ctx);
+
+        // More detailed error messages
+        segment.errbuf[0] = '\0';
+        curl_easy_setopt_maybe(ctx, CURLOPT_ERRORBUFFER, segment.errbuf);
+    }
+
+    boost::optional<uint64_t> client::ranged_size(request const& req)
+    {
+        response res;
+        context ctx(req, res);
+        ctx.download = true;
+
+        curl_easy_reset(_handle);
+        curl_easy_setopt_maybe(ctx, CURLOPT_NOPROGRESS, 1);
+        curl_easy_setopt_maybe(ctx, CURLOPT_NOBODY, 1);
+        curl_easy_setopt_maybe(ctx, CURLOPT_HEADERFUNCTION, write_header);
+        curl_easy_setopt_maybe(ctx, CURLOPT_HEADERDATA, &ctx);
+        set_url(ctx);
+        set_headers(ctx);
+        set_timeouts(ctx);
+        set_ca_info(ctx);
+        set_client_info(ctx);
+        set_client_protocols(ctx);
+        set_connection_reuse(ctx);
+
+        // If the server can't tell, the file is downloaded in a single transfer, which reports any error
+        auto result = curl_easy_perform(_handle);
+        complete_transfer(ctx, result);
+        if (result != CURLE_OK || res.status_code() != 200) {
+            return boost::none;
+        }
+        auto ranges = res.header("Accept-Ranges");
+        auto length = res.header("Content-Length");
+        boost::optional<uint64_t> size;
+        if (length) {
+            try {
+                size = stoull(*length);
+            } catch (logic_error&) {
+            }
+        }
+        if (!ranges || !boost::icontains(*ranges, "bytes") || !size) {
+            LOG_DEBUG("{1} doesn't support range requests; downloading it in a single transfer.", req.url());
+            return boost::none;
+        }
+        return size;
+    }
+
+    uint32_t client::download_segments(request const& req, FILE* fp, uint64_t size, download_options const& options)
+    {
+        preallocate(fp, size);
+
+        // Split the file into ranges of at least the minimum size
+        auto count = static_cast<uint64_t>(options.segments);
+        count = max<uint64_t>(min(count, size / max<uint64_t>(options.min_segment_size, 1)), 1);
+        vector<unique_ptr<download_segment>> segments;
+        for (uint64_t i = 0; i < count; ++i) {
+            unique_ptr<download_segment> segment(new download_segment());
+            segment->fp = fp;
+            segment->start = segment->position = size * i / count;
+            segment->end = size * (i + 1) / count;
+            segment->ranged = true;
+            segment->write_errors = false;
+            segment->handle.reset(new client());
+            auto& c = *segment->handle;
+            c._ca_cert = _ca_cert;
+            c._client_cert = _client_cert;
+            c._client_key = _client_key;
+            c._client_protocols = _client_protocols;
+            c._retry = _retry;
+            c._share = _share;
+            segments.push_back(move(segment));
         }
+        LOG_DEBUG("downloading {1} in {2} ranges.", req.url(), count);
+
+        curl_multi_handle multi;
+        if (!multi) {
+            throw http_request_exception(req, _("failed to create cURL multi handle."));
+        }
+        map<CURL*, download_segment*> active;
+        util::scope_exit remove_active([&]() {
+            for (auto const& transfer : active) {
+                curl_multi_remove_handle(multi, transfer.first);
+            }
+        });
+
+        auto start = chrono::steady_clock::now();
+        size_t done = 0;
+        while (done < segments.size()) {
+            // Start the ranges due to be (re)started
+            auto now = chrono::steady_clock::now();
+            auto next_start = chrono::steady_clock::time_point::max();
+            for (auto& segment : segments) {
+                CURL* handle = segment->handle->_handle;
+                if (segment->done || active.count(handle)) {
+                    continue;
+                }
+                if (segment->retry_at > now) {
+                    next_start = min(next_start, segment->retry_at);
+                    continue;
+                }
+                segment->res.reset(new response());
+                segment->attempt_ctx.reset(new context(req, *segment->res));
+                auto& ctx = *segment->attempt_ctx;
+                ctx.download = true;
+                segment->ctx = &ctx;
+                segment->handle->start_attempt(ctx, ++segment->attempt, start);
+                segment->handle->prepare_download(ctx, *segment);
+                auto result = curl_multi_add_handle(multi, handle);
+                if (result != CURLM_OK) {
+                    throw http_request_exception(req, curl_multi_strerror(result));
+                }
+                active.emplace(handle, segment.get());
+            }
+
+            int running = 0;
+            auto result = curl_multi_perform(multi, &running);
+            if (result != CURLM_OK) {
+                throw http_request_exception(req, curl_multi_strerror(result));
+            }
+
+            bool completed = false;
+            int queued = 0;
+            while (CURLMsg* msg = curl_multi_info_read(multi, &queued)) {
+                if (msg->msg != CURLMSG_DONE) {
+                    continue;
+                }
+                completed = true;
+                auto it = active.find(msg->easy_handle);
+                if (it == active.end()) {
+                    continue;
+                }
+                auto& segment = *it->second;
+                curl_multi_remove_handle(multi, msg->easy_handle);
+                active.erase(it);
+                // A range cut short is resumed like a failed transfer
+                auto code = msg->data.result;
+                segment.handle->complete_transfer(*segment.attempt_ctx, code);
+                auto status = segment.res->status_code();
+                if (code == CURLE_OK && status == 206 && segment.position != segment.end) {
+                    code = CURLE_PARTIAL_FILE;
+                }
+                if (code == CURLE_OK && status == 206) {
+                    segment.done = true;
+                    ++done;
+                    continue;
+                }
+                auto delay = segment.handle->retry_delay(*segment.attempt_ctx, code, segment.attempt, start);
+                if (!delay) {
+                    if (code != CURLE_OK) {
+                        throw http_request_exception(req, segment.errbuf[0] ? segment.errbuf : curl_easy_strerror(code));
+                    }
+                    throw http_request_exception(req, status == 200 ?
+                        _("the server ignored the range request.") :
+                        _("download failed with HTTP status {1}.", status));
+                }
+                segment.retry_at = chrono::steady_clock::now() + *delay;
+            }
+
+            if (completed || done == segments.size() || (running == 0 && active.empty() && next_start == chrono::steady_clock::time_point::max())) {
+                continue;
+            }
+
+            // Wait for activity, or until a range is due to be retried
+            auto timeout = chrono::milliseconds(1000);
+            if (next_start != chrono::steady_clock::time_point::max()) {
+                timeout = min(timeout, chrono::duration_cast<chrono::milliseconds>(next_start - chrono::steady_clock::now()));
+                timeout = max(timeout, chrono::milliseconds(0));
+            }
+#if LIBCURL_VERSION_NUM >= 0x074200
+            result = curl_multi_poll(multi, nullptr, 0, static_cast<int>(timeout.count()), nullptr);
+#else
+            result = curl_multi_wait(multi, nullptr, 0, static_cast<int>(timeout.count()), nullptr);
+#endif
+            if (result != CURLM_OK) {
+                throw http_request_exception(req, curl_multi_strerror(result));
+            }
+        }
+
+        // Combine the checksums of the ranges, in order
+        uLong crc = segments.front()->crc;
+        for (size_t i = 1; i < segments.size(); ++i) {
+            crc = crc32_combine(crc, segments[i]->crc, static_cast<z_off_t>(segments[i]->end - segments[i]->start));
+        }
+        return static_cast<uint32_t>(crc);
     }
 
     void client::set_ca_cert(string const& cert_file)
@@ -252,6 +1010,88 @@ namespace leatherman { namespace curl {
         _client_protocols = client_protocols;
     }
 
+    void client::set_share(shared_ptr<curl_share> share)
+    {
+        // Detach the handle before releasing the previous share, which
+        // can't be cleaned up while in use
+        curl_easy_setopt(_handle, CURLOPT_SHARE, static_cast<CURLSH*>(nullptr));
+        _share = move(share);
+    }
+
+    void client::set_accept_encoding(string encodings)
+    {
+        _accept_encoding = move(encodings);
+    }
+
+    void client::set_body_compression(content_encoding encoding, int level)
+    {
+        _body_encoding = encoding;
+        _body_compression_level = level < -1 ? -1 : min(level, 9);
+    }
+
+    void client::set_retry_policy(retry_policy policy)
+    {
+        _retry = move(policy);
+    }
+
+    void client::start_attempt(context& ctx, unsigned int attempt, chrono::steady_clock::time_point start)
+    {
+        if (attempt < _retry.max_attempts) {
+            ctx.retry_statuses = &_retry.retryable_statuses;
+        }
+        if (_retry.deadline.count() > 0) {
+            auto left = chrono::duration_cast<chrono::milliseconds>(start + _retry.deadline - chrono::steady_clock::now());
+            ctx.deadline_timeout = static_cast<long>(max<long long>(left.count(), 1));
+        }
+    }
+
+    boost::optional<chrono::milliseconds> client::retry_delay(
+        context const& ctx, CURLcode result, unsigned int attempt, chrono::steady_clock::time_point start) const
+    {
+        if (attempt >= _retry.max_attempts) {
+            return boost::none;
+        }
+        if (result == CURLE_OK ?
+                _retry.retryable_statuses.count(ctx.res.status_code()) == 0 :
+                _retry.retryable_errors.count(result) == 0) {
+            return boost::none;
+        }
+
+        // The request body must be read again, and the response body not yet passed on
+        if (ctx.upload && !ctx.upload->seekable() && ctx.read_offset > 0) {
+            return boost::none;
+        }
+        if (ctx.on_body && ctx.body_size > 0) {
+            return boost::none;
+        }
+
+        auto delay = _retry.backoff(attempt);
+        if (result == CURLE_OK && _retry.honor_retry_after) {
+            auto retry_after_header = ctx.res.header("Retry-After");
+            if (retry_after_header) {
+                if (auto retry_after = parse_retry_after(*retry_after_header)) {
+                    if (*retry_after > _retry.max_delay) {
+                        LOG_DEBUG("not retrying request to {1}: the server asked to wait {2}ms, longer than the maximum delay.",
+                                  ctx.req.url(), retry_after->count());
+                        return boost::none;
+                    }
+                    delay = *retry_after;
+                }
+            }
+        }
+
+        if (_retry.deadline.count() > 0 && chrono::steady_clock::now() + delay >= start + _retry.deadline) {
+            LOG_DEBUG("not retrying request to {1}: the retry deadline would pass.", ctx.req.url());
+            return boost::none;
+        }
+
+        LOG_DEBUG("attempt {1} of request to {2} failed ({3}); retrying in {4}ms.",
+                  attempt, ctx.req.url(),
+                  result == CURLE_OK ? _("status {1}", ctx.res.status_code()) : string(curl_easy_strerror(result)),
+                  delay.count());
+        return delay;
+    }
+
     void client::set_method(context& ctx, http_method method)
     {
         switch (method) {
@@ -281,12 +1121,34 @@ namespace leatherman { namespace curl {
         LOG_DEBUG("requesting {1}.", ctx.req.url());
     }
 
+    void client::set_body_encoding(context& ctx)
+    {
+        // Decode the response bodies of the encodings accepted
+        curl_easy_setopt_maybe(ctx, CURLOPT_ACCEPT_ENCODING, _accept_encoding.c_str());
+
+        ctx.upload = ctx.req.streamed_body();
+        if (_body_encoding != content_encoding::identity && (ctx.upload || !ctx.req.body().empty())) {
+            ctx.upload = make_shared<deflate_body_source>(ctx.req, _body_encoding, _body_compression_level);
+        }
+    }
+
     void client::set_headers(context& ctx)
     {
+        bool chunked = false;
         ctx.req.each_header([&](string const& name, string const& value) {
+            chunked = chunked || boost::iequals(name, "Transfer-Encoding");
             ctx.request_headers.append(name + ": " + value);
             return true;
         });
+
+        if (dynamic_pointer_cast<deflate_body_source>(ctx.upload)) {
+            ctx.request_headers.append(_body_encoding == content_encoding::gzip ? "Content-Encoding: gzip" : "Content-Encoding: deflate");
+        }
+
+        // A streamed body of unknown size is sent in chunks, as it's read
+        if (!chunked && ctx.upload && ctx.upload->size() < 0) {
+            ctx.request_headers.append("Transfer-Encoding: chunked");
+        }
         curl_easy_setopt_maybe(ctx, CURLOPT_HTTPHEADER, static_cast<curl_slist*>(ctx.request_headers));
     }
 
@@ -310,13 +1172,14 @@ namespace leatherman { namespace curl {
         curl_easy_setopt_maybe(ctx, CURLOPT_SEEKFUNCTION, seek_body);
         curl_easy_setopt_maybe(ctx, CURLOPT_SEEKDATA, &ctx);
 
+        curl_off_t size = ctx.upload ? ctx.upload->size() : static_cast<curl_off_t>(ctx.req.body().size());
         switch (method) {
             case http_method::post: {
-                curl_easy_setopt_maybe(ctx, CURLOPT_POSTFIELDSIZE_LARGE, ctx.req.body().size());
+                curl_easy_setopt_maybe(ctx, CURLOPT_POSTFIELDSIZE_LARGE, size);
                 break;
             }
             case http_method::put: {
-                curl_easy_setopt_maybe(ctx, CURLOPT_INFILESIZE_LARGE, ctx.req.body().size());
+                curl_easy_setopt_maybe(ctx, CURLOPT_INFILESIZE_LARGE, size);
                 break;
             }
             default:
@@ -326,8 +1189,13 @@ namespace leatherman { namespace curl {
 
     void client::set_timeouts(context& ctx)
     {
+        // End the attempt by the retry deadline
+        long timeout = ctx.req.timeout();
+        if (ctx.deadline_timeout > 0 && (timeout == 0 || ctx.deadline_timeout < timeout)) {
+            timeout = ctx.deadline_timeout;
+        }
         curl_easy_setopt_maybe(ctx, CURLOPT_CONNECTTIMEOUT_MS, ctx.req.connection_timeout());
-        curl_easy_setopt_maybe(ctx, CURLOPT_TIMEOUT_MS, ctx.req.timeout());
+        curl_easy_setopt_maybe(ctx, CURLOPT_TIMEOUT_MS, timeout);
     }
 
     void client::set_write_callbacks(context& ctx)
@@ -359,13 +1227,165 @@ namespace leatherman { namespace curl {
         curl_easy_setopt_maybe(ctx, CURLOPT_PROTOCOLS, _client_protocols);
     }
 
+    void client::set_connection_reuse(context& ctx)
+    {
+        // Keep idle connections open, e.g. through NATs and firewalls,
+        // until they are reused
+        curl_easy_setopt_maybe(ctx, CURLOPT_TCP_KEEPALIVE, 1L);
+
+        // Set on every request, as the share may have changed since the last one
+        curl_easy_setopt_maybe(ctx, CURLOPT_SHARE, _share ? static_cast<CURLSH*>(*_share) : nullptr);
+    }
+
+    // Gets a time of a transfer, in microseconds
+    static chrono::microseconds get_time(CURL* handle, CURLINFO info, CURLINFO seconds_info)
+    {
+#if LIBCURL_VERSION_NUM >= 0x073d00
+        curl_off_t time = 0;
+        if (curl_easy_getinfo(handle, info, &time) == CURLE_OK) {
+            return chrono::microseconds(time);
+        }
+#endif
+        double seconds = 0;
+        if (curl_easy_getinfo(handle, seconds_info, &seconds) == CURLE_OK) {
+            return chrono::microseconds(static_cast<int64_t>(seconds * 1000000));
+        }
+        return chrono::microseconds(0);
+    }
+
+    // Gets a size or speed of a transfer, given by the curl_off_t info where cURL has it and the double one otherwise
+    static uint64_t get_size(CURL* handle, CURLINFO info)
+    {
+#if LIBCURL_VERSION_NUM >= 0x073700
+        curl_off_t size = 0;
+#else
+        double size = 0;
+#endif
+        if (curl_easy_getinfo(handle, info, &size) == CURLE_OK && size > 0) {
+            return static_cast<uint64_t>(size);
+        }
+        return 0;
+    }
+
+    static long get_long(CURL* handle, CURLINFO info)
+    {
+        long value = 0;
+        if (curl_easy_getinfo(handle, info, &value) != CURLE_OK) {
+            return 0;
+        }
+        return value;
+    }
+
+    // The observer of every client's transfers; copied to be called outside the lock
+    static mutex transfer_observer_mutex;
+    static shared_ptr<client::transfer_observer> observer_of_transfers;
+
+    void client::set_transfer_observer(transfer_observer observer)
+    {
+        shared_ptr<transfer_observer> replacement;
+        if (observer) {
+            replacement = make_shared<transfer_observer>(move(observer));
+        }
+        lock_guard<mutex> lock(transfer_observer_mutex);
+        observer_of_transfers = move(replacement);
+    }
+
+    void client::complete_transfer(context& ctx, CURLcode result)
+    {
+        set_transfer_info(ctx);
+
+        shared_ptr<transfer_observer> observer;
+        {
+            lock_guard<mutex> lock(transfer_observer_mutex);
+            observer = observer_of_transfers;
+        }
+        if (!observer) {
+            return;
+        }
+        // Metrics mustn't fail a request
+        try {
+            (*observer)(ctx.req, ctx.res, result);
+        } catch (exception& e) {
+            LOG_WARNING("transfer observer failed: {1}", e.what());
+        }
+    }
+
+    void client::set_transfer_info(context& ctx)
+    {
+        // cURL's status code is that of the final response, whichever the protocol version
+        long status_code = 0;
+        if (curl_easy_getinfo(_handle, CURLINFO_RESPONSE_CODE, &status_code) == CURLE_OK && status_code != 0) {
+            ctx.res.status_code(static_cast<int>(status_code));
+        }
+
+        transfer_sizes sent;
+        sent.transferred = ctx.read_offset;
+        auto encoder = dynamic_pointer_cast<deflate_body_source>(ctx.upload);
+        sent.body = encoder ? encoder->consumed() : ctx.read_offset;
+        ctx.res.request_sizes(sent);
+
+        // cURL counts the response body as received, before decoding it
+        transfer_sizes received;
+        received.body = ctx.body_size;
+        received.transferred = ctx.body_size;
+#if LIBCURL_VERSION_NUM >= 0x073700
+        curl_off_t downloaded = 0;
+        if (curl_easy_getinfo(_handle, CURLINFO_SIZE_DOWNLOAD_T, &downloaded) == CURLE_OK && downloaded > 0) {
+            received.transferred = static_cast<uint64_t>(downloaded);
+        }
+#endif
+        ctx.res.response_sizes(received);
+
+        transfer_metrics metrics;
+        metrics.name_lookup = get_time(_handle, CURLINFO_NAMELOOKUP_TIME_T, CURLINFO_NAMELOOKUP_TIME);
+        metrics.connect = get_time(_handle, CURLINFO_CONNECT_TIME_T, CURLINFO_CONNECT_TIME);
+        metrics.app_connect = get_time(_handle, CURLINFO_APPCONNECT_TIME_T, CURLINFO_APPCONNECT_TIME);
+        metrics.pre_transfer = get_time(_handle, CURLINFO_PRETRANSFER_TIME_T, CURLINFO_PRETRANSFER_TIME);
+        metrics.start_transfer = get_time(_handle, CURLINFO_STARTTRANSFER_TIME_T, CURLINFO_STARTTRANSFER_TIME);
+        metrics.total = get_time(_handle, CURLINFO_TOTAL_TIME_T, CURLINFO_TOTAL_TIME);
+        metrics.redirect = get_time(_handle, CURLINFO_REDIRECT_TIME_T, CURLINFO_REDIRECT_TIME);
+        metrics.redirects = get_long(_handle, CURLINFO_REDIRECT_COUNT);
+        metrics.request_size = static_cast<uint64_t>(max(get_long(_handle, CURLINFO_REQUEST_SIZE), 0L));
+        metrics.header_size = static_cast<uint64_t>(max(get_long(_handle, CURLINFO_HEADER_SIZE), 0L));
+#if LIBCURL_VERSION_NUM >= 0x073700
+        metrics.upload_speed = get_size(_handle, CURLINFO_SPEED_UPLOAD_T);
+        metrics.download_speed = get_size(_handle, CURLINFO_SPEED_DOWNLOAD_T);
+#else
+        metrics.upload_speed = get_size(_handle, CURLINFO_SPEED_UPLOAD);
+        metrics.download_speed = get_size(_handle, CURLINFO_SPEED_DOWNLOAD);
+#endif
+
+        // cURL counts the connections the transfer opened; none were if it reused one to send the request
+        long connects = 0;
+        metrics.connection_reused = curl_easy_getinfo(_handle, CURLINFO_NUM_CONNECTS, &connects) == CURLE_OK &&
+                                    connects == 0 && metrics.pre_transfer.count() > 0;
+#if LIBCURL_VERSION_NUM >= 0x073200
+        metrics.http_version = get_long(_handle, CURLINFO_HTTP_VERSION);
+#endif
+        ctx.res.metrics(metrics);
+    }
+
     size_t client::read_body(char* buffer, size_t size, size_t count, void* ptr)
     {
         auto ctx = reinterpret_cast<context*>(ptr);
         size_t requested = size * count;
 
+        if (ctx->upload) {
+            try {
+                auto read = ctx->upload->read(buffer, requested, ctx->read_offset);
+                ctx->read_offset += read;
+                return read;
+            } catch (...) {
+                ctx->body_error = current_exception();
+                return CURL_READFUNC_ABORT;
+            }
+        }
+
         auto const& body = ctx->req.body();
 
+        if (ctx->read_offset >= body.size()) {
+            return 0;
+        }
         if (requested > (body.size() - ctx->read_offset)) {
             requested = (body.size() - ctx->read_offset);
         }
@@ -392,10 +1412,47 @@ namespace leatherman { namespace curl {
             return CURL_SEEKFUNC_FAIL;
         }
 
+        // A body read in order can't be rewound; let cURL decide whether to go on
+        if (ctx->upload && !ctx->upload->seekable()) {
+            return static_cast<uint64_t>(offset) == ctx->read_offset ? CURL_SEEKFUNC_OK : CURL_SEEKFUNC_CANTSEEK;
+        }
+
         ctx->read_offset = offset;
         return CURL_SEEKFUNC_OK;
     }
 
+    // Trims the whitespace around a header name or value
+    static boost::string_ref trim_header(boost::string_ref input)
+    {
+        while (!input.empty() && isspace(static_cast<unsigned char>(input.front()))) {
+            input.remove_prefix(1);
+        }
+        while (!input.empty() && isspace(static_cast<unsigned char>(input.back()))) {
+            input.remove_suffix(1);
+        }
+        return input;
+    }
+
+    // Parses the status code of a status line, e.g. "HTTP/1.1 200 OK" or "HTTP/2 200"
+    static int parse_status_code(boost::string_ref line)
+    {
+        auto pos = line.find(' ');
+        if (pos == boost::string_ref::npos || line.size() < pos + 4) {
+            return 0;
+        }
+        int status_code = 0;
+        for (auto c : line.substr(pos + 1, 3)) {
+            if (c < '0' || c > '9') {
+                return 0;
+            }
+            status_code = status_code * 10 + (c - '0');
+        }
+        if (line.size() > pos + 4 && !isspace(static_cast<unsigned char>(line[pos + 4]))) {
+            return 0;
+        }
+        return status_code;
+    }
+
     size_t client::write_header(char* buffer, size_t size, size_t count, void* ptr)
     {
         size_t written = size * count;
@@ -408,10 +1465,9 @@ namespace leatherman { namespace curl {
             // Reset the response buffer
             ctx->response_buffer.clear();
 
-            // Parse out the error code
-            static boost::regex regex("HTTP/\\d\\.\\d (\\d\\d\\d).*");
-            int status_code = 0;
-            if (util::re_search(input.to_string(), regex, &status_code)) {
+            // Parse out the status code; cURL's replaces it once the transfer completes
+            int status_code = parse_status_code(input);
+            if (status_code != 0) {
                 ctx->res.status_code(status_code);
             }
             return written;
@@ -420,26 +1476,25 @@ namespace leatherman { namespace curl {
             return written;
         }
 
-        auto pos = input.find_first_of(':');
+        auto pos = input.find(':');
         if (pos == boost::string_ref::npos) {
             LOG_WARNING("unexpected HTTP response header: {1}.", input);
             return written;
         }
 
-        auto name = input.substr(0, pos).to_string();
-        auto value = input.substr(pos + 1).to_string();
-        boost::trim(name);
-        boost::trim(value);
+        auto name = trim_header(input.substr(0, pos));
+        auto value = trim_header(input.substr(pos + 1));
 
         // If this is the "Content-Length" header, reserve the response buffer as an optimization
-        if (name == "Content-Length") {
+        static const boost::string_ref content_length("Content-Length");
+        if (!ctx->on_body && !ctx->download && name.size() == content_length.size() && boost::iequals(name, content_length)) {
             try {
-                ctx->response_buffer.reserve(stoi(value));
+                ctx->response_buffer.reserve(stoi(value.to_string()));
             } catch (logic_error&) {
             }
         }
 
-        ctx->res.add_header(move(name), move(value));
+        ctx->res.add_header(name.to_string(), value.to_string());
         return written;
     }
 
@@ -448,16 +1503,52 @@ namespace leatherman { namespace curl {
         size_t written = size * count;
 
         auto ctx = reinterpret_cast<context*>(ptr);
-        if (written > 0) {
+        if (ctx->on_body && ctx->retry_statuses && ctx->retry_statuses->count(ctx->res.status_code())) {
+            // Drop the body of a response that will be retried rather than pass it on
+            return written;
+        }
+        ctx->body_size += written;
+        if (ctx->on_body) {
+            // Exceptions can't propagate through libcurl; rethrow them once it returns
+            try {
+                if (!(*ctx->on_body)(ctx->res, buffer, written)) {
+                    ctx->aborted = true;
+                    return 0;
+                }
+            } catch (...) {
+                ctx->body_error = current_exception();
+                return 0;
+            }
+        } else if (written > 0) {
             ctx->response_buffer.append(buffer, written);
         }
 
         return written;
     }
 
-    size_t client::write_file(char *buffer, size_t size, size_t count, void* ptr)
+    size_t client::write_segment(char *buffer, size_t size, size_t count, void* ptr)
     {
-        return fwrite(buffer, size, count, reinterpret_cast<FILE*>(ptr));
+        size_t written = size * count;
+        auto segment = reinterpret_cast<download_segment*>(ptr);
+
+        // Keep the body of an error response out of the file
+        int status = segment->ctx->res.status_code();
+        if (!segment->write_errors && status >= 300) {
+            return written;
+        }
+
+        if (segment->ranged) {
+            // Fail a range the server ignored or overran
+            if (status != 206 || written > segment->end - segment->position ||
+                !write_at(segment->fp, buffer, written, segment->position)) {
+                return 0;
+            }
+        } else if (fwrite(buffer, 1, written, segment->fp) != written) {
+            return 0;
+        }
+        segment->crc = crc32(segment->crc, reinterpret_cast<Bytef*>(buffer), static_cast<uInt>(written));
+        segment->position += written;
+        return written;
     }
 
     int client::debug(CURL* handle, curl_infotype type, char* data, size_t size, void* ptr)
@@ -0,0 +1,298 @@
+#include <leatherman/curl/multi_client.hpp>
+#include <leatherman/logging/logging.hpp>
+#include <leatherman/locale/locale.hpp>
+
+// Mark string for translation (alias for leatherman::locale::format)
+using leatherman::locale::_;
+
+using namespace std;
+
+namespace leatherman { namespace curl {
+
+    // Gets the scheme and authority of a URL, which identify the host its connections go to
+    static string host_of(string const& url)
+    {
+        auto start = url.find("://");
+        start = start == string::npos ? 0 : start + 3;
+        return url.substr(0, url.find_first_of("/?#", start));
+    }
+
+    // A queued request, with the client whose handle performs it once started
+    struct multi_client::transfer
+    {
+        transfer(client::http_method method, request r, response_callback on_response, error_callback on_error) :
+            method(method),
+            req(move(r)),
+            host(host_of(req.url())),
+            ctx(req, res),
+            on_response(move(on_response)),
+            on_error(move(on_error))
+        {
+        }
+
+        client::http_method method;
+        request req;
+        string host;
+        response res;
+        client::context ctx;
+        response_callback on_response;
+        error_callback on_error;
+        unique_ptr<client> handle;
+    };
+
+    constexpr size_t multi_client::default_max_host_connections;
+
+    multi_client::multi_client()
+    {
+        if (!_handle) {
+            throw http_exception(_("failed to create cURL multi handle."));
+        }
+
+        // Multiplex requests to a host over a single HTTP/2 connection
+        auto result = curl_multi_setopt(_handle, CURLMOPT_PIPELINING, static_cast<long>(CURLPIPE_MULTIPLEX));
+        if (result != CURLM_OK) {
+            throw http_exception(curl_multi_strerror(result));
+        }
+    }
+
+    multi_client::~multi_client()
+    {
+        for (auto const& t : _transfers) {
+            curl_multi_remove_handle(_handle, t.first);
+        }
+    }
+
+    void multi_client::get(request req, response_callback on_response, error_callback on_error)
+    {
+        add(client::http_method::get, move(req), move(on_response), move(on_error));
+    }
+
+    void multi_client::post(request req, response_callback on_response, error_callback on_error)
+    {
+        add(client::http_method::post, move(req), move(on_response), move(on_error));
+    }
+
+    void multi_client::put(request req, response_callback on_response, error_callback on_error)
+    {
+        add(client::http_method::put, move(req), move(on_response), move(on_error));
+    }
+
+    void multi_client::add(client::http_method method, request req, response_callback on_response, error_callback on_error)
+    {
+        _queued.emplace_back(new transfer(method, move(req), move(on_response), move(on_error)));
+    }
+
+    void multi_client::perform()
+    {
+        while (pending() > 0) {
+            start_queued();
+
+            int running = 0;
+            auto result = curl_multi_perform(_handle, &running);
+            if (result != CURLM_OK) {
+                throw http_exception(curl_multi_strerror(result));
+            }
+
+            // Complete the finished transfers; their callbacks may queue more
+            bool completed = false;
+            int queued = 0;
+            while (CURLMsg* msg = curl_multi_info_read(_handle, &queued)) {
+                if (msg->msg == CURLMSG_DONE) {
+                    completed = true;
+                    complete(msg->easy_handle, msg->data.result);
+                }
+            }
+
+            // Start the requests waiting on the completed ones before waiting for activity
+            if (completed || running == 0) {
+                continue;
+            }
+
+#if LIBCURL_VERSION_NUM >= 0x074200
+            result = curl_multi_poll(_handle, nullptr, 0, 1000, nullptr);
+#else
+            result = curl_multi_wait(_handle, nullptr, 0, 1000, nullptr);
+#endif
+            if (result != CURLM_OK) {
+                throw http_exception(curl_multi_strerror(result));
+            }
+        }
+    }
+
+    void multi_client::start_queued()
+    {
+        // The limits are enforced here rather than by libcurl, which only
+        // revisits the requests it holds back for a connection on a timer
+        vector<unique_ptr<transfer>> ready;
+        for (auto it = _queued.begin(); it != _queued.end();) {
+            if (_max_transfers != 0 && _transfers.size() + ready.size() >= _max_transfers) {
+                break;
+            }
+            auto& count = _host_transfers[(*it)->host];
+            if (_max_host_transfers != 0 && count >= _max_host_transfers) {
+                ++it;
+                continue;
+            }
+            ++count;
+            ready.push_back(move(*it));
+            it = _queued.erase(it);
+        }
+
+        // Start them once out of the queue, as a failure callback may queue others
+        for (auto it = ready.begin(); it != ready.end(); ++it) {
+            try {
+                start(move(*it));
+            } catch (...) {
+                // Return the requests not yet started to the front of the queue
+                for (auto rest = ready.end(); rest != it + 1;) {
+                    --rest;
+                    --_host_transfers[(*rest)->host];
+                    _queued.push_front(move(*rest));
+                }
+                throw;
+            }
+        }
+    }
+
+    void multi_client::start(unique_ptr<transfer> t)
+    {
+        if (_idle.empty()) {
+            t->handle.reset(new client());
+        } else {
+            t->handle = move(_idle.back());
+            _idle.pop_back();
+        }
+
+        auto& c = *t->handle;
+        c.set_ca_cert(_ca_cert);
+        c.set_client_cert(_client_cert, _client_key);
+        c.set_supported_protocols(_client_protocols);
+        c.set_accept_encoding(_accept_encoding);
+        c.set_body_compression(_body_encoding, _body_compression_level);
+
+        CURL* handle = c._handle;
+        try {
+            c.prepare(t->ctx, t->method);
+
+            // Wait for a connection that may multiplex the request, rather than opening another
+            c.curl_easy_setopt_maybe(t->ctx, CURLOPT_PIPEWAIT, 1L);
+            c.curl_easy_setopt_maybe(t->ctx, CURLOPT_HTTP_VERSION, static_cast<long>(CURL_HTTP_VERSION_2TLS));
+
+            auto result = curl_multi_add_handle(_handle, handle);
+            if (result != CURLM_OK) {
+                throw http_request_exception(t->req, curl_multi_strerror(result));
+            }
+        } catch (http_request_exception& e) {
+            finish(*t);
+            fail(*t, e);
+            return;
+        }
+        _transfers.emplace(handle, move(t));
+    }
+
+    void multi_client::complete(CURL* handle, CURLcode result)
+    {
+        auto it = _transfers.find(handle);
+        if (it == _transfers.end()) {
+            return;
+        }
+        auto t = move(it->second);
+        _transfers.erase(it);
+        curl_multi_remove_handle(_handle, handle);
+        t->handle->complete_transfer(t->ctx, result);
+        finish(*t);
+
+        // Report the error of a request body source rather than the abort it caused
+        if (t->ctx.body_error) {
+            try {
+                rethrow_exception(t->ctx.body_error);
+            } catch (exception& e) {
+                fail(*t, http_request_exception(t->req, e.what()));
+                return;
+            } catch (...) {
+                fail(*t, http_request_exception(t->req, curl_easy_strerror(result)));
+                return;
+            }
+        }
+        if (result != CURLE_OK) {
+            fail(*t, http_request_exception(t->req, curl_easy_strerror(result)));
+            return;
+        }
+
+        LOG_DEBUG("request to {1} completed (status {2}).", t->req.url(), t->res.status_code());
+
+        // Set the body of the response
+        t->res.body(move(t->ctx.response_buffer));
+        if (t->on_response) {
+            t->on_response(move(t->res));
+        }
+    }
+
+    void multi_client::finish(transfer& t)
+    {
+        if (t.handle) {
+            _idle.push_back(move(t.handle));
+        }
+
+        auto it = _host_transfers.find(t.host);
+        if (it != _host_transfers.end() && --it->second == 0) {
+            _host_transfers.erase(it);
+        }
+    }
+
+    void multi_client::fail(transfer& t, http_request_exception const& error)
+    {
+        if (!t.on_error) {
+            throw error;
+        }
+        t.on_error(error);
+    }
+
+    size_t multi_client::pending() const
+    {
+        return _queued.size() + _transfers.size();
+    }
+
+    void multi_client::set_ca_cert(string const& cert_file)
+    {
+        _ca_cert = cert_file;
+    }
+
+    void multi_client::set_client_cert(string const& client_cert, string const& client_key)
+    {
+        _client_cert = client_cert;
+        _client_key = client_key;
+    }
+
+    void multi_client::set_supported_protocols(long client_protocols)
+    {
+        _client_protocols = client_protocols;
+    }
+
+    void multi_client::set_accept_encoding(string encodings)
+    {
+        _accept_encoding = move(encodings);
+    }
+
+    void multi_client::set_body_compression(content_encoding encoding, int level)
+    {
+        _body_encoding = encoding;
+        _body_compression_level = level;
+    }
+
+    void multi_client::set_max_host_connections(size_t max_connections)
+    {
+        _max_host_transfers = max_connections;
+    }
+
+    void multi_client::set_max_connections(size_t max_connections)
+    {
+        _max_transfers = max_connections;
+    }
+
+    curl_multi_handle const& multi_client::get_handle()
+    {
+        return _handle;
+    }
+
+}}  // namespace leatherman::curl
@@ -1,9 +1,162 @@
 #include <leatherman/curl/request.hpp>
+#include <leatherman/curl/client.hpp>
+#include <leatherman/locale/locale.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+// Mark string for translation (alias for leatherman::locale::format)
+using leatherman::locale::_;
 
 using namespace std;
 
 namespace leatherman { namespace curl {
 
+    // Reads the body from a file at the offsets cURL asks for, so it can be rewound
+    struct file_body_source : body_source
+    {
+        explicit file_body_source(string const& path) :
+            _path(path)
+        {
+#ifdef _WIN32
+            _fd = ::_open(path.c_str(), _O_RDONLY | _O_BINARY);
+            struct _stat64 info;
+            if (_fd >= 0 && ::_fstat64(_fd, &info) == 0) {
+#else
+            _fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            struct stat info;
+            if (_fd >= 0 && ::fstat(_fd, &info) == 0) {
+#endif
+                _size = info.st_size;
+                return;
+            }
+            auto error = errno;
+            if (_fd >= 0) {
+                close();
+            }
+            throw http_exception(_("failed to open request body file {1}: {2}.", path, strerror(error)));
+        }
+
+        ~file_body_source()
+        {
+            close();
+        }
+
+        int64_t size() const override
+        {
+            return _size;
+        }
+
+        size_t read(char* buffer, size_t size, uint64_t offset) override
+        {
+            while (true) {
+#ifdef _WIN32
+                // Windows has no pread; the source isn't shared between transfers
+                auto count = ::_lseeki64(_fd, offset, SEEK_SET) < 0 ? -1 :
+                    ::_read(_fd, buffer, static_cast<unsigned int>(size));
+#else
+                auto count = ::pread(_fd, buffer, size, static_cast<off_t>(offset));
+#endif
+                if (count >= 0) {
+                    return static_cast<size_t>(count);
+                }
+                if (errno != EINTR) {
+                    throw http_exception(_("failed to read request body file {1}: {2}.", _path, strerror(errno)));
+                }
+            }
+        }
+
+        bool seekable() const override
+        {
+            return true;
+        }
+
+     private:
+        void close()
+        {
+#ifdef _WIN32
+            ::_close(_fd);
+#else
+            ::close(_fd);
+#endif
+        }
+
+        string _path;
+        int _fd;
+        int64_t _size = 0;
+    };
+
+    // Copies the body out of a region of memory owned by the caller
+    struct memory_body_source : body_source
+    {
+        memory_body_source(char const* data, size_t size) :
+            _data(data),
+            _size(size)
+        {
+        }
+
+        int64_t size() const override
+        {
+            return static_cast<int64_t>(_size);
+        }
+
+        size_t read(char* buffer, size_t size, uint64_t offset) override
+        {
+            if (offset >= _size) {
+                return 0;
+            }
+            size = std::min(size, static_cast<size_t>(_size - offset));
+            memcpy(buffer, _data + offset, size);
+            return size;
+        }
+
+        bool seekable() const override
+        {
+            return true;
+        }
+
+     private:
+        char const* _data;
+        size_t _size;
+    };
+
+    // Reads the body in order from a caller's function
+    struct stream_body_source : body_source
+    {
+        stream_body_source(request::body_reader reader, int64_t size) :
+            _reader(move(reader)),
+            _size(size < 0 ? -1 : size)
+        {
+        }
+
+        int64_t size() const override
+        {
+            return _size;
+        }
+
+        size_t read(char* buffer, size_t size, uint64_t) override
+        {
+            return _reader(buffer, size);
+        }
+
+        bool seekable() const override
+        {
+            return false;
+        }
+
+     private:
+        request::body_reader _reader;
+        int64_t _size;
+    };
+
     request::request(string url) :
         _url(move(url)),
         _timeout(0),
@@ -81,6 +234,7 @@ namespace leatherman { namespace curl {
     void request::body(string body, string content_type)
     {
         _body = move(body);
+        _body_source.reset();
         add_header("Content-Type", move(content_type));
     }
 
@@ -89,6 +243,33 @@ namespace leatherman { namespace curl {
         return _body;
     }
 
+    void request::body(shared_ptr<body_source> source, string content_type)
+    {
+        _body.clear();
+        _body_source = move(source);
+        add_header("Content-Type", move(content_type));
+    }
+
+    void request::body_file(string const& path, string content_type)
+    {
+        body(make_shared<file_body_source>(path), move(content_type));
+    }
+
+    void request::body_memory(char const* data, size_t size, string content_type)
+    {
+        body(make_shared<memory_body_source>(data, size), move(content_type));
+    }
+
+    void request::body_stream(body_reader reader, string content_type, int64_t size)
+    {
+        body(make_shared<stream_body_source>(move(reader), size), move(content_type));
+    }
+
+    shared_ptr<body_source> const& request::streamed_body() const
+    {
+        return _body_source;
+    }
+
     long request::timeout() const
     {
         return _timeout;
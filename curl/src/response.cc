@@ -1,9 +1,27 @@
 #include <leatherman/curl/response.hpp>
+#include <algorithm>
+#include <cctype>
 
 using namespace std;
 
 namespace leatherman { namespace curl {
 
+    double transfer_sizes::compression_ratio() const
+    {
+        if (transferred == 0) {
+            return 1.0;
+        }
+        return static_cast<double>(body) / transferred;
+    }
+
+    // Compares header names, which are ASCII, ignoring case; cheaper than a locale-aware comparison
+    static bool header_name_equals(string const& left, string const& right)
+    {
+        return left.size() == right.size() && equal(left.begin(), left.end(), right.begin(), [](char l, char r) {
+            return tolower(static_cast<unsigned char>(l)) == tolower(static_cast<unsigned char>(r));
+        });
+    }
+
     response::response() :
         _status_code(0)
     {
@@ -11,7 +29,11 @@ namespace leatherman { namespace curl {
 
     void response::add_header(string name, string value)
     {
-        _headers.emplace(make_pair(move(name), move(value)));
+        // Few headers are received, so a scan is cheaper than a map's allocations
+        if (_headers.empty()) {
+            _headers.reserve(16);
+        }
+        _headers.emplace_back(move(name), move(value));
     }
 
     void response::each_header(function<bool(string const&, string const&)> callback) const
@@ -28,16 +50,19 @@ namespace leatherman { namespace curl {
 
     const string* response::header(string const& name) const
     {
-        auto header = _headers.find(name);
-        if (header == _headers.end()) {
-            return nullptr;
+        for (auto const& kvp : _headers) {
+            if (header_name_equals(kvp.first, name)) {
+                return &kvp.second;
+            }
         }
-        return &header->second;
+        return nullptr;
     }
 
     void response::remove_header(string const& name)
     {
-        _headers.erase(name);
+        _headers.erase(remove_if(_headers.begin(), _headers.end(), [&](pair<string, string> const& kvp) {
+            return header_name_equals(kvp.first, name);
+        }), _headers.end());
     }
 
     void response::body(string body)
@@ -59,4 +84,34 @@ namespace leatherman { namespace curl {
     {
         _status_code = status;
     }
+
+    void response::request_sizes(transfer_sizes sizes)
+    {
+        _request_sizes = sizes;
+    }
+
+    transfer_sizes const& response::request_sizes() const
+    {
+        return _request_sizes;
+    }
+
+    void response::response_sizes(transfer_sizes sizes)
+    {
+        _response_sizes = sizes;
+    }
+
+    transfer_sizes const& response::response_sizes() const
+    {
+        return _response_sizes;
+    }
+
+    void response::metrics(transfer_metrics metrics)
+    {
+        _metrics = metrics;
+    }
+
+    transfer_metrics const& response::metrics() const
+    {
+        return _metrics;
+    }
 }}  // leatherman::curl
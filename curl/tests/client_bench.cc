@@ -0,0 +1,140 @@
+// Benchmark of the connection reuse and concurrency of leatherman::curl.
+//
+// Performs GET requests against a local HTTPS server for a fixed time
+// and prints the requests per second of each mode as a JSON document:
+//   new_client        a new client per request, as short-lived tasks do
+//   new_client_share  the same, with the clients sharing a curl_share
+//   same_client       a single client for all the requests
+//   multi_client      batches of concurrent requests on a multi_client
+//
+// Usage: curl_client_bench <url> <ca_cert> [seconds]
+//
+// The server must keep connections alive and write each response at once,
+// as small writes stall on delayed ACKs; e.g. with a certificate for
+// localhost:
+//    openssl req -x509 -newkey rsa:2048 -nodes -subj /CN=localhost
+//        -addext subjectAltName=DNS:localhost
+//        -keyout key.pem -out cert.pem -days 1
+//    python3 -c "import asyncio, ssl
+//    resp = b'HTTP/1.1 200 OK\\r\\nContent-Length: 2\\r\\n\\r\\nok'
+//    async def handle(r, w):
+//        while await r.readuntil(b'\\r\\n\\r\\n'):
+//            w.write(resp)
+//    c = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+//    c.load_cert_chain('cert.pem', 'key.pem')
+//    async def main():
+//        s = await asyncio.start_server(handle, 'localhost', 8443, ssl=c)
+//        await s.serve_forever()
+//    asyncio.run(main())"
+//    curl_client_bench https://localhost:8443/ cert.pem
+
+#include <leatherman/curl/client.hpp>
+#include <leatherman/curl/multi_client.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+using leatherman::curl::client;
+using leatherman::curl::curl_share;
+using leatherman::curl::multi_client;
+using leatherman::curl::request;
+using leatherman::curl::response;
+
+namespace {
+
+    struct Benchmark {
+        std::string name;
+        // Performs one or more requests; returns how many succeeded
+        std::function<size_t()> run;
+    };
+
+    double requests_per_second(const Benchmark& benchmark, double seconds) {
+        using clock = std::chrono::steady_clock;
+        size_t requests = 0;
+        auto start = clock::now();
+        std::chrono::duration<double> elapsed {};
+
+        do {
+            requests += benchmark.run();
+            elapsed = clock::now() - start;
+        } while (elapsed.count() < seconds);
+
+        return requests / elapsed.count();
+    }
+
+    size_t succeeded(int status_code) {
+        if (status_code != 200) {
+            throw std::runtime_error("unexpected status code");
+        }
+        return 1;
+    }
+
+    // Requests per batch in the multi_client benchmark
+    constexpr size_t batch_size = 64;
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::fprintf(stderr, "usage: %s <url> <ca_cert> [seconds]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    request req { argv[1] };
+    std::string ca_cert { argv[2] };
+    double seconds = argc > 3 ? std::atof(argv[3]) : 2.0;
+
+    auto share = std::make_shared<curl_share>();
+    client same_client {};
+    same_client.set_ca_cert(ca_cert);
+    multi_client multi {};
+    multi.set_ca_cert(ca_cert);
+
+    std::vector<Benchmark> benchmarks {
+        { "new_client", [&] {
+            client c {};
+            c.set_ca_cert(ca_cert);
+            return succeeded(c.get(req).status_code());
+        } },
+        { "new_client_share", [&] {
+            client c {};
+            c.set_ca_cert(ca_cert);
+            c.set_share(share);
+            return succeeded(c.get(req).status_code());
+        } },
+        { "same_client", [&] {
+            return succeeded(same_client.get(req).status_code());
+        } },
+        { "multi_client", [&] {
+            size_t requests = 0;
+            for (size_t i = 0; i < batch_size; i++) {
+                multi.get(req, [&](response res) { requests += succeeded(res.status_code()); });
+            }
+            multi.perform();
+            return requests;
+        } },
+    };
+
+    try {
+        std::printf("{\"benchmarks\":[");
+
+        for (size_t i = 0; i < benchmarks.size(); i++) {
+            std::fprintf(stderr, "running %s\n", benchmarks[i].name.c_str());
+            std::printf("%s{\"name\":\"%s\",\"requests_per_s\":%.1f}", i ? "," : "",
+                        benchmarks[i].name.c_str(), requests_per_second(benchmarks[i], seconds));
+            std::fflush(stdout);
+        }
+
+        std::printf("]}\n");
+    } catch (std::exception& e) {
+        std::fprintf(stderr, "\n%s\n", e.what());
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
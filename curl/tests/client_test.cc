@@ -4,12 +4,17 @@
 #include <leatherman/curl/client.hpp>
 #include <leatherman/curl/request.hpp>
 #include <leatherman/curl/response.hpp>
+#include <boost/algorithm/string/join.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/nowide/iostream.hpp>
 #include <boost/nowide/fstream.hpp>
 #include <boost/regex.hpp>
+#include <algorithm>
+#include <cstring>
 #include <sstream>
+#include <chrono>
 #include <cstdio>
+#include <zlib.h>
 
 using namespace std;
 namespace fs = boost::filesystem;
@@ -42,12 +47,43 @@ void trigger_filesystem_error() {
     fs::remove(temp_dir_path.parent_path());
 }
 
+// Decompresses a zlib or gzip body.
+string inflate_body(string const& body) {
+    z_stream stream = {};
+    inflateInit2(&stream, 15 + 32);
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(body.data()));
+    stream.avail_in = body.size();
+    string result;
+    char buffer[1024];
+    int status;
+    do {
+        stream.next_out = reinterpret_cast<Bytef*>(buffer);
+        stream.avail_out = sizeof(buffer);
+        status = inflate(&stream, Z_NO_FLUSH);
+        result.append(buffer, sizeof(buffer) - stream.avail_out);
+    } while (status == Z_OK);
+    inflateEnd(&stream);
+    if (status != Z_STREAM_END) {
+        throw runtime_error("invalid compressed body");
+    }
+    return result;
+}
+
 namespace leatherman { namespace curl {
 
     struct mock_client : client {
         curl_handle const& get_handle() { return client::get_handle(); }
     };
 
+    // Gets the custom request headers passed to cURL.
+    static vector<string> request_headers(curl_impl const* impl) {
+        vector<string> headers;
+        for (auto header = impl->header; header; header = header->next) {
+            headers.push_back(header->data);
+        }
+        return headers;
+    }
+
     TEST_CASE("curl::client HTTP methods") {
         mock_client test_client;
         request test_request {"http://valid.com/"};
@@ -141,6 +177,31 @@ namespace leatherman { namespace curl {
             REQUIRE(*(resp.header("nonstd_header_name")) == "nonstd_header_value");
         }
 
+        SECTION("HTTP/2 status lines and headers should be parsed") {
+            request test_request {"http://http2.com/"};
+            auto resp = test_client.get(test_request);
+            REQUIRE(resp.status_code() == 204);
+            REQUIRE(resp.header("Content-Type"));
+            REQUIRE(*resp.header("Content-Type") == "text/plain");
+            vector<string> cookies;
+            resp.each_header([&](string const& name, string const& value) {
+                if (name == "set-cookie" || name == "Set-Cookie") {
+                    cookies.push_back(value);
+                }
+                return true;
+            });
+            REQUIRE(cookies == (vector<string> { "first=1", "second=2" }));
+        }
+
+        SECTION("The status code reported by cURL should take precedence over the status line") {
+            request test_request {"http://valid.com/"};
+            CURL* const& handle = test_client.get_handle();
+            auto test_impl = reinterpret_cast<curl_impl* const>(handle);
+            test_impl->response_code = 201;
+            auto resp = test_client.get(test_request);
+            REQUIRE(resp.status_code() == 201);
+        }
+
         SECTION("Invalid headers should not be parsed or returned in the response") {
             request test_request {"http://invalid-header.com/"};
             auto resp = test_client.get(test_request);
@@ -174,6 +235,506 @@ namespace leatherman { namespace curl {
         }
     }
 
+    TEST_CASE("curl::client streaming response body") {
+        mock_client test_client;
+        request test_request {"http://valid.com/"};
+        CURL* const& handle = test_client.get_handle();
+        auto test_impl = reinterpret_cast<curl_impl* const>(handle);
+        test_impl->resp_body = "Hello, I am a response body in several chunks!";
+        vector<string> chunks;
+
+        SECTION("The response body should be passed to the callback in chunks") {
+            int status_code = 0;
+            auto resp = test_client.get(test_request, [&](response const& res, char const* data, size_t size) {
+                status_code = res.status_code();
+                chunks.emplace_back(data, size);
+                return true;
+            });
+            REQUIRE(chunks.size() == 5u);
+            REQUIRE(boost::algorithm::join(chunks, "") == test_impl->resp_body);
+            REQUIRE(status_code == 200);
+            REQUIRE(resp.status_code() == 200);
+            REQUIRE(resp.body().empty());
+        }
+
+        SECTION("The response body should be streamed for POST and PUT") {
+            auto collect = [&](response const&, char const* data, size_t size) {
+                chunks.emplace_back(data, size);
+                return true;
+            };
+            test_client.post(test_request, collect);
+            test_client.put(test_request, collect);
+            REQUIRE(boost::algorithm::join(chunks, "") == test_impl->resp_body + test_impl->resp_body);
+        }
+
+        SECTION("Returning false should abort the transfer without an error") {
+            auto resp = test_client.get(test_request, [&](response const&, char const* data, size_t size) {
+                chunks.emplace_back(data, size);
+                return chunks.size() < 2;
+            });
+            REQUIRE(chunks.size() == 2u);
+            REQUIRE(resp.status_code() == 200);
+        }
+
+        SECTION("Exceptions thrown by the callback should be rethrown") {
+            REQUIRE_THROWS_AS(test_client.get(test_request, [&](response const&, char const*, size_t) -> bool {
+                throw runtime_error("sink failed");
+            }), runtime_error);
+        }
+
+        SECTION("Transfer errors should still throw") {
+            test_impl->test_failure_mode = curl_impl::error_mode::easy_perform_error;
+            REQUIRE_THROWS_AS(test_client.get(test_request, [&](response const&, char const*, size_t) {
+                return true;
+            }), http_request_exception);
+        }
+    }
+
+    TEST_CASE("curl::client streaming request body") {
+        mock_client test_client;
+        request test_request {"http://valid.com/"};
+        CURL* const& handle = test_client.get_handle();
+        auto test_impl = reinterpret_cast<curl_impl* const>(handle);
+        string body = "Hello, I am a request body in several chunks!";
+
+        SECTION("A request body file should be read as it is sent") {
+            temp_directory temp_dir;
+            auto path = (fs::path(temp_dir.get_dir_name()) / "body").string();
+            {
+                nw::ofstream file(path, ios::binary);
+                file << body;
+            }
+            test_request.body_file(path, "message");
+            auto resp = test_client.put(test_request);
+            REQUIRE(resp.status_code() == 200);
+            REQUIRE(test_impl->read_buffer == body);
+            REQUIRE(test_impl->upload_size == static_cast<curl_off_t>(body.size()));
+        }
+
+        SECTION("A request body in memory should be sent again after rewinding") {
+            test_request.body_memory(body.data(), body.size(), "message");
+            test_impl->rewind_body = true;
+            test_client.post(test_request);
+            REQUIRE(test_impl->seek_result == CURL_SEEKFUNC_OK);
+            REQUIRE(test_impl->read_buffer == body);
+            REQUIRE(test_impl->upload_size == static_cast<curl_off_t>(body.size()));
+        }
+
+        SECTION("A request body of unknown size should be sent chunked") {
+            size_t offset = 0;
+            test_request.body_stream([&](char* buffer, size_t size) {
+                size = min(size, body.size() - offset);
+                memcpy(buffer, body.data() + offset, size);
+                offset += size;
+                return size;
+            }, "message");
+            test_client.post(test_request);
+            REQUIRE(test_impl->read_buffer == body);
+            REQUIRE(test_impl->upload_size == -1);
+
+            auto headers = request_headers(test_impl);
+            REQUIRE(find(headers.begin(), headers.end(), "Transfer-Encoding: chunked") != headers.end());
+        }
+
+        SECTION("A request body of known size should not be sent chunked") {
+            test_request.body_stream([&](char*, size_t) { return size_t(0); }, "message", 0);
+            test_client.post(test_request);
+            REQUIRE(test_impl->upload_size == 0);
+            auto headers = request_headers(test_impl);
+            REQUIRE(find(headers.begin(), headers.end(), "Transfer-Encoding: chunked") == headers.end());
+        }
+
+        SECTION("A request body read from a function should not be rewound") {
+            bool read = false;
+            test_request.body_stream([&](char* buffer, size_t) {
+                buffer[0] = 'x';
+                return read ? size_t(0) : (read = true, size_t(1));
+            }, "message");
+            test_impl->rewind_body = true;
+            test_client.post(test_request);
+            REQUIRE(test_impl->seek_result == CURL_SEEKFUNC_CANTSEEK);
+            REQUIRE(test_impl->read_buffer == "x");
+        }
+
+        SECTION("Exceptions thrown while reading the request body should be rethrown") {
+            test_request.body_stream([&](char*, size_t) -> size_t {
+                throw runtime_error("source failed");
+            }, "message");
+            REQUIRE_THROWS_AS(test_client.post(test_request), runtime_error);
+        }
+    }
+
+    TEST_CASE("curl::client content encoding") {
+        mock_client test_client;
+        request test_request {"http://valid.com/"};
+        CURL* const& handle = test_client.get_handle();
+        auto test_impl = reinterpret_cast<curl_impl* const>(handle);
+        string body;
+        for (int i = 0; i < 2000; ++i) {
+            body += "{\"fact\": \"value " + to_string(i % 10) + "\"},";
+        }
+
+        SECTION("Every supported response encoding should be accepted by default") {
+            test_client.get(test_request);
+            REQUIRE(test_impl->accept_encoding_set);
+            REQUIRE(test_impl->accept_encoding == "");
+        }
+
+        SECTION("The accepted response encodings should be configurable") {
+            test_client.set_accept_encoding("gzip");
+            test_client.get(test_request);
+            REQUIRE(test_impl->accept_encoding == "gzip");
+        }
+
+        SECTION("Request bodies should not be compressed by default") {
+            test_request.body(body, "application/json");
+            auto resp = test_client.post(test_request);
+            REQUIRE(test_impl->read_buffer == body);
+            auto headers = request_headers(test_impl);
+            REQUIRE(find(headers.begin(), headers.end(), "Content-Encoding: gzip") == headers.end());
+            REQUIRE(resp.request_sizes().body == body.size());
+            REQUIRE(resp.request_sizes().compression_ratio() == 1.0);
+        }
+
+        SECTION("Request bodies should be compressed with gzip as they are sent") {
+            test_client.set_body_compression(content_encoding::gzip);
+            test_request.body(body, "application/json");
+            auto resp = test_client.post(test_request);
+
+            REQUIRE(test_impl->read_buffer.compare(0, 2, "\x1f\x8b") == 0);
+            REQUIRE(inflate_body(test_impl->read_buffer) == body);
+            REQUIRE(test_impl->upload_size == -1);
+            auto headers = request_headers(test_impl);
+            REQUIRE(find(headers.begin(), headers.end(), "Content-Encoding: gzip") != headers.end());
+            REQUIRE(find(headers.begin(), headers.end(), "Transfer-Encoding: chunked") != headers.end());
+
+            REQUIRE(resp.request_sizes().body == body.size());
+            REQUIRE(resp.request_sizes().transferred == test_impl->read_buffer.size());
+            REQUIRE(resp.request_sizes().compression_ratio() > 10.0);
+        }
+
+        SECTION("Streamed request bodies should be compressed with deflate") {
+            test_client.set_body_compression(content_encoding::deflate, 9);
+            size_t offset = 0;
+            test_request.body_stream([&](char* buffer, size_t size) {
+                size = min(size, body.size() - offset);
+                memcpy(buffer, body.data() + offset, size);
+                offset += size;
+                return size;
+            }, "application/json");
+            test_client.put(test_request);
+
+            REQUIRE(test_impl->read_buffer.compare(0, 1, "\x78") == 0);
+            REQUIRE(inflate_body(test_impl->read_buffer) == body);
+            auto headers = request_headers(test_impl);
+            REQUIRE(find(headers.begin(), headers.end(), "Content-Encoding: deflate") != headers.end());
+        }
+
+        SECTION("Compressed request bodies should be compressed again after rewinding") {
+            test_client.set_body_compression(content_encoding::gzip);
+            test_request.body_memory(body.data(), body.size(), "application/json");
+            test_impl->rewind_body = true;
+            test_client.post(test_request);
+            REQUIRE(test_impl->seek_result == CURL_SEEKFUNC_OK);
+            REQUIRE(inflate_body(test_impl->read_buffer) == body);
+        }
+
+        SECTION("Requests without a body should not be compressed") {
+            test_client.set_body_compression(content_encoding::gzip);
+            test_client.get(test_request);
+            REQUIRE(test_impl->read_buffer.empty());
+            auto headers = request_headers(test_impl);
+            REQUIRE(find(headers.begin(), headers.end(), "Content-Encoding: gzip") == headers.end());
+        }
+
+        SECTION("The response should report the compression of its body") {
+            test_impl->resp_body = body;
+            test_impl->size_download = body.size() / 4;
+            auto resp = test_client.get(test_request);
+            REQUIRE(resp.response_sizes().body == body.size());
+            REQUIRE(resp.response_sizes().transferred == body.size() / 4);
+            REQUIRE(resp.response_sizes().compression_ratio() == Approx(4.0).epsilon(0.01));
+        }
+    }
+
+    TEST_CASE("curl::client retries") {
+        mock_client test_client;
+        request test_request {"http://flaky.com/"};
+        CURL* const& handle = test_client.get_handle();
+        auto test_impl = reinterpret_cast<curl_impl* const>(handle);
+        test_impl->resp_body = "Hello, I am a response body!";
+        retry_policy policy;
+        policy.max_attempts = 3;
+        policy.base_delay = chrono::milliseconds(1);
+
+        SECTION("Requests should not be retried by default") {
+            test_impl->failures = 1;
+            auto resp = test_client.get(test_request);
+            REQUIRE(resp.status_code() == 503);
+            REQUIRE(test_impl->attempts == 1);
+        }
+
+        SECTION("Requests with a retryable status should be retried until they succeed") {
+            test_client.set_retry_policy(policy);
+            test_impl->failures = 2;
+            auto resp = test_client.get(test_request);
+            REQUIRE(resp.status_code() == 200);
+            REQUIRE(resp.body() == "Hello, I am a response body!");
+            REQUIRE(test_impl->attempts == 3);
+        }
+
+        SECTION("A moved client should keep its retry policy") {
+            test_client.set_retry_policy(policy);
+            mock_client moved_client { move(test_client) };
+            test_impl->failures = 2;
+            auto resp = moved_client.get(test_request);
+            REQUIRE(resp.status_code() == 200);
+            REQUIRE(test_impl->attempts == 3);
+        }
+
+        SECTION("Requests failing with a retryable error should be retried") {
+            test_client.set_retry_policy(policy);
+            test_impl->failures = 1;
+            test_impl->failure_error = CURLE_COULDNT_CONNECT;
+            auto resp = test_client.post(test_request);
+            REQUIRE(resp.status_code() == 200);
+            REQUIRE(test_impl->attempts == 2);
+        }
+
+        SECTION("The last response should be returned once the attempts run out") {
+            test_client.set_retry_policy(policy);
+            test_impl->failures = 5;
+            auto resp = test_client.get(test_request);
+            REQUIRE(resp.status_code() == 503);
+            REQUIRE(resp.body() == "failed");
+            REQUIRE(test_impl->attempts == 3);
+        }
+
+        SECTION("The last error should be thrown once the attempts run out") {
+            test_client.set_retry_policy(policy);
+            test_impl->failures = 5;
+            test_impl->failure_error = CURLE_RECV_ERROR;
+            REQUIRE_THROWS_AS(test_client.get(test_request), http_request_exception);
+            REQUIRE(test_impl->attempts == 3);
+        }
+
+        SECTION("Requests failing otherwise should not be retried") {
+            policy.retryable_errors.clear();
+            test_client.set_retry_policy(policy);
+            test_impl->failures = 1;
+            test_impl->failure_status = 404;
+            REQUIRE(test_client.get(test_request).status_code() == 404);
+
+            test_impl->failures = 2;
+            test_impl->failure_error = CURLE_COULDNT_CONNECT;
+            REQUIRE_THROWS_AS(test_client.get(test_request), http_request_exception);
+            REQUIRE(test_impl->attempts == 2);
+        }
+
+        SECTION("Retry-After should be honored instead of the backoff") {
+            policy.base_delay = chrono::milliseconds(60000);
+            test_client.set_retry_policy(policy);
+            test_impl->failures = 2;
+            test_impl->retry_after = "0";
+            auto start = chrono::steady_clock::now();
+            REQUIRE(test_client.get(test_request).status_code() == 200);
+            REQUIRE(chrono::steady_clock::now() - start < chrono::seconds(10));
+
+            test_impl->attempts = 0;
+            test_impl->retry_after = "Thu, 01 Jan 2015 00:00:00 GMT";
+            REQUIRE(test_client.get(test_request).status_code() == 200);
+            REQUIRE(test_impl->attempts == 3);
+        }
+
+        SECTION("Requests should not be retried when Retry-After is longer than the maximum delay") {
+            test_client.set_retry_policy(policy);
+            test_impl->failures = 1;
+            test_impl->retry_after = "86400";
+            auto start = chrono::steady_clock::now();
+            REQUIRE(test_client.get(test_request).status_code() == 503);
+            REQUIRE(test_impl->attempts == 1);
+
+            test_impl->attempts = 0;
+            test_impl->retry_after = "99999999999999999999";
+            REQUIRE(test_client.get(test_request).status_code() == 503);
+            REQUIRE(test_impl->attempts == 1);
+
+            test_impl->attempts = 0;
+            test_impl->retry_after = "Fri, 31 Dec 9999 23:59:59 GMT";
+            REQUIRE(test_client.get(test_request).status_code() == 503);
+            REQUIRE(test_impl->attempts == 1);
+            REQUIRE(chrono::steady_clock::now() - start < chrono::seconds(10));
+        }
+
+        SECTION("Requests should not be retried past the deadline") {
+            policy.deadline = chrono::milliseconds(5000);
+            test_client.set_retry_policy(policy);
+            test_impl->failures = 1;
+            test_impl->retry_after = "60";
+            REQUIRE(test_client.get(test_request).status_code() == 503);
+            REQUIRE(test_impl->attempts == 1);
+            REQUIRE(test_impl->timeout > 0);
+            REQUIRE(test_impl->timeout <= 5000);
+        }
+
+        SECTION("The bodies of retried responses should not be streamed") {
+            test_client.set_retry_policy(policy);
+            test_impl->failures = 1;
+            string body;
+            auto resp = test_client.get(test_request, [&](response const&, char const* data, size_t size) {
+                body.append(data, size);
+                return true;
+            });
+            REQUIRE(resp.status_code() == 200);
+            REQUIRE(body == "Hello, I am a response body!");
+        }
+
+        SECTION("Requests should not be retried once a streamed response body was passed on") {
+            test_client.set_retry_policy(policy);
+            test_impl->failures = 1;
+            test_impl->failure_error = CURLE_PARTIAL_FILE;
+            test_impl->failure_partial = 5;
+            REQUIRE_THROWS_AS(test_client.get(test_request, [&](response const&, char const*, size_t) { return true; }), http_request_exception);
+            REQUIRE(test_impl->attempts == 1);
+        }
+
+        SECTION("Requests should not be retried once a body read in order was sent") {
+            test_client.set_retry_policy(policy);
+            test_impl->failures = 1;
+            bool read = false;
+            test_request.body_stream([&](char* buffer, size_t) {
+                buffer[0] = 'x';
+                return read ? size_t(0) : (read = true, size_t(1));
+            }, "message");
+            REQUIRE(test_client.post(test_request).status_code() == 503);
+            REQUIRE(test_impl->attempts == 1);
+        }
+
+        SECTION("The backoff should be randomly up to the base delay doubled for each attempt") {
+            policy.base_delay = chrono::milliseconds(100);
+            policy.max_delay = chrono::milliseconds(1000);
+            for (int i = 0; i < 100; ++i) {
+                REQUIRE(policy.backoff(1) <= chrono::milliseconds(100));
+                REQUIRE(policy.backoff(3) <= chrono::milliseconds(400));
+                REQUIRE(policy.backoff(40) <= chrono::milliseconds(1000));
+            }
+        }
+    }
+
+    // Records the transfers of every client while it exists
+    struct recorded_transfers
+    {
+        recorded_transfers()
+        {
+            client::set_transfer_observer([this](request const& req, response const& res, CURLcode result) {
+                urls.push_back(req.url());
+                statuses.push_back(res.status_code());
+                results.push_back(result);
+                metrics.push_back(res.metrics());
+            });
+        }
+
+        ~recorded_transfers()
+        {
+            client::set_transfer_observer(nullptr);
+        }
+
+        vector<string> urls;
+        vector<int> statuses;
+        vector<CURLcode> results;
+        vector<transfer_metrics> metrics;
+    };
+
+    TEST_CASE("curl::client transfer metrics") {
+        mock_client test_client;
+        CURL* const& handle = test_client.get_handle();
+        auto test_impl = reinterpret_cast<curl_impl* const>(handle);
+
+        SECTION("The response should carry the timings and measures of its transfer") {
+            test_impl->info_off_t[CURLINFO_NAMELOOKUP_TIME_T] = 100;
+            test_impl->info_off_t[CURLINFO_CONNECT_TIME_T] = 200;
+            test_impl->info_off_t[CURLINFO_APPCONNECT_TIME_T] = 300;
+            test_impl->info_off_t[CURLINFO_PRETRANSFER_TIME_T] = 400;
+            test_impl->info_off_t[CURLINFO_STARTTRANSFER_TIME_T] = 500;
+            test_impl->info_off_t[CURLINFO_TOTAL_TIME_T] = 600;
+            test_impl->info_off_t[CURLINFO_REDIRECT_TIME_T] = 50;
+            test_impl->info_off_t[CURLINFO_SPEED_DOWNLOAD_T] = 2048;
+            test_impl->info_off_t[CURLINFO_SPEED_UPLOAD_T] = 1024;
+            test_impl->info_long[CURLINFO_REDIRECT_COUNT] = 1;
+            test_impl->info_long[CURLINFO_REQUEST_SIZE] = 80;
+            test_impl->info_long[CURLINFO_HEADER_SIZE] = 160;
+            test_impl->info_long[CURLINFO_NUM_CONNECTS] = 1;
+            test_impl->info_long[CURLINFO_HTTP_VERSION] = CURL_HTTP_VERSION_2_0;
+
+            auto metrics = test_client.get(request {"http://valid.com/"}).metrics();
+            REQUIRE(metrics.name_lookup == chrono::microseconds(100));
+            REQUIRE(metrics.connect == chrono::microseconds(200));
+            REQUIRE(metrics.app_connect == chrono::microseconds(300));
+            REQUIRE(metrics.pre_transfer == chrono::microseconds(400));
+            REQUIRE(metrics.start_transfer == chrono::microseconds(500));
+            REQUIRE(metrics.total == chrono::microseconds(600));
+            REQUIRE(metrics.redirect == chrono::microseconds(50));
+            REQUIRE(metrics.redirects == 1);
+            REQUIRE(metrics.request_size == 80u);
+            REQUIRE(metrics.header_size == 160u);
+            REQUIRE(metrics.download_speed == 2048u);
+            REQUIRE(metrics.upload_speed == 1024u);
+            REQUIRE_FALSE(metrics.connection_reused);
+            REQUIRE(metrics.http_version == CURL_HTTP_VERSION_2_0);
+        }
+
+        SECTION("Times reported in seconds should be converted") {
+            test_impl->info_double[CURLINFO_TOTAL_TIME] = 1.5;
+            auto metrics = test_client.get(request {"http://valid.com/"}).metrics();
+            REQUIRE(metrics.total == chrono::microseconds(1500000));
+        }
+
+        SECTION("A transfer that opened no connection should have reused one") {
+            test_impl->info_off_t[CURLINFO_PRETRANSFER_TIME_T] = 400;
+            test_impl->info_long[CURLINFO_NUM_CONNECTS] = 0;
+            REQUIRE(test_client.get(request {"http://valid.com/"}).metrics().connection_reused);
+        }
+
+        SECTION("The observer should be given every transfer") {
+            recorded_transfers transfers;
+            test_impl->info_off_t[CURLINFO_TOTAL_TIME_T] = 600;
+            test_client.get(request {"http://valid.com/"});
+            REQUIRE_THROWS_AS(test_client.get(request {"http://unreachable.com/"}), http_request_exception);
+            REQUIRE(transfers.urls == (vector<string> { "http://valid.com/", "http://unreachable.com/" }));
+            REQUIRE(transfers.statuses.front() == 200);
+            REQUIRE(transfers.results == (vector<CURLcode> { CURLE_OK, CURLE_COULDNT_CONNECT }));
+            REQUIRE(transfers.metrics.front().total == chrono::microseconds(600));
+        }
+
+        SECTION("The observer should be given each attempt of a retried request") {
+            recorded_transfers transfers;
+            retry_policy policy;
+            policy.max_attempts = 2;
+            policy.base_delay = chrono::milliseconds(0);
+            test_client.set_retry_policy(policy);
+            test_impl->failures = 1;
+            test_client.get(request {"http://flaky.com/"});
+            REQUIRE(transfers.statuses == (vector<int> { 503, 200 }));
+        }
+
+        SECTION("An observer that throws should not fail the request") {
+            client::set_transfer_observer([](request const&, response const&, CURLcode) {
+                throw runtime_error("metrics unavailable");
+            });
+            auto resp = test_client.get(request {"http://valid.com/"});
+            client::set_transfer_observer(nullptr);
+            REQUIRE(resp.status_code() == 200);
+        }
+
+        SECTION("Transfers should not be observed once the observer is removed") {
+            int calls = 0;
+            client::set_transfer_observer([&](request const&, response const&, CURLcode) { ++calls; });
+            client::set_transfer_observer(nullptr);
+            test_client.get(request {"http://valid.com/"});
+            REQUIRE(calls == 0);
+        }
+    }
+
     TEST_CASE("curl::client cookies") {
         mock_client test_client;
         request test_request {"http://valid.com"};
@@ -278,6 +839,64 @@ namespace leatherman { namespace curl {
         }
     }
 
+    TEST_CASE("curl::client connection reuse") {
+        mock_client test_client;
+        request test_request {"http://valid.com/"};
+        CURL* const& handle = test_client.get_handle();
+        auto test_impl = reinterpret_cast<curl_impl* const>(handle);
+
+        SECTION("cURL should not use a share handle by default") {
+            test_client.get(test_request);
+            REQUIRE(test_impl->share == nullptr);
+        }
+
+        SECTION("cURL should receive the share handle set on the client") {
+            auto share = make_shared<curl_share>();
+            test_client.set_share(share);
+            test_client.get(test_request);
+            REQUIRE(test_impl->share == static_cast<CURLSH*>(*share));
+
+            test_client.set_share(nullptr);
+            test_client.get(test_request);
+            REQUIRE(test_impl->share == nullptr);
+        }
+
+        SECTION("The share handle should share the DNS, TLS session and connection caches") {
+            curl_share share;
+            auto share_impl = reinterpret_cast<curl_share_impl*>(static_cast<CURLSH*>(share));
+            REQUIRE(share_impl->shared_data == ((1L << CURL_LOCK_DATA_DNS) |
+                                                (1L << CURL_LOCK_DATA_SSL_SESSION) |
+                                                (1L << CURL_LOCK_DATA_CONNECT)));
+        }
+
+        SECTION("The share handle should not share connections if not requested") {
+            curl_share share { false };
+            auto share_impl = reinterpret_cast<curl_share_impl*>(static_cast<CURLSH*>(share));
+            REQUIRE(share_impl->shared_data == ((1L << CURL_LOCK_DATA_DNS) |
+                                                (1L << CURL_LOCK_DATA_SSL_SESSION)));
+        }
+
+        SECTION("Clients sharing a handle should lock its caches") {
+            auto share = make_shared<curl_share>();
+            auto share_impl = reinterpret_cast<curl_share_impl*>(static_cast<CURLSH*>(*share));
+            mock_client other_client;
+            test_client.set_share(share);
+            other_client.set_share(share);
+
+            test_client.get(test_request);
+            other_client.get(test_request);
+            REQUIRE(share_impl->locks == 2);
+        }
+
+        SECTION("The share handle should outlive the clients it is set on") {
+            auto share = make_shared<curl_share>();
+            test_client.set_share(share);
+            share.reset();
+            auto resp = test_client.get(test_request);
+            REQUIRE(resp.status_code() == 200);
+        }
+    }
+
     TEST_CASE("curl::client errors") {
         mock_client test_client;
         request test_request {"http://valid.com/"};
@@ -296,6 +915,16 @@ namespace leatherman { namespace curl {
             REQUIRE_THROWS_AS(mock_client test_client, http_exception);
         }
 
+        SECTION("share handle fails to initialize") {
+            curl_fail_init mock_error {share_init_error};
+            REQUIRE_THROWS_AS(curl_share share, http_exception);
+        }
+
+        SECTION("share handle fails to set its options") {
+            curl_fail_init mock_error {share_setopt_error};
+            REQUIRE_THROWS_AS(curl_share share, http_exception);
+        }
+
         SECTION("client fails to perform a cURL request") {
             test_impl->test_failure_mode = curl_impl::error_mode::easy_perform_error;
             REQUIRE_THROWS_AS(test_client.get(test_request), http_request_exception);
@@ -436,6 +1065,82 @@ namespace leatherman { namespace curl {
             REQUIRE(stream.str() == "successfully downloaded file"); 
         }
 
+        SECTION("resumes an interrupted download from the last byte received") {
+            retry_policy policy;
+            policy.max_attempts = 3;
+            policy.base_delay = chrono::milliseconds(1);
+            test_client.set_retry_policy(policy);
+            test_impl->resp_body = "0123456789abcdefghij";
+            test_impl->failures = 1;
+            test_impl->failure_error = CURLE_PARTIAL_FILE;
+            test_impl->failure_partial = 10;
+
+            auto file_path = (temp_dir_path / "resumed_file").string();
+            test_client.download_file(request("http://flaky.com/"), file_path);
+            REQUIRE(test_impl->resumes == (vector<curl_off_t> { 0, 10 }));
+            nw::ifstream in(file_path);
+            stringstream stream;
+            stream << in.rdbuf();
+            REQUIRE(stream.str() == "0123456789abcdefghij");
+        }
+
+        SECTION("keeps the bytes received when a later attempt fails before any response") {
+            retry_policy policy;
+            policy.max_attempts = 3;
+            policy.base_delay = chrono::milliseconds(1);
+            test_client.set_retry_policy(policy);
+            test_impl->resp_body = "0123456789abcdefghij";
+            test_impl->failures = 1;
+            test_impl->failure_error = CURLE_PARTIAL_FILE;
+            test_impl->failure_partial = 10;
+            test_impl->refused_attempt = 2;
+
+            auto file_path = (temp_dir_path / "refused_file").string();
+            test_client.download_file(request("http://flaky.com/"), file_path);
+            REQUIRE(test_impl->resumes == (vector<curl_off_t> { 0, 10, 10 }));
+            nw::ifstream in(file_path);
+            stringstream stream;
+            stream << in.rdbuf();
+            REQUIRE(stream.str() == "0123456789abcdefghij");
+        }
+
+        SECTION("restarts a download when it can't be resumed") {
+            retry_policy policy;
+            policy.max_attempts = 3;
+            policy.base_delay = chrono::milliseconds(1);
+            test_client.set_retry_policy(policy);
+            test_impl->resp_body = "0123456789abcdefghij";
+            test_impl->failures = 1;
+            test_impl->failure_error = CURLE_PARTIAL_FILE;
+            test_impl->failure_partial = 10;
+            test_impl->ignore_range = true;
+
+            auto file_path = (temp_dir_path / "restarted_file").string();
+            test_client.download_file(request("http://flaky.com/"), file_path);
+            REQUIRE(test_impl->resumes == (vector<curl_off_t> { 0, 10, 0 }));
+            nw::ifstream in(file_path);
+            stringstream stream;
+            stream << in.rdbuf();
+            REQUIRE(stream.str() == "0123456789abcdefghij");
+        }
+
+        SECTION("discards the body of a response that is retried") {
+            retry_policy policy;
+            policy.max_attempts = 2;
+            policy.base_delay = chrono::milliseconds(1);
+            test_client.set_retry_policy(policy);
+            test_impl->resp_body = "0123456789abcdefghij";
+            test_impl->failures = 1;
+
+            auto file_path = (temp_dir_path / "retried_file").string();
+            test_client.download_file(request("http://flaky.com/"), file_path);
+            REQUIRE(test_impl->attempts == 2);
+            nw::ifstream in(file_path);
+            stringstream stream;
+            stream << in.rdbuf();
+            REQUIRE(stream.str() == "0123456789abcdefghij");
+        }
+
 #ifndef _WIN32
         SECTION("sets permissions if requested") {
             auto file_path = (temp_dir_path / "other_test_file").string();
@@ -449,6 +1154,176 @@ namespace leatherman { namespace curl {
 #endif
     }
 
+    static string read_file(string const& path)
+    {
+        nw::ifstream in(path, ios::binary);
+        stringstream stream;
+        stream << in.rdbuf();
+        return stream.str();
+    }
+
+    static uint32_t crc32_of(string const& data)
+    {
+        return static_cast<uint32_t>(crc32(crc32(0, Z_NULL, 0), reinterpret_cast<Bytef const*>(data.data()), static_cast<uInt>(data.size())));
+    }
+
+    TEST_CASE("curl::client download_file with options") {
+        mock_client test_client;
+        temp_directory temp_dir;
+        fs::path temp_dir_path = fs::path(temp_dir.get_dir_name());
+        CURL* const& handle = test_client.get_handle();
+        auto test_impl = reinterpret_cast<curl_impl* const>(handle);
+        string body = "0123456789abcdefghijklmnopqrstuvwxyzABCD";
+        auto file_path = (temp_dir_path / "file").string();
+        retry_policy policy;
+        policy.max_attempts = 2;
+        policy.base_delay = chrono::milliseconds(0);
+        download_options options;
+
+        SECTION("keeps the partial file of a failed download and resumes from it") {
+            test_impl->resp_body = body;
+            test_impl->failures = 1;
+            test_impl->failure_error = CURLE_PARTIAL_FILE;
+            test_impl->failure_partial = 10;
+            options.resume = true;
+            options.crc32 = crc32_of(body);
+
+            try {
+                test_client.download_file(request("http://flaky.com/"), file_path, options);
+                FAIL("the download should fail");
+            } catch (http_file_download_exception const& e) {
+                REQUIRE(e.temp_path() == file_path + ".part");
+            }
+            REQUIRE(read_file(file_path + ".part") == body.substr(0, 10));
+
+            test_client.download_file(request("http://flaky.com/"), file_path, options);
+            REQUIRE(test_impl->resumes == (vector<curl_off_t> { 0, 10 }));
+            REQUIRE(read_file(file_path) == body);
+            REQUIRE_FALSE(fs::exists(file_path + ".part"));
+        }
+
+        SECTION("keeps resuming the partial file when a retry fails before any response") {
+            {
+                nw::ofstream part(file_path + ".part", ios::binary);
+                part << body.substr(0, 10);
+            }
+            policy.max_attempts = 3;
+            test_client.set_retry_policy(policy);
+            test_impl->resp_body = body;
+            test_impl->refused_attempt = 1;
+            options.resume = true;
+            options.crc32 = crc32_of(body);
+
+            test_client.download_file(request("http://flaky.com/"), file_path, options);
+            REQUIRE(test_impl->resumes == (vector<curl_off_t> { 10, 10 }));
+            REQUIRE(read_file(file_path) == body);
+            REQUIRE_FALSE(fs::exists(file_path + ".part"));
+        }
+
+        SECTION("keeps resuming the partial file when a retried status has no body written") {
+            {
+                nw::ofstream part(file_path + ".part", ios::binary);
+                part << body.substr(0, 10);
+            }
+            test_client.set_retry_policy(policy);
+            test_impl->resp_body = body;
+            test_impl->failures = 1;
+            options.resume = true;
+            options.crc32 = crc32_of(body);
+
+            test_client.download_file(request("http://flaky.com/"), file_path, options);
+            REQUIRE(test_impl->resumes == (vector<curl_off_t> { 10, 10 }));
+            REQUIRE(read_file(file_path) == body);
+            REQUIRE_FALSE(fs::exists(file_path + ".part"));
+        }
+
+        SECTION("fails on an error status rather than writing the body") {
+            test_client.set_retry_policy(policy);
+            test_impl->failures = 2;
+            REQUIRE_THROWS_AS(test_client.download_file(request("http://flaky.com/"), file_path, options), http_file_download_exception);
+            REQUIRE_FALSE(fs::exists(file_path));
+        }
+
+        SECTION("verifies the checksum of the file") {
+            test_impl->resp_body = body;
+            options.crc32 = crc32_of(body);
+            test_client.download_file(request("http://flaky.com/"), file_path, options);
+            REQUIRE(read_file(file_path) == body);
+        }
+
+        SECTION("removes a file that doesn't match the checksum") {
+            test_impl->resp_body = body;
+            options.resume = true;
+            options.crc32 = crc32_of(body) + 1;
+            REQUIRE_THROWS_AS(test_client.download_file(request("http://flaky.com/"), file_path, options), http_file_download_exception);
+            REQUIRE_FALSE(fs::exists(file_path));
+            REQUIRE_FALSE(fs::exists(file_path + ".part"));
+        }
+
+        SECTION("removes the temporary file when the ranges can't be allocated") {
+            ranged_server server(body);
+            server.content_length = "18446744073709551615";
+            options.segments = 4;
+            REQUIRE_THROWS_AS(test_client.download_file(request("http://ranged.com/"), file_path, options), http_file_download_exception);
+            REQUIRE(server.transfers == 0);
+            REQUIRE(fs::is_empty(temp_dir_path));
+        }
+
+        SECTION("downloads ranges of the file concurrently") {
+            ranged_server server(body);
+            options.segments = 4;
+            options.min_segment_size = 10;
+            options.crc32 = crc32_of(body);
+            test_client.download_file(request("http://ranged.com/"), file_path, options);
+            REQUIRE(server.probes == 1);
+            sort(server.requested.begin(), server.requested.end());
+            REQUIRE(server.requested == (vector<string> { "0-9", "10-19", "20-29", "30-39" }));
+            REQUIRE(read_file(file_path) == body);
+        }
+
+        SECTION("resumes a failed range") {
+            ranged_server server(body);
+            server.failures = 1;
+            server.failure_partial = 4;
+            test_client.set_retry_policy(policy);
+            options.segments = 2;
+            options.min_segment_size = 10;
+            options.crc32 = crc32_of(body);
+            test_client.download_file(request("http://ranged.com/"), file_path, options);
+            REQUIRE(server.transfers == 3);
+            REQUIRE(find(server.requested.begin(), server.requested.end(), "4-19") != server.requested.end());
+            REQUIRE(read_file(file_path) == body);
+        }
+
+        SECTION("fails when a range can't be retried") {
+            ranged_server server(body);
+            server.failures = 1;
+            options.segments = 2;
+            options.min_segment_size = 10;
+            options.resume = true;
+            REQUIRE_THROWS_AS(test_client.download_file(request("http://ranged.com/"), file_path, options), http_file_download_exception);
+            REQUIRE_FALSE(fs::exists(file_path + ".part"));
+        }
+
+        SECTION("downloads the file in a single transfer if the server doesn't support ranges") {
+            ranged_server server(body, false);
+            options.segments = 4;
+            options.min_segment_size = 10;
+            test_client.download_file(request("http://ranged.com/"), file_path, options);
+            REQUIRE(server.requested == vector<string> { "" });
+            REQUIRE(read_file(file_path) == body);
+        }
+
+        SECTION("downloads a file smaller than two ranges in a single transfer") {
+            ranged_server server(body);
+            options.segments = 4;
+            options.min_segment_size = 21;
+            test_client.download_file(request("http://ranged.com/"), file_path, options);
+            REQUIRE(server.requested == vector<string> { "" });
+            REQUIRE(read_file(file_path) == body);
+        }
+    }
+
     TEST_CASE("curl::client download_file errors") {
          mock_client test_client;
          temp_directory temp_dir;
@@ -0,0 +1,133 @@
+// Benchmark of the parsing and storage of response headers in leatherman::curl.
+//
+// Prints the responses per second of each mode as a JSON document:
+//   response_headers  a response's headers added and looked up, as the client
+//                     does for each response, without a server
+//   get_headers       GET requests against a local HTTP server whose responses
+//                     carry many headers, as those of CDNs and package servers do
+//
+// Usage: curl_header_bench [url] [seconds]
+//
+// get_headers is run only if a url is given. The server must keep connections
+// alive and write each response at once, e.g.:
+//    python3 -c "import asyncio
+//    headers = b''.join(b'X-Header-%d: value %d\\r\\n' % (i, i) for i in range(40))
+//    resp = b'HTTP/1.1 200 OK\\r\\nContent-Length: 2\\r\\n' + headers + b'\\r\\nok'
+//    async def handle(r, w):
+//        while await r.readuntil(b'\\r\\n\\r\\n'):
+//            w.write(resp)
+//    async def main():
+//        s = await asyncio.start_server(handle, 'localhost', 8080)
+//        await s.serve_forever()
+//    asyncio.run(main())"
+//    curl_header_bench http://localhost:8080/
+
+#include <leatherman/curl/client.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+using leatherman::curl::client;
+using leatherman::curl::request;
+using leatherman::curl::response;
+
+namespace {
+
+    struct Benchmark {
+        std::string name;
+        // Handles one or more responses; returns how many
+        std::function<size_t()> run;
+    };
+
+    double responses_per_second(const Benchmark& benchmark, double seconds) {
+        using clock = std::chrono::steady_clock;
+        size_t responses = 0;
+        auto start = clock::now();
+        std::chrono::duration<double> elapsed {};
+
+        do {
+            responses += benchmark.run();
+            elapsed = clock::now() - start;
+        } while (elapsed.count() < seconds);
+
+        return responses / elapsed.count();
+    }
+
+    // Headers of a response from a CDN, in the case they are sent in over HTTP/2
+    std::vector<std::pair<std::string, std::string>> sample_headers() {
+        std::vector<std::pair<std::string, std::string>> headers {
+            { "content-type", "application/octet-stream" },
+            { "content-length", "1048576" },
+            { "date", "Thu, 16 Jul 2015 18:41:08 GMT" },
+            { "etag", "\"5d41402abc4b2a76b9719d911017c592\"" },
+            { "last-modified", "Wed, 15 Jul 2015 10:00:00 GMT" },
+            { "accept-ranges", "bytes" },
+            { "cache-control", "public, max-age=31536000" },
+            { "server", "cdn" },
+        };
+        for (int i = 0; i < 32; i++) {
+            headers.emplace_back("x-header-" + std::to_string(i), "value " + std::to_string(i));
+        }
+        return headers;
+    }
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    std::string url = argc > 1 ? argv[1] : "";
+    double seconds = argc > 2 ? std::atof(argv[2]) : 2.0;
+
+    auto headers = sample_headers();
+    client same_client {};
+
+    std::vector<Benchmark> benchmarks {
+        { "response_headers", [&] {
+            response res;
+            for (auto const& header : headers) {
+                res.add_header(header.first, header.second);
+            }
+            // The lookups the client makes of a download's response
+            size_t found = 0;
+            for (auto name : { "content-length", "content-range", "accept-ranges", "retry-after" }) {
+                found += res.header(name) ? 1 : 0;
+            }
+            if (found != 2) {
+                throw std::runtime_error("unexpected headers");
+            }
+            return 1;
+        } },
+    };
+    if (!url.empty()) {
+        benchmarks.push_back({ "get_headers", [&] {
+            auto res = same_client.get(request { url });
+            if (res.status_code() != 200) {
+                throw std::runtime_error("unexpected status code");
+            }
+            return 1;
+        } });
+    }
+
+    try {
+        std::printf("{\"benchmarks\":[");
+
+        for (size_t i = 0; i < benchmarks.size(); i++) {
+            std::fprintf(stderr, "running %s\n", benchmarks[i].name.c_str());
+            std::printf("%s{\"name\":\"%s\",\"responses_per_s\":%.1f}", i ? "," : "",
+                        benchmarks[i].name.c_str(), responses_per_second(benchmarks[i], seconds));
+            std::fflush(stdout);
+        }
+
+        std::printf("]}\n");
+    } catch (std::exception& e) {
+        std::fprintf(stderr, "\n%s\n", e.what());
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
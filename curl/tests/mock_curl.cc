@@ -1,4 +1,5 @@
 #define BUILDING_LIBCURL
+#include <algorithm>
 #include <cstring>
 #include <stdarg.h>
 #include <stdio.h>
@@ -23,6 +24,23 @@ curl_fail_init::~curl_fail_init()
     test_failure_mode = success;
 }
 
+/*
+ * The active ranged server, if any.
+ */
+static ranged_server* test_ranged_server = nullptr;
+
+ranged_server::ranged_server(string body, bool ranges) :
+    body(move(body)),
+    ranges(ranges)
+{
+    test_ranged_server = this;
+}
+
+ranged_server::~ranged_server()
+{
+    test_ranged_server = nullptr;
+}
+
 /*
  * libcurl implementations below. We are mocking necessary methods
  * of the CURL API to ensure that our wrapper is making the calls
@@ -152,6 +170,16 @@ CURLcode curl_easy_setopt(CURL *handle, CURLoption option, ...)
             }
             h->read_data = va_arg(vl, void*);
             break;
+        case CURLOPT_SEEKFUNCTION:
+            h->seek_function = va_arg(vl, int (*)(void*, curl_off_t, int));
+            break;
+        case CURLOPT_SEEKDATA:
+            h->seek_data = va_arg(vl, void*);
+            break;
+        case CURLOPT_POSTFIELDSIZE_LARGE:
+        case CURLOPT_INFILESIZE_LARGE:
+            h->upload_size = va_arg(vl, curl_off_t);
+            break;
         case CURLOPT_URL:
             // Set the mock curl URL as the URL specified in the request.
             if (h->test_failure_mode == curl_impl::error_mode::set_url_error) {
@@ -229,6 +257,16 @@ CURLcode curl_easy_setopt(CURL *handle, CURLoption option, ...)
                 va_end(vl);
                 return CURLE_COULDNT_CONNECT;
             }
+            h->timeout = va_arg(vl, long);
+            break;
+        case CURLOPT_RESUME_FROM_LARGE:
+            h->resume_from = va_arg(vl, curl_off_t);
+            break;
+        case CURLOPT_RANGE:
+            h->range = va_arg(vl, char*);
+            break;
+        case CURLOPT_NOBODY:
+            h->nobody = va_arg(vl, long);
             break;
         case CURLOPT_PROTOCOLS:
             if (h->test_failure_mode == curl_impl::error_mode::protocol_error) {
@@ -237,6 +275,19 @@ CURLcode curl_easy_setopt(CURL *handle, CURLoption option, ...)
             }
             h->protocols = va_arg(vl, long);
             break;
+        case CURLOPT_SHARE:
+            h->share = va_arg(vl, CURLSH*);
+            break;
+        case CURLOPT_PIPEWAIT:
+            h->pipewait = va_arg(vl, long);
+            break;
+        case CURLOPT_HTTP_VERSION:
+            h->http_version = va_arg(vl, long);
+            break;
+        case CURLOPT_ACCEPT_ENCODING:
+            h->accept_encoding = va_arg(vl, char*);
+            h->accept_encoding_set = true;
+            break;
         case CURLOPT_ERRORBUFFER:
             h->errbuf = va_arg(vl, char*); 
             break;
@@ -260,13 +311,30 @@ CURLcode curl_easy_perform(CURL * easy_handle)
         }
         if (h->trigger_external_failure) {
             #ifdef _WIN32
-            fclose(reinterpret_cast<FILE*>(h->body_context));
+            // The file being downloaded is the first member of the download's state
+            fclose(*reinterpret_cast<FILE**>(h->body_context));
             #endif
             h->trigger_external_failure();
         }
         return CURLE_COULDNT_CONNECT;
     }
 
+    if (h->request_url == "http://unreachable.com/") {
+        return CURLE_COULDNT_CONNECT;
+    }
+
+    /*
+     * Look up the host in the shared DNS cache, as real libcurl does.
+     */
+    if (h->share) {
+        auto share = reinterpret_cast<curl_share_impl*>(h->share);
+        if (share->lock) {
+            share->lock(easy_handle, CURL_LOCK_DATA_DNS, CURL_LOCK_ACCESS_SINGLE, share->user_data);
+            share->locks++;
+            share->unlock(easy_handle, CURL_LOCK_DATA_DNS, share->user_data);
+        }
+    }
+
     /*
      * Fill the read buffer in multiple chunks to better simulate real libcurl.
      */
@@ -275,8 +343,106 @@ CURLcode curl_easy_perform(CURL * easy_handle)
         char buf[10] = {};
 
         while ((bytes_returned = h->read_function(buf, 1, 10, h->read_data))) {
+            if (bytes_returned == CURL_READFUNC_ABORT) {
+                return CURLE_ABORTED_BY_CALLBACK;
+            }
             h->read_buffer.append(buf, bytes_returned);
         }
+
+        // Send the body again, as real libcurl does when following a redirect
+        if (h->rewind_body && h->seek_function) {
+            h->seek_result = h->seek_function(h->seek_data, 0, SEEK_SET);
+            if (h->seek_result == CURL_SEEKFUNC_OK) {
+                h->read_buffer.clear();
+                while ((bytes_returned = h->read_function(buf, 1, 10, h->read_data))) {
+                    h->read_buffer.append(buf, bytes_returned);
+                }
+            }
+        }
+    }
+
+    /*
+     * Simulate a flaky server, resuming transfers from the requested offset.
+     */
+    if (h->request_url == "http://flaky.com/") {
+        ++h->attempts;
+        h->resumes.push_back(h->resume_from);
+        auto resume_from = h->resume_from;
+        h->resume_from = 0;
+
+        if (h->attempts == h->refused_attempt) {
+            return CURLE_COULDNT_CONNECT;
+        }
+        bool failing = h->attempts <= h->failures;
+        if (resume_from > 0 && h->ignore_range) {
+            return CURLE_RANGE_ERROR;
+        }
+        int status = failing && h->failure_error == CURLE_OK ? h->failure_status : (resume_from > 0 ? 206 : 200);
+        if (h->write_header) {
+            vector<string> headers { "HTTP/1.1 " + to_string(status) + " Flaky\r\n" };
+            if (failing && !h->retry_after.empty()) {
+                headers.push_back("Retry-After: " + h->retry_after + "\r\n");
+            }
+            for (auto& header : headers) {
+                h->write_header(&header[0], 1, header.size(), h->header_context);
+            }
+        }
+
+        string body = status >= 400 ? "failed" : h->resp_body.substr(static_cast<size_t>(resume_from));
+        if (failing && h->failure_error != CURLE_OK) {
+            body = body.substr(0, h->failure_partial);
+        }
+        if (!body.empty() && h->write_body(&body[0], 1, body.size(), h->body_context) != body.size()) {
+            return CURLE_WRITE_ERROR;
+        }
+        return failing ? h->failure_error : CURLE_OK;
+    }
+
+    /*
+     * Simulate a server supporting range requests, whose first range transfers fail.
+     */
+    if (h->request_url == "http://ranged.com/" && test_ranged_server) {
+        auto& server = *test_ranged_server;
+        auto write_headers = [&](vector<string> headers) {
+            for (auto& header : headers) {
+                header += "\r\n";
+                h->write_header(&header[0], 1, header.size(), h->header_context);
+            }
+        };
+
+        if (h->nobody) {
+            ++server.probes;
+            auto length = server.content_length.empty() ? to_string(server.body.size()) : server.content_length;
+            vector<string> headers { "HTTP/1.1 200 OK", "Content-Length: " + length };
+            if (server.ranges) {
+                headers.push_back("Accept-Ranges: bytes");
+            }
+            write_headers(headers);
+            return CURLE_OK;
+        }
+
+        server.requested.push_back(h->range);
+        string body = server.body;
+        bool failing = false;
+        if (!h->range.empty() && server.ranges) {
+            ++server.transfers;
+            failing = server.transfers <= server.failures;
+            auto dash = h->range.find('-');
+            auto first = stoull(h->range.substr(0, dash));
+            auto last = stoull(h->range.substr(dash + 1));
+            body = body.substr(first, last - first + 1);
+            write_headers({ "HTTP/1.1 206 Partial Content",
+                            "Content-Range: bytes " + h->range + "/" + to_string(server.body.size()) });
+        } else {
+            write_headers({ "HTTP/1.1 200 OK" });
+        }
+        if (failing) {
+            body = body.substr(0, server.failure_partial);
+        }
+        if (!body.empty() && h->write_body(&body[0], 1, body.size(), h->body_context) != body.size()) {
+            return CURLE_WRITE_ERROR;
+        }
+        return failing ? server.failure_error : CURLE_OK;
     }
 
     /*
@@ -303,6 +469,15 @@ CURLcode curl_easy_perform(CURL * easy_handle)
                                     "Via: 1.1 vegur";
 
             h->write_header(&header_content[0], 1, header_content.size(), h->header_context);
+        } else if (h->request_url == "http://http2.com/") {
+            // Each header in its own call, as real libcurl writes them
+            for (string header : { "HTTP/2 204\r\n",
+                                   "content-type: text/plain\r\n",
+                                   "set-cookie: first=1\r\n",
+                                   "Set-Cookie:  second=2 \r\n",
+                                   "\r\n" }) {
+                h->write_header(&header[0], 1, header.size(), h->header_context);
+            }
         } else if (h->request_url == "http://nonstd-header.com/") {
             string header_content = "nonstd_header_name:nonstd_header_value";
             h->write_header(&header_content[0], 1, header_content.size(), h->header_context);
@@ -325,10 +500,16 @@ CURLcode curl_easy_perform(CURL * easy_handle)
     }
 
     /*
-     * We set resp_body internally in write_body tests.
+     * We set resp_body internally in write_body tests. Write it in multiple
+     * chunks and stop if one isn't fully written, as real libcurl does.
      */
     if (h->write_body) {
-        h->write_body(&h->resp_body[0], 1, h->resp_body.size(), h->body_context);
+        for (size_t offset = 0; offset < h->resp_body.size(); offset += 10) {
+            auto size = min<size_t>(10, h->resp_body.size() - offset);
+            if (h->write_body(&h->resp_body[offset], 1, size, h->body_context) != size) {
+                return CURLE_WRITE_ERROR;
+            }
+        }
     }
 
     return CURLE_OK;
@@ -337,8 +518,47 @@ CURLcode curl_easy_perform(CURL * easy_handle)
 /*
  * Unimplemented, as resetting options is not necessary for testing.
  */
+/*
+ * Get information about the last transfer.
+ */
+CURLcode curl_easy_getinfo(CURL *handle, CURLINFO info, ...)
+{
+    auto h = reinterpret_cast<curl_impl*>(handle);
+    va_list vl;
+    va_start(vl, info);
+    CURLcode result = CURLE_OK;
+    switch (info) {
+        case CURLINFO_SIZE_DOWNLOAD_T:
+            *va_arg(vl, curl_off_t*) = h->size_download;
+            break;
+        case CURLINFO_RESPONSE_CODE:
+            *va_arg(vl, long*) = h->response_code;
+            break;
+        default: {
+            // Report the information set by the test, as an unsupported option otherwise
+            auto type = info & CURLINFO_TYPEMASK;
+            if (type == CURLINFO_LONG && h->info_long.count(info)) {
+                *va_arg(vl, long*) = h->info_long[info];
+            } else if (type == CURLINFO_DOUBLE && h->info_double.count(info)) {
+                *va_arg(vl, double*) = h->info_double[info];
+            } else if (type == CURLINFO_OFF_T && h->info_off_t.count(info)) {
+                *va_arg(vl, curl_off_t*) = h->info_off_t[info];
+            } else {
+                result = CURLE_UNKNOWN_OPTION;
+            }
+            break;
+        }
+    }
+    va_end(vl);
+    return result;
+}
+
 void curl_easy_reset(CURL *handle)
 {
+    // Only the options that would otherwise carry over to the next transfer
+    auto h = reinterpret_cast<curl_impl*>(handle);
+    h->range.clear();
+    h->nobody = 0;
 }
 
 /*
@@ -358,12 +578,210 @@ const char *curl_easy_strerror(CURLcode errornum)
             return "cURL failed with: CURLE_OUT_OF_MEMORY";
         case CURLE_UNKNOWN_OPTION:
             return "cURL failed with CURLE_UNKNOWN_OPTION";
+        case CURLE_PARTIAL_FILE:
+            return "cURL failed with: CURLE_PARTIAL_FILE";
+        case CURLE_RECV_ERROR:
+            return "cURL failed with: CURLE_RECV_ERROR";
+        case CURLE_RANGE_ERROR:
+            return "cURL failed with: CURLE_RANGE_ERROR";
         default:
             return nullptr;
     }
     return nullptr;
 }
 
+/*
+ * Create a share handle. The mock implementation returns a new mock
+ * share object, unless we are specifically testing share_init
+ * exception handling, in which case we return nullptr.
+ */
+CURLSH *curl_share_init(void)
+{
+    if (test_failure_mode == share_init_error) {
+        return nullptr;
+    } else {
+        return reinterpret_cast<CURLSH*>(new curl_share_impl());
+    }
+}
+
+/*
+ * Set options for a share handle, storing them in the mock share
+ * object so that they can be verified in the tests.
+ */
+CURLSHcode curl_share_setopt(CURLSH *share, CURLSHoption option, ...)
+{
+    if (test_failure_mode == share_setopt_error) {
+        return CURLSHE_BAD_OPTION;
+    }
+
+    auto s = reinterpret_cast<curl_share_impl*>(share);
+    va_list vl;
+    va_start(vl, option);
+
+    switch (option) {
+        case CURLSHOPT_SHARE:
+            s->shared_data |= 1L << va_arg(vl, int);
+            break;
+        case CURLSHOPT_LOCKFUNC:
+            s->lock = va_arg(vl, curl_lock_function);
+            break;
+        case CURLSHOPT_UNLOCKFUNC:
+            s->unlock = va_arg(vl, curl_unlock_function);
+            break;
+        case CURLSHOPT_USERDATA:
+            s->user_data = va_arg(vl, void*);
+            break;
+        default:
+            break;
+    }
+    va_end(vl);
+    return CURLSHE_OK;
+}
+
+/*
+ * Delete the mock share object.
+ */
+CURLSHcode curl_share_cleanup(CURLSH *share)
+{
+    delete reinterpret_cast<curl_share_impl*>(share);
+    return CURLSHE_OK;
+}
+
+const char *curl_share_strerror(CURLSHcode errornum)
+{
+    switch (errornum) {
+        case CURLSHE_BAD_OPTION:
+            return "cURL share failed with: CURLSHE_BAD_OPTION";
+        default:
+            return nullptr;
+    }
+}
+
+/*
+ * Create a multi handle. The mock implementation returns a new mock
+ * multi object, unless we are specifically testing multi_init
+ * exception handling, in which case we return nullptr.
+ */
+CURLM *curl_multi_init(void)
+{
+    if (test_failure_mode == multi_init_error) {
+        return nullptr;
+    } else {
+        return reinterpret_cast<CURLM*>(new curl_multi_impl());
+    }
+}
+
+/*
+ * Set options for a multi handle, storing them in the mock multi
+ * object so that they can be verified in the tests.
+ */
+CURLMcode curl_multi_setopt(CURLM *multi_handle, CURLMoption option, ...)
+{
+    auto m = reinterpret_cast<curl_multi_impl*>(multi_handle);
+    va_list vl;
+    va_start(vl, option);
+
+    switch (option) {
+        case CURLMOPT_PIPELINING:
+            m->pipelining = va_arg(vl, long);
+            break;
+        default:
+            break;
+    }
+    va_end(vl);
+    return CURLM_OK;
+}
+
+CURLMcode curl_multi_add_handle(CURLM *multi_handle, CURL *curl_handle)
+{
+    auto m = reinterpret_cast<curl_multi_impl*>(multi_handle);
+    m->handles.push_back(curl_handle);
+    m->added.push_back(curl_handle);
+    m->max_handles = max(m->max_handles, m->handles.size());
+    return CURLM_OK;
+}
+
+CURLMcode curl_multi_remove_handle(CURLM *multi_handle, CURL *curl_handle)
+{
+    auto m = reinterpret_cast<curl_multi_impl*>(multi_handle);
+    m->handles.erase(remove(m->handles.begin(), m->handles.end(), curl_handle), m->handles.end());
+    return CURLM_OK;
+}
+
+/*
+ * Perform the transfers of a multi handle. The mock implementation
+ * completes one transfer per call once the handle has been polled,
+ * so that the client has to wait between transfers, as with real
+ * libcurl.
+ */
+CURLMcode curl_multi_perform(CURLM *multi_handle, int *running_handles)
+{
+    if (test_failure_mode == multi_perform_error) {
+        return CURLM_INTERNAL_ERROR;
+    }
+
+    auto m = reinterpret_cast<curl_multi_impl*>(multi_handle);
+    if (m->ready && !m->handles.empty()) {
+        m->ready = false;
+        CURLMsg msg {};
+        msg.msg = CURLMSG_DONE;
+        msg.easy_handle = m->handles.front();
+        msg.data.result = curl_easy_perform(msg.easy_handle);
+        m->handles.erase(m->handles.begin());
+        m->done.push_back(msg);
+    }
+    *running_handles = static_cast<int>(m->handles.size());
+    return CURLM_OK;
+}
+
+CURLMsg *curl_multi_info_read(CURLM *multi_handle, int *msgs_in_queue)
+{
+    auto m = reinterpret_cast<curl_multi_impl*>(multi_handle);
+    if (m->done.empty()) {
+        *msgs_in_queue = 0;
+        return nullptr;
+    }
+    m->msg = m->done.front();
+    m->done.erase(m->done.begin());
+    *msgs_in_queue = static_cast<int>(m->done.size());
+    return &m->msg;
+}
+
+CURLMcode curl_multi_poll(CURLM *multi_handle, struct curl_waitfd extra_fds[], unsigned int extra_nfds, int timeout_ms, int *ret)
+{
+    auto m = reinterpret_cast<curl_multi_impl*>(multi_handle);
+    m->polls++;
+    m->ready = true;
+    return CURLM_OK;
+}
+
+CURLMcode curl_multi_wait(CURLM *multi_handle, struct curl_waitfd extra_fds[], unsigned int extra_nfds, int timeout_ms, int *ret)
+{
+    auto m = reinterpret_cast<curl_multi_impl*>(multi_handle);
+    m->polls++;
+    m->ready = true;
+    return CURLM_OK;
+}
+
+/*
+ * Delete the mock multi object.
+ */
+CURLMcode curl_multi_cleanup(CURLM *multi_handle)
+{
+    delete reinterpret_cast<curl_multi_impl*>(multi_handle);
+    return CURLM_OK;
+}
+
+const char *curl_multi_strerror(CURLMcode errornum)
+{
+    switch (errornum) {
+        case CURLM_INTERNAL_ERROR:
+            return "cURL multi failed with: CURLM_INTERNAL_ERROR";
+        default:
+            return nullptr;
+    }
+}
+
 /*
  * Unimplemented, as we don't allocate many objects to clean up
  * in tests.
@@ -2,6 +2,8 @@
 
 #include <string>
 #include <functional>
+#include <map>
+#include <vector>
 #include <curl/curl.h>
 #ifdef _WIN32
     #include "export.h"
@@ -55,6 +57,10 @@ struct curl_impl
     std::function<size_t(char*, size_t, size_t, void*)> read_function;
     void* read_data; // Where to read the request body from
 
+    // Pointer for client::seek_body as a callback function in curl_easy_setopt
+    std::function<int(void*, curl_off_t, int)> seek_function;
+    void* seek_data;
+
     std::string request_url, cookie, cacert, client_cert, client_key;
     long protocols;
     long connect_timeout;
@@ -63,18 +69,74 @@ struct curl_impl
     curl_slist* header; // List of custom request headers to be passed to the server
 
     std::string read_buffer; // Buffer to test reading the request body
+    curl_off_t upload_size = 0; // Size of the request body set for a POST or PUT
+    bool rewind_body = false;   // Whether to read the request body again from the start, as after a redirect
+    int seek_result = CURL_SEEKFUNC_OK;
     std::string resp_body;   // Response body which should be written to a context using the write_body function callback
 
+    CURLSH* share = nullptr; // Share handle whose caches the handle uses
+    long pipewait = 0;       // Whether to wait for a connection to multiplex on
+    long http_version = CURL_HTTP_VERSION_NONE;
+    std::string accept_encoding; // Encodings accepted for the response body
+    bool accept_encoding_set = false;
+    curl_off_t size_download = 0; // Size of the response body as received, reported by curl_easy_getinfo
+    long response_code = 0;       // Status code reported by curl_easy_getinfo, or 0 if none
+    // Other information reported by curl_easy_getinfo, by type
+    std::map<CURLINFO, long> info_long;
+    std::map<CURLINFO, double> info_double;
+    std::map<CURLINFO, curl_off_t> info_off_t;
+    long timeout = 0;
+
+    // A flaky server at http://flaky.com/, whose first transfers fail either
+    // with failure_error after sending part of the body, or with a failure_status response
+    int failures = 0;
+    CURLcode failure_error = CURLE_OK;
+    int failure_status = 503;
+    std::string retry_after;      // Retry-After header of the failure responses
+    size_t failure_partial = 0;   // Bytes of the body sent before failing with failure_error
+    bool ignore_range = false;    // Whether the server fails resumed transfers as it doesn't support ranges
+    int refused_attempt = 0;      // Transfer failing with CURLE_COULDNT_CONNECT before any response
+    int attempts = 0;             // Number of transfers performed
+    curl_off_t resume_from = 0;
+    std::vector<curl_off_t> resumes; // Offset each transfer resumed from
+    std::string range;            // Range of the body requested
+    long nobody = 0;              // Whether to request the headers only
+
     char* errbuf = 0;
     // Pointer to trigger failure callbacks
     std::function<void()> trigger_external_failure;
 };
 
+struct curl_share_impl
+{
+    long shared_data = 0; // Bitmask of the shared curl_lock_data
+    curl_lock_function lock = nullptr;
+    curl_unlock_function unlock = nullptr;
+    void* user_data = nullptr;
+    int locks = 0; // Number of times the caches were locked
+};
+
+struct curl_multi_impl
+{
+    std::vector<CURL*> handles;   // Easy handles added and not yet performed
+    std::vector<CURLMsg> done;    // Messages of the performed handles, not yet read
+    CURLMsg msg;                  // The last message read
+    std::vector<CURL*> added;     // Every easy handle added, in order
+    size_t max_handles = 0;       // Largest number of handles added at once
+    long pipelining = 0;
+    int polls = 0;                // Number of times the handle was polled
+    bool ready = false;           // Whether a transfer is ready to complete
+};
+
 enum error_mode
 {
     success,
     easy_init_error,
-    global_init_error
+    global_init_error,
+    share_init_error,
+    share_setopt_error,
+    multi_init_error,
+    multi_perform_error
 };
 
 struct MOCK_CURL_EXPORT curl_fail_init
@@ -82,3 +144,26 @@ struct MOCK_CURL_EXPORT curl_fail_init
     curl_fail_init(error_mode mode);
     ~curl_fail_init();
 };
+
+/*
+ * A server at http://ranged.com/ serving body, which supports range requests
+ * if ranges is set. Its first range transfers fail with failure_error after
+ * sending failure_partial bytes. The server is global as a download may
+ * create clients of its own, and is active while the object exists.
+ */
+struct MOCK_CURL_EXPORT ranged_server
+{
+    ranged_server(std::string body, bool ranges = true);
+    ~ranged_server();
+
+    std::string body;
+    bool ranges;
+    int failures = 0;
+    CURLcode failure_error = CURLE_RECV_ERROR;
+    size_t failure_partial = 0;
+    std::string content_length;      // Content-Length of the probe, if not the size of body
+
+    int probes = 0;                  // Number of requests for the headers only
+    int transfers = 0;               // Number of range transfers performed
+    std::vector<std::string> requested; // Range of each transfer, or an empty string for the whole body
+};
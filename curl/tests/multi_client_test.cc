@@ -0,0 +1,204 @@
+#include <catch.hpp>
+#include "mock_curl.hpp"
+#include <leatherman/curl/multi_client.hpp>
+#include <leatherman/curl/request.hpp>
+#include <leatherman/curl/response.hpp>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace leatherman { namespace curl {
+
+    struct mock_multi_client : multi_client {
+        curl_multi_handle const& get_handle() { return multi_client::get_handle(); }
+    };
+
+    TEST_CASE("curl::multi_client requests") {
+        mock_multi_client test_client;
+        auto test_impl = reinterpret_cast<curl_multi_impl*>(static_cast<CURLM*>(test_client.get_handle()));
+        map<string, int> status_codes;
+        auto record = [&](string url) {
+            return [&, url](response res) { status_codes[url] = res.status_code(); };
+        };
+
+        SECTION("All queued requests should complete with their own response") {
+            test_client.get(request {"http://valid.com/"}, record("get"));
+            test_client.post(request {"http://valid.com/"}, record("post"));
+            test_client.put(request {"http://invalid.com/"}, record("put"));
+            REQUIRE(test_client.pending() == 3u);
+
+            test_client.perform();
+            REQUIRE(test_client.pending() == 0u);
+            REQUIRE(status_codes == (map<string, int> { {"get", 200}, {"post", 200}, {"put", 404} }));
+        }
+
+        SECTION("The client should wait for activity until the transfers complete") {
+            test_client.get(request {"http://valid.com/"}, record("first"));
+            test_client.get(request {"http://valid.com/"}, record("second"));
+            test_client.perform();
+            REQUIRE(test_impl->polls == 2);
+        }
+
+        SECTION("The response body should be passed to the callback") {
+            string body;
+            test_client.get(request {"https://download.com"}, [&](response res) { body = res.body(); });
+            test_client.perform();
+            REQUIRE(body == "successfully downloaded file");
+        }
+
+        SECTION("The transfers should be observed with their metrics") {
+            vector<string> observed;
+            client::set_transfer_observer([&](request const& req, response const& res, CURLcode result) {
+                observed.push_back(req.url() + " " + to_string(res.status_code()));
+            });
+            test_client.get(request {"http://valid.com/"}, nullptr);
+            test_client.get(request {"http://invalid.com/"}, nullptr);
+            test_client.perform();
+            client::set_transfer_observer(nullptr);
+            REQUIRE(observed == (vector<string> { "http://valid.com/ 200", "http://invalid.com/ 404" }));
+        }
+
+        SECTION("Requests queued by a callback should be performed") {
+            test_client.get(request {"http://valid.com/"}, [&](response res) {
+                test_client.get(request {"http://invalid.com/"}, record("chained"));
+            });
+            test_client.perform();
+            REQUIRE(status_codes["chained"] == 404);
+        }
+
+        SECTION("Performing without queued requests should do nothing") {
+            test_client.perform();
+            REQUIRE(test_impl->polls == 0);
+        }
+    }
+
+    TEST_CASE("curl::multi_client connections") {
+        mock_multi_client test_client;
+        auto test_impl = reinterpret_cast<curl_multi_impl*>(static_cast<CURLM*>(test_client.get_handle()));
+
+        SECTION("Requests to a host should be capped by default") {
+            for (int i = 0; i < 20; i++) {
+                test_client.get(request {"http://valid.com/"}, nullptr);
+            }
+            test_client.perform();
+            REQUIRE(test_impl->max_handles == multi_client::default_max_host_connections);
+        }
+
+        SECTION("Requests over the host cap should wait for the others to complete") {
+            vector<int> status_codes;
+            test_client.set_max_host_connections(2);
+            for (int i = 0; i < 5; i++) {
+                test_client.get(request {"http://valid.com/"}, [&](response res) { status_codes.push_back(res.status_code()); });
+            }
+            test_client.perform();
+            REQUIRE(test_impl->max_handles == 2u);
+            REQUIRE(status_codes == vector<int>(5, 200));
+        }
+
+        SECTION("The host cap should apply to each host") {
+            test_client.set_max_host_connections(1);
+            test_client.get(request {"http://valid.com/"}, nullptr);
+            test_client.get(request {"http://valid.com/"}, nullptr);
+            test_client.get(request {"http://invalid.com/"}, nullptr);
+            test_client.perform();
+            REQUIRE(test_impl->max_handles == 2u);
+        }
+
+        SECTION("The total cap should apply across hosts") {
+            test_client.set_max_host_connections(0);
+            test_client.set_max_connections(1);
+            test_client.get(request {"http://valid.com/"}, nullptr);
+            test_client.get(request {"http://invalid.com/"}, nullptr);
+            test_client.perform();
+            REQUIRE(test_impl->max_handles == 1u);
+        }
+
+        SECTION("Requests should not be capped without limits") {
+            test_client.set_max_host_connections(0);
+            for (int i = 0; i < 20; i++) {
+                test_client.get(request {"http://valid.com/"}, nullptr);
+            }
+            test_client.perform();
+            REQUIRE(test_impl->max_handles == 20u);
+        }
+
+        SECTION("Requests should be multiplexed over HTTP/2") {
+            REQUIRE(test_impl->pipelining == CURLPIPE_MULTIPLEX);
+
+            test_client.get(request {"http://valid.com/"}, nullptr);
+            test_client.perform();
+            auto handle = reinterpret_cast<curl_impl*>(test_impl->added.front());
+            REQUIRE(handle->pipewait == 1);
+            REQUIRE(handle->http_version == CURL_HTTP_VERSION_2TLS);
+        }
+
+        SECTION("Client settings should apply to every request") {
+            test_client.set_ca_cert("cacert");
+            test_client.set_client_cert("cert", "key");
+            test_client.set_supported_protocols(CURLPROTO_HTTPS);
+            test_client.get(request {"http://valid.com/"}, nullptr);
+            test_client.get(request {"http://valid.com/"}, nullptr);
+            test_client.perform();
+
+            REQUIRE(test_impl->added.size() == 2u);
+            for (auto easy : test_impl->added) {
+                auto handle = reinterpret_cast<curl_impl*>(easy);
+                REQUIRE(handle->cacert == "cacert");
+                REQUIRE(handle->client_cert == "cert");
+                REQUIRE(handle->client_key == "key");
+                REQUIRE(handle->protocols == CURLPROTO_HTTPS);
+            }
+        }
+
+        SECTION("Handles of completed requests should be reused") {
+            test_client.get(request {"http://valid.com/"}, nullptr);
+            test_client.perform();
+            test_client.get(request {"http://valid.com/"}, nullptr);
+            test_client.perform();
+
+            REQUIRE(test_impl->added.size() == 2u);
+            REQUIRE(test_impl->added[0] == test_impl->added[1]);
+        }
+    }
+
+    TEST_CASE("curl::multi_client errors") {
+        mock_multi_client test_client;
+
+        SECTION("multi handle fails to initialize") {
+            curl_fail_init mock_error {multi_init_error};
+            REQUIRE_THROWS_AS(mock_multi_client test_client, http_exception);
+        }
+
+        SECTION("Failed requests should be passed to the error callback") {
+            vector<string> failed;
+            int responses = 0;
+            test_client.get(request {"http://unreachable.com/"},
+                            [&](response) { responses++; },
+                            [&](http_request_exception const& e) { failed.push_back(e.req().url()); });
+            test_client.get(request {"http://valid.com/"}, [&](response) { responses++; });
+            test_client.perform();
+            REQUIRE(failed == vector<string> { "http://unreachable.com/" });
+            REQUIRE(responses == 1);
+        }
+
+        SECTION("Failed requests without an error callback should throw, and perform should resume") {
+            int responses = 0;
+            test_client.get(request {"http://unreachable.com/"}, [&](response) { responses++; });
+            test_client.get(request {"http://valid.com/"}, [&](response) { responses++; });
+            REQUIRE_THROWS_AS(test_client.perform(), http_request_exception);
+            REQUIRE(test_client.pending() == 1u);
+
+            test_client.perform();
+            REQUIRE(responses == 1);
+        }
+
+        SECTION("multi handle fails to perform") {
+            test_client.get(request {"http://valid.com/"}, nullptr);
+            curl_fail_init mock_error {multi_perform_error};
+            REQUIRE_THROWS_AS(test_client.perform(), http_exception);
+        }
+    }
+
+}}  // namespace leatherman::curl
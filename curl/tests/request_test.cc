@@ -74,6 +74,45 @@ namespace leatherman { namespace curl {
             REQUIRE(body == "Hello, I am a request body!");
         }
 
+        SECTION("A streamed request body should replace the request body") {
+            string data = "Hello, I am a request body in memory!";
+            test_request.body("Hello, I am a request body!", "message");
+            test_request.body_memory(data.data(), data.size(), "message");
+            REQUIRE(test_request.body().empty());
+            REQUIRE(test_request.streamed_body());
+            REQUIRE(test_request.streamed_body()->size() == static_cast<int64_t>(data.size()));
+
+            test_request.body("Hello, I am a request body!", "message");
+            REQUIRE_FALSE(test_request.streamed_body());
+        }
+
+        SECTION("A request body in memory should be readable from any offset") {
+            string data = "Hello, I am a request body in memory!";
+            test_request.body_memory(data.data(), data.size(), "message");
+            auto const& source = test_request.streamed_body();
+            REQUIRE(source->seekable());
+
+            char buffer[5];
+            REQUIRE(source->read(buffer, sizeof(buffer), 7) == 5u);
+            REQUIRE(string(buffer, 5) == "I am ");
+            REQUIRE(source->read(buffer, sizeof(buffer), data.size() - 2) == 2u);
+            REQUIRE(source->read(buffer, sizeof(buffer), data.size()) == 0u);
+        }
+
+        SECTION("A request body read from a function should have the given size, or none") {
+            auto reader = [](char*, size_t) { return size_t(0); };
+            test_request.body_stream(reader, "message", 42);
+            REQUIRE(test_request.streamed_body()->size() == 42);
+            REQUIRE_FALSE(test_request.streamed_body()->seekable());
+
+            test_request.body_stream(reader, "message");
+            REQUIRE(test_request.streamed_body()->size() == -1);
+        }
+
+        SECTION("A request body file that can't be opened should throw") {
+            REQUIRE_THROWS_AS(test_request.body_file("does/not/exist", "message"), http_exception);
+        }
+
         SECTION("Overall request timeout should be configurable and retrievable") {
             test_request.timeout(100);
             REQUIRE(test_request.timeout() == 100);
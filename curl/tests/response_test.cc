@@ -2,6 +2,8 @@
 #include "mock_curl.hpp"
 #include <leatherman/curl/client.hpp>
 #include <leatherman/curl/request.hpp>
+#include <string>
+#include <vector>
 
 using namespace std;
 
@@ -45,12 +47,45 @@ namespace leatherman { namespace curl {
             });
         }
 
+        SECTION("Header names should be compared ignoring case") {
+            test_response.add_header("content-length", "10");
+            test_response.add_header("Content-Length", "20");
+            auto header = test_response.header("CONTENT-LENGTH");
+            REQUIRE(header);
+            REQUIRE(*header == "10");
+
+            test_response.remove_header("Content-length");
+            REQUIRE(test_response.header("content-length") == nullptr);
+        }
+
+        SECTION("Headers should be enumerated in the order they were added") {
+            vector<string> names;
+            test_response.add_header("Set-Cookie", "b=2");
+            test_response.add_header("Date", "today");
+            test_response.add_header("Set-Cookie", "a=1");
+            test_response.each_header([&](string const& name, string const& value) {
+                names.push_back(name + ": " + value);
+                return true;
+            });
+            REQUIRE(names == (vector<string> { "Set-Cookie: b=2", "Date: today", "Set-Cookie: a=1" }));
+        }
+
         SECTION("Response body should be addable and retrievable") {
             test_response.body("Hello, I am a response body!");
             auto body = test_response.body();
             REQUIRE(body == "Hello, I am a response body!");
         }
 
+        SECTION("Transfer metrics should be settable and retrievable") {
+            REQUIRE(test_response.metrics().total.count() == 0);
+            transfer_metrics metrics;
+            metrics.total = chrono::microseconds(1500);
+            metrics.connection_reused = true;
+            test_response.metrics(metrics);
+            REQUIRE(test_response.metrics().total == chrono::microseconds(1500));
+            REQUIRE(test_response.metrics().connection_reused);
+        }
+
         SECTION("Status code should be addable and retrievable") {
             test_response.status_code(200);
             auto code = test_response.status_code();
@@ -0,0 +1,2 @@
+#define EXEC_TESTS_DIRECTORY "/root/repo/execution/tests"
+#define CMAKE_BIN_DIRECTORY "/tmp/gb/bin"
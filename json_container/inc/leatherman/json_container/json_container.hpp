@@ -2,10 +2,13 @@
 
 #include <vector>
 #include <cstdarg>
+#include <cstdint>
+#include <iterator>
 #include <iostream>
 #include <tuple>
 #include <typeinfo>
 #include <memory>
+#include <boost/utility/string_ref.hpp>
 #include <leatherman/locale/locale.hpp>
 
 // Mark string for translation (alias for leatherman::locale::format)
@@ -54,7 +57,19 @@ namespace leatherman { namespace json_container {
 
     // Types
 
-    enum DataType { Object, Array, String, Int, Bool, Double, Null };
+    /// Int is used for integral values that fit in an int, Int64 for
+    /// the other ones that fit in an int64_t and Uint64 for the values
+    /// greater than INT64_MAX.
+    enum DataType { Object, Array, String, Int, Bool, Double, Null, Int64, Uint64 };
+
+    /// How a JSON text is parsed into a container. Eager parses the
+    /// whole text at once. Lazy, for large objects of which only a few
+    /// entries are used, scans the text for the extent of each member
+    /// of the root object and parses a member only when first looked
+    /// up; texts of other types are parsed at once.
+    /// WARNING: in lazy mode, reading a container modifies it, so that
+    /// a lazy container must not be read by several threads at once.
+    enum class ParseMode { Eager, Lazy };
 
     struct JsonContainerKey : public std::string {
         JsonContainerKey(const std::string& value) : std::string(value) {}
@@ -62,6 +77,28 @@ namespace leatherman { namespace json_container {
         JsonContainerKey(std::initializer_list<char> il) = delete;
     };
 
+    /// A sequence of nested keys compiled once, with the hash of each
+    /// key computed up front, so that it can be reused across many
+    /// lookups without being copied or re-measured.
+    class JsonContainerPath {
+    public:
+        struct Step {
+            JsonContainerKey key;
+            size_t hash;
+        };
+
+        explicit JsonContainerPath(const std::vector<JsonContainerKey>& keys);
+
+        const std::vector<Step>& steps() const { return steps_; }
+
+        /// Hash function used for keys, both by JsonContainerPath and
+        /// by the member index of JsonContainer.
+        static size_t hashKey(const char* key, size_t length);
+
+    private:
+        std::vector<Step> steps_;
+    };
+
     /**
      * Typedef for RapidJSON allocator.
      */
@@ -75,10 +112,153 @@ namespace leatherman { namespace json_container {
      */
     using json_document = rapidjson::GenericDocument<rapidjson::UTF8<char>, json_allocator, json_allocator>;
 
+    class JsonContainer;
+    class JsonArenaContainer;
+    class JsonContainerMemberIterator;
+    class JsonContainerElementIterator;
+    template <typename Iterator> class JsonContainerRange;
+    using JsonContainerMembers = JsonContainerRange<JsonContainerMemberIterator>;
+    using JsonContainerElements = JsonContainerRange<JsonContainerElementIterator>;
+
+    /// Read-only view of a value stored in a JsonContainer; it doesn't
+    /// copy the value and it's only valid until the container is
+    /// modified or destroyed.
+    class JsonContainerView {
+    public:
+        explicit JsonContainerView(const json_value& value) : value_(&value) {}
+
+        DataType type() const;
+
+        /// Return the number of entries in case of an object or an
+        /// array; 0 otherwise.
+        size_t size() const;
+
+        /// Return the value; T can be int, int64_t, uint64_t, double,
+        /// bool, std::string, boost::string_ref (viewing the string
+        /// stored in the container) or JsonContainer (a copy).
+        /// Null values are returned as the default of T.
+        /// Throw a data_type_error in case the type T doesn't match
+        /// the one of the value.
+        template <typename T>
+        T get() const;
+
+        /// Throw a data_type_error in case the value is not an object.
+        JsonContainerMembers members() const;
+
+        /// Throw a data_type_error in case the value is not an array.
+        JsonContainerElements elements() const;
+
+        std::string toString() const;
+
+        const json_value& getRaw() const { return *value_; }
+
+    private:
+        const json_value* value_;
+    };
+
+    struct JsonContainerMember {
+        boost::string_ref name;
+        JsonContainerView value;
+    };
+
+    /// Iterator over the members of an object, in document order.
+    class JsonContainerMemberIterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = JsonContainerMember;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const JsonContainerMember*;
+        using reference = JsonContainerMember;
+
+        JsonContainerMemberIterator(const json_value& object, size_t index)
+                : object_(&object), index_(index) {}
+
+        JsonContainerMember operator*() const;
+
+        JsonContainerMemberIterator& operator++() {
+            ++index_;
+            return *this;
+        }
+
+        JsonContainerMemberIterator operator++(int) {
+            auto previous = *this;
+            ++index_;
+            return previous;
+        }
+
+        bool operator==(const JsonContainerMemberIterator& other) const {
+            return object_ == other.object_ && index_ == other.index_;
+        }
+
+        bool operator!=(const JsonContainerMemberIterator& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        const json_value* object_;
+        size_t index_;
+    };
+
+    /// Iterator over the elements of an array.
+    class JsonContainerElementIterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = JsonContainerView;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const JsonContainerView*;
+        using reference = JsonContainerView;
+
+        JsonContainerElementIterator(const json_value& array, size_t index)
+                : array_(&array), index_(index) {}
+
+        JsonContainerView operator*() const;
+
+        JsonContainerElementIterator& operator++() {
+            ++index_;
+            return *this;
+        }
+
+        JsonContainerElementIterator operator++(int) {
+            auto previous = *this;
+            ++index_;
+            return previous;
+        }
+
+        bool operator==(const JsonContainerElementIterator& other) const {
+            return array_ == other.array_ && index_ == other.index_;
+        }
+
+        bool operator!=(const JsonContainerElementIterator& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        const json_value* array_;
+        size_t index_;
+    };
+
+    /// Pair of iterators, to be used in range-based for loops.
+    template <typename Iterator>
+    class JsonContainerRange {
+    public:
+        JsonContainerRange(Iterator begin, Iterator end, size_t size)
+                : begin_(begin), end_(end), size_(size) {}
+
+        Iterator begin() const { return begin_; }
+        Iterator end() const { return end_; }
+        size_t size() const { return size_; }
+        bool empty() const { return size_ == 0; }
+
+    private:
+        Iterator begin_;
+        Iterator end_;
+        size_t size_;
+    };
+
     // Usage:
     //
     // SUPPORTED SCALARS:
-    //    int, float, double, bool, std::string, nullptr
+    //    int, int64_t, uint64_t, float, double, bool, std::string, nullptr
     //
     // To set a key to a scalar value in object x
     //    x.set<int>("foo", 1);
@@ -114,14 +294,78 @@ namespace leatherman { namespace json_container {
     // To get a json string representation of object x
     //    x.toString();
     //
+    // To write the json representation of object x to a stream or file
+    // descriptor without building the string
+    //    x.write(std::cout);
+    //    x.write(fd);
+    //
+    // To cache object x in binary form and load it back
+    //    x.writeCBOR(fd);
+    //    auto y = JsonContainer::fromCBOR(fd);
+    //
+    // To copy a numeric array into a buffer, or a field of each of the
+    // objects of an array
+    //    std::vector<double> values(x.size("vec"));
+    //    x.getArray<double>("vec", values.data(), values.size());
+    //    x.getColumn<double>("samples", "value", values.data(), values.size());
+    //
+    // To iterate the members of an object, or the elements of an array,
+    // without copying them
+    //    for (const auto& member : x.members("foo")) {
+    //        member.name;  // boost::string_ref
+    //        member.value.get<int>();
+    //    }
+    //    for (const auto& element : x.elements("vec")) {
+    //        element.get<double>();
+    //    }
+    //    x.each("foo", [](boost::string_ref name, JsonContainerView value) {});
+    //
+    // To read a few entries of a large JSON object, parsing only them
+    //    JsonContainer x { json_txt, ParseMode::Lazy };
+    //    x.get<std::string>({ "metadata", "name" });
+    // WARNING: unlike the other containers, a lazy one parses members
+    // when they are read, so that it must not be read concurrently.
+    //
     // To check if a key is set in object x
     //    x.includes("foo");
     //    x.includes({ "foo", "bar", "baz" });
+    //
+    // To repeatedly access a nested entry with a precompiled path
+    //    JsonContainerPath path { { "foo", "bar", "baz" } };
+    //    x.get<int>(path);
+    //    x.set<int>(path, 42);
+    //
+    // To check whether an entry changed, without serializing it
+    //    x.enableHashCache();
+    //    auto before = x.hash("foo");
+    //    ...
+    //    x.hash("foo") != before;
+    //
+    // To compute the operations turning object x into y (RFC 6902)
+    //    auto ops = x.diff(y);
+    //
+    // To remove the foo entry of object x with a merge patch (RFC 7396)
+    //    x.mergePatch(JsonContainer { "{\"foo\" : null}" });
+    //
+    // To pass copies of object x around without copying its document
+    //    x.enableCopyOnWrite();
+    //    JsonContainer y { x };  // shares the document of x
+    //    y.set<int>("foo", 1);   // copies it
 
     class JsonContainer {
     public:
+        static const size_t DEFAULT_MEMBER_INDEX_THRESHOLD;
+
         JsonContainer();
-        explicit JsonContainer(const std::string& json_txt);
+        /// Throw a data_parse_error in case the text is not valid JSON.
+        /// In lazy mode, only the structure of the root object is
+        /// validated at first; the values of its members are validated
+        /// when parsed, so that the lookups reaching an invalid value
+        /// throw a data_parse_error; includes doesn't throw. Any access
+        /// to the whole document (e.g. toString, getRaw or a copy)
+        /// parses the remaining members. As lookups can parse members,
+        /// a container in lazy mode must not be read concurrently.
+        explicit JsonContainer(const std::string& json_txt, ParseMode mode = ParseMode::Eager);
         explicit JsonContainer(const json_value& value);
         JsonContainer(const JsonContainer& data);
         JsonContainer(const JsonContainer&& data);
@@ -133,15 +377,69 @@ namespace leatherman { namespace json_container {
 
         std::string toString() const;
 
+        /// Same as toString(), but reserve the output string from an
+        /// estimate of its size first. The estimate walks the whole
+        /// document, so this only pays off for documents of many small
+        /// entries, where it saves the reallocations of the string.
+        std::string toStringReserved() const;
+
         /// Throw a data_key_error in case the specified key is unknown.
         std::string toString(const JsonContainerKey& key) const;
 
         /// Throw a data_key_error in case the specified key is unknown.
         std::string toString(const std::vector<JsonContainerKey>& keys) const;
 
+        /// Throw a data_key_error in case the specified key is unknown.
+        std::string toString(const JsonContainerPath& path) const;
+
+        /// Write the JSON text of the root entry to the stream through
+        /// a fixed size buffer, without materializing it in memory.
+        /// Throw a data_error in case the stream fails.
+        void write(std::ostream& output) const;
+
+        /// Write the JSON text of the root entry to the file descriptor
+        /// through a fixed size buffer.
+        /// Throw a data_error in case of write failure.
+        void write(int fd) const;
+
+        /// Return the CBOR (RFC 7049) encoding of the root entry.
+        /// Doubles are encoded in single precision when that is exact,
+        /// so that the types and values of all entries round-trip.
+        std::string toCBOR() const;
+
+        /// Write the CBOR encoding of the root entry to the stream
+        /// through a fixed size buffer.
+        /// Throw a data_error in case the stream fails.
+        void writeCBOR(std::ostream& output) const;
+
+        /// Write the CBOR encoding of the root entry to the file
+        /// descriptor through a fixed size buffer.
+        /// Throw a data_error in case of write failure.
+        void writeCBOR(int fd) const;
+
+        /// Decode a single CBOR data item.
+        /// Throw a data_parse_error in case of invalid CBOR, or of
+        /// items without a JSON equivalent (byte strings, non-string
+        /// keys, non-finite numbers, integers less than INT64_MIN).
+        static JsonContainer fromCBOR(const std::string& cbor);
+
+        /// Decode a single CBOR data item read from the file descriptor
+        /// through a fixed size buffer, up to the end of the input.
+        /// Throw a data_parse_error in case of invalid CBOR.
+        /// Throw a data_error in case of read failure.
+        static JsonContainer fromCBOR(int fd);
+
+        /// Return a human readable representation of the root entry:
+        /// one "key : value" line per object member, with nested
+        /// objects indented by left_padding plus two spaces per level.
+        /// Note that the output is not valid JSON.
         std::string toPrettyString(size_t left_padding) const;
         std::string toPrettyString() const;
 
+        /// Return the JSON text of the root entry, with each value on
+        /// its own line indented by indent spaces per nesting level.
+        std::string toIndentedString(size_t indent = 4) const;
+
         /// Return true if the root is an empty JSON array or an empty
         /// JSON object, false otherwise.
         bool empty() const;
@@ -160,16 +458,135 @@ namespace leatherman { namespace json_container {
         /// Throw a data_key_error in case of unknown keys.
         size_t size(const std::vector<JsonContainerKey>& keys) const;
 
+        /// Return the number of entries of the specified element;
+        /// return 0 in case it's scalar
+        /// Throw a data_key_error in case of unknown keys.
+        size_t size(const JsonContainerPath& path) const;
+
         /// In case the root entry is an object, returns its keys,
         /// otherwise an empty vector.
         std::vector<std::string> keys() const;
 
+        /// Return a view of the root entry.
+        JsonContainerView view() const;
+
+        /// Return a view of the specified entry.
+        /// Throw a data_key_error in case of unknown keys.
+        JsonContainerView view(const JsonContainerKey& key) const;
+
+        /// Throw a data_key_error in case of unknown keys.
+        JsonContainerView view(const std::vector<JsonContainerKey>& keys) const;
+
+        /// Return the members of the root object, to be iterated in
+        /// document order without copying their names or values.
+        /// Throw a data_type_error in case the root is not an object.
+        JsonContainerMembers members() const;
+
+        /// Throw a data_key_error in case of unknown keys.
+        /// Throw a data_type_error in case the entry is not an object.
+        JsonContainerMembers members(const JsonContainerKey& key) const;
+
+        /// Throw a data_key_error in case of unknown keys.
+        /// Throw a data_type_error in case the entry is not an object.
+        JsonContainerMembers members(const std::vector<JsonContainerKey>& keys) const;
+
+        /// Return the elements of the root array.
+        /// Throw a data_type_error in case the root is not an array.
+        JsonContainerElements elements() const;
+
+        /// Throw a data_key_error in case of unknown keys.
+        /// Throw a data_type_error in case the entry is not an array.
+        JsonContainerElements elements(const JsonContainerKey& key) const;
+
+        /// Throw a data_key_error in case of unknown keys.
+        /// Throw a data_type_error in case the entry is not an array.
+        JsonContainerElements elements(const std::vector<JsonContainerKey>& keys) const;
+
+        /// Call callback(boost::string_ref name, JsonContainerView value)
+        /// for each member of the specified object entry or, with an
+        /// empty name, for each element of the specified array entry.
+        /// Throw a data_key_error in case of unknown keys.
+        /// Throw a data_type_error in case the entry is neither an
+        /// object nor an array.
+        template <typename Callback>
+        void each(const std::vector<JsonContainerKey>& keys, Callback callback) const {
+            auto entry = view(keys);
+
+            if (entry.type() == DataType::Array) {
+                for (const auto& element : entry.elements()) {
+                    callback(boost::string_ref {}, element);
+                }
+            } else {
+                for (const auto& member : entry.members()) {
+                    callback(member.name, member.value);
+                }
+            }
+        }
+
+        template <typename Callback>
+        void each(const JsonContainerKey& key, Callback callback) const {
+            each(std::vector<JsonContainerKey> { key }, callback);
+        }
+
+        template <typename Callback>
+        void each(Callback callback) const {
+            each(std::vector<JsonContainerKey> {}, callback);
+        }
+
         /// Whether the specified entry exists.
+        /// In lazy mode, the entry itself is not parsed, so that a
+        /// member whose value is not valid JSON is included, while get
+        /// throws a data_parse_error for it; the entries nested in such
+        /// a member are not included.
         bool includes(const JsonContainerKey& key) const;
 
         /// Whether the specified entry exists.
         bool includes(const std::vector<JsonContainerKey>& keys) const;
 
+        /// Whether the specified entry exists.
+        bool includes(const JsonContainerPath& path) const;
+
+        /// Enable a hash index of the members of the objects having at
+        /// least threshold members. Each object is indexed the first
+        /// time it is searched, so that repeated lookups into wide
+        /// objects take constant time; the index is dropped whenever
+        /// the container is modified.
+        /// Building the index is serialized by a lock, so the container
+        /// can still be read concurrently.
+        void enableMemberIndex(size_t threshold = DEFAULT_MEMBER_INDEX_THRESHOLD);
+
+        /// Return a 64-bit hash (based on xxHash64) of the content of
+        /// the root entry, computed in one traversal without serializing
+        /// it. Objects hash the same regardless of the order of their
+        /// members; integers and doubles hash differently.
+        uint64_t hash() const;
+
+        /// Throw a data_key_error in case the specified key is unknown.
+        uint64_t hash(const JsonContainerKey& key) const;
+
+        /// Throw a data_key_error in case of unknown keys.
+        uint64_t hash(const std::vector<JsonContainerKey>& keys) const;
+
+        /// Throw a data_key_error in case of unknown keys.
+        uint64_t hash(const JsonContainerPath& path) const;
+
+        /// Cache the hash of each object and array once computed. A set
+        /// only drops the hashes of the entries along its path and of
+        /// the replaced value, so that hashing again only walks what
+        /// changed; any other modification drops the whole cache.
+        /// Note that, once enabled, hash() updates the cache; the
+        /// container must then not be read concurrently.
+        void enableHashCache();
+
+        /// Make the copies of the container share its document, instead
+        /// of copying it, until either of them is modified: the first
+        /// set or mergePatch of a container sharing the document copies
+        /// it. Copies of the container are in copy-on-write mode too.
+        /// The shared document is only read, so that copies sharing it
+        /// can be read by different threads; each copy must still be
+        /// used by one thread at a time when modified.
+        void enableCopyOnWrite();
+
         DataType type() const;
 
         /// Throw a data_key_error in case the specified key is unknown.
@@ -178,6 +595,9 @@ namespace leatherman { namespace json_container {
         /// Throw a data_key_error in case of unknown keys.
         DataType type(const std::vector<JsonContainerKey>& keys) const;
 
+        /// Throw a data_key_error in case of unknown keys.
+        DataType type(const JsonContainerPath& path) const;
+
         /// Throw a data_type_error in case the root entry is not an array.
         /// Throw a data_index_error in case the index is out of bounds.
         DataType type(const size_t idx) const;
@@ -192,6 +612,11 @@ namespace leatherman { namespace json_container {
         /// Throw a data_index_error in case the index is out of bound.
         DataType type(const std::vector<JsonContainerKey>& keys, const size_t idx) const;
 
+        /// Throw a data_key_error in case of unknown keys.
+        /// Throw a data_type_error in case the specified entry is not an array.
+        /// Throw a data_index_error in case the index is out of bound.
+        DataType type(const JsonContainerPath& path, const size_t idx) const;
+
         /// Return the value of the root entry.
         /// Throw a data_type_error in case the type of the root entry
         /// does not match the specified one.
@@ -214,10 +639,19 @@ namespace leatherman { namespace json_container {
         /// Throw a data_type_error in case the type T doesn't match
         /// the specified one.
         template <typename T>
-        T get(std::vector<JsonContainerKey> keys) const {
+        T get(const std::vector<JsonContainerKey>& keys) const {
             return getValue<T>(*getValueInJson(keys));
         }
 
+        /// Return the value of the specified nested entry.
+        /// Throw a data_key_error in case the entry does not exist.
+        /// Throw a data_type_error in case the type T doesn't match
+        /// the specified one.
+        template <typename T>
+        T get(const JsonContainerPath& path) const {
+            return getValue<T>(*getValueInJson(path));
+        }
+
         /// Return the indexed value of root array.
         /// Throw a data_index_error in case the index is out of bound.
         /// Throw a data_type_error in case the type T doesn't match
@@ -249,28 +683,41 @@ namespace leatherman { namespace json_container {
         /// the one of the specified entry or in case the specified
         /// entry is not an array.
         template <typename T>
-        T get(std::vector<JsonContainerKey> keys, const size_t idx) const {
+        T get(const std::vector<JsonContainerKey>& keys, const size_t idx) const {
             return getValue<T>(*getValueInJson(keys, true, idx));
         }
 
+        /// Return the indexed value of the specified nested array
+        /// entry.
+        /// Throw a data_key_error in case the array entry is unknown.
+        /// Throw a data_index_error in case the index is out of bound.
+        /// Throw a data_type_error in case the type T doesn't match
+        /// the one of the specified entry or in case the specified
+        /// entry is not an array.
+        template <typename T>
+        T get(const JsonContainerPath& path, const size_t idx) const {
+            return getValue<T>(*getValueInJson(path, true, idx));
+        }
+
         /// Return the value of the specified entry of the root object,
         /// or default_value if the entry doesn't exist.
         /// Throw a data_type_error in case the type T doesn't match
         /// the specified one or if the root entry is not an object.
         template <typename T>
         T getWithDefault(const JsonContainerKey& key, const T default_value) const {
-            auto jval = getValueInJson();
-            auto key_data = key.data();
+            auto jval = rootValue();
 
             if (!isObject(*jval)) {
                 throw data_type_error { _("not an object") };
             }
 
-            if (!hasKey(*jval, key_data)) {
+            auto member = findMember(*jval, key);
+
+            if (member == nullptr) {
                 return default_value;
             }
 
-            return getValue<T>(*getValueInJson(*jval, key_data));
+            return getValue<T>(*member);
         }
 
         /// Return the value of the specified nested entry or
@@ -281,70 +728,241 @@ namespace leatherman { namespace json_container {
         /// entry is not an object.
         template <typename T>
         T getWithDefault(const std::vector<JsonContainerKey>& keys, const T& default_value) const {
-            auto key_data = keys.back().data();
-            auto jval_obj = getValueInJson(keys.cbegin(), keys.cend()-1);
+            return getWithDefaultIn(keys, default_value);
+        }
 
-            if (!isObject(*jval_obj)) {
-                throw data_type_error { _("not an object") };
-            }
+        /// Return the value of the specified nested entry or
+        /// default_value if the entry doesn't exist but its parent is
+        /// an object.
+        /// Throw a data_type_error in case the type T doesn't match
+        /// the specified one or in case the parent of the specified
+        /// entry is not an object.
+        template <typename T>
+        T getWithDefault(const JsonContainerPath& path, const T& default_value) const {
+            return getWithDefaultIn(path.steps(), default_value);
+        }
 
-            if (!hasKey(*jval_obj, key_data)) {
-                return default_value;
-            }
+        /// Copy the elements of the specified array entry into output,
+        /// which must have room for capacity elements, and return their
+        /// number. T can be int, int64_t, uint64_t, double or bool.
+        /// The elements are type checked while being copied; output is
+        /// left partially written in case a check fails.
+        /// Throw a data_key_error in case of unknown keys.
+        /// Throw a data_type_error in case the entry is not an array or
+        /// one of its elements doesn't match T.
+        /// Throw a data_index_error in case the array has more than
+        /// capacity elements.
+        template <typename T>
+        size_t getArray(const std::vector<JsonContainerKey>& keys,
+                        T* output, size_t capacity) const;
+
+        template <typename T>
+        size_t getArray(T* output, size_t capacity) const {
+            return getArray<T>(std::vector<JsonContainerKey> {}, output, capacity);
+        }
 
-            return getValue<T>(*getValueInJson(*jval_obj, key_data));
+        template <typename T>
+        size_t getArray(const JsonContainerKey& key, T* output, size_t capacity) const {
+            return getArray<T>(std::vector<JsonContainerKey> { key }, output, capacity);
+        }
+
+        /// Copy the field entry of each object of the specified array
+        /// entry into output, turning an array of objects into an array
+        /// of values, and return the number of copied values. T can be
+        /// int, int64_t, uint64_t, double or bool.
+        /// Throw a data_key_error in case of unknown keys or in case an
+        /// object lacks field.
+        /// Throw a data_type_error in case the entry is not an array of
+        /// objects or a field value doesn't match T.
+        /// Throw a data_index_error in case the array has more than
+        /// capacity elements.
+        template <typename T>
+        size_t getColumn(const std::vector<JsonContainerKey>& keys,
+                         const JsonContainerKey& field,
+                         T* output, size_t capacity) const;
+
+        template <typename T>
+        size_t getColumn(const JsonContainerKey& key, const JsonContainerKey& field,
+                         T* output, size_t capacity) const {
+            return getColumn<T>(std::vector<JsonContainerKey> { key }, field, output, capacity);
         }
 
         /// Throw a data_key_error in case the root is not a valid JSON
         /// object, so that is not possible to set the entry.
         template <typename T>
         void set(const JsonContainerKey& key, T value) {
-            auto jval = getValueInJson();
-            auto key_data = key.data();
+            unshareDocument();
+            auto jval = rootValue();
 
             if (!isObject(*jval)) {
                 throw data_key_error { _("root is not a valid JSON object") };
             }
 
-            if (!hasKey(*jval, key_data)) {
-                createKeyInJson(key_data, *jval);
+            dropHash(*jval);
+            auto member = findMember(*jval, key);
+
+            if (member == nullptr) {
+                member = createKeyInJson(key, *jval);
             }
 
-            setValue<T>(*getValueInJson(*jval, key_data), value);
+            dropHash(*member, true);
+            setValue<T>(*member, value);
+            invalidateMemberIndex();
         }
 
         /// Throw a data_key_error if a known nested key is not associated
         /// with a valid JSON object, so that it is not  possible to
         /// iterate the remaining keys.
         template <typename T>
-        void set(std::vector<JsonContainerKey> keys, T value) {
-            auto jval = getValueInJson();
+        void set(const std::vector<JsonContainerKey>& keys, T value) {
+            setIn<T>(keys, value);
+        }
 
-            for (const auto& key : keys) {
-                const char* key_data = key.data();
+        /// Throw a data_key_error if a known nested key is not associated
+        /// with a valid JSON object, so that it is not  possible to
+        /// iterate the remaining keys.
+        template <typename T>
+        void set(const JsonContainerPath& path, T value) {
+            setIn<T>(path.steps(), value);
+        }
+
+        /// Apply a JSON merge patch (RFC 7396) to the root entry: the
+        /// members of patch objects are merged recursively, null members
+        /// are removed and any other value replaces the target entry.
+        /// Entries left unchanged by the patch are not copied.
+        void mergePatch(const JsonContainer& patch);
+
+        /// Return the JSON patch (RFC 6902) turning this container into
+        /// other, as an array of add, remove and replace operations.
+        /// Identical subtrees are skipped; only the values of the added
+        /// and replaced entries are copied into the patch.
+        JsonContainer diff(const JsonContainer& other) const;
+
+    private:
+        friend class JsonArenaContainer;
+
+        struct MemberIndex;
+        struct HashCache;
+        struct LazyDocument;
+
+        // Shared with the copies of the container in copy-on-write mode
+        std::shared_ptr<json_document> document_root_;
+        std::unique_ptr<MemberIndex> member_index_;
+        std::unique_ptr<HashCache> hash_cache_;
+        bool copy_on_write_;
+        // Members of the root object not parsed yet, in lazy mode
+        mutable std::unique_ptr<LazyDocument> lazy_;
+
+        // Give the container its own copy of the document, in case it
+        // shares it; must be called before modifying the document
+        void unshareDocument() {
+            if (copy_on_write_) {
+                copyDocumentIfShared();
+            }
+        }
+
+        void copyDocumentIfShared();
+
+        // Return the document, once all of its values are parsed
+        const json_document& document() const;
+
+        // Return the document shared with a copy of the container, or
+        // a copy of it, depending on the copy-on-write mode
+        std::shared_ptr<json_document> documentForCopy() const;
+
+        // Return the root value, whose members may not be parsed yet in
+        // lazy mode; findMember parses them
+        json_value* rootValue() const;
+
+        // Parse value in case it's a member of the root object deferred
+        // by the lazy mode
+        json_value* parsedMember(const json_value& object, json_value* value) const;
+
+        template <typename T, typename Keys>
+        T getWithDefaultIn(const Keys& keys, const T& default_value) const {
+            auto jval_obj = keys.size() > 1 ? getValueInJson(keys.cbegin(), keys.cend()-1)
+                                            : rootValue();
 
+            if (!isObject(*jval_obj)) {
+                throw data_type_error { _("not an object") };
+            }
+
+            auto member = findMember(*jval_obj, keys.back());
+
+            if (member == nullptr) {
+                return default_value;
+            }
+
+            return getValue<T>(*member);
+        }
+
+        template <typename T, typename Keys>
+        void setIn(const Keys& keys, T value) {
+            unshareDocument();
+            auto jval = rootValue();
+
+            for (const auto& key : keys) {
                 if (!isObject(*jval)) {
                     throw data_key_error { _("invalid key supplied; cannot navigate the provided path") };
                 }
 
-                if (!hasKey(*jval, key_data)) {
-                    createKeyInJson(key_data, *jval);
-                }
-
-                jval = getValueInJson(*jval, key_data);
+                dropHash(*jval);
+                auto member = findMember(*jval, key);
+                jval = member != nullptr ? member : createKeyInJson(key, *jval);
             }
 
+            dropHash(*jval, true);
             setValue<T>(*jval, value);
+            invalidateMemberIndex();
         }
 
-    private:
-        std::unique_ptr<json_document> document_root_;
-
         size_t getSize(const json_value& jval) const;
 
         DataType getValueType(const json_value& jval) const;
 
-        bool hasKey(const json_value& jval, const char* key) const;
+        // Object member lookup; returns nullptr in case the specified
+        // value is not an object or the key is unknown. The hash is
+        // only used if the object is indexed; it's computed on demand
+        // when not supplied.
+        // The member index must be invalidated after any change to the
+        // document, as it stores pointers to its values.
+        json_value* findMember(const json_value& jval,
+                               const std::string& key,
+                               const size_t* hash = nullptr) const;
+
+        json_value* findMember(const json_value& jval,
+                               const JsonContainerPath::Step& step) const {
+            return findMember(jval, step.key, &step.hash);
+        }
+
+        // As findMember, without parsing the member in lazy mode
+        json_value* lookupMember(const json_value& jval,
+                                 const std::string& key,
+                                 const size_t* hash = nullptr) const;
+
+        json_value* lookupMember(const json_value& jval,
+                                 const JsonContainerPath::Step& step) const {
+            return lookupMember(jval, step.key, &step.hash);
+        }
+
+        // Look up the entries of includes: the last one is not parsed,
+        // and the ones nested in an invalid lazy member are unknown
+        template <typename Keys>
+        bool includesIn(const Keys& keys) const;
+
+        void invalidateMemberIndex();
+
+        // Drop the cached hash of the specified value, and the ones of
+        // its nested values if recursive; must be called before the
+        // value is modified, as hashes are cached by the address of
+        // the members or elements of objects and arrays.
+        void dropHash(const json_value& jval, bool recursive = false) {
+            if (hash_cache_) {
+                dropCachedHash(jval, recursive);
+            }
+        }
+
+        void dropCachedHash(const json_value& jval, bool recursive);
 
         // NOTE(ale): we cant' use json_value::IsObject directly
         // since we have forward declarations for rapidjson; otherwise
@@ -356,7 +974,8 @@ namespace leatherman { namespace json_container {
         // an object.
         // Throws a data_key_error or if the key is unknown.
         json_value* getValueInJson(const json_value& jval,
-                                   const char* key) const;
+                                   const std::string& key,
+                                   const size_t* hash = nullptr) const;
 
         // Root array entry accessor
         // Throws a data_type_error in case the specified value is not
@@ -378,6 +997,19 @@ namespace leatherman { namespace json_container {
             const bool is_array = false,
             const size_t idx = 0) const;
 
+        json_value* getValueInJson(
+            std::vector<JsonContainerPath::Step>::const_iterator begin,
+            std::vector<JsonContainerPath::Step>::const_iterator end,
+            const bool is_array = false,
+            const size_t idx = 0) const;
+
+        json_value* getValueInJson(
+            const JsonContainerPath& path,
+            const bool is_array = false,
+            const size_t idx = 0) const {
+            return getValueInJson(path.steps().cbegin(), path.steps().cend(), is_array, idx);
+        }
+
         // Generic entry accessor
         // In case any key is specified, throws a data_type_error if
         // the specified entry is not an object; throws a
@@ -391,7 +1023,11 @@ namespace leatherman { namespace json_container {
             return getValueInJson(keys.cbegin(), keys.cend(), is_array, idx);
         }
 
-        void createKeyInJson(const char* key, json_value& jval);
+        json_value* createKeyInJson(const std::string& key, json_value& jval);
+
+        json_value* createKeyInJson(const JsonContainerPath::Step& step, json_value& jval) {
+            return createKeyInJson(step.key, jval);
+        }
 
         template<typename T>
         T getValue(const json_value& value) const;
@@ -400,6 +1036,30 @@ namespace leatherman { namespace json_container {
         void setValue(json_value& jval, T new_value);
     };
 
+    template<>
+    int JsonContainerView::get<>() const;
+
+    template<>
+    int64_t JsonContainerView::get<>() const;
+
+    template<>
+    uint64_t JsonContainerView::get<>() const;
+
+    template<>
+    double JsonContainerView::get<>() const;
+
+    template<>
+    bool JsonContainerView::get<>() const;
+
+    template<>
+    std::string JsonContainerView::get<>() const;
+
+    template<>
+    boost::string_ref JsonContainerView::get<>() const;
+
+    template<>
+    JsonContainer JsonContainerView::get<>() const;
+
     template<>
     void JsonContainer::setValue<>(json_value& jval, const std::string& new_value);
 
@@ -412,6 +1072,12 @@ namespace leatherman { namespace json_container {
     template<>
     void JsonContainer::setValue<>(json_value& jval, int new_value);
 
+    template<>
+    void JsonContainer::setValue<>(json_value& jval, int64_t new_value);
+
+    template<>
+    void JsonContainer::setValue<>(json_value& jval, uint64_t new_value);
+
     template<>
     void JsonContainer::setValue<>(json_value& jval, double new_value);
 
@@ -424,6 +1090,12 @@ namespace leatherman { namespace json_container {
     template<>
     void JsonContainer::setValue<>(json_value& jval, std::vector<int> new_value);
 
+    template<>
+    void JsonContainer::setValue<>(json_value& jval, std::vector<int64_t> new_value);
+
+    template<>
+    void JsonContainer::setValue<>(json_value& jval, std::vector<uint64_t> new_value);
+
     template<>
     void JsonContainer::setValue<>(json_value& jval, std::vector<double> new_value);
 
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <leatherman/json_container/json_container.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// Forward declarations for rapidjson
+namespace rapidjson {
+    template <typename BaseAllocator> class MemoryPoolAllocator;
+}  // namespace rapidjson
+
+namespace leatherman { namespace json_container {
+
+    /**
+     * Typedef for the RapidJSON allocator of the arena values.
+     */
+    using json_arena_allocator = rapidjson::MemoryPoolAllocator<json_allocator>;
+    /**
+     * Typedef for the RapidJSON value of the arena containers.
+     */
+    using json_arena_value = rapidjson::GenericValue<rapidjson::UTF8<char>, json_arena_allocator>;
+
+    // Usage:
+    //
+    // To build one container per resource and serialize them
+    //    JsonContainerArena arena {};
+    //    for (const auto& resource : resources) {
+    //        auto& entry = arena.create();
+    //        entry.set<std::string>("name", resource.name);
+    //        output << entry.toString() << "\n";
+    //    }
+    //    // all the entries are released here, together
+
+    /// A JSON value built in a JsonContainerArena, with the accessors
+    /// needed to fill and serialize it; toContainer returns a heap copy
+    /// of it providing the whole JsonContainer interface.
+    /// It belongs to the arena and must not be used after the arena is
+    /// cleared or destroyed.
+    class JsonArenaContainer {
+    public:
+        JsonArenaContainer(const JsonArenaContainer&) = delete;
+        JsonArenaContainer& operator=(const JsonArenaContainer&) = delete;
+
+        const json_arena_value& getRaw() const { return *value_; }
+
+        DataType type() const;
+
+        /// Return true if the root is an empty object or array.
+        bool empty() const;
+
+        /// Return the number of entries of the root object or array;
+        /// 0 otherwise.
+        size_t size() const;
+
+        bool includes(const JsonContainerKey& key) const;
+        bool includes(const std::vector<JsonContainerKey>& keys) const;
+
+        /// Return the value of the entry; T can be int, int64_t,
+        /// uint64_t, double, bool, std::string, std::vector<std::string>,
+        /// std::vector<int> or JsonContainer (a heap copy).
+        /// Null values are returned as the default of T.
+        /// Throw a data_key_error in case the entry doesn't exist and a
+        /// data_type_error in case T doesn't match the type of the value.
+        template <typename T>
+        T get(const JsonContainerKey& key) const {
+            return getValue<T>(getValueIn({ key }));
+        }
+
+        template <typename T>
+        T get(const std::vector<JsonContainerKey>& keys) const {
+            return getValue<T>(getValueIn(keys));
+        }
+
+        /// Set the entry, creating the missing objects along the keys;
+        /// T can be one of the types of get, const char* included.
+        /// The values replaced keep their memory until the arena is
+        /// cleared.
+        /// Throw a data_key_error in case a key is associated with a
+        /// value that is not an object.
+        template <typename T>
+        void set(const JsonContainerKey& key, T value) {
+            setValue<T>(createValueIn({ key }), value);
+        }
+
+        template <typename T>
+        void set(const std::vector<JsonContainerKey>& keys, T value) {
+            setValue<T>(createValueIn(keys), value);
+        }
+
+        std::string toString() const;
+
+        /// Return a heap container holding a copy of the value.
+        JsonContainer toContainer() const;
+
+    private:
+        friend class JsonContainerArena;
+
+        json_arena_value* value_;
+        json_arena_allocator* allocator_;
+
+        JsonArenaContainer(json_arena_value* value, json_arena_allocator* allocator)
+                : value_(value), allocator_(allocator) {}
+
+        const json_arena_value& getValueIn(const std::vector<JsonContainerKey>& keys) const;
+        json_arena_value& createValueIn(const std::vector<JsonContainerKey>& keys);
+
+        template <typename T>
+        T getValue(const json_arena_value& value) const;
+
+        template <typename T>
+        void setValue(json_arena_value& jval, T new_value);
+    };
+
+    /// Creates containers sharing one memory pool, for building many
+    /// small containers at once. The containers and their values are
+    /// carved out of large blocks instead of being allocated one by
+    /// one, and clearing or destroying the arena releases the blocks
+    /// without walking the values.
+    /// Only the containers of an arena use its allocator: the ordinary
+    /// JsonContainers and their documents are unchanged.
+    /// An arena and its containers must not be used by several threads
+    /// at once.
+    /// As memory is only reclaimed with the blocks, an arena is meant for
+    /// containers that are built, used and dropped together; values
+    /// replaced keep their space until then.
+    class JsonContainerArena {
+    public:
+        static const size_t DEFAULT_BLOCK_SIZE;
+
+        explicit JsonContainerArena(size_t block_size = DEFAULT_BLOCK_SIZE);
+
+        JsonContainerArena(const JsonContainerArena&) = delete;
+        JsonContainerArena& operator=(const JsonContainerArena&) = delete;
+
+        ~JsonContainerArena();
+
+        /// Return a new container holding an empty object.
+        JsonArenaContainer& create();
+
+        /// Return a new container holding the parsed JSON text.
+        /// Throw a data_parse_error in case the text is not valid JSON.
+        JsonArenaContainer& create(const std::string& json_txt);
+
+        /// Return the number of containers created.
+        size_t size() const;
+
+        /// Return the number of bytes of the memory blocks.
+        size_t reserved() const;
+
+        /// Destroy all the containers and release the memory blocks.
+        void clear();
+
+    private:
+        std::unique_ptr<json_arena_allocator> allocator_;
+        std::vector<JsonArenaContainer*> containers_;
+
+        JsonArenaContainer& createContainer();
+    };
+
+}}  // namespace leatherman::json_container
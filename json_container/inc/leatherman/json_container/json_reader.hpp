@@ -0,0 +1,129 @@
+#pragma once
+
+#include <leatherman/json_container/json_container.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace leatherman { namespace json_container {
+
+    /// Receives the events produced by a JsonReader while it scans a
+    /// JSON text. Each method returns true to continue parsing or
+    /// false to stop; the default implementations ignore the event.
+    class JsonHandler {
+    public:
+        virtual ~JsonHandler() {}
+
+        /// Called before the events of a value selected by a filter;
+        /// pointer is the JSON pointer of that value in the document
+        /// (e.g. "/resources/3/title"). Not called when the reader
+        /// has no filters.
+        virtual bool match(const std::string& pointer) { return true; }
+
+        virtual bool null() { return true; }
+        virtual bool boolean(bool value) { return true; }
+
+        /// Integral values that fit in an int64_t.
+        virtual bool integer(int64_t value) { return true; }
+
+        /// Integral values greater than INT64_MAX.
+        virtual bool unsignedInteger(uint64_t value) { return true; }
+
+        virtual bool real(double value) { return true; }
+
+        /// The string is not null-terminated and may contain null
+        /// characters; it is only valid for the duration of the call.
+        virtual bool string(const char* value, size_t length) { return true; }
+
+        virtual bool startObject() { return true; }
+        virtual bool key(const char* name, size_t length) { return true; }
+        virtual bool endObject(size_t member_count) { return true; }
+
+        virtual bool startArray() { return true; }
+        virtual bool endArray(size_t element_count) { return true; }
+    };
+
+    /// Pull callback providing JSON text in chunks: it must copy at
+    /// most size bytes into buffer and return how many were copied,
+    /// or 0 once the input is exhausted.
+    using JsonChunkSource = std::function<size_t(char* buffer, size_t size)>;
+
+    // Usage:
+    //
+    // To print every key of a document read from stdin
+    //    struct KeyPrinter : JsonHandler {
+    //        bool key(const char* name, size_t length) override {
+    //            std::cout << std::string(name, length) << "\n";
+    //            return true;
+    //        }
+    //    } printer;
+    //    JsonReader {}.parse(std::cin, printer);
+    //
+    // To only receive the events of a few entries of a large file
+    //    JsonReader reader {};
+    //    reader.addFilter("/facts/os/name");
+    //    reader.addFilter("/resources/*/title");
+    //    reader.parse(fd, handler);
+
+    /// Event-driven (SAX-style) JSON reader. No DOM is built: memory
+    /// use is bounded by the read buffer, the nesting depth of the
+    /// document and the length of the longest string.
+    class JsonReader {
+    public:
+        static const size_t DEFAULT_BUFFER_SIZE;
+
+        explicit JsonReader(size_t buffer_size = DEFAULT_BUFFER_SIZE);
+
+        /// Restrict the delivered events to the subtree located at
+        /// the specified JSON pointer (RFC 6901); a "*" token matches
+        /// any object key or array index. Once filters are set, the
+        /// events of the other entries are skipped and the handler's
+        /// match() is called before each selected value. When no
+        /// filter contains a wildcard, parsing stops as soon as all of
+        /// them have been matched.
+        /// Throw a data_parse_error in case of an invalid pointer.
+        void addFilter(const std::string& pointer);
+
+        /// Parse the JSON text, dispatching its events to handler.
+        /// Return false in case the handler stopped the parsing, true
+        /// otherwise.
+        /// Throw a data_parse_error in case of invalid JSON.
+        bool parse(const std::string& json_txt, JsonHandler& handler) const;
+
+        /// Throw a data_parse_error in case of invalid JSON.
+        bool parse(std::istream& input, JsonHandler& handler) const;
+
+        /// Read from the file descriptor until end of file.
+        /// Throw a data_parse_error in case of invalid JSON.
+        /// Throw a data_error in case of a read failure.
+        bool parse(int fd, JsonHandler& handler) const;
+
+        /// Throw a data_parse_error in case of invalid JSON.
+        bool parse(JsonChunkSource source, JsonHandler& handler) const;
+
+        /// Replay the content of the container as events, as if its
+        /// JSON text was parsed.
+        bool parse(const JsonContainer& document, JsonHandler& handler) const;
+
+    private:
+        struct Token {
+            std::string name;
+            bool wildcard;
+            bool is_index;
+            size_t index;
+        };
+
+        // SAX handler applying the filters, defined with the parser
+        class FilteringHandler;
+
+        size_t buffer_size_;
+        std::vector<std::vector<Token>> filters_;
+
+        template <typename Stream>
+        bool parseStream(Stream& stream, JsonHandler& handler) const;
+    };
+
+}}  // namespace leatherman::json_container
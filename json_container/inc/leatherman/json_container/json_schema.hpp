@@ -0,0 +1,182 @@
+#pragma once
+
+#include <leatherman/json_container/json_container.hpp>
+#include <leatherman/json_container/json_reader.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace leatherman { namespace json_container {
+
+    /// A violation of a JsonSchema.
+    struct JsonSchemaError {
+        /// JSON pointer of the offending value (e.g. "/params/0/name").
+        std::string pointer;
+        std::string message;
+    };
+
+    /// Error thrown when a document doesn't satisfy a JsonSchema.
+    class data_validation_error : public data_error {
+    public:
+        data_validation_error(std::string const& msg, std::vector<JsonSchemaError> errors)
+                : data_error(msg), errors_(std::move(errors)) {}
+
+        const std::vector<JsonSchemaError>& errors() const { return errors_; }
+
+    private:
+        std::vector<JsonSchemaError> errors_;
+    };
+
+    // Usage:
+    //
+    // To validate a message
+    //    JsonSchema schema { JsonContainer { schema_txt } };
+    //    for (const auto& error : schema.validate(message)) {
+    //        std::cerr << error.pointer << ": " << error.message << "\n";
+    //    }
+    //
+    // To validate while reading a stream, without building a DOM
+    //    JsonSchemaValidator validator { schema };
+    //    JsonReader {}.parse(fd, validator);
+    //    validator.errors();
+
+    /// Subset of JSON Schema (draft 4), compiled into a flat table of
+    /// checks. The supported keywords are:
+    ///  - type (a type name or an array of type names)
+    ///  - enum (of scalar values)
+    ///  - minimum, maximum (numbers)
+    ///  - minLength, maxLength (strings, in bytes)
+    ///  - minItems, maxItems, items (arrays; items is a single schema)
+    ///  - properties, required (objects)
+    /// Other keywords are ignored; members not listed in properties are
+    /// allowed.
+    class JsonSchema {
+    public:
+        /// Throw a data_parse_error in case the schema is invalid.
+        explicit JsonSchema(const JsonContainer& schema);
+
+        /// Check the document in a single pass and return all the
+        /// violations found, in document order.
+        std::vector<JsonSchemaError> validate(const JsonContainer& document) const;
+
+        /// Throw a data_validation_error in case the document doesn't
+        /// satisfy the schema.
+        void check(const JsonContainer& document) const;
+
+    private:
+        static const size_t NONE;
+
+        enum TypeMask : unsigned {
+            NULL_TYPE = 1 << 0,
+            BOOLEAN_TYPE = 1 << 1,
+            INTEGER_TYPE = 1 << 2,
+            NUMBER_TYPE = 1 << 3,
+            STRING_TYPE = 1 << 4,
+            ARRAY_TYPE = 1 << 5,
+            OBJECT_TYPE = 1 << 6,
+            ANY_TYPE = (1 << 7) - 1
+        };
+
+        // Integral numbers are held as their sign and magnitude as
+        // well, so that 64-bit integers compare exactly
+        struct Number {
+            double value;
+            bool integral;
+            bool negative;
+            uint64_t magnitude;
+
+            static Number of(int64_t value);
+            static Number of(uint64_t value);
+            static Number of(double value);
+
+            bool operator==(const Number& other) const;
+        };
+
+        struct EnumValue {
+            unsigned type;
+            bool boolean;
+            Number number;
+            std::string string;
+        };
+
+        // Checks applying to a value; each (sub)schema is a node, and
+        // nested schemas are referred to by their index in nodes_
+        struct Node {
+            unsigned types;
+            size_t enum_begin, enum_end;
+            bool has_minimum, has_maximum;
+            double minimum, maximum;
+            size_t min_length, max_length;
+            size_t min_items, max_items;
+            size_t properties_begin, properties_end;
+            size_t required_count;
+            size_t items;
+        };
+
+        struct Property {
+            std::string name;
+            size_t node;
+            bool required;
+        };
+
+        std::vector<Node> nodes_;
+        std::vector<Property> properties_;
+        std::vector<EnumValue> enum_values_;
+
+        size_t compile(const JsonContainerView& schema, const std::string& pointer);
+
+        friend class JsonSchemaValidator;
+    };
+
+    /// JsonHandler checking the events it receives against a
+    /// JsonSchema, e.g. while a JsonReader parses a stream.
+    class JsonSchemaValidator : public JsonHandler {
+    public:
+        explicit JsonSchemaValidator(const JsonSchema& schema);
+
+        /// The violations found so far.
+        const std::vector<JsonSchemaError>& errors() const { return errors_; }
+
+        /// Clear the state, to validate another document.
+        void reset();
+
+        bool null() override;
+        bool boolean(bool value) override;
+        bool integer(int64_t value) override;
+        bool unsignedInteger(uint64_t value) override;
+        bool real(double value) override;
+        bool string(const char* value, size_t length) override;
+        bool startObject() override;
+        bool key(const char* name, size_t length) override;
+        bool endObject(size_t member_count) override;
+        bool startArray() override;
+        bool endArray(size_t element_count) override;
+
+    private:
+        struct Frame {
+            size_t node;
+            bool is_array;
+            size_t index;
+            std::string key;
+            // Node of the value following the current key
+            size_t member_node;
+            std::vector<bool> seen;
+        };
+
+        const JsonSchema& schema_;
+        // Frames are reused across containers to keep their buffers
+        std::vector<Frame> frames_;
+        size_t depth_;
+        std::vector<JsonSchemaError> errors_;
+
+        size_t nextNode();
+        void afterValue();
+        bool checkScalar(unsigned type, bool boolean, const JsonSchema::Number& number,
+                         const char* string, size_t length);
+        bool checkType(size_t node, unsigned type);
+        void startContainer(bool is_array);
+        void addError(std::string message, bool parent = false);
+    };
+
+}}  // namespace leatherman::json_container
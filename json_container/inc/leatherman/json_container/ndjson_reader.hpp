@@ -0,0 +1,64 @@
+#pragma once
+
+#include <leatherman/json_container/json_container.hpp>
+#include <leatherman/json_container/json_reader.hpp>
+
+#include <functional>
+#include <iosfwd>
+#include <string>
+
+namespace leatherman { namespace json_container {
+
+    /// Receives the records of an NDJSON stream, in input order;
+    /// returns false to stop reading. The record can be modified or
+    /// swapped out; it's destroyed once the callback returns.
+    using NdjsonCallback = std::function<bool(JsonContainer& record)>;
+
+    // Usage:
+    //
+    // To process the JSON records printed one per line by a command
+    //    NdjsonReader reader {};
+    //    reader.read(fd, [](JsonContainer& record) {
+    //        std::cout << record.get<std::string>("name") << "\n";
+    //        return true;
+    //    });
+
+    /// Reader of newline-delimited JSON (one JSON text per line, as
+    /// output by many tools). The input is read on the calling thread
+    /// and cut into batches of whole lines, which are parsed in
+    /// parallel by a pool of threads; the records are then delivered
+    /// to the callback on the calling thread, in input order.
+    /// Memory use is bounded by the batches in flight: two per thread,
+    /// each of batch_size bytes (or of the longest line) plus the
+    /// containers parsed from it.
+    /// Blank lines are skipped and "\r\n" line endings are accepted.
+    class NdjsonReader {
+    public:
+        static const size_t DEFAULT_BATCH_SIZE;
+
+        /// Use threads parsing threads; 0 selects one per core.
+        explicit NdjsonReader(size_t threads = 0, size_t batch_size = DEFAULT_BATCH_SIZE);
+
+        /// Return false in case the callback stopped the reading, true
+        /// otherwise.
+        /// Throw a data_parse_error, once the previous records have
+        /// been delivered, in case a line is not valid JSON.
+        bool read(const std::string& ndjson_txt, NdjsonCallback callback) const;
+
+        /// Throw a data_parse_error in case a line is not valid JSON.
+        bool read(std::istream& input, NdjsonCallback callback) const;
+
+        /// Read from the file descriptor until end of file.
+        /// Throw a data_parse_error in case a line is not valid JSON.
+        /// Throw a data_error in case of a read failure.
+        bool read(int fd, NdjsonCallback callback) const;
+
+        /// Throw a data_parse_error in case a line is not valid JSON.
+        bool read(JsonChunkSource source, NdjsonCallback callback) const;
+
+    private:
+        size_t threads_;
+        size_t batch_size_;
+    };
+
+}}  // namespace leatherman::json_container
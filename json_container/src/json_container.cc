@@ -1,40 +1,1919 @@
 #include <leatherman/json_container/json_container.hpp>
+#include <leatherman/json_container/json_container_arena.hpp>
 #include <leatherman/locale/locale.hpp>
 
 #include <rapidjson/document.h>
-#include <rapidjson/stringbuffer.h>
 #include <rapidjson/writer.h>
+#include <rapidjson/memorystream.h>
+#include <rapidjson/prettywriter.h>
 #include <rapidjson/allocators.h>
 #include <rapidjson/rapidjson.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
 // Mark string for translation (alias for leatherman::locale::format)
 using leatherman::locale::_;
 
-namespace leatherman { namespace json_container {
+namespace leatherman { namespace json_container {
+
+    const size_t DEFAULT_LEFT_PADDING { 4 };
+    const size_t LEFT_PADDING_INCREMENT { 2 };
+
+    // Size of the buffer used by write() before flushing to the sink
+    const size_t WRITE_BUFFER_SIZE { 64 * 1024 };
+
+    //
+    // output streams
+    //
+
+    // RapidJSON output stream appending directly to a std::string,
+    // avoiding the intermediate copy of a rapidjson::StringBuffer.
+    // The string grows geometrically from the given capacity and is
+    // trimmed by Flush().
+    class StringOutputStream {
+    public:
+        typedef char Ch;
+
+        StringOutputStream(std::string& output, size_t capacity)
+                : output_(output),
+                  start_(output.size()) {
+            output_.resize(start_ + capacity + SLACK);
+            current_ = &output_[0] + start_;
+            end_ = &output_[0] + output_.size();
+        }
+
+        void Put(Ch c) {
+            *Push(1) = c;
+        }
+
+        // Same contract as rapidjson::StringBuffer::Push/Pop, used to
+        // format numbers in place
+        Ch* Push(size_t count) {
+            if (static_cast<size_t>(end_ - current_) < count) {
+                grow(count);
+            }
+
+            auto begin = current_;
+            current_ += count;
+            return begin;
+        }
+
+        void Pop(size_t count) {
+            current_ -= count;
+        }
+
+        void Flush() {
+            output_.resize(static_cast<size_t>(current_ - &output_[0]));
+            current_ = &output_[0] + output_.size();
+            end_ = current_;
+        }
+
+    private:
+        // Room for a formatted number, beyond the requested capacity
+        static const size_t SLACK { 32 };
+
+        std::string& output_;
+        size_t start_;
+        Ch* current_;
+        Ch* end_;
+
+        void grow(size_t count) {
+            // Grow geometrically with respect to what this stream wrote,
+            // as the string may already hold a large prefix
+            auto size = static_cast<size_t>(current_ - &output_[0]);
+            output_.resize(size + std::max(count, size - start_) + SLACK);
+            current_ = &output_[0] + size;
+            end_ = &output_[0] + output_.size();
+        }
+    };
+
+    // RapidJSON output stream accumulating the output in a fixed size
+    // buffer that is handed to the sink whenever it fills up.
+    class BufferedOutputStream {
+    public:
+        typedef char Ch;
+
+        explicit BufferedOutputStream(std::function<void(const char*, size_t)> sink)
+                : sink_(std::move(sink)),
+                  buffer_(WRITE_BUFFER_SIZE) {
+            current_ = buffer_.data();
+            end_ = buffer_.data() + buffer_.size();
+        }
+
+        void Put(Ch c) {
+            *Push(1) = c;
+        }
+
+        Ch* Push(size_t count) {
+            if (static_cast<size_t>(end_ - current_) < count) {
+                Flush();
+            }
+
+            auto begin = current_;
+            current_ += count;
+            return begin;
+        }
+
+        void Pop(size_t count) {
+            current_ -= count;
+        }
+
+        void Flush() {
+            if (current_ != buffer_.data()) {
+                sink_(buffer_.data(), static_cast<size_t>(current_ - buffer_.data()));
+                current_ = buffer_.data();
+            }
+        }
+
+    private:
+        std::function<void(const char*, size_t)> sink_;
+        std::vector<Ch> buffer_;
+        Ch* current_;
+        Ch* end_;
+    };
+
+}}  // namespace leatherman::json_container
+
+// rapidjson::Writer formats numbers in place only for its own
+// StringBuffer and puts them one character at a time into any other
+// stream; mirror its specializations for the streams above.
+namespace rapidjson {
+
+#define LEATHERMAN_JSON_WRITER_NUMBERS(Stream)                          \
+    template<>                                                          \
+    inline bool Writer<Stream>::WriteInt(int i) {                       \
+        char* buffer = os_->Push(11);                                   \
+        const char* end = internal::i32toa(i, buffer);                  \
+        os_->Pop(11 - (end - buffer));                                  \
+        return true;                                                    \
+    }                                                                   \
+    template<>                                                          \
+    inline bool Writer<Stream>::WriteUint(unsigned u) {                 \
+        char* buffer = os_->Push(10);                                   \
+        const char* end = internal::u32toa(u, buffer);                  \
+        os_->Pop(10 - (end - buffer));                                  \
+        return true;                                                    \
+    }                                                                   \
+    template<>                                                          \
+    inline bool Writer<Stream>::WriteInt64(int64_t i64) {               \
+        char* buffer = os_->Push(21);                                   \
+        const char* end = internal::i64toa(i64, buffer);                \
+        os_->Pop(21 - (end - buffer));                                  \
+        return true;                                                    \
+    }                                                                   \
+    template<>                                                          \
+    inline bool Writer<Stream>::WriteUint64(uint64_t u) {               \
+        char* buffer = os_->Push(20);                                   \
+        const char* end = internal::u64toa(u, buffer);                  \
+        os_->Pop(20 - (end - buffer));                                  \
+        return true;                                                    \
+    }                                                                   \
+    template<>                                                          \
+    inline bool Writer<Stream>::WriteDouble(double d) {                 \
+        char* buffer = os_->Push(25);                                   \
+        char* end = internal::dtoa(d, buffer);                          \
+        os_->Pop(25 - (end - buffer));                                  \
+        return true;                                                    \
+    }
+
+    LEATHERMAN_JSON_WRITER_NUMBERS(leatherman::json_container::StringOutputStream)
+    LEATHERMAN_JSON_WRITER_NUMBERS(leatherman::json_container::BufferedOutputStream)
+
+#undef LEATHERMAN_JSON_WRITER_NUMBERS
+
+}  // namespace rapidjson
+
+namespace leatherman { namespace json_container {
+
+    //
+    // free functions
+    //
+
+    // Rough size of the serialized value, used to reserve the output
+    // string; escaping and number formatting are not accounted for.
+    static size_t estimateSize(const json_value& jval) {
+        switch (jval.GetType()) {
+            case rapidjson::Type::kObjectType: {
+                size_t size = 2;
+                for (auto itr = jval.MemberBegin(); itr != jval.MemberEnd(); ++itr) {
+                    size += itr->name.GetStringLength() + 4 + estimateSize(itr->value);
+                }
+                return size;
+            }
+            case rapidjson::Type::kArrayType: {
+                size_t size = 2;
+                for (auto itr = jval.Begin(); itr != jval.End(); ++itr) {
+                    size += estimateSize(*itr) + 1;
+                }
+                return size;
+            }
+            case rapidjson::Type::kStringType:
+                return jval.GetStringLength() + 2;
+            case rapidjson::Type::kNumberType:
+                return jval.IsDouble() ? 16 : 8;
+            default:
+                return 5;
+        }
+    }
+
+    // The string grows as the value is written, unless the capacity
+    // of the output is given; the value can be a JsonContainerArena one
+    template <typename Value>
+    static void appendValue(const Value& jval, std::string& output, size_t capacity = 0) {
+        StringOutputStream stream { output, capacity };
+        rapidjson::Writer<StringOutputStream> writer { stream };
+        jval.Accept(writer);
+        stream.Flush();
+    }
+
+    static std::string valueToString(const json_value& jval) {
+        std::string output {};
+        appendValue(jval, output);
+        return output;
+    }
+
+    // Format of toPrettyString(): one "key : value" line per member,
+    // nested objects on the following lines with increased padding,
+    // strings unquoted, doubles in fixed notation and other values
+    // (arrays, non-object roots) as compact JSON.
+    static void appendPrettyValue(const json_value& jval, size_t left_padding, std::string& output) {
+        if (!jval.IsObject()) {
+            appendValue(jval, output);
+            return;
+        }
+
+        if (jval.ObjectEmpty()) {
+            output += "{}";
+            return;
+        }
+
+        for (auto itr = jval.MemberBegin(); itr != jval.MemberEnd(); ++itr) {
+            const auto& value = itr->value;
+            output.append(left_padding, ' ');
+            output.append(itr->name.GetString(), itr->name.GetStringLength());
+            output += " : ";
+
+            switch (value.GetType()) {
+                case rapidjson::Type::kObjectType:
+                    // Inner object: add new line, increment padding
+                    output += '\n';
+                    appendPrettyValue(value, left_padding + LEFT_PADDING_INCREMENT, output);
+                    break;
+                case rapidjson::Type::kArrayType:
+                    // Array: add raw string, regardless of its items
+                    appendValue(value, output);
+                    break;
+                case rapidjson::Type::kStringType:
+                    output.append(value.GetString(), value.GetStringLength());
+                    break;
+                case rapidjson::Type::kNumberType:
+                    if (value.IsDouble()) {
+                        // Same as std::to_string
+                        char buffer[DBL_MAX_10_EXP + 16];
+                        auto length = std::snprintf(buffer, sizeof(buffer), "%f", value.GetDouble());
+                        output.append(buffer, static_cast<size_t>(length));
+                    } else {
+                        appendValue(value, output);
+                    }
+                    break;
+                case rapidjson::Type::kTrueType:
+                    output += "true";
+                    break;
+                case rapidjson::Type::kFalseType:
+                    output += "false";
+                    break;
+                default:
+                    output += "NULL";
+            }
+
+            output += '\n';
+        }
+    }
+
+    static void writeValue(const json_value& jval, std::function<void(const char*, size_t)> sink) {
+        BufferedOutputStream stream { std::move(sink) };
+        rapidjson::Writer<BufferedOutputStream> writer { stream };
+        jval.Accept(writer);
+        stream.Flush();
+    }
+
+    static std::function<void(const char*, size_t)> streamSink(std::ostream& output) {
+        return [&output](const char* data, size_t size) {
+            if (!output.write(data, size)) {
+                throw data_error { _("failed to write JSON output") };
+            }
+        };
+    }
+
+    static std::function<void(const char*, size_t)> fdSink(int fd) {
+        return [fd](const char* data, size_t size) {
+            while (size > 0) {
+#ifdef _WIN32
+                auto count = ::_write(fd, data, static_cast<unsigned int>(size));
+#else
+                auto count = ::write(fd, data, size);
+#endif
+                if (count < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+
+                    throw data_error { _("failed to write JSON output: {1}", std::strerror(errno)) };
+                }
+
+                data += count;
+                size -= static_cast<size_t>(count);
+            }
+        };
+    }
+
+    // Also maps the values of JsonContainerArena
+    template <typename Value>
+    static DataType valueType(const Value& jval) {
+        switch (jval.GetType()) {
+            case rapidjson::Type::kNullType:
+                return DataType::Null;
+            case rapidjson::Type::kFalseType:
+                return DataType::Bool;
+            case rapidjson::Type::kTrueType:
+                return DataType::Bool;
+            case rapidjson::Type::kObjectType:
+                return DataType::Object;
+            case rapidjson::Type::kArrayType:
+                return DataType::Array;
+            case rapidjson::Type::kStringType:
+                return DataType::String;
+            case rapidjson::Type::kNumberType:
+                if (jval.IsDouble()) {
+                    return DataType::Double;
+                } else if (jval.IsInt()) {
+                    return DataType::Int;
+                } else if (jval.IsInt64()) {
+                    return DataType::Int64;
+                } else {
+                    return DataType::Uint64;
+                }
+            default:
+                // This is unexpected as for rapidjson docs
+                return DataType::Null;
+        }
+    }
+
+    // Scalar conversions shared by JsonContainer::get and
+    // JsonContainerView::get; null values are read as the default of T
+
+    template <typename T>
+    T readValue(const json_value& value);
+
+    template <>
+    int readValue<int>(const json_value& value) {
+        if (value.IsNull()) {
+            return 0;
+        }
+
+        if (!value.IsInt()) {
+            throw data_type_error { _("not an integer") };
+        }
+
+        return value.GetInt();
+    }
+
+    template <>
+    int64_t readValue<int64_t>(const json_value& value) {
+        if (value.IsNull()) {
+            return 0;
+        }
+
+        if (!value.IsInt64()) {
+            throw data_type_error { _("not a 64-bit integer") };
+        }
+
+        return value.GetInt64();
+    }
+
+    template <>
+    uint64_t readValue<uint64_t>(const json_value& value) {
+        if (value.IsNull()) {
+            return 0;
+        }
+
+        if (!value.IsUint64()) {
+            throw data_type_error { _("not an unsigned 64-bit integer") };
+        }
+
+        return value.GetUint64();
+    }
+
+    template <>
+    bool readValue<bool>(const json_value& value) {
+        if (value.IsNull()) {
+            return false;
+        }
+
+        if (!value.IsBool()) {
+            throw data_type_error { _("not a boolean") };
+        }
+
+        return value.GetBool();
+    }
+
+    template <>
+    std::string readValue<std::string>(const json_value& value) {
+        if (value.IsNull()) {
+            return "";
+        }
+
+        if (!value.IsString()) {
+            throw data_type_error { _("not a string") };
+        }
+
+        return std::string(value.GetString(), value.GetStringLength());
+    }
+
+    template <>
+    double readValue<double>(const json_value& value) {
+        if (value.IsNull()) {
+            return 0.0;
+        }
+
+        if (!value.IsDouble()) {
+            throw data_type_error { _("not a double") };
+        }
+
+        return value.GetDouble();
+    }
+
+    // Type checks and accessors of the element types supported by
+    // getArray() and getColumn()
+    template <typename T>
+    struct ElementType;
+
+    template <>
+    struct ElementType<int> {
+        static bool is(const json_value& jval) { return jval.IsInt(); }
+        static int get(const json_value& jval) { return jval.GetInt(); }
+        static std::string error() { return _("not an integer"); }
+    };
+
+    template <>
+    struct ElementType<int64_t> {
+        static bool is(const json_value& jval) { return jval.IsInt64(); }
+        static int64_t get(const json_value& jval) { return jval.GetInt64(); }
+        static std::string error() { return _("not a 64-bit integer"); }
+    };
+
+    template <>
+    struct ElementType<uint64_t> {
+        static bool is(const json_value& jval) { return jval.IsUint64(); }
+        static uint64_t get(const json_value& jval) { return jval.GetUint64(); }
+        static std::string error() { return _("not an unsigned 64-bit integer"); }
+    };
+
+    template <>
+    struct ElementType<double> {
+        static bool is(const json_value& jval) { return jval.IsDouble(); }
+        static double get(const json_value& jval) { return jval.GetDouble(); }
+        static std::string error() { return _("not a double"); }
+    };
+
+    template <>
+    struct ElementType<bool> {
+        static bool is(const json_value& jval) { return jval.IsBool(); }
+        static bool get(const json_value& jval) { return jval.GetBool(); }
+        static std::string error() { return _("not a boolean"); }
+    };
+
+    // Throw unless jval is an array that fits in capacity elements
+    void checkArrayCapacity(const json_value& jval, size_t capacity) {
+        if (!jval.IsArray()) {
+            throw data_type_error { _("not an array") };
+        }
+
+        if (jval.Size() > capacity) {
+            throw data_index_error { _("array of {1} elements exceeds the output capacity of {2}",
+                                       jval.Size(), capacity) };
+        }
+    }
+
+    //
+    // CBOR
+    //
+
+    // Major types (top 3 bits of the initial byte) used for JSON values
+    const uint8_t CBOR_UNSIGNED { 0x00 };
+    const uint8_t CBOR_NEGATIVE { 0x20 };
+    const uint8_t CBOR_TEXT { 0x60 };
+    const uint8_t CBOR_ARRAY { 0x80 };
+    const uint8_t CBOR_MAP { 0xa0 };
+    const uint8_t CBOR_TAG { 0xc0 };
+
+    const uint8_t CBOR_FALSE { 0xf4 };
+    const uint8_t CBOR_TRUE { 0xf5 };
+    const uint8_t CBOR_NULL { 0xf6 };
+    const uint8_t CBOR_FLOAT16 { 0xf9 };
+    const uint8_t CBOR_FLOAT32 { 0xfa };
+    const uint8_t CBOR_FLOAT64 { 0xfb };
+    const uint8_t CBOR_BREAK { 0xff };
+
+    // Additional information of items of indefinite length
+    const uint8_t CBOR_INDEFINITE { 31 };
+
+    // Bound on the nesting of decoded items, to protect the stack
+    const size_t CBOR_MAX_DEPTH { 512 };
+
+    // Elements reserved for an array from its count in the input
+    const uint64_t CBOR_MAX_RESERVE { 1024 };
+
+    // Largest piece of a string pushed at once to the output stream
+    const size_t CBOR_COPY_SIZE { 4096 };
+
+    template <typename Stream>
+    void putCborHead(uint8_t major, uint64_t argument, Stream& stream) {
+        size_t length;
+        uint8_t info;
+
+        if (argument < 24) {
+            stream.Put(static_cast<char>(major | argument));
+            return;
+        } else if (argument <= 0xff) {
+            length = 1;
+            info = 24;
+        } else if (argument <= 0xffff) {
+            length = 2;
+            info = 25;
+        } else if (argument <= 0xffffffff) {
+            length = 4;
+            info = 26;
+        } else {
+            length = 8;
+            info = 27;
+        }
+
+        auto buffer = stream.Push(length + 1);
+        buffer[0] = static_cast<char>(major | info);
+
+        for (size_t i = length; i > 0; i--) {
+            buffer[i] = static_cast<char>(argument & 0xff);
+            argument >>= 8;
+        }
+    }
+
+    template <typename Stream>
+    void putCborString(const json_value& jval, Stream& stream) {
+        size_t length = jval.GetStringLength();
+        putCborHead(CBOR_TEXT, length, stream);
+
+        // In pieces, as BufferedOutputStream can't push beyond its size
+        for (size_t offset = 0; offset < length; offset += CBOR_COPY_SIZE) {
+            auto size = std::min(length - offset, CBOR_COPY_SIZE);
+            std::memcpy(stream.Push(size), jval.GetString() + offset, size);
+        }
+    }
+
+    template <typename Stream>
+    void putCborDouble(double value, Stream& stream) {
+        // Single precision when no bits are lost; the value is checked
+        // against FLT_MAX first, as converting it otherwise is undefined
+        if (std::fabs(value) <= FLT_MAX &&
+                static_cast<double>(static_cast<float>(value)) == value) {
+            auto single = static_cast<float>(value);
+            uint32_t bits;
+            std::memcpy(&bits, &single, sizeof(bits));
+            auto buffer = stream.Push(5);
+            buffer[0] = static_cast<char>(CBOR_FLOAT32);
+
+            for (size_t i = 4; i > 0; i--) {
+                buffer[i] = static_cast<char>(bits & 0xff);
+                bits >>= 8;
+            }
+        } else {
+            uint64_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            auto buffer = stream.Push(9);
+            buffer[0] = static_cast<char>(CBOR_FLOAT64);
+
+            for (size_t i = 8; i > 0; i--) {
+                buffer[i] = static_cast<char>(bits & 0xff);
+                bits >>= 8;
+            }
+        }
+    }
+
+    // Encode with definite lengths, which rapidjson values always know
+    template <typename Stream>
+    void putCborValue(const json_value& jval, Stream& stream) {
+        switch (jval.GetType()) {
+            case rapidjson::Type::kNullType:
+                stream.Put(static_cast<char>(CBOR_NULL));
+                break;
+            case rapidjson::Type::kFalseType:
+                stream.Put(static_cast<char>(CBOR_FALSE));
+                break;
+            case rapidjson::Type::kTrueType:
+                stream.Put(static_cast<char>(CBOR_TRUE));
+                break;
+            case rapidjson::Type::kObjectType:
+                putCborHead(CBOR_MAP, jval.MemberCount(), stream);
+                for (auto itr = jval.MemberBegin(); itr != jval.MemberEnd(); ++itr) {
+                    putCborString(itr->name, stream);
+                    putCborValue(itr->value, stream);
+                }
+                break;
+            case rapidjson::Type::kArrayType:
+                putCborHead(CBOR_ARRAY, jval.Size(), stream);
+                for (auto itr = jval.Begin(); itr != jval.End(); ++itr) {
+                    putCborValue(*itr, stream);
+                }
+                break;
+            case rapidjson::Type::kStringType:
+                putCborString(jval, stream);
+                break;
+            case rapidjson::Type::kNumberType:
+                if (jval.IsDouble()) {
+                    putCborDouble(jval.GetDouble(), stream);
+                } else if (jval.IsInt64() && jval.GetInt64() < 0) {
+                    // -1 - n cannot overflow for negative n; INT64_MIN
+                    // is also flagged as a uint64 by rapidjson's reader
+                    putCborHead(CBOR_NEGATIVE, static_cast<uint64_t>(-1 - jval.GetInt64()), stream);
+                } else {
+                    putCborHead(CBOR_UNSIGNED, jval.GetUint64(), stream);
+                }
+                break;
+        }
+    }
+
+    // Reads the bytes of CBOR data items, either from memory or from a
+    // chunk source through a buffer that grows only to fit the longest
+    // string, and rejects the items that have no JSON equivalent.
+    class CborInput {
+    public:
+        CborInput(const char* data, size_t size)
+                : source_(),
+                  buffer_(),
+                  current_(data),
+                  end_(data + size) {
+        }
+
+        explicit CborInput(std::function<size_t(char*, size_t)> source)
+                : source_(std::move(source)),
+                  buffer_(WRITE_BUFFER_SIZE) {
+            current_ = buffer_.data();
+            end_ = current_;
+        }
+
+        void checkDepth(size_t depth) const {
+            if (depth > CBOR_MAX_DEPTH) {
+                throw data_parse_error { _("invalid CBOR: nesting too deep") };
+            }
+        }
+
+        uint8_t readInitial() {
+            return static_cast<uint8_t>(*take(1));
+        }
+
+        uint64_t readArgument(uint8_t info) {
+            if (info < 24) {
+                return info;
+            }
+
+            if (info > 27) {
+                throw data_parse_error { _("invalid CBOR: unsupported length encoding {1}",
+                                           static_cast<int>(info)) };
+            }
+
+            size_t length = size_t { 1 } << (info - 24);
+            auto bytes = take(length);
+            uint64_t argument = 0;
+
+            for (size_t i = 0; i < length; i++) {
+                argument = (argument << 8) | static_cast<uint8_t>(bytes[i]);
+            }
+
+            return argument;
+        }
+
+        int64_t readNegative(uint8_t info) {
+            auto argument = readArgument(info);
+
+            if (argument > static_cast<uint64_t>(INT64_MAX)) {
+                throw data_parse_error { _("invalid CBOR: integer out of range") };
+            }
+
+            return -1 - static_cast<int64_t>(argument);
+        }
+
+        // Read a text string whose initial byte has been consumed; the
+        // returned pointer is valid until the next read
+        const char* readText(uint8_t info, size_t& length) {
+            if (info != CBOR_INDEFINITE) {
+                auto argument = readArgument(info);
+
+                // Strings fitting in memory or in the buffer are read
+                // in place; longer ones are accumulated as they arrive
+                if (argument <= static_cast<uint64_t>(end_ - current_) ||
+                        argument <= buffer_.size()) {
+                    length = static_cast<size_t>(argument);
+                    return take(length);
+                }
+
+                text_.clear();
+                appendText(argument);
+            } else {
+                text_.clear();
+
+                while (!atBreak()) {
+                    auto chunk = readInitial();
+                    if ((chunk & 0xe0) != CBOR_TEXT || (chunk & 0x1f) == CBOR_INDEFINITE) {
+                        throw data_parse_error { _("invalid CBOR: invalid string chunk") };
+                    }
+                    appendText(readArgument(static_cast<uint8_t>(chunk & 0x1f)));
+                }
+            }
+
+            length = text_.size();
+            return text_.data();
+        }
+
+        const char* readKey(size_t& length) {
+            auto initial = readInitial();
+
+            if ((initial & 0xe0) != CBOR_TEXT) {
+                throw data_parse_error { _("invalid CBOR: object keys must be strings") };
+            }
+
+            return readText(static_cast<uint8_t>(initial & 0x1f), length);
+        }
+
+        double readFloat(uint8_t initial) {
+            double value;
+
+            if (initial == CBOR_FLOAT16) {
+                auto half = static_cast<unsigned>(readArgument(25));
+                auto exponent = static_cast<int>((half >> 10) & 0x1f);
+                auto mantissa = static_cast<double>(half & 0x3ff);
+
+                if (exponent == 0) {
+                    value = std::ldexp(mantissa, -24);
+                } else if (exponent != 31) {
+                    value = std::ldexp(mantissa + 1024, exponent - 25);
+                } else {
+                    value = HUGE_VAL;
+                }
+
+                value = (half & 0x8000) ? -value : value;
+            } else if (initial == CBOR_FLOAT32) {
+                auto bits = static_cast<uint32_t>(readArgument(26));
+                float single;
+                std::memcpy(&single, &bits, sizeof(single));
+                value = single;
+            } else {
+                auto bits = readArgument(27);
+                std::memcpy(&value, &bits, sizeof(value));
+            }
+
+            if (!std::isfinite(value)) {
+                throw data_parse_error { _("invalid CBOR: non-finite number") };
+            }
+
+            return value;
+        }
+
+        // Byte strings, undefined and other simple values
+        void unsupported(uint8_t initial) const {
+            throw data_parse_error { _("invalid CBOR: unsupported initial byte {1}",
+                                       static_cast<int>(initial)) };
+        }
+
+        // Consume the break ending an item of indefinite length, if next
+        bool atBreak() {
+            if (static_cast<uint8_t>(*take(1)) == CBOR_BREAK) {
+                return true;
+            }
+
+            current_--;
+            return false;
+        }
+
+        // Return true if there is no input left
+        bool atEnd() {
+            if (current_ != end_) {
+                return false;
+            }
+
+            if (!source_) {
+                return true;
+            }
+
+            auto count = source_(buffer_.data(), buffer_.size());
+            current_ = buffer_.data();
+            end_ = current_ + count;
+            return count == 0;
+        }
+
+    private:
+        std::function<size_t(char*, size_t)> source_;
+        std::vector<char> buffer_;
+        const char* current_;
+        const char* end_;
+        // Holds text longer than the buffer, or made of several chunks
+        std::string text_;
+
+        const char* take(size_t count) {
+            if (static_cast<size_t>(end_ - current_) < count) {
+                fill(count);
+            }
+
+            auto begin = current_;
+            current_ += count;
+            return begin;
+        }
+
+        // Make at least count bytes available from current_
+        void fill(size_t count) {
+            if (!source_) {
+                throw data_parse_error { _("invalid CBOR: unexpected end of input") };
+            }
+
+            auto available = static_cast<size_t>(end_ - current_);
+            std::memmove(buffer_.data(), current_, available);
+
+            if (buffer_.size() < count) {
+                buffer_.resize(count);
+            }
+
+            while (available < count) {
+                auto read = source_(buffer_.data() + available, buffer_.size() - available);
+
+                if (read == 0) {
+                    throw data_parse_error { _("invalid CBOR: unexpected end of input") };
+                }
+
+                available += read;
+            }
+
+            current_ = buffer_.data();
+            end_ = current_ + available;
+        }
+
+        void appendText(uint64_t count) {
+            while (count > 0) {
+                if (current_ == end_) {
+                    fill(1);
+                }
+
+                auto size = static_cast<size_t>(std::min(count, static_cast<uint64_t>(end_ - current_)));
+                text_.append(current_, size);
+                current_ += size;
+                count -= size;
+            }
+        }
+    };
+
+    // Decode a data item into value, building it through the public
+    // GenericValue interface; strings are copied with the allocator
+    static void readCborValue(CborInput& input, json_value& value, json_allocator& allocator, size_t depth) {
+        input.checkDepth(depth);
+        auto initial = input.readInitial();
+        auto info = static_cast<uint8_t>(initial & 0x1f);
+        size_t length;
+
+        switch (initial & 0xe0) {
+            case CBOR_UNSIGNED:
+                value.SetUint64(input.readArgument(info));
+                break;
+            case CBOR_NEGATIVE:
+                value.SetInt64(input.readNegative(info));
+                break;
+            case CBOR_TEXT: {
+                auto text = input.readText(info, length);
+                value.SetString(text, static_cast<rapidjson::SizeType>(length), allocator);
+                break;
+            }
+            case CBOR_ARRAY: {
+                bool indefinite = info == CBOR_INDEFINITE;
+                auto count = indefinite ? 0 : input.readArgument(info);
+                value.SetArray();
+                // The count isn't trusted to reserve more than a few elements
+                value.Reserve(static_cast<rapidjson::SizeType>(std::min(count, CBOR_MAX_RESERVE)), allocator);
+
+                for (uint64_t size = 0; indefinite ? !input.atBreak() : size < count; size++) {
+                    json_value element {};
+                    readCborValue(input, element, allocator, depth + 1);
+                    value.PushBack(element, allocator);
+                }
+                break;
+            }
+            case CBOR_MAP: {
+                bool indefinite = info == CBOR_INDEFINITE;
+                auto count = indefinite ? 0 : input.readArgument(info);
+                value.SetObject();
+
+                for (uint64_t size = 0; indefinite ? !input.atBreak() : size < count; size++) {
+                    auto key = input.readKey(length);
+                    json_value name { key, static_cast<rapidjson::SizeType>(length), allocator };
+                    json_value member {};
+                    readCborValue(input, member, allocator, depth + 1);
+                    value.AddMember(name, member, allocator);
+                }
+                break;
+            }
+            case CBOR_TAG:
+                // Semantic tags (dates, bignums...) only annotate the
+                // following item, which is decoded as is
+                input.readArgument(info);
+                readCborValue(input, value, allocator, depth + 1);
+                break;
+            default:
+                switch (initial) {
+                    case CBOR_FALSE:
+                        value.SetBool(false);
+                        break;
+                    case CBOR_TRUE:
+                        value.SetBool(true);
+                        break;
+                    case CBOR_NULL:
+                        value.SetNull();
+                        break;
+                    case CBOR_FLOAT16:
+                    case CBOR_FLOAT32:
+                    case CBOR_FLOAT64:
+                        value.SetDouble(input.readFloat(initial));
+                        break;
+                    default:
+                        input.unsupported(initial);
+                }
+        }
+    }
+
+    void writeCbor(const json_value& jval, std::function<void(const char*, size_t)> sink) {
+        BufferedOutputStream stream { std::move(sink) };
+        putCborValue(jval, stream);
+        stream.Flush();
+    }
+
+    void readCbor(CborInput& input, json_document& document) {
+        readCborValue(input, document, document.GetAllocator(), 0);
+
+        if (!input.atEnd()) {
+            throw data_parse_error { _("invalid CBOR: trailing data after the first item") };
+        }
+    }
+
+    //
+    // merge patch and diff
+    //
+
+    // Deep equality distinguishing integers from doubles, unlike the
+    // operator== of rapidjson; shared values are equal without being
+    // walked.
+    bool sameValue(const json_value& a, const json_value& b) {
+        if (&a == &b) {
+            return true;
+        }
+
+        auto type = valueType(a);
+
+        if (type != valueType(b)) {
+            return false;
+        }
+
+        switch (type) {
+            case DataType::Object: {
+                if (a.MemberCount() != b.MemberCount()) {
+                    return false;
+                }
+
+                auto b_itr = b.MemberBegin();
+
+                for (auto itr = a.MemberBegin(); itr != a.MemberEnd(); ++itr, ++b_itr) {
+                    // Members are usually in the same order
+                    auto other = b_itr;
+
+                    if (itr->name != other->name) {
+                        other = b.FindMember(itr->name);
+
+                        if (other == b.MemberEnd()) {
+                            return false;
+                        }
+                    }
+
+                    if (!sameValue(itr->value, other->value)) {
+                        return false;
+                    }
+                }
+
+                return true;
+            }
+            case DataType::Array: {
+                if (a.Size() != b.Size()) {
+                    return false;
+                }
+
+                for (rapidjson::SizeType i = 0; i < a.Size(); i++) {
+                    if (!sameValue(a[i], b[i])) {
+                        return false;
+                    }
+                }
+
+                return true;
+            }
+            case DataType::String:
+                return a.GetStringLength() == b.GetStringLength() &&
+                       (a.GetString() == b.GetString() ||
+                        std::memcmp(a.GetString(), b.GetString(), a.GetStringLength()) == 0);
+            case DataType::Double:
+                return a.GetDouble() == b.GetDouble();
+            case DataType::Uint64:
+                return a.GetUint64() == b.GetUint64();
+            case DataType::Null:
+                return true;
+            case DataType::Bool:
+                return a.GetBool() == b.GetBool();
+            default:
+                return a.GetInt64() == b.GetInt64();
+        }
+    }
+
+    void mergePatchValue(json_value& target, const json_value& patch, json_allocator& allocator) {
+        if (!patch.IsObject()) {
+            if (!sameValue(target, patch)) {
+                target.CopyFrom(patch, allocator);
+            }
+            return;
+        }
+
+        if (!target.IsObject()) {
+            target.SetObject();
+        }
+
+        for (auto itr = patch.MemberBegin(); itr != patch.MemberEnd(); ++itr) {
+            auto member = target.FindMember(itr->name);
+
+            if (itr->value.IsNull()) {
+                if (member != target.MemberEnd()) {
+                    // Unlike RemoveMember, keeps the order of the members
+                    target.EraseMember(member);
+                }
+            } else if (member != target.MemberEnd()) {
+                mergePatchValue(member->value, itr->value, allocator);
+            } else {
+                json_value name { itr->name, allocator };
+                json_value value {};
+                mergePatchValue(value, itr->value, allocator);
+                target.AddMember(name, value, allocator);
+            }
+        }
+    }
+
+    // Location of the value being compared by diffValues(); the JSON
+    // pointer is only formatted when an operation is added
+    struct PatchPathToken {
+        // nullptr for array indexes
+        const char* key;
+        size_t length;
+        size_t index;
+    };
+
+    std::string formatPointer(const std::vector<PatchPathToken>& path) {
+        std::string pointer {};
+
+        for (const auto& token : path) {
+            pointer += '/';
+
+            if (token.key == nullptr) {
+                pointer += std::to_string(token.index);
+                continue;
+            }
+
+            // Escape as per RFC 6901
+            for (size_t i = 0; i < token.length; i++) {
+                if (token.key[i] == '~') {
+                    pointer += "~0";
+                } else if (token.key[i] == '/') {
+                    pointer += "~1";
+                } else {
+                    pointer += token.key[i];
+                }
+            }
+        }
+
+        return pointer;
+    }
+
+    void addPatchOperation(const char* op, const std::vector<PatchPathToken>& path,
+                           const json_value* value, json_value& ops, json_allocator& allocator) {
+        auto pointer = formatPointer(path);
+        json_value operation { rapidjson::kObjectType };
+        operation.AddMember("op", rapidjson::StringRef(op), allocator);
+        operation.AddMember("path", json_value { pointer.data(),
+                                                 static_cast<rapidjson::SizeType>(pointer.size()),
+                                                 allocator },
+                            allocator);
+
+        if (value != nullptr) {
+            operation.AddMember("value", json_value { *value, allocator }, allocator);
+        }
+
+        ops.PushBack(operation, allocator);
+    }
+
+    // Append to ops the operations turning a, located at path, into b
+    void diffValues(const json_value& a, const json_value& b, std::vector<PatchPathToken>& path,
+                    json_value& ops, json_allocator& allocator) {
+        if (&a == &b) {
+            return;
+        }
+
+        auto type = valueType(a);
+
+        if (type != valueType(b)) {
+            addPatchOperation("replace", path, &b, ops, allocator);
+            return;
+        }
+
+        if (type == DataType::Object) {
+            auto b_itr = b.MemberBegin();
+            // Members of b matched by a member of a; the others are added
+            std::vector<bool> matches(b.MemberCount(), false);
+            rapidjson::SizeType matched = 0;
+
+            for (auto itr = a.MemberBegin(); itr != a.MemberEnd(); ++itr) {
+                // Members are usually in the same order in both objects
+                auto other = b_itr;
+
+                if (other == b.MemberEnd() || itr->name != other->name) {
+                    other = b.FindMember(itr->name);
+                }
+
+                path.push_back({ itr->name.GetString(), itr->name.GetStringLength(), 0 });
+
+                if (other == b.MemberEnd()) {
+                    addPatchOperation("remove", path, nullptr, ops, allocator);
+                } else {
+                    diffValues(itr->value, other->value, path, ops, allocator);
+                    auto position = static_cast<size_t>(other - b.MemberBegin());
+
+                    if (!matches[position]) {
+                        matches[position] = true;
+                        matched++;
+                    }
+
+                    // Carry on after the match, so that a member removed
+                    // or moved doesn't misalign the following ones
+                    b_itr = other + 1;
+                }
+
+                path.pop_back();
+            }
+
+            // Search the added members only if there are any
+            if (matched == b.MemberCount()) {
+                return;
+            }
+
+            for (auto itr = b.MemberBegin(); itr != b.MemberEnd(); ++itr) {
+                if (!matches[static_cast<size_t>(itr - b.MemberBegin())]) {
+                    path.push_back({ itr->name.GetString(), itr->name.GetStringLength(), 0 });
+                    addPatchOperation("add", path, &itr->value, ops, allocator);
+                    path.pop_back();
+                }
+            }
+        } else if (type == DataType::Array) {
+            auto common = std::min(a.Size(), b.Size());
+
+            for (rapidjson::SizeType i = 0; i < common; i++) {
+                path.push_back({ nullptr, 0, i });
+                diffValues(a[i], b[i], path, ops, allocator);
+                path.pop_back();
+            }
+
+            for (auto i = common; i < b.Size(); i++) {
+                path.push_back({ nullptr, 0, i });
+                addPatchOperation("add", path, &b[i], ops, allocator);
+                path.pop_back();
+            }
+
+            // From the end, so that the indexes remain valid
+            for (auto i = a.Size(); i > common; i--) {
+                path.push_back({ nullptr, 0, i - 1 });
+                addPatchOperation("remove", path, nullptr, ops, allocator);
+                path.pop_back();
+            }
+        } else if (!sameValue(a, b)) {
+            addPatchOperation("replace", path, &b, ops, allocator);
+        }
+    }
+
+    //
+    // hashing
+    //
+
+    const uint64_t XXH_PRIME64_1 { 0x9E3779B185EBCA87ULL };
+    const uint64_t XXH_PRIME64_2 { 0xC2B2AE3D27D4EB4FULL };
+    const uint64_t XXH_PRIME64_3 { 0x165667B19E3779F9ULL };
+    const uint64_t XXH_PRIME64_4 { 0x85EBCA77C2B2AE63ULL };
+    const uint64_t XXH_PRIME64_5 { 0x27D4EB2F165667C5ULL };
+
+    // Seeds separating the hashes of the different types of values
+    const uint64_t HASH_SEED_NULL { 1 };
+    const uint64_t HASH_SEED_BOOL { 2 };
+    const uint64_t HASH_SEED_INT { 3 };
+    const uint64_t HASH_SEED_UINT { 4 };
+    const uint64_t HASH_SEED_DOUBLE { 5 };
+    const uint64_t HASH_SEED_STRING { 6 };
+    const uint64_t HASH_SEED_ARRAY { 7 };
+    const uint64_t HASH_SEED_OBJECT { 8 };
+    const uint64_t HASH_SEED_MEMBER { 9 };
+
+    inline uint64_t rotateLeft(uint64_t value, int bits) {
+        return (value << bits) | (value >> (64 - bits));
+    }
+
+    inline uint64_t readLittleEndian64(const char* data) {
+        uint64_t value = 0;
+
+        for (int i = 7; i >= 0; i--) {
+            value = (value << 8) | static_cast<uint8_t>(data[i]);
+        }
+
+        return value;
+    }
+
+    inline uint64_t readLittleEndian32(const char* data) {
+        uint64_t value = 0;
+
+        for (int i = 3; i >= 0; i--) {
+            value = (value << 8) | static_cast<uint8_t>(data[i]);
+        }
+
+        return value;
+    }
+
+    inline uint64_t xxhRound(uint64_t accumulator, uint64_t input) {
+        accumulator += input * XXH_PRIME64_2;
+        return rotateLeft(accumulator, 31) * XXH_PRIME64_1;
+    }
+
+    inline uint64_t xxhMergeRound(uint64_t accumulator, uint64_t value) {
+        accumulator ^= xxhRound(0, value);
+        return accumulator * XXH_PRIME64_1 + XXH_PRIME64_4;
+    }
+
+    inline uint64_t xxhAvalanche(uint64_t hash) {
+        hash ^= hash >> 33;
+        hash *= XXH_PRIME64_2;
+        hash ^= hash >> 29;
+        hash *= XXH_PRIME64_3;
+        hash ^= hash >> 32;
+        return hash;
+    }
+
+    // XXH64 of the specified bytes
+    uint64_t xxHash64(const char* data, size_t length, uint64_t seed) {
+        auto end = data + length;
+        uint64_t hash;
+
+        if (length >= 32) {
+            auto v1 = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+            auto v2 = seed + XXH_PRIME64_2;
+            auto v3 = seed;
+            auto v4 = seed - XXH_PRIME64_1;
+
+            do {
+                v1 = xxhRound(v1, readLittleEndian64(data));
+                v2 = xxhRound(v2, readLittleEndian64(data + 8));
+                v3 = xxhRound(v3, readLittleEndian64(data + 16));
+                v4 = xxhRound(v4, readLittleEndian64(data + 24));
+                data += 32;
+            } while (end - data >= 32);
+
+            hash = rotateLeft(v1, 1) + rotateLeft(v2, 7) + rotateLeft(v3, 12) + rotateLeft(v4, 18);
+            hash = xxhMergeRound(hash, v1);
+            hash = xxhMergeRound(hash, v2);
+            hash = xxhMergeRound(hash, v3);
+            hash = xxhMergeRound(hash, v4);
+        } else {
+            hash = seed + XXH_PRIME64_5;
+        }
+
+        hash += length;
+
+        for (; end - data >= 8; data += 8) {
+            hash ^= xxhRound(0, readLittleEndian64(data));
+            hash = rotateLeft(hash, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+        }
+
+        if (end - data >= 4) {
+            hash ^= readLittleEndian32(data) * XXH_PRIME64_1;
+            hash = rotateLeft(hash, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+            data += 4;
+        }
+
+        for (; data < end; data++) {
+            hash ^= static_cast<uint8_t>(*data) * XXH_PRIME64_5;
+            hash = rotateLeft(hash, 11) * XXH_PRIME64_1;
+        }
+
+        return xxhAvalanche(hash);
+    }
+
+    // XXH64 of the 8 bytes of value, in little endian order
+    inline uint64_t xxHash64(uint64_t value, uint64_t seed) {
+        auto hash = seed + XXH_PRIME64_5 + 8;
+        hash ^= xxhRound(0, value);
+        hash = rotateLeft(hash, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+        return xxhAvalanche(hash);
+    }
+
+    // Key of the hash of an object or array in the cache: the address
+    // of its members or elements, which doesn't change when the value
+    // itself is relocated within its parent; nullptr if empty
+    const void* hashCacheKey(const json_value& jval) {
+        if (jval.IsObject() && !jval.ObjectEmpty()) {
+            return &*jval.MemberBegin();
+        } else if (jval.IsArray() && !jval.Empty()) {
+            return jval.Begin();
+        }
+
+        return nullptr;
+    }
+
+    // Hashes are consistent with sameValue(): equal values have equal
+    // hashes. Objects sum the hashes of their members, so that the
+    // order of the members doesn't matter.
+    uint64_t hashValue(const json_value& jval, std::unordered_map<const void*, uint64_t>* cache) {
+        const void* key = nullptr;
+
+        if (cache != nullptr && (key = hashCacheKey(jval)) != nullptr) {
+            auto it = cache->find(key);
+
+            if (it != cache->end()) {
+                return it->second;
+            }
+        }
+
+        uint64_t hash;
+
+        switch (valueType(jval)) {
+            case DataType::Object: {
+                uint64_t sum = 0;
+
+                for (auto itr = jval.MemberBegin(); itr != jval.MemberEnd(); ++itr) {
+                    auto name = xxHash64(itr->name.GetString(), itr->name.GetStringLength(),
+                                         HASH_SEED_MEMBER);
+                    sum += xxHash64(hashValue(itr->value, cache), name);
+                }
+
+                hash = xxHash64(sum + jval.MemberCount(), HASH_SEED_OBJECT);
+                break;
+            }
+            case DataType::Array:
+                hash = HASH_SEED_ARRAY;
+
+                for (auto itr = jval.Begin(); itr != jval.End(); ++itr) {
+                    hash = xxHash64(hashValue(*itr, cache), hash);
+                }
+
+                hash = xxHash64(hash + jval.Size(), HASH_SEED_ARRAY);
+                break;
+            case DataType::String:
+                hash = xxHash64(jval.GetString(), jval.GetStringLength(), HASH_SEED_STRING);
+                break;
+            case DataType::Double: {
+                // 0.0 == -0.0
+                double value = jval.GetDouble() == 0 ? 0.0 : jval.GetDouble();
+                uint64_t bits;
+                std::memcpy(&bits, &value, sizeof(bits));
+                hash = xxHash64(bits, HASH_SEED_DOUBLE);
+                break;
+            }
+            case DataType::Uint64:
+                hash = xxHash64(jval.GetUint64(), HASH_SEED_UINT);
+                break;
+            case DataType::Bool:
+                hash = xxHash64(jval.GetBool() ? 1 : 0, HASH_SEED_BOOL);
+                break;
+            case DataType::Null:
+                hash = xxHash64(0, HASH_SEED_NULL);
+                break;
+            default:
+                hash = xxHash64(static_cast<uint64_t>(jval.GetInt64()), HASH_SEED_INT);
+        }
+
+        if (key != nullptr) {
+            cache->emplace(key, hash);
+        }
+
+        return hash;
+    }
+
+    //
+    // JsonArenaContainer accessors sharing the helpers above; the rest
+    // of the class is in json_container_arena.cc
+    //
+
+    DataType JsonArenaContainer::type() const {
+        return valueType(*value_);
+    }
+
+    std::string JsonArenaContainer::toString() const {
+        std::string output {};
+        appendValue(*value_, output);
+        return output;
+    }
+
+    //
+    // JsonContainerView
+    //
+
+    DataType JsonContainerView::type() const {
+        return valueType(*value_);
+    }
+
+    size_t JsonContainerView::size() const {
+        if (value_->IsObject()) {
+            return value_->MemberCount();
+        } else if (value_->IsArray()) {
+            return value_->Size();
+        } else {
+            return 0;
+        }
+    }
+
+    template<>
+    int JsonContainerView::get<>() const {
+        return readValue<int>(*value_);
+    }
 
-    const size_t DEFAULT_LEFT_PADDING { 4 };
-    const size_t LEFT_PADDING_INCREMENT { 2 };
+    template<>
+    int64_t JsonContainerView::get<>() const {
+        return readValue<int64_t>(*value_);
+    }
+
+    template<>
+    uint64_t JsonContainerView::get<>() const {
+        return readValue<uint64_t>(*value_);
+    }
+
+    template<>
+    double JsonContainerView::get<>() const {
+        return readValue<double>(*value_);
+    }
+
+    template<>
+    bool JsonContainerView::get<>() const {
+        return readValue<bool>(*value_);
+    }
+
+    template<>
+    std::string JsonContainerView::get<>() const {
+        return readValue<std::string>(*value_);
+    }
+
+    template<>
+    boost::string_ref JsonContainerView::get<>() const {
+        if (value_->IsNull()) {
+            return {};
+        }
+
+        if (!value_->IsString()) {
+            throw data_type_error { _("not a string") };
+        }
+
+        return { value_->GetString(), value_->GetStringLength() };
+    }
+
+    template<>
+    JsonContainer JsonContainerView::get<>() const {
+        if (value_->IsNull()) {
+            return {};
+        }
+
+        return JsonContainer { *value_ };
+    }
+
+    JsonContainerMembers JsonContainerView::members() const {
+        if (!value_->IsObject()) {
+            throw data_type_error { _("not an object") };
+        }
+
+        return { { *value_, 0 }, { *value_, value_->MemberCount() }, value_->MemberCount() };
+    }
+
+    JsonContainerElements JsonContainerView::elements() const {
+        if (!value_->IsArray()) {
+            throw data_type_error { _("not an array") };
+        }
+
+        return { { *value_, 0 }, { *value_, value_->Size() }, value_->Size() };
+    }
+
+    std::string JsonContainerView::toString() const {
+        return valueToString(*value_);
+    }
+
+    JsonContainerMember JsonContainerMemberIterator::operator*() const {
+        const auto& member = *(object_->MemberBegin() + index_);
+        return { { member.name.GetString(), member.name.GetStringLength() },
+                 JsonContainerView { member.value } };
+    }
+
+    JsonContainerView JsonContainerElementIterator::operator*() const {
+        return JsonContainerView { (*array_)[static_cast<rapidjson::SizeType>(index_)] };
+    }
 
     //
-    // free functions
+    // JsonContainerPath
     //
 
-    std::string valueToString(const json_value& jval) {
-        rapidjson::StringBuffer buffer;
-        rapidjson::Writer<rapidjson::StringBuffer> writer { buffer };
-        jval.Accept(writer);
-        return buffer.GetString();
+    JsonContainerPath::JsonContainerPath(const std::vector<JsonContainerKey>& keys) {
+        steps_.reserve(keys.size());
+
+        for (const auto& key : keys) {
+            steps_.push_back({ key, hashKey(key.data(), key.size()) });
+        }
+    }
+
+    size_t JsonContainerPath::hashKey(const char* key, size_t length) {
+        // FNV-1a
+        uint64_t hash { 14695981039346656037ULL };
+
+        for (size_t i = 0; i < length; i++) {
+            hash ^= static_cast<unsigned char>(key[i]);
+            hash *= 1099511628211ULL;
+        }
+
+        return static_cast<size_t>(hash);
+    }
+
+    //
+    // member index
+    //
+
+    // Key of the member index; refers to the name stored in the
+    // rapidjson value, which outlives the index
+    struct IndexedKey {
+        const char* data;
+        size_t length;
+        size_t hash;
+
+        bool operator==(const IndexedKey& other) const {
+            return length == other.length
+                && std::memcmp(data, other.data, length) == 0;
+        }
+    };
+
+    struct IndexedKeyHash {
+        size_t operator()(const IndexedKey& key) const {
+            return key.hash;
+        }
+    };
+
+    using ObjectIndex = std::unordered_map<IndexedKey, json_value*, IndexedKeyHash>;
+
+    struct JsonContainer::MemberIndex {
+        size_t threshold;
+        std::unordered_map<const json_value*, ObjectIndex> objects;
+        // Guards objects, as const lookups build the indexes; those
+        // already built stay in place, so they're searched unlocked
+        std::mutex mutex;
+
+        explicit MemberIndex(size_t threshold) : threshold(threshold), objects(), mutex() {}
+
+        // Return the index of the specified object, building it if
+        // needed, or nullptr if the object is too small to be indexed
+        const ObjectIndex* lookup(const json_value& jval) {
+            if (jval.MemberCount() < threshold) {
+                return nullptr;
+            }
+
+            std::lock_guard<std::mutex> lock { mutex };
+            auto it = objects.find(&jval);
+
+            if (it != objects.end()) {
+                return &it->second;
+            }
+
+            ObjectIndex& index = objects[&jval];
+            index.reserve(jval.MemberCount());
+
+            for (auto member = jval.MemberBegin(); member != jval.MemberEnd(); ++member) {
+                auto name = member->name.GetString();
+                auto length = member->name.GetStringLength();
+                // emplace keeps the first of duplicated keys, as FindMember
+                index.emplace(IndexedKey { name, length, JsonContainerPath::hashKey(name, length) },
+                              const_cast<json_value*>(&member->value));
+            }
+
+            return &index;
+        }
+    };
+
+    // Hashes of the objects and arrays, see hashCacheKey()
+    struct JsonContainer::HashCache {
+        std::unordered_map<const void*, uint64_t> hashes;
+    };
+
+    // Extent of a piece of JSON text
+    struct TextSpan {
+        size_t offset;
+        size_t length;
+    };
+
+    // Text of the members of the root object, in lazy mode; their values
+    // are null until parsed
+    struct JsonContainer::LazyDocument {
+        std::string text;
+        // Extent of the text of each member value, by member position
+        std::vector<TextSpan> values;
+        std::vector<bool> parsed;
+        size_t unparsed;
+    };
+
+    const size_t JsonContainer::DEFAULT_MEMBER_INDEX_THRESHOLD { 16 };
+
+    // Initial size of the parsing stack of the documents (rapidjson's default)
+    const size_t DOCUMENT_STACK_CAPACITY { 1024 };
+
+    // Allocator shared by the documents: rapidjson's CrtAllocator has no
+    // state, so that a container doesn't need to allocate one of its own
+    json_allocator& sharedAllocator() {
+        static json_allocator allocator {};
+        return allocator;
+    }
+
+    std::shared_ptr<json_document> copyDocument(const json_value& value) {
+        auto document = std::make_shared<json_document>(&sharedAllocator(),
+                                                        DOCUMENT_STACK_CAPACITY,
+                                                        &sharedAllocator());
+        document->CopyFrom(value, document->GetAllocator());
+        return document;
+    }
+
+    //
+    // Lazy parsing
+    //
+
+    // Structural pass of the lazy mode, in the spirit of the first stage
+    // of simdjson: a single pass over the text finds the extent of each
+    // member of the root object, matching brackets and skipping strings
+    // in runs of plain characters, without building any value.
+
+    enum TextClass : unsigned char { PLAIN, QUOTE, BACKSLASH, OPENING, CLOSING, SPACE, DELIMITER };
+
+    struct TextClasses {
+        TextClass classes[256];
+
+        TextClasses() {
+            std::fill(std::begin(classes), std::end(classes), PLAIN);
+            classes[static_cast<unsigned char>('"')] = QUOTE;
+            classes[static_cast<unsigned char>('\\')] = BACKSLASH;
+            classes[static_cast<unsigned char>('{')] = OPENING;
+            classes[static_cast<unsigned char>('[')] = OPENING;
+            classes[static_cast<unsigned char>('}')] = CLOSING;
+            classes[static_cast<unsigned char>(']')] = CLOSING;
+            classes[static_cast<unsigned char>(' ')] = SPACE;
+            classes[static_cast<unsigned char>('\t')] = SPACE;
+            classes[static_cast<unsigned char>('\r')] = SPACE;
+            classes[static_cast<unsigned char>('\n')] = SPACE;
+            classes[static_cast<unsigned char>(',')] = DELIMITER;
+            classes[static_cast<unsigned char>(':')] = DELIMITER;
+        }
+
+        TextClass operator()(char c) const {
+            return classes[static_cast<unsigned char>(c)];
+        }
+    };
+
+    const TextClasses TEXT_CLASSES {};
+
+    [[noreturn]] void invalidJson() {
+        throw data_parse_error { _("invalid json") };
+    }
+
+    const char* skipSpaces(const char* current, const char* end) {
+        while (current < end && TEXT_CLASSES(*current) == SPACE) {
+            ++current;
+        }
+
+        return current;
+    }
+
+    // From an opening quote to past the closing one
+    const char* skipString(const char* current, const char* end) {
+        for (++current; current < end; ++current) {
+            auto text_class = TEXT_CLASSES(*current);
+
+            if (text_class == QUOTE) {
+                return current + 1;
+            }
+
+            if (text_class == BACKSLASH) {
+                ++current;
+            }
+        }
+
+        invalidJson();
+    }
+
+    const char* skipValue(const char* current, const char* end) {
+        if (current == end) {
+            invalidJson();
+        }
+
+        switch (TEXT_CLASSES(*current)) {
+            case QUOTE:
+                return skipString(current, end);
+
+            case OPENING: {
+                // Openings of the enclosing arrays and objects
+                std::string openings {};
+
+                while (current < end) {
+                    switch (TEXT_CLASSES(*current)) {
+                        case QUOTE:
+                            current = skipString(current, end);
+                            continue;
+
+                        case OPENING:
+                            openings.push_back(*current);
+                            break;
+
+                        case CLOSING:
+                            if (openings.back() != (*current == '}' ? '{' : '[')) {
+                                invalidJson();
+                            }
+
+                            openings.pop_back();
+
+                            if (openings.empty()) {
+                                return current + 1;
+                            }
+
+                            break;
+
+                        default:
+                            break;
+                    }
+
+                    ++current;
+                }
+
+                invalidJson();
+            }
+
+            case PLAIN: {
+                // Number, literal; validated when parsed
+                while (current < end && TEXT_CLASSES(*current) == PLAIN) {
+                    ++current;
+                }
+
+                return current;
+            }
+
+            default:
+                invalidJson();
+        }
+    }
+
+    bool isObjectText(const std::string& text) {
+        auto current = skipSpaces(text.data(), text.data() + text.size());
+        return current < text.data() + text.size() && *current == '{';
+    }
+
+    // Find the extent of the keys (with their quotes) and of the values
+    // of the members of the root object.
+    // Throw a data_parse_error in case the structure of the text is not
+    // valid.
+    void scanObjectMembers(const std::string& text,
+                           std::vector<TextSpan>& keys,
+                           std::vector<TextSpan>& values) {
+        auto begin = text.data();
+        auto end = begin + text.size();
+        auto current = skipSpaces(begin, end) + 1;
+
+        current = skipSpaces(current, end);
+
+        if (current < end && *current == '}') {
+            current++;
+        } else {
+            while (true) {
+                if (current == end || *current != '"') {
+                    invalidJson();
+                }
+
+                auto key_end = skipString(current, end);
+                keys.push_back({ static_cast<size_t>(current - begin),
+                                 static_cast<size_t>(key_end - current) });
+
+                current = skipSpaces(key_end, end);
+
+                if (current == end || *current != ':') {
+                    invalidJson();
+                }
+
+                auto value = skipSpaces(current + 1, end);
+                current = skipValue(value, end);
+                values.push_back({ static_cast<size_t>(value - begin),
+                                   static_cast<size_t>(current - value) });
+
+                current = skipSpaces(current, end);
+
+                if (current < end && *current == ',') {
+                    current = skipSpaces(current + 1, end);
+                } else if (current < end && *current == '}') {
+                    current++;
+                    break;
+                } else {
+                    invalidJson();
+                }
+            }
+        }
+
+        if (skipSpaces(current, end) != end) {
+            invalidJson();
+        }
+    }
+
+    // Parse the JSON text of span into value.
+    // Throw a data_parse_error in case it is not valid.
+    void parseSpan(const std::string& text, const TextSpan& span,
+                   json_value& value, json_allocator& allocator) {
+        rapidjson::MemoryStream stream { text.data() + span.offset, span.length };
+        json_document parsed { &allocator, DOCUMENT_STACK_CAPACITY, &sharedAllocator() };
+        parsed.ParseStream<rapidjson::kParseDefaultFlags, rapidjson::UTF8<char>>(stream);
+
+        if (parsed.HasParseError()) {
+            invalidJson();
+        }
+
+        value.Swap(parsed);
+    }
+
+    void parseKey(const std::string& text, const TextSpan& key,
+                  json_value& name, json_allocator& allocator) {
+        auto first = text.data() + key.offset + 1;
+        auto length = key.length - 2;
+
+        if (std::find(first, first + length, '\\') == first + length) {
+            name.SetString(first, static_cast<rapidjson::SizeType>(length), allocator);
+        } else {
+            parseSpan(text, key, name, allocator);
+        }
     }
 
     //
     // public interface
     //
 
-    JsonContainer::JsonContainer() : document_root_ { new json_document() } {
+    JsonContainer::JsonContainer()
+            : document_root_ { std::make_shared<json_document>(&sharedAllocator(),
+                                                               DOCUMENT_STACK_CAPACITY,
+                                                               &sharedAllocator()) },
+              copy_on_write_ { false } {
         document_root_->SetObject();
     }
 
-    JsonContainer::JsonContainer(const std::string& json_text) : JsonContainer() {
+    JsonContainer::JsonContainer(const std::string& json_text, ParseMode mode) : JsonContainer() {
+        if (mode == ParseMode::Lazy && isObjectText(json_text)) {
+            std::unique_ptr<LazyDocument> lazy { new LazyDocument { json_text, {}, {}, 0 } };
+            std::vector<TextSpan> keys {};
+            scanObjectMembers(lazy->text, keys, lazy->values);
+
+            auto& allocator = document_root_->GetAllocator();
+
+            for (const auto& key : keys) {
+                json_value name {};
+                parseKey(lazy->text, key, name, allocator);
+                document_root_->AddMember(name, json_value {}, allocator);
+            }
+
+            if (!keys.empty()) {
+                lazy->parsed.assign(keys.size(), false);
+                lazy->unparsed = keys.size();
+                lazy_ = std::move(lazy);
+            }
+
+            return;
+        }
+
         document_root_->Parse(json_text.data());
 
         if (document_root_->HasParseError()) {
@@ -48,16 +1927,27 @@ namespace leatherman { namespace json_container {
         document_root_->CopyFrom(value, document_root_->GetAllocator());
     }
 
-    JsonContainer::JsonContainer(const JsonContainer& data) : JsonContainer(){
-        document_root_->CopyFrom(*data.document_root_, document_root_->GetAllocator());
+    JsonContainer::JsonContainer(const JsonContainer& data)
+            : document_root_ { data.documentForCopy() },
+              copy_on_write_ { data.copy_on_write_ } {
+        if (data.member_index_) {
+            enableMemberIndex(data.member_index_->threshold);
+        }
+
+        if (data.hash_cache_) {
+            enableHashCache();
+        }
     }
 
-    JsonContainer::JsonContainer(const JsonContainer&& data) : JsonContainer() {
-        document_root_->CopyFrom(*data.document_root_, document_root_->GetAllocator());
+    JsonContainer::JsonContainer(const JsonContainer&& data) : JsonContainer(data) {
     }
 
     JsonContainer& JsonContainer::operator=(JsonContainer other) {
         std::swap(document_root_, other.document_root_);
+        std::swap(member_index_, other.member_index_);
+        std::swap(hash_cache_, other.hash_cache_);
+        std::swap(copy_on_write_, other.copy_on_write_);
+        std::swap(lazy_, other.lazy_);
         return *this;
     }
 
@@ -65,14 +1955,21 @@ namespace leatherman { namespace json_container {
     // either have an empty destructor or use a shared_ptr instead.
     JsonContainer::~JsonContainer() {}
 
+
     // representation
 
     const json_document& JsonContainer::getRaw() const {
-        return *document_root_;
+        return document();
     }
 
     std::string JsonContainer::toString() const {
-        return valueToString(*document_root_);
+        return valueToString(document());
+    }
+
+    std::string JsonContainer::toStringReserved() const {
+        std::string output {};
+        appendValue(document(), output, estimateSize(document()));
+        return output;
     }
 
     std::string JsonContainer::toString(const JsonContainerKey& key) const {
@@ -85,71 +1982,88 @@ namespace leatherman { namespace json_container {
         return valueToString(*jval);
     }
 
-    std::string JsonContainer::toPrettyString(size_t left_padding) const {
-        if (empty()) {
-            switch (type()) {
-                case DataType::Object:
-                    return "{}";
-                case DataType::Array:
-                    return "[]";
-                default:
-                    return "\"\"";
-            }
-        }
+    std::string JsonContainer::toString(const JsonContainerPath& path) const {
+        auto jval = getValueInJson(path);
+        return valueToString(*jval);
+    }
 
-        std::string formatted_data {};
+    void JsonContainer::write(std::ostream& output) const {
+        writeValue(document(), streamSink(output));
+    }
 
-        if (type() == DataType::Object) {
-            for (const auto& key : keys()) {
-                formatted_data += std::string(left_padding, ' ');
-                formatted_data += key + " : ";
-                switch (type(key)) {
-                    case DataType::Object:
-                        // Inner object: add new line, increment padding
-                        formatted_data += "\n";
-                        formatted_data += get<JsonContainer>(key).toPrettyString(
-                                            left_padding + LEFT_PADDING_INCREMENT);
-                        break;
-                    case DataType::Array:
-                        // Array: add raw string, regardless of its items
-                        formatted_data += toString(key);
-                        break;
-                    case DataType::String:
-                        formatted_data += get<std::string>(key);
-                        break;
-                    case DataType::Int:
-                        formatted_data += std::to_string(get<int>(key));
-                        break;
-                    case DataType::Bool:
-                        if (get<bool>(key)) {
-                            formatted_data += "true";
-                        } else {
-                            formatted_data += "false";
-                        }
-                        break;
-                    case DataType::Double:
-                        formatted_data += std::to_string(get<double>(key));
-                        break;
-                    default:
-                        formatted_data += "NULL";
+    void JsonContainer::write(int fd) const {
+        writeValue(document(), fdSink(fd));
+    }
+
+    std::string JsonContainer::toCBOR() const {
+        std::string output {};
+        StringOutputStream stream { output, 0 };
+        putCborValue(document(), stream);
+        stream.Flush();
+        return output;
+    }
+
+    void JsonContainer::writeCBOR(std::ostream& output) const {
+        writeCbor(document(), streamSink(output));
+    }
+
+    void JsonContainer::writeCBOR(int fd) const {
+        writeCbor(document(), fdSink(fd));
+    }
+
+    JsonContainer JsonContainer::fromCBOR(const std::string& cbor) {
+        CborInput input { cbor.data(), cbor.size() };
+        JsonContainer result {};
+        readCbor(input, *result.document_root_);
+        return result;
+    }
+
+    JsonContainer JsonContainer::fromCBOR(int fd) {
+        CborInput input { [fd](char* buffer, size_t size) -> size_t {
+            while (true) {
+#ifdef _WIN32
+                auto count = ::_read(fd, buffer, static_cast<unsigned int>(size));
+#else
+                auto count = ::read(fd, buffer, size);
+#endif
+                if (count >= 0) {
+                    return static_cast<size_t>(count);
+                }
+
+                if (errno != EINTR) {
+                    throw data_error { _("failed to read CBOR input: {1}", std::strerror(errno)) };
                 }
-                formatted_data += "\n";
             }
-        } else {
-            formatted_data += toString();
-        }
+        } };
+        JsonContainer result {};
+        readCbor(input, *result.document_root_);
+        return result;
+    }
 
-        return formatted_data;
+    std::string JsonContainer::toPrettyString(size_t left_padding) const {
+        std::string output {};
+        appendPrettyValue(document(), left_padding, output);
+        return output;
     }
 
     std::string JsonContainer::toPrettyString() const {
         return toPrettyString(DEFAULT_LEFT_PADDING);
     }
 
+    std::string JsonContainer::toIndentedString(size_t indent) const {
+        std::string output {};
+        StringOutputStream stream { output, 0 };
+        rapidjson::PrettyWriter<StringOutputStream> writer { stream };
+        writer.SetIndent(' ', static_cast<unsigned>(indent));
+        document().Accept(writer);
+        stream.Flush();
+        return output;
+    }
+
     // capacity
 
     bool JsonContainer::empty() const {
-        auto jval = getValueInJson();
+        auto jval = rootValue();
         auto data_type = getValueType(*jval);
 
         if (data_type == DataType::Object) {
@@ -162,7 +2076,7 @@ namespace leatherman { namespace json_container {
     }
 
     size_t JsonContainer::size() const {
-        auto jval = getValueInJson();
+        auto jval = rootValue();
         return getSize(*jval);
     }
 
@@ -176,11 +2090,16 @@ namespace leatherman { namespace json_container {
         return getSize(*jval);
     }
 
+    size_t JsonContainer::size(const JsonContainerPath& path) const {
+        auto jval = getValueInJson(path);
+        return getSize(*jval);
+    }
+
     // keys
 
     std::vector<std::string> JsonContainer::keys() const {
         std::vector<std::string> k;
-        auto jval = getValueInJson();
+        auto jval = rootValue();
 
         if (jval->IsObject()) {
             for (json_value::ConstMemberIterator itr = jval->MemberBegin();
@@ -189,39 +2108,139 @@ namespace leatherman { namespace json_container {
             }
         }
 
-        // Return an empty vector if the document type isn't an object
-        return k;
+        // Return an empty vector if the document type isn't an object
+        return k;
+    }
+
+    // iteration
+
+    JsonContainerView JsonContainer::view() const {
+        return JsonContainerView { *getValueInJson() };
+    }
+
+    JsonContainerView JsonContainer::view(const JsonContainerKey& key) const {
+        return JsonContainerView { *getValueInJson({ key }) };
+    }
+
+    JsonContainerView JsonContainer::view(const std::vector<JsonContainerKey>& keys) const {
+        return JsonContainerView { *getValueInJson(keys) };
+    }
+
+    JsonContainerMembers JsonContainer::members() const {
+        return view().members();
+    }
+
+    JsonContainerMembers JsonContainer::members(const JsonContainerKey& key) const {
+        return view(key).members();
+    }
+
+    JsonContainerMembers JsonContainer::members(const std::vector<JsonContainerKey>& keys) const {
+        return view(keys).members();
+    }
+
+    JsonContainerElements JsonContainer::elements() const {
+        return view().elements();
+    }
+
+    JsonContainerElements JsonContainer::elements(const JsonContainerKey& key) const {
+        return view(key).elements();
+    }
+
+    JsonContainerElements JsonContainer::elements(const std::vector<JsonContainerKey>& keys) const {
+        return view(keys).elements();
+    }
+
+    // includes
+
+    bool JsonContainer::includes(const JsonContainerKey& key) const {
+        return lookupMember(*rootValue(), key) != nullptr;
+    }
+
+    bool JsonContainer::includes(const std::vector<JsonContainerKey>& keys) const {
+        return includesIn(keys);
+    }
+
+    bool JsonContainer::includes(const JsonContainerPath& path) const {
+        return includesIn(path.steps());
+    }
+
+    template <typename Keys>
+    bool JsonContainer::includesIn(const Keys& keys) const {
+        auto jval = rootValue();
+
+        for (auto it = keys.begin(); it != keys.end(); ++it) {
+            if (it + 1 == keys.end()) {
+                return lookupMember(*jval, *it) != nullptr;
+            }
+
+            try {
+                jval = findMember(*jval, *it);
+            } catch (const data_parse_error&) {
+                return false;
+            }
+
+            if (jval == nullptr) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    void JsonContainer::enableMemberIndex(size_t threshold) {
+        member_index_.reset(new MemberIndex { threshold });
     }
 
-    // includes
+    void JsonContainer::enableCopyOnWrite() {
+        copy_on_write_ = true;
+    }
 
-    bool JsonContainer::includes(const JsonContainerKey& key) const {
-        auto jval = getValueInJson();
+    void JsonContainer::copyDocumentIfShared() {
+        if (document_root_.use_count() > 1) {
+            document_root_ = copyDocument(*document_root_);
+            // Both refer to the values of the shared document
+            invalidateMemberIndex();
 
-        if (hasKey(*jval, key.data())) {
-            return true;
+            if (hash_cache_) {
+                hash_cache_->hashes.clear();
+            }
         } else {
-            return false;
+            // The other copies may have just released the document, after
+            // reading it on other threads; order those reads before the
+            // modification
+            std::atomic_thread_fence(std::memory_order_acquire);
         }
     }
 
-    bool JsonContainer::includes(const std::vector<JsonContainerKey>& keys) const {
-        auto jval = getValueInJson();
+    // hash
 
-        for (const auto& key : keys) {
-            if (!hasKey(*jval, key.data())) {
-                return false;
-            }
-            jval = getValueInJson(*jval, key.data());
-        }
+    uint64_t JsonContainer::hash() const {
+        return hashValue(document(), hash_cache_ ? &hash_cache_->hashes : nullptr);
+    }
 
-        return true;
+    uint64_t JsonContainer::hash(const JsonContainerKey& key) const {
+        auto jval = getValueInJson({ key });
+        return hashValue(*jval, hash_cache_ ? &hash_cache_->hashes : nullptr);
+    }
+
+    uint64_t JsonContainer::hash(const std::vector<JsonContainerKey>& keys) const {
+        auto jval = getValueInJson(keys);
+        return hashValue(*jval, hash_cache_ ? &hash_cache_->hashes : nullptr);
+    }
+
+    uint64_t JsonContainer::hash(const JsonContainerPath& path) const {
+        auto jval = getValueInJson(path);
+        return hashValue(*jval, hash_cache_ ? &hash_cache_->hashes : nullptr);
+    }
+
+    void JsonContainer::enableHashCache() {
+        hash_cache_.reset(new HashCache {});
     }
 
     // type
 
     DataType JsonContainer::type() const {
-        auto jval = getValueInJson();
+        auto jval = rootValue();
         return getValueType(*jval);
     }
 
@@ -251,6 +2270,95 @@ namespace leatherman { namespace json_container {
         return getValueType(*jval);
     }
 
+    DataType JsonContainer::type(const JsonContainerPath& path) const {
+        auto jval = getValueInJson(path);
+        return getValueType(*jval);
+    }
+
+    DataType JsonContainer::type(const JsonContainerPath& path,
+                                 const size_t idx) const {
+        auto jval = getValueInJson(path, true, idx);
+        return getValueType(*jval);
+    }
+
+    // bulk extraction
+
+    template <typename T>
+    size_t JsonContainer::getArray(const std::vector<JsonContainerKey>& keys,
+                                   T* output, size_t capacity) const {
+        auto jval = getValueInJson(keys);
+        checkArrayCapacity(*jval, capacity);
+
+        for (auto itr = jval->Begin(); itr != jval->End(); ++itr) {
+            if (!ElementType<T>::is(*itr)) {
+                throw data_type_error { ElementType<T>::error() };
+            }
+
+            *output++ = ElementType<T>::get(*itr);
+        }
+
+        return jval->Size();
+    }
+
+    template <typename T>
+    size_t JsonContainer::getColumn(const std::vector<JsonContainerKey>& keys,
+                                    const JsonContainerKey& field,
+                                    T* output, size_t capacity) const {
+        auto jval = getValueInJson(keys);
+        checkArrayCapacity(*jval, capacity);
+        auto hash = JsonContainerPath::hashKey(field.data(), field.size());
+
+        for (auto itr = jval->Begin(); itr != jval->End(); ++itr) {
+            // Throws in case the element is not an object or lacks field
+            auto value = getValueInJson(*itr, field, &hash);
+
+            if (!ElementType<T>::is(*value)) {
+                throw data_type_error { ElementType<T>::error() };
+            }
+
+            *output++ = ElementType<T>::get(*value);
+        }
+
+        return jval->Size();
+    }
+
+#define LEATHERMAN_JSON_BULK_TYPE(T)                                    \
+    template size_t JsonContainer::getArray<T>(                         \
+        const std::vector<JsonContainerKey>&, T*, size_t) const;        \
+    template size_t JsonContainer::getColumn<T>(                        \
+        const std::vector<JsonContainerKey>&, const JsonContainerKey&,  \
+        T*, size_t) const;
+
+    LEATHERMAN_JSON_BULK_TYPE(int)
+    LEATHERMAN_JSON_BULK_TYPE(int64_t)
+    LEATHERMAN_JSON_BULK_TYPE(uint64_t)
+    LEATHERMAN_JSON_BULK_TYPE(double)
+    LEATHERMAN_JSON_BULK_TYPE(bool)
+
+#undef LEATHERMAN_JSON_BULK_TYPE
+
+    // patches
+
+    void JsonContainer::mergePatch(const JsonContainer& patch) {
+        document();
+        unshareDocument();
+        mergePatchValue(*document_root_, patch.document(), document_root_->GetAllocator());
+        invalidateMemberIndex();
+
+        if (hash_cache_) {
+            hash_cache_->hashes.clear();
+        }
+    }
+
+    JsonContainer JsonContainer::diff(const JsonContainer& other) const {
+        JsonContainer result {};
+        auto& ops = *result.document_root_;
+        std::vector<PatchPathToken> path {};
+        ops.SetArray();
+        diffValues(document(), other.document(), path, ops, ops.GetAllocator());
+        return result;
+    }
+
     //
     // Private functions
     //
@@ -267,52 +2375,144 @@ namespace leatherman { namespace json_container {
     }
 
     DataType JsonContainer::getValueType(const json_value& jval) const {
-        switch (jval.GetType()) {
-            case rapidjson::Type::kNullType:
-                return DataType::Null;
-            case rapidjson::Type::kFalseType:
-                return DataType::Bool;
-            case rapidjson::Type::kTrueType:
-                return DataType::Bool;
-            case rapidjson::Type::kObjectType:
-                return DataType::Object;
-            case rapidjson::Type::kArrayType:
-                return DataType::Array;
-            case rapidjson::Type::kStringType:
-                return DataType::String;
-            case rapidjson::Type::kNumberType:
-                if (jval.IsDouble()) {
-                    return DataType::Double;
-                } else {
-                    return DataType::Int;
-                }
-            default:
-                // This is unexpected as for rapidjson docs
-                return DataType::Null;
-        }
+        return valueType(jval);
     }
 
     // Internal key / index manipulation methods
 
-    bool JsonContainer::hasKey(const json_value& jval, const char* key) const {
-        return (jval.IsObject() && jval.HasMember(key));
-    }
-
     bool JsonContainer::isObject(const json_value& jval) const {
         return jval.IsObject();
     }
 
+    json_value* JsonContainer::findMember(const json_value& jval,
+                                          const std::string& key,
+                                          const size_t* hash) const {
+        return parsedMember(jval, lookupMember(jval, key, hash));
+    }
+
+    json_value* JsonContainer::lookupMember(const json_value& jval,
+                                            const std::string& key,
+                                            const size_t* hash) const {
+        if (!jval.IsObject()) {
+            return nullptr;
+        }
+
+        if (member_index_) {
+            auto index = member_index_->lookup(jval);
+
+            if (index != nullptr) {
+                IndexedKey indexed { key.data(), key.size(),
+                                     hash ? *hash : JsonContainerPath::hashKey(key.data(), key.size()) };
+                auto it = index->find(indexed);
+                return it != index->end() ? it->second : nullptr;
+            }
+        }
+
+        // Pass the length, so that rapidjson doesn't have to measure it
+        auto member = jval.FindMember(json_value(rapidjson::StringRef(key.data(), key.size())));
+
+        if (member == jval.MemberEnd()) {
+            return nullptr;
+        }
+
+        return const_cast<json_value*>(&member->value);
+    }
+
+    const json_document& JsonContainer::document() const {
+        if (lazy_) {
+            json_value& root = *document_root_;
+
+            for (auto itr = root.MemberBegin(); lazy_ && itr != root.MemberEnd(); ++itr) {
+                parsedMember(root, &itr->value);
+            }
+        }
+
+        return *document_root_;
+    }
+
+    std::shared_ptr<json_document> JsonContainer::documentForCopy() const {
+        const auto& root = document();
+
+        if (copy_on_write_) {
+            return document_root_;
+        }
+
+        return copyDocument(root);
+    }
+
+    json_value* JsonContainer::rootValue() const {
+        return document_root_.get();
+    }
+
+    json_value* JsonContainer::parsedMember(const json_value& object, json_value* value) const {
+        if (!lazy_ || value == nullptr || &object != document_root_.get()) {
+            return value;
+        }
+
+        // The members are in the order of the text; those added since
+        // follow them
+        auto member = reinterpret_cast<const json_value::Member*>(
+            reinterpret_cast<const char*>(value) - offsetof(json_value::Member, value));
+        auto position = static_cast<size_t>(member - &*object.MemberBegin());
+
+        if (position < lazy_->values.size() && !lazy_->parsed[position]) {
+            parseSpan(lazy_->text, lazy_->values[position], *value,
+                      document_root_->GetAllocator());
+            lazy_->parsed[position] = true;
+
+            if (--lazy_->unparsed == 0) {
+                lazy_.reset();
+            }
+        }
+
+        return value;
+    }
+
+    void JsonContainer::invalidateMemberIndex() {
+        if (member_index_) {
+            member_index_->objects.clear();
+        }
+    }
+
+    void JsonContainer::dropCachedHash(const json_value& jval, bool recursive) {
+        auto key = hashCacheKey(jval);
+
+        if (key == nullptr) {
+            return;
+        }
+
+        hash_cache_->hashes.erase(key);
+
+        // Nested values may be cached on their own, by hash(keys)
+        if (!recursive) {
+            return;
+        }
+
+        if (jval.IsObject()) {
+            for (auto itr = jval.MemberBegin(); itr != jval.MemberEnd(); ++itr) {
+                dropCachedHash(itr->value, true);
+            }
+        } else {
+            for (auto itr = jval.Begin(); itr != jval.End(); ++itr) {
+                dropCachedHash(*itr, true);
+            }
+        }
+    }
+
     json_value* JsonContainer::getValueInJson(const json_value& jval,
-                                                    const char* key) const {
+                                              const std::string& key,
+                                              const size_t* hash) const {
         if (!jval.IsObject()) {
             throw data_type_error { _("not an object") };
         }
 
-        if (!jval.HasMember(key)) {
+        auto member = findMember(jval, key, hash);
+
+        if (member == nullptr) {
             throw data_key_error { _("unknown object entry with key: {1}", key) };
         }
 
-        return const_cast<json_value*>(&jval[key]);
+        return member;
     }
 
     json_value* JsonContainer::getValueInJson(const json_value& jval,
@@ -332,10 +2532,31 @@ namespace leatherman { namespace json_container {
                                               std::vector<JsonContainerKey>::const_iterator end,
                                                     const bool is_array,
                                                     const size_t idx) const {
-        auto jval = dynamic_cast<json_value*>(document_root_.get());
+        // The whole root is needed, unless reaching one of its members
+        json_value* jval = begin == end && !is_array ? const_cast<json_document*>(&document())
+                                                     : document_root_.get();
+
+        for (auto it = begin; it != end; ++it) {
+            jval = getValueInJson(*jval, *it);
+        }
+
+        if (is_array) {
+            jval = getValueInJson(*jval, idx);
+        }
+
+        return jval;
+    }
+
+    json_value* JsonContainer::getValueInJson(std::vector<JsonContainerPath::Step>::const_iterator begin,
+                                              std::vector<JsonContainerPath::Step>::const_iterator end,
+                                              const bool is_array,
+                                              const size_t idx) const {
+        // The whole root is needed, unless reaching one of its members
+        json_value* jval = begin == end && !is_array ? const_cast<json_document*>(&document())
+                                                     : document_root_.get();
 
         for (auto it = begin; it != end; ++it) {
-            jval = getValueInJson(*jval, it->data());
+            jval = getValueInJson(*jval, it->key, &it->hash);
         }
 
         if (is_array) {
@@ -345,65 +2566,46 @@ namespace leatherman { namespace json_container {
         return jval;
     }
 
-    void JsonContainer::createKeyInJson(const char* key,
-                                        json_value& jval) {
-        jval.AddMember(json_value(key, document_root_->GetAllocator()).Move(),
+    json_value* JsonContainer::createKeyInJson(const std::string& key,
+                                               json_value& jval) {
+        jval.AddMember(json_value(key.data(), key.size(), document_root_->GetAllocator()).Move(),
                        json_value(rapidjson::kObjectType).Move(),
                        document_root_->GetAllocator());
+        // Adding a member may relocate the members of the object
+        invalidateMemberIndex();
+        return &(jval.MemberEnd() - 1)->value;
     }
 
     // getValue specialisations
 
     template<>
     int JsonContainer::getValue<>(const json_value& value) const {
-        if (value.IsNull()) {
-            return 0;
-        }
+        return readValue<int>(value);
+    }
 
-        if (!value.IsInt()) {
-            throw data_type_error { _("not an integer") };
-        }
+    template<>
+    int64_t JsonContainer::getValue<>(const json_value& value) const {
+        return readValue<int64_t>(value);
+    }
 
-        return value.GetInt();
+    template<>
+    uint64_t JsonContainer::getValue<>(const json_value& value) const {
+        return readValue<uint64_t>(value);
     }
 
     template<>
     bool JsonContainer::getValue<>(const json_value& value) const {
-        if (value.IsNull()) {
-            return false;
-        }
-
-        if (!value.IsBool()) {
-            throw data_type_error { _("not a boolean") };
-        }
-
-        return value.GetBool();
+        return readValue<bool>(value);
     }
 
     template<>
     std::string JsonContainer::getValue<>(const json_value& value) const {
-        if (value.IsNull()) {
-            return "";
-        }
-
-        if (!value.IsString()) {
-            throw data_type_error { _("not a string") };
-        }
-
-        return std::string(value.GetString(), value.GetStringLength());
+        return readValue<std::string>(value);
     }
 
     template<>
     double JsonContainer::getValue<>(const json_value& value) const {
-        if (value.IsNull()) {
-            return 0.0;
-        }
-
-        if (!value.IsDouble()) {
-            throw data_type_error { _("not a double") };
-        }
-
-        return value.GetDouble();
+        return readValue<double>(value);
     }
 
     template<>
@@ -439,6 +2641,8 @@ namespace leatherman { namespace json_container {
             throw data_type_error { _("not an array") };
         }
 
+        tmp.reserve(value.Size());
+
         for (json_value::ConstValueIterator itr = value.Begin();
              itr != value.End();
              itr++) {
@@ -464,6 +2668,8 @@ namespace leatherman { namespace json_container {
             throw data_type_error { _("not an array") };
         }
 
+        tmp.reserve(value.Size());
+
         for (json_value::ConstValueIterator itr = value.Begin();
              itr != value.End();
              itr++) {
@@ -489,6 +2695,8 @@ namespace leatherman { namespace json_container {
             throw data_type_error { _("not an array") };
         }
 
+        tmp.reserve(value.Size());
+
         for (json_value::ConstValueIterator itr = value.Begin();
              itr != value.End();
              itr++) {
@@ -502,6 +2710,60 @@ namespace leatherman { namespace json_container {
         return tmp;
     }
 
+    template<>
+    std::vector<int64_t> JsonContainer::getValue<>(const json_value& value) const {
+        std::vector<int64_t> tmp {};
+
+        if (value.IsNull()) {
+            return tmp;
+        }
+
+        if (!value.IsArray()) {
+            throw data_type_error { _("not an array") };
+        }
+
+        tmp.reserve(value.Size());
+
+        for (json_value::ConstValueIterator itr = value.Begin();
+             itr != value.End();
+             itr++) {
+            if (!itr->IsInt64()) {
+                throw data_type_error { _("not a 64-bit integer") };
+            }
+
+            tmp.push_back(itr->GetInt64());
+        }
+
+        return tmp;
+    }
+
+    template<>
+    std::vector<uint64_t> JsonContainer::getValue<>(const json_value& value) const {
+        std::vector<uint64_t> tmp {};
+
+        if (value.IsNull()) {
+            return tmp;
+        }
+
+        if (!value.IsArray()) {
+            throw data_type_error { _("not an array") };
+        }
+
+        tmp.reserve(value.Size());
+
+        for (json_value::ConstValueIterator itr = value.Begin();
+             itr != value.End();
+             itr++) {
+            if (!itr->IsUint64()) {
+                throw data_type_error { _("not an unsigned 64-bit integer") };
+            }
+
+            tmp.push_back(itr->GetUint64());
+        }
+
+        return tmp;
+    }
+
     template<>
     std::vector<double> JsonContainer::getValue<>(const json_value& value) const {
         std::vector<double> tmp {};
@@ -514,6 +2776,8 @@ namespace leatherman { namespace json_container {
             throw data_type_error { _("not an array") };
         }
 
+        tmp.reserve(value.Size());
+
         for (json_value::ConstValueIterator itr = value.Begin();
              itr != value.End();
              itr++) {
@@ -539,6 +2803,8 @@ namespace leatherman { namespace json_container {
             throw data_type_error { _("not an array") };
         }
 
+        tmp.reserve(value.Size());
+
         for (json_value::ConstValueIterator itr = value.Begin();
              itr != value.End();
              itr++) {
@@ -577,6 +2843,16 @@ namespace leatherman { namespace json_container {
         jval.SetString(new_value, std::string(new_value).size(), document_root_->GetAllocator());
     }
 
+    template<>
+    void JsonContainer::setValue<>(json_value& jval, int64_t new_value) {
+        jval.SetInt64(new_value);
+    }
+
+    template<>
+    void JsonContainer::setValue<>(json_value& jval, uint64_t new_value) {
+        jval.SetUint64(new_value);
+    }
+
     template<>
     void JsonContainer::setValue<>(json_value& jval, double new_value) {
         jval.SetDouble(new_value);
@@ -616,6 +2892,28 @@ namespace leatherman { namespace json_container {
         }
     }
 
+    template<>
+    void JsonContainer::setValue<>(json_value& jval, std::vector<int64_t> new_value ) {
+        jval.SetArray();
+
+        for (const auto& value : new_value) {
+            json_value tmp_val;
+            tmp_val.SetInt64(value);
+            jval.PushBack(tmp_val, document_root_->GetAllocator());
+        }
+    }
+
+    template<>
+    void JsonContainer::setValue<>(json_value& jval, std::vector<uint64_t> new_value ) {
+        jval.SetArray();
+
+        for (const auto& value : new_value) {
+            json_value tmp_val;
+            tmp_val.SetUint64(value);
+            jval.PushBack(tmp_val, document_root_->GetAllocator());
+        }
+    }
+
     template<>
     void JsonContainer::setValue<>(json_value& jval, std::vector<double> new_value ) {
         jval.SetArray();
@@ -633,7 +2931,7 @@ namespace leatherman { namespace json_container {
 
         for (auto value : new_value) {
             json_document tmp_value;
-            tmp_value.CopyFrom(*value.document_root_, document_root_->GetAllocator());
+            tmp_value.CopyFrom(value.document(), document_root_->GetAllocator());
             jval.PushBack(tmp_value, document_root_->GetAllocator());
         }
     }
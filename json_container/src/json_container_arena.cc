@@ -0,0 +1,366 @@
+#include <leatherman/json_container/json_container_arena.hpp>
+#include <leatherman/locale/locale.hpp>
+
+#include <rapidjson/document.h>
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+// Mark string for translation (alias for leatherman::locale::format)
+using leatherman::locale::_;
+
+namespace leatherman { namespace json_container {
+
+    using json_arena_document = rapidjson::GenericDocument<rapidjson::UTF8<char>,
+                                                           json_arena_allocator,
+                                                           json_allocator>;
+
+    const size_t JsonContainerArena::DEFAULT_BLOCK_SIZE { 64 * 1024 };
+
+    // Initial size of the parsing stack (rapidjson's default)
+    const size_t ARENA_STACK_CAPACITY { 1024 };
+
+    //
+    // JsonArenaContainer; type() and toString() are in json_container.cc,
+    // as they share the helpers of JsonContainer
+    //
+
+    bool JsonArenaContainer::empty() const {
+        return size() == 0;
+    }
+
+    size_t JsonArenaContainer::size() const {
+        if (value_->IsObject()) {
+            return value_->MemberCount();
+        }
+
+        if (value_->IsArray()) {
+            return value_->Size();
+        }
+
+        return 0;
+    }
+
+    bool JsonArenaContainer::includes(const JsonContainerKey& key) const {
+        return includes(std::vector<JsonContainerKey> { key });
+    }
+
+    bool JsonArenaContainer::includes(const std::vector<JsonContainerKey>& keys) const {
+        const json_arena_value* jval = value_;
+
+        for (const auto& key : keys) {
+            if (!jval->IsObject()) {
+                return false;
+            }
+
+            auto member = jval->FindMember(json_arena_value(rapidjson::StringRef(key.data(), key.size())));
+
+            if (member == jval->MemberEnd()) {
+                return false;
+            }
+
+            jval = &member->value;
+        }
+
+        return true;
+    }
+
+    JsonContainer JsonArenaContainer::toContainer() const {
+        JsonContainer container {};
+        auto& document = *container.document_root_;
+        document.CopyFrom(*value_, document.GetAllocator());
+        return container;
+    }
+
+    const json_arena_value& JsonArenaContainer::getValueIn(const std::vector<JsonContainerKey>& keys) const {
+        const json_arena_value* jval = value_;
+
+        for (const auto& key : keys) {
+            if (!jval->IsObject()) {
+                throw data_type_error { _("not an object") };
+            }
+
+            auto member = jval->FindMember(json_arena_value(rapidjson::StringRef(key.data(), key.size())));
+
+            if (member == jval->MemberEnd()) {
+                throw data_key_error { _("unknown object entry with key: {1}", key) };
+            }
+
+            jval = &member->value;
+        }
+
+        return *jval;
+    }
+
+    json_arena_value& JsonArenaContainer::createValueIn(const std::vector<JsonContainerKey>& keys) {
+        json_arena_value* jval = value_;
+
+        for (const auto& key : keys) {
+            if (!jval->IsObject()) {
+                throw data_key_error { _("invalid key supplied; cannot navigate the provided path") };
+            }
+
+            auto member = jval->FindMember(json_arena_value(rapidjson::StringRef(key.data(), key.size())));
+
+            if (member == jval->MemberEnd()) {
+                jval->AddMember(json_arena_value(key.data(), key.size(), *allocator_).Move(),
+                                json_arena_value(rapidjson::kObjectType).Move(),
+                                *allocator_);
+                jval = &(jval->MemberEnd() - 1)->value;
+            } else {
+                jval = &member->value;
+            }
+        }
+
+        return *jval;
+    }
+
+    // getValue specialisations
+
+    template<>
+    int JsonArenaContainer::getValue<>(const json_arena_value& value) const {
+        if (value.IsNull()) {
+            return 0;
+        }
+
+        if (!value.IsInt()) {
+            throw data_type_error { _("not an integer") };
+        }
+
+        return value.GetInt();
+    }
+
+    template<>
+    int64_t JsonArenaContainer::getValue<>(const json_arena_value& value) const {
+        if (value.IsNull()) {
+            return 0;
+        }
+
+        if (!value.IsInt64()) {
+            throw data_type_error { _("not a 64-bit integer") };
+        }
+
+        return value.GetInt64();
+    }
+
+    template<>
+    uint64_t JsonArenaContainer::getValue<>(const json_arena_value& value) const {
+        if (value.IsNull()) {
+            return 0;
+        }
+
+        if (!value.IsUint64()) {
+            throw data_type_error { _("not an unsigned 64-bit integer") };
+        }
+
+        return value.GetUint64();
+    }
+
+    template<>
+    bool JsonArenaContainer::getValue<>(const json_arena_value& value) const {
+        if (value.IsNull()) {
+            return false;
+        }
+
+        if (!value.IsBool()) {
+            throw data_type_error { _("not a boolean") };
+        }
+
+        return value.GetBool();
+    }
+
+    template<>
+    std::string JsonArenaContainer::getValue<>(const json_arena_value& value) const {
+        if (value.IsNull()) {
+            return "";
+        }
+
+        if (!value.IsString()) {
+            throw data_type_error { _("not a string") };
+        }
+
+        return std::string(value.GetString(), value.GetStringLength());
+    }
+
+    template<>
+    double JsonArenaContainer::getValue<>(const json_arena_value& value) const {
+        if (value.IsNull()) {
+            return 0.0;
+        }
+
+        if (!value.IsDouble()) {
+            throw data_type_error { _("not a double") };
+        }
+
+        return value.GetDouble();
+    }
+
+    template<>
+    std::vector<std::string> JsonArenaContainer::getValue<>(const json_arena_value& value) const {
+        std::vector<std::string> result {};
+
+        if (value.IsNull()) {
+            return result;
+        }
+
+        if (!value.IsArray()) {
+            throw data_type_error { _("not an array") };
+        }
+
+        result.reserve(value.Size());
+
+        for (auto itr = value.Begin(); itr != value.End(); itr++) {
+            result.push_back(getValue<std::string>(*itr));
+        }
+
+        return result;
+    }
+
+    template<>
+    std::vector<int> JsonArenaContainer::getValue<>(const json_arena_value& value) const {
+        std::vector<int> result {};
+
+        if (value.IsNull()) {
+            return result;
+        }
+
+        if (!value.IsArray()) {
+            throw data_type_error { _("not an array") };
+        }
+
+        result.reserve(value.Size());
+
+        for (auto itr = value.Begin(); itr != value.End(); itr++) {
+            result.push_back(getValue<int>(*itr));
+        }
+
+        return result;
+    }
+
+    template<>
+    JsonContainer JsonArenaContainer::getValue<>(const json_arena_value& value) const {
+        if (value.IsNull()) {
+            return JsonContainer {};
+        }
+
+        return JsonArenaContainer { const_cast<json_arena_value*>(&value), allocator_ }.toContainer();
+    }
+
+    // setValue specialisations
+
+    template<>
+    void JsonArenaContainer::setValue<>(json_arena_value& jval, bool new_value) {
+        jval.SetBool(new_value);
+    }
+
+    template<>
+    void JsonArenaContainer::setValue<>(json_arena_value& jval, int new_value) {
+        jval.SetInt(new_value);
+    }
+
+    template<>
+    void JsonArenaContainer::setValue<>(json_arena_value& jval, int64_t new_value) {
+        jval.SetInt64(new_value);
+    }
+
+    template<>
+    void JsonArenaContainer::setValue<>(json_arena_value& jval, uint64_t new_value) {
+        jval.SetUint64(new_value);
+    }
+
+    template<>
+    void JsonArenaContainer::setValue<>(json_arena_value& jval, double new_value) {
+        jval.SetDouble(new_value);
+    }
+
+    template<>
+    void JsonArenaContainer::setValue<>(json_arena_value& jval, std::string new_value) {
+        jval.SetString(new_value.data(), new_value.size(), *allocator_);
+    }
+
+    template<>
+    void JsonArenaContainer::setValue<>(json_arena_value& jval, const char* new_value) {
+        jval.SetString(new_value, std::strlen(new_value), *allocator_);
+    }
+
+    template<>
+    void JsonArenaContainer::setValue<>(json_arena_value& jval, std::vector<std::string> new_value) {
+        jval.SetArray();
+        jval.Reserve(new_value.size(), *allocator_);
+
+        for (const auto& value : new_value) {
+            jval.PushBack(json_arena_value(value.data(), value.size(), *allocator_).Move(), *allocator_);
+        }
+    }
+
+    template<>
+    void JsonArenaContainer::setValue<>(json_arena_value& jval, std::vector<int> new_value) {
+        jval.SetArray();
+        jval.Reserve(new_value.size(), *allocator_);
+
+        for (auto value : new_value) {
+            jval.PushBack(json_arena_value(value).Move(), *allocator_);
+        }
+    }
+
+    template<>
+    void JsonArenaContainer::setValue<>(json_arena_value& jval, JsonContainer new_value) {
+        jval.CopyFrom(new_value.getRaw(), *allocator_);
+    }
+
+    //
+    // JsonContainerArena
+    //
+
+    JsonContainerArena::JsonContainerArena(size_t block_size)
+            : allocator_(new json_arena_allocator(std::max(block_size, size_t { 1024 }))),
+              containers_() {
+    }
+
+    // The values don't need to be freed: the blocks are released at once
+    JsonContainerArena::~JsonContainerArena() {}
+
+    JsonArenaContainer& JsonContainerArena::create() {
+        auto& container = createContainer();
+        container.value_->SetObject();
+        return container;
+    }
+
+    JsonArenaContainer& JsonContainerArena::create(const std::string& json_txt) {
+        json_allocator stack_allocator {};
+        json_arena_document document { allocator_.get(), ARENA_STACK_CAPACITY, &stack_allocator };
+        document.Parse(json_txt.data());
+
+        if (document.HasParseError()) {
+            // The values parsed keep their space until the arena is cleared
+            throw data_parse_error { _("invalid json") };
+        }
+
+        auto& container = createContainer();
+        container.value_->Swap(document);
+        return container;
+    }
+
+    size_t JsonContainerArena::size() const {
+        return containers_.size();
+    }
+
+    size_t JsonContainerArena::reserved() const {
+        return allocator_->Capacity();
+    }
+
+    void JsonContainerArena::clear() {
+        containers_.clear();
+        allocator_->Clear();
+    }
+
+    JsonArenaContainer& JsonContainerArena::createContainer() {
+        auto value = new (allocator_->Malloc(sizeof(json_arena_value))) json_arena_value {};
+        auto container = new (allocator_->Malloc(sizeof(JsonArenaContainer)))
+            JsonArenaContainer { value, allocator_.get() };
+        containers_.push_back(container);
+        return *container;
+    }
+
+}}  // namespace leatherman::json_container
@@ -0,0 +1,519 @@
+#include <leatherman/json_container/json_reader.hpp>
+#include <leatherman/locale/locale.hpp>
+
+#include <rapidjson/document.h>
+#include <rapidjson/reader.h>
+#include <rapidjson/error/en.h>
+
+#include <cerrno>
+#include <cstring>
+#include <istream>
+#include <limits>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+// Mark string for translation (alias for leatherman::locale::format)
+using leatherman::locale::_;
+
+namespace leatherman { namespace json_container {
+
+    const size_t JsonReader::DEFAULT_BUFFER_SIZE { 64 * 1024 };
+
+    namespace {
+
+    //
+    // ChunkStream
+    //
+
+    // RapidJSON read-only stream pulling the input from a
+    // JsonChunkSource through a fixed size buffer. Unlike
+    // rapidjson::FileReadStream, a short read is not taken as the end
+    // of the input, so that pipes and sockets can be consumed.
+    class ChunkStream {
+    public:
+        typedef char Ch;
+
+        ChunkStream(JsonChunkSource& source, size_t buffer_size)
+                : source_(source),
+                  buffer_(buffer_size > 0 ? buffer_size : 1),
+                  current_(buffer_.data()),
+                  end_(buffer_.data()),
+                  consumed_(0) {
+            fill();
+        }
+
+        Ch Peek() const {
+            return current_ != end_ ? *current_ : '\0';
+        }
+
+        Ch Take() {
+            if (current_ == end_) {
+                return '\0';
+            }
+
+            Ch c = *current_++;
+
+            if (current_ == end_) {
+                fill();
+            }
+
+            return c;
+        }
+
+        size_t Tell() const {
+            return consumed_ + static_cast<size_t>(current_ - buffer_.data());
+        }
+
+        // Not implemented; only needed for in situ parsing
+        void Put(Ch) { RAPIDJSON_ASSERT(false); }
+        void Flush() { RAPIDJSON_ASSERT(false); }
+        Ch* PutBegin() { RAPIDJSON_ASSERT(false); return 0; }
+        size_t PutEnd(Ch*) { RAPIDJSON_ASSERT(false); return 0; }
+
+    private:
+        JsonChunkSource& source_;
+        std::vector<Ch> buffer_;
+        Ch* current_;
+        Ch* end_;
+        size_t consumed_;
+
+        void fill() {
+            consumed_ += static_cast<size_t>(end_ - buffer_.data());
+            auto count = source_(buffer_.data(), buffer_.size());
+            current_ = buffer_.data();
+            end_ = buffer_.data() + (count < buffer_.size() ? count : buffer_.size());
+        }
+    };
+
+    }  // namespace
+
+    //
+    // FilteringHandler
+    //
+
+    // RapidJSON SAX handler that keeps track of the position of the
+    // current value and forwards to a JsonHandler only the events of
+    // the subtrees selected by the JsonReader filters. Each frame
+    // holds the filters still matching the path of an enclosing
+    // container, so every event is compared against a single token.
+    class JsonReader::FilteringHandler {
+    public:
+        FilteringHandler(const JsonReader& reader, JsonHandler& handler)
+                : filters_(reader.filters_),
+                  handler_(handler),
+                  frames_(),
+                  root_candidates_(),
+                  matched_(reader.filters_.size(), false),
+                  matched_count_(0),
+                  has_wildcards_(false),
+                  skip_depth_(0),
+                  match_depth_(0),
+                  done_(false),
+                  stopped_(false) {
+            for (size_t i = 0; i < filters_.size(); i++) {
+                root_candidates_.push_back(i);
+
+                for (const auto& token : filters_[i]) {
+                    has_wildcards_ = has_wildcards_ || token.wildcard;
+                }
+            }
+        }
+
+        // Whether parsing was interrupted because all filters were
+        // matched (as opposed to being stopped by the JsonHandler)
+        bool done() const { return done_; }
+
+        bool stopped() const { return stopped_; }
+
+        bool Null() {
+            return scalar([this] { return handler_.null(); });
+        }
+
+        bool Bool(bool b) {
+            return scalar([this, b] { return handler_.boolean(b); });
+        }
+
+        bool Int(int i) {
+            return scalar([this, i] { return handler_.integer(i); });
+        }
+
+        bool Uint(unsigned u) {
+            return scalar([this, u] { return handler_.integer(u); });
+        }
+
+        bool Int64(int64_t i) {
+            return scalar([this, i] { return handler_.integer(i); });
+        }
+
+        bool Uint64(uint64_t u) {
+            if (u > static_cast<uint64_t>(std::numeric_limits<int64_t>::max())) {
+                return scalar([this, u] { return handler_.unsignedInteger(u); });
+            }
+
+            return scalar([this, u] { return handler_.integer(static_cast<int64_t>(u)); });
+        }
+
+        bool Double(double d) {
+            return scalar([this, d] { return handler_.real(d); });
+        }
+
+        bool String(const char* str, rapidjson::SizeType length, bool) {
+            return scalar([this, str, length] { return handler_.string(str, length); });
+        }
+
+        bool StartObject() {
+            return startContainer(false);
+        }
+
+        bool Key(const char* str, rapidjson::SizeType length, bool) {
+            if (skip_depth_ > 0) {
+                return true;
+            }
+
+            if (match_depth_ > 0) {
+                return forward(handler_.key(str, length));
+            }
+
+            frames_.back().key.assign(str, length);
+            return true;
+        }
+
+        bool EndObject(rapidjson::SizeType member_count) {
+            return endContainer([this, member_count] {
+                return handler_.endObject(member_count);
+            });
+        }
+
+        bool StartArray() {
+            return startContainer(true);
+        }
+
+        bool EndArray(rapidjson::SizeType element_count) {
+            return endContainer([this, element_count] {
+                return handler_.endArray(element_count);
+            });
+        }
+
+    private:
+        enum class Selection { Match, Descend, Skip };
+
+        struct Frame {
+            bool is_array;
+            size_t index;
+            std::string key;
+            std::vector<size_t> candidates;
+        };
+
+        const std::vector<std::vector<JsonReader::Token>>& filters_;
+        JsonHandler& handler_;
+        std::vector<Frame> frames_;
+        std::vector<size_t> root_candidates_;
+        std::vector<bool> matched_;
+        size_t matched_count_;
+        bool has_wildcards_;
+        size_t skip_depth_;
+        size_t match_depth_;
+        bool done_;
+        bool stopped_;
+
+        bool forward(bool result) {
+            stopped_ = stopped_ || !result;
+            return result;
+        }
+
+        bool tokenMatches(const JsonReader::Token& token, const Frame& frame) const {
+            if (token.wildcard) {
+                return true;
+            }
+
+            if (frame.is_array) {
+                return token.is_index && token.index == frame.index;
+            }
+
+            return token.name == frame.key;
+        }
+
+        // Compare the path of the value about to start against the
+        // filters; candidates receives the filters for which the path
+        // is a proper prefix.
+        Selection select(std::vector<size_t>& candidates) {
+            if (filters_.empty()) {
+                return Selection::Match;
+            }
+
+            const auto& parent_candidates = frames_.empty() ? root_candidates_
+                                                            : frames_.back().candidates;
+            auto depth = frames_.size();
+            bool is_match = false;
+
+            for (auto i : parent_candidates) {
+                const auto& tokens = filters_[i];
+
+                if (depth > 0 && !tokenMatches(tokens[depth - 1], frames_.back())) {
+                    continue;
+                }
+
+                if (tokens.size() == depth) {
+                    is_match = true;
+
+                    if (!matched_[i]) {
+                        matched_[i] = true;
+                        matched_count_++;
+                    }
+                } else {
+                    candidates.push_back(i);
+                }
+            }
+
+            if (is_match) {
+                return Selection::Match;
+            }
+
+            return candidates.empty() ? Selection::Skip : Selection::Descend;
+        }
+
+        std::string pointer() const {
+            std::string result {};
+
+            for (const auto& frame : frames_) {
+                result += '/';
+
+                if (frame.is_array) {
+                    result += std::to_string(frame.index);
+                    continue;
+                }
+
+                for (auto c : frame.key) {
+                    if (c == '~') {
+                        result += "~0";
+                    } else if (c == '/') {
+                        result += "~1";
+                    } else {
+                        result += c;
+                    }
+                }
+            }
+
+            return result;
+        }
+
+        bool notifyMatch() {
+            if (filters_.empty()) {
+                return true;
+            }
+
+            return forward(handler_.match(pointer()));
+        }
+
+        // Called once a value at the level of the innermost tracked
+        // frame has been entirely processed.
+        bool advance(bool was_match) {
+            if (!frames_.empty() && frames_.back().is_array) {
+                frames_.back().index++;
+            }
+
+            if (was_match && !has_wildcards_ && !filters_.empty()
+                    && matched_count_ == filters_.size()) {
+                done_ = true;
+                return false;
+            }
+
+            return true;
+        }
+
+        template <typename Event>
+        bool scalar(Event event) {
+            if (skip_depth_ > 0) {
+                return true;
+            }
+
+            if (match_depth_ > 0) {
+                return forward(event());
+            }
+
+            std::vector<size_t> candidates {};
+
+            if (select(candidates) == Selection::Match) {
+                if (!notifyMatch() || !forward(event())) {
+                    return false;
+                }
+
+                return advance(true);
+            }
+
+            return advance(false);
+        }
+
+        bool startContainer(bool is_array) {
+            if (skip_depth_ > 0) {
+                skip_depth_++;
+                return true;
+            }
+
+            if (match_depth_ > 0) {
+                match_depth_++;
+                return forward(is_array ? handler_.startArray() : handler_.startObject());
+            }
+
+            std::vector<size_t> candidates {};
+
+            switch (select(candidates)) {
+                case Selection::Match:
+                    match_depth_ = 1;
+
+                    if (!notifyMatch()) {
+                        return false;
+                    }
+
+                    return forward(is_array ? handler_.startArray() : handler_.startObject());
+                case Selection::Descend:
+                    frames_.push_back(Frame { is_array, 0, std::string {}, std::move(candidates) });
+                    return true;
+                default:
+                    skip_depth_ = 1;
+                    return true;
+            }
+        }
+
+        template <typename Event>
+        bool endContainer(Event event) {
+            if (skip_depth_ > 0) {
+                return --skip_depth_ > 0 || advance(false);
+            }
+
+            if (match_depth_ > 0) {
+                if (!forward(event())) {
+                    return false;
+                }
+
+                return --match_depth_ > 0 || advance(true);
+            }
+
+            frames_.pop_back();
+            return advance(false);
+        }
+    };
+
+    //
+    // JsonReader
+    //
+
+    template <typename Stream>
+    bool JsonReader::parseStream(Stream& stream, JsonHandler& handler) const {
+        FilteringHandler filtering_handler { *this, handler };
+        rapidjson::Reader rapidjson_reader {};
+        auto result = rapidjson_reader.Parse(stream, filtering_handler);
+
+        if (filtering_handler.done()) {
+            return true;
+        }
+
+        if (filtering_handler.stopped()) {
+            return false;
+        }
+
+        if (result.IsError()) {
+            throw data_parse_error { _("invalid json at offset {1}: {2}",
+                                       result.Offset(),
+                                       rapidjson::GetParseError_En(result.Code())) };
+        }
+
+        return true;
+    }
+
+    JsonReader::JsonReader(size_t buffer_size)
+            : buffer_size_ { buffer_size },
+              filters_ {} {
+    }
+
+    void JsonReader::addFilter(const std::string& pointer) {
+        if (!pointer.empty() && pointer[0] != '/') {
+            throw data_parse_error { _("invalid JSON pointer: {1}", pointer) };
+        }
+
+        std::vector<Token> tokens {};
+        size_t pos = 0;
+
+        while (pos < pointer.size()) {
+            auto next = pointer.find('/', pos + 1);
+            auto raw = pointer.substr(pos + 1, next == std::string::npos ? std::string::npos
+                                                                        : next - pos - 1);
+            Token token { "", raw == "*", false, 0 };
+
+            for (size_t i = 0; i < raw.size(); i++) {
+                if (raw[i] != '~') {
+                    token.name += raw[i];
+                } else if (i + 1 < raw.size() && raw[i + 1] == '0') {
+                    token.name += '~';
+                    i++;
+                } else if (i + 1 < raw.size() && raw[i + 1] == '1') {
+                    token.name += '/';
+                    i++;
+                } else {
+                    throw data_parse_error { _("invalid JSON pointer: {1}", pointer) };
+                }
+            }
+
+            // Array indexes are non-empty sequences of digits without
+            // leading zeros
+            if (!token.name.empty()
+                    && token.name.find_first_not_of("0123456789") == std::string::npos
+                    && (token.name.size() == 1 || token.name[0] != '0')) {
+                token.is_index = true;
+                token.index = std::stoul(token.name);
+            }
+
+            tokens.push_back(std::move(token));
+            pos = next == std::string::npos ? pointer.size() : next;
+        }
+
+        filters_.push_back(std::move(tokens));
+    }
+
+    bool JsonReader::parse(const std::string& json_txt, JsonHandler& handler) const {
+        rapidjson::StringStream stream { json_txt.data() };
+        return parseStream(stream, handler);
+    }
+
+    bool JsonReader::parse(std::istream& input, JsonHandler& handler) const {
+        return parse([&input](char* buffer, size_t size) -> size_t {
+            input.read(buffer, size);
+            return static_cast<size_t>(input.gcount());
+        }, handler);
+    }
+
+    bool JsonReader::parse(int fd, JsonHandler& handler) const {
+        return parse([fd](char* buffer, size_t size) -> size_t {
+            while (true) {
+#ifdef _WIN32
+                auto count = ::_read(fd, buffer, static_cast<unsigned int>(size));
+#else
+                auto count = ::read(fd, buffer, size);
+#endif
+                if (count >= 0) {
+                    return static_cast<size_t>(count);
+                }
+
+                if (errno != EINTR) {
+                    throw data_error { _("failed to read JSON input: {1}", std::strerror(errno)) };
+                }
+            }
+        }, handler);
+    }
+
+    bool JsonReader::parse(JsonChunkSource source, JsonHandler& handler) const {
+        ChunkStream stream { source, buffer_size_ };
+        return parseStream(stream, handler);
+    }
+
+    bool JsonReader::parse(const JsonContainer& document, JsonHandler& handler) const {
+        FilteringHandler filtering_handler { *this, handler };
+        document.getRaw().Accept(filtering_handler);
+        return !filtering_handler.stopped();
+    }
+
+}}  // namespace leatherman::json_container
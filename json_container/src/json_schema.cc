@@ -0,0 +1,523 @@
+#include <leatherman/json_container/json_schema.hpp>
+#include <leatherman/locale/locale.hpp>
+
+#include <rapidjson/document.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+// Mark string for translation (alias for leatherman::locale::format)
+using leatherman::locale::_;
+
+namespace leatherman { namespace json_container {
+
+    const size_t JsonSchema::NONE { std::numeric_limits<size_t>::max() };
+
+    static const struct {
+        const char* name;
+        unsigned mask;
+    } TYPE_NAMES[] = {
+        { "null", 1 << 0 },
+        { "boolean", 1 << 1 },
+        { "integer", 1 << 2 },
+        { "number", 1 << 3 },
+        { "string", 1 << 4 },
+        { "array", 1 << 5 },
+        { "object", 1 << 6 },
+    };
+
+    static std::string typeNames(unsigned types) {
+        std::string names {};
+
+        for (const auto& type : TYPE_NAMES) {
+            if (types & type.mask) {
+                names += (names.empty() ? "" : ", ");
+                names += type.name;
+            }
+        }
+
+        return names;
+    }
+
+    static std::string escapePointerToken(const std::string& token) {
+        std::string escaped {};
+
+        for (auto c : token) {
+            if (c == '~') {
+                escaped += "~0";
+            } else if (c == '/') {
+                escaped += "~1";
+            } else {
+                escaped += c;
+            }
+        }
+
+        return escaped;
+    }
+
+    //
+    // JsonSchema::Number
+    //
+
+    JsonSchema::Number JsonSchema::Number::of(int64_t value) {
+        // Negate in unsigned arithmetic, as -INT64_MIN overflows
+        auto magnitude = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+        return { static_cast<double>(value), true, value < 0, magnitude };
+    }
+
+    JsonSchema::Number JsonSchema::Number::of(uint64_t value) {
+        return { static_cast<double>(value), true, false, value };
+    }
+
+    JsonSchema::Number JsonSchema::Number::of(double value) {
+        // Doubles of at least 2^64 have no exact integer equivalent
+        auto magnitude = std::fabs(value);
+
+        if (std::trunc(value) != value || magnitude >= 18446744073709551616.0) {
+            return { value, false, false, 0 };
+        }
+
+        return { value, true, value < 0, static_cast<uint64_t>(magnitude) };
+    }
+
+    bool JsonSchema::Number::operator==(const Number& other) const {
+        if (integral || other.integral) {
+            return integral && other.integral && negative == other.negative && magnitude == other.magnitude;
+        }
+
+        return value == other.value;
+    }
+
+    //
+    // JsonSchema
+    //
+
+    JsonSchema::JsonSchema(const JsonContainer& schema)
+            : nodes_(),
+              properties_(),
+              enum_values_() {
+        compile(schema.view(), "");
+    }
+
+    size_t JsonSchema::compile(const JsonContainerView& schema, const std::string& pointer) {
+        if (schema.type() != DataType::Object) {
+            throw data_parse_error { _("invalid JSON schema at '{1}': expected an object", pointer) };
+        }
+
+        auto index = nodes_.size();
+        nodes_.push_back({ ANY_TYPE, 0, 0, false, false, 0.0, 0.0,
+                           0, NONE, 0, NONE, 0, 0, 0, NONE });
+
+        // Nested schemas append their own properties and enum values,
+        // so the ones of this node are collected first
+        Node node = nodes_[index];
+        std::vector<Property> properties {};
+        std::vector<EnumValue> enum_values {};
+
+        auto number = [&pointer](const JsonContainerMember& member) -> double {
+            if (!member.value.getRaw().IsNumber()) {
+                throw data_parse_error { _("invalid JSON schema at '{1}': {2} must be a number",
+                                           pointer, member.name.to_string()) };
+            }
+            return member.value.getRaw().GetDouble();
+        };
+
+        auto exactNumber = [](const json_value& raw) -> Number {
+            if (raw.IsUint64()) {
+                return Number::of(raw.GetUint64());
+            }
+            if (raw.IsInt64()) {
+                return Number::of(raw.GetInt64());
+            }
+            return Number::of(raw.GetDouble());
+        };
+
+        auto count = [&pointer](const JsonContainerMember& member) -> size_t {
+            if (!member.value.getRaw().IsUint64()) {
+                throw data_parse_error { _("invalid JSON schema at '{1}': {2} must be a non-negative integer",
+                                           pointer, member.name.to_string()) };
+            }
+            return static_cast<size_t>(member.value.getRaw().GetUint64());
+        };
+
+        auto typeMask = [&pointer](const JsonContainerView& value) -> unsigned {
+            if (value.type() == DataType::String) {
+                auto name = value.get<boost::string_ref>();
+
+                for (const auto& type : TYPE_NAMES) {
+                    if (name == type.name) {
+                        // Integers are numbers as well
+                        return type.mask == NUMBER_TYPE ? (NUMBER_TYPE | INTEGER_TYPE) : type.mask;
+                    }
+                }
+            }
+
+            throw data_parse_error { _("invalid JSON schema at '{1}': unknown type {2}",
+                                       pointer, value.toString()) };
+        };
+
+        for (const auto& member : schema.members()) {
+            if (member.name == "type") {
+                if (member.value.type() == DataType::Array) {
+                    node.types = 0;
+                    for (const auto& type : member.value.elements()) {
+                        node.types |= typeMask(type);
+                    }
+                } else {
+                    node.types = typeMask(member.value);
+                }
+            } else if (member.name == "enum") {
+                if (member.value.type() != DataType::Array) {
+                    throw data_parse_error { _("invalid JSON schema at '{1}': enum must be an array of scalar values",
+                                               pointer) };
+                }
+
+                for (const auto& element : member.value.elements()) {
+                    const auto& raw = element.getRaw();
+
+                    if (raw.IsNull()) {
+                        enum_values.push_back({ NULL_TYPE, false, Number::of(0.0), "" });
+                    } else if (raw.IsBool()) {
+                        enum_values.push_back({ BOOLEAN_TYPE, raw.GetBool(), Number::of(0.0), "" });
+                    } else if (raw.IsNumber()) {
+                        enum_values.push_back({ NUMBER_TYPE, false, exactNumber(raw), "" });
+                    } else if (raw.IsString()) {
+                        enum_values.push_back({ STRING_TYPE, false, Number::of(0.0),
+                                                { raw.GetString(), raw.GetStringLength() } });
+                    } else {
+                        throw data_parse_error { _("invalid JSON schema at '{1}': enum must be an array of scalar values",
+                                                   pointer) };
+                    }
+                }
+            } else if (member.name == "minimum") {
+                node.has_minimum = true;
+                node.minimum = number(member);
+            } else if (member.name == "maximum") {
+                node.has_maximum = true;
+                node.maximum = number(member);
+            } else if (member.name == "minLength") {
+                node.min_length = count(member);
+            } else if (member.name == "maxLength") {
+                node.max_length = count(member);
+            } else if (member.name == "minItems") {
+                node.min_items = count(member);
+            } else if (member.name == "maxItems") {
+                node.max_items = count(member);
+            } else if (member.name == "items") {
+                node.items = compile(member.value, pointer + "/items");
+            } else if (member.name == "properties") {
+                if (member.value.type() != DataType::Object) {
+                    throw data_parse_error { _("invalid JSON schema at '{1}': expected an object",
+                                               pointer + "/properties") };
+                }
+
+                for (const auto& property : member.value.members()) {
+                    auto name = property.name.to_string();
+                    auto property_node = compile(property.value,
+                                                 pointer + "/properties/" + escapePointerToken(name));
+                    properties.push_back({ std::move(name), property_node, false });
+                }
+            } else if (member.name == "required") {
+                if (member.value.type() != DataType::Array) {
+                    throw data_parse_error { _("invalid JSON schema at '{1}': required must be an array of strings",
+                                               pointer) };
+                }
+
+                for (const auto& element : member.value.elements()) {
+                    if (element.type() != DataType::String) {
+                        throw data_parse_error { _("invalid JSON schema at '{1}': required must be an array of strings",
+                                                   pointer) };
+                    }
+
+                    properties.push_back({ element.get<std::string>(), NONE, true });
+                }
+            }
+        }
+
+        // Merge the required names into the properties, so that a
+        // single lookup per member serves both checks
+        std::vector<Property> merged {};
+
+        for (const auto& property : properties) {
+            auto existing = std::find_if(merged.begin(), merged.end(), [&property](const Property& p) {
+                return p.name == property.name;
+            });
+
+            if (existing == merged.end()) {
+                merged.push_back(property);
+                continue;
+            }
+
+            existing->required = existing->required || property.required;
+
+            if (property.node != NONE) {
+                existing->node = property.node;
+            }
+        }
+
+        node.properties_begin = properties_.size();
+
+        for (auto& property : merged) {
+            node.required_count += property.required ? 1 : 0;
+            properties_.push_back(std::move(property));
+        }
+
+        node.properties_end = properties_.size();
+        node.enum_begin = enum_values_.size();
+        enum_values_.insert(enum_values_.end(), enum_values.begin(), enum_values.end());
+        node.enum_end = enum_values_.size();
+        nodes_[index] = node;
+        return index;
+    }
+
+    std::vector<JsonSchemaError> JsonSchema::validate(const JsonContainer& document) const {
+        JsonSchemaValidator validator { *this };
+        JsonReader {}.parse(document, validator);
+        return validator.errors();
+    }
+
+    void JsonSchema::check(const JsonContainer& document) const {
+        auto errors = validate(document);
+
+        if (!errors.empty()) {
+            auto message = _("invalid document at '{1}': {2}", errors.front().pointer, errors.front().message);
+            throw data_validation_error { message, std::move(errors) };
+        }
+    }
+
+    //
+    // JsonSchemaValidator
+    //
+
+    JsonSchemaValidator::JsonSchemaValidator(const JsonSchema& schema)
+            : schema_(schema),
+              frames_(),
+              depth_(0),
+              errors_() {
+    }
+
+    void JsonSchemaValidator::reset() {
+        depth_ = 0;
+        errors_.clear();
+    }
+
+    bool JsonSchemaValidator::null() {
+        return checkScalar(JsonSchema::NULL_TYPE, false, JsonSchema::Number::of(0.0), nullptr, 0);
+    }
+
+    bool JsonSchemaValidator::boolean(bool value) {
+        return checkScalar(JsonSchema::BOOLEAN_TYPE, value, JsonSchema::Number::of(0.0), nullptr, 0);
+    }
+
+    bool JsonSchemaValidator::integer(int64_t value) {
+        return checkScalar(JsonSchema::INTEGER_TYPE, false, JsonSchema::Number::of(value), nullptr, 0);
+    }
+
+    bool JsonSchemaValidator::unsignedInteger(uint64_t value) {
+        return checkScalar(JsonSchema::INTEGER_TYPE, false, JsonSchema::Number::of(value), nullptr, 0);
+    }
+
+    bool JsonSchemaValidator::real(double value) {
+        return checkScalar(JsonSchema::NUMBER_TYPE, false, JsonSchema::Number::of(value), nullptr, 0);
+    }
+
+    bool JsonSchemaValidator::string(const char* value, size_t length) {
+        return checkScalar(JsonSchema::STRING_TYPE, false, JsonSchema::Number::of(0.0), value, length);
+    }
+
+    bool JsonSchemaValidator::startObject() {
+        startContainer(false);
+        return true;
+    }
+
+    bool JsonSchemaValidator::key(const char* name, size_t length) {
+        auto& frame = frames_[depth_ - 1];
+        frame.key.assign(name, length);
+        frame.member_node = JsonSchema::NONE;
+
+        if (frame.node == JsonSchema::NONE) {
+            return true;
+        }
+
+        const auto& node = schema_.nodes_[frame.node];
+
+        for (auto i = node.properties_begin; i < node.properties_end; i++) {
+            const auto& property = schema_.properties_[i];
+
+            if (property.name.size() == length
+                    && std::memcmp(property.name.data(), name, length) == 0) {
+                frame.member_node = property.node;
+                frame.seen[i - node.properties_begin] = true;
+                break;
+            }
+        }
+
+        return true;
+    }
+
+    bool JsonSchemaValidator::endObject(size_t member_count) {
+        const auto& frame = frames_[depth_ - 1];
+
+        if (frame.node != JsonSchema::NONE) {
+            const auto& node = schema_.nodes_[frame.node];
+
+            for (auto i = node.properties_begin; node.required_count > 0 && i < node.properties_end; i++) {
+                const auto& property = schema_.properties_[i];
+
+                if (property.required && !frame.seen[i - node.properties_begin]) {
+                    addError(_("missing required property: {1}", property.name), true);
+                }
+            }
+        }
+
+        depth_--;
+        afterValue();
+        return true;
+    }
+
+    bool JsonSchemaValidator::startArray() {
+        startContainer(true);
+        return true;
+    }
+
+    bool JsonSchemaValidator::endArray(size_t element_count) {
+        const auto& frame = frames_[depth_ - 1];
+
+        if (frame.node != JsonSchema::NONE) {
+            const auto& node = schema_.nodes_[frame.node];
+
+            if (element_count < node.min_items) {
+                addError(_("array has {1} items, less than the minimum of {2}",
+                           element_count, node.min_items), true);
+            } else if (element_count > node.max_items) {
+                addError(_("array has {1} items, more than the maximum of {2}",
+                           element_count, node.max_items), true);
+            }
+        }
+
+        depth_--;
+        afterValue();
+        return true;
+    }
+
+    size_t JsonSchemaValidator::nextNode() {
+        if (depth_ == 0) {
+            return schema_.nodes_.empty() ? JsonSchema::NONE : 0;
+        }
+
+        const auto& frame = frames_[depth_ - 1];
+
+        if (frame.node == JsonSchema::NONE) {
+            return JsonSchema::NONE;
+        }
+
+        return frame.is_array ? schema_.nodes_[frame.node].items : frame.member_node;
+    }
+
+    void JsonSchemaValidator::afterValue() {
+        if (depth_ > 0 && frames_[depth_ - 1].is_array) {
+            frames_[depth_ - 1].index++;
+        }
+    }
+
+    bool JsonSchemaValidator::checkScalar(unsigned type, bool boolean, const JsonSchema::Number& number,
+                                          const char* string, size_t length) {
+        auto node_index = nextNode();
+
+        if (node_index != JsonSchema::NONE && checkType(node_index, type)) {
+            const auto& node = schema_.nodes_[node_index];
+            auto is_number = (type & (JsonSchema::INTEGER_TYPE | JsonSchema::NUMBER_TYPE)) != 0;
+
+            if (node.enum_begin != node.enum_end) {
+                auto matches = false;
+
+                for (auto i = node.enum_begin; i < node.enum_end && !matches; i++) {
+                    const auto& value = schema_.enum_values_[i];
+
+                    if (is_number) {
+                        matches = value.type == JsonSchema::NUMBER_TYPE && value.number == number;
+                    } else if (value.type == type) {
+                        matches = type == JsonSchema::NULL_TYPE
+                            || (type == JsonSchema::BOOLEAN_TYPE && value.boolean == boolean)
+                            || (type == JsonSchema::STRING_TYPE && value.string.size() == length
+                                && std::memcmp(value.string.data(), string, length) == 0);
+                    }
+                }
+
+                if (!matches) {
+                    addError(_("value is not one of the enumerated values"));
+                }
+            }
+
+            if (is_number && node.has_minimum && number.value < node.minimum) {
+                addError(_("value {1} is less than the minimum of {2}", number.value, node.minimum));
+            } else if (is_number && node.has_maximum && number.value > node.maximum) {
+                addError(_("value {1} is greater than the maximum of {2}", number.value, node.maximum));
+            }
+
+            if (type == JsonSchema::STRING_TYPE && length < node.min_length) {
+                addError(_("string has {1} bytes, less than the minimum of {2}", length, node.min_length));
+            } else if (type == JsonSchema::STRING_TYPE && length > node.max_length) {
+                addError(_("string has {1} bytes, more than the maximum of {2}", length, node.max_length));
+            }
+        }
+
+        afterValue();
+        return true;
+    }
+
+    bool JsonSchemaValidator::checkType(size_t node, unsigned type) {
+        auto types = schema_.nodes_[node].types;
+
+        if ((types & type) == 0) {
+            addError(_("invalid type {1}; expected {2}", typeNames(type), typeNames(types)));
+            return false;
+        }
+
+        return true;
+    }
+
+    void JsonSchemaValidator::startContainer(bool is_array) {
+        auto node = nextNode();
+        auto type = is_array ? JsonSchema::ARRAY_TYPE : JsonSchema::OBJECT_TYPE;
+
+        // In case of a type mismatch, the content is not checked
+        if (node != JsonSchema::NONE && !checkType(node, type)) {
+            node = JsonSchema::NONE;
+        }
+
+        if (depth_ == frames_.size()) {
+            frames_.emplace_back();
+        }
+
+        auto& frame = frames_[depth_++];
+        frame.node = node;
+        frame.is_array = is_array;
+        frame.index = 0;
+        frame.key.clear();
+        frame.member_node = JsonSchema::NONE;
+
+        if (!is_array && node != JsonSchema::NONE) {
+            const auto& schema_node = schema_.nodes_[node];
+            frame.seen.assign(schema_node.properties_end - schema_node.properties_begin, false);
+        }
+    }
+
+    void JsonSchemaValidator::addError(std::string message, bool parent) {
+        // The pointer of the current value, or of the container being
+        // closed in case of parent
+        auto depth = parent ? depth_ - 1 : depth_;
+        std::string pointer {};
+
+        for (size_t i = 0; i < depth; i++) {
+            pointer += '/';
+            pointer += frames_[i].is_array ? std::to_string(frames_[i].index)
+                                           : escapePointerToken(frames_[i].key);
+        }
+
+        errors_.push_back({ std::move(pointer), std::move(message) });
+    }
+
+}}  // namespace leatherman::json_container
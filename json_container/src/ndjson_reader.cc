@@ -0,0 +1,303 @@
+#include <leatherman/json_container/ndjson_reader.hpp>
+#include <leatherman/locale/locale.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+// Mark string for translation (alias for leatherman::locale::format)
+using leatherman::locale::_;
+
+namespace leatherman { namespace json_container {
+
+    const size_t NdjsonReader::DEFAULT_BATCH_SIZE { 64 * 1024 };
+
+    // Size of each read from the source
+    const size_t READ_SIZE { 64 * 1024 };
+
+    // Batches queued or being parsed, per thread
+    const size_t BATCHES_PER_THREAD { 2 };
+
+    namespace {
+
+    // Whole lines of the input, parsed by one of the threads
+    struct NdjsonBatch {
+        std::string text;
+        // Number of the first line of text
+        size_t first_line;
+        // A deque, as JsonContainer can only be copied, not moved
+        std::deque<JsonContainer> records;
+        // Parse error, raised after delivering the records
+        std::exception_ptr error;
+        bool done;
+    };
+
+    // Scan for newlines with memchr, which the C libraries vectorize
+    size_t countLines(const std::string& text) {
+        size_t count = 0;
+        auto current = text.data();
+        auto end = current + text.size();
+
+        while ((current = static_cast<const char*>(std::memchr(current, '\n', end - current)))) {
+            count++;
+            current++;
+        }
+
+        return count;
+    }
+
+    bool isBlank(const char* begin, const char* end) {
+        return std::all_of(begin, end, [](char c) {
+            return c == ' ' || c == '\t' || c == '\r';
+        });
+    }
+
+    void parseBatch(NdjsonBatch& batch, std::string& line) {
+        auto current = batch.text.data();
+        auto end = current + batch.text.size();
+        auto number = batch.first_line;
+
+        for (; current < end; number++) {
+            auto newline = static_cast<const char*>(std::memchr(current, '\n', end - current));
+            auto line_end = newline ? newline : end;
+
+            if (!isBlank(current, line_end)) {
+                line.assign(current, line_end);
+
+                try {
+                    batch.records.emplace_back(line);
+                } catch (data_parse_error&) {
+                    batch.error = std::make_exception_ptr(
+                        data_parse_error { _("invalid JSON on line {1}", number) });
+                    return;
+                }
+            }
+
+            current = line_end + 1;
+        }
+    }
+
+    // Threads parsing the submitted batches, in submission order
+    class NdjsonPool {
+    public:
+        explicit NdjsonPool(size_t threads) : stopping_(false) {
+            for (size_t i = 0; i < threads; i++) {
+                threads_.emplace_back([this] { run(); });
+            }
+        }
+
+        ~NdjsonPool() {
+            {
+                std::lock_guard<std::mutex> lock { mutex_ };
+                stopping_ = true;
+            }
+
+            work_available_.notify_all();
+
+            for (auto& thread : threads_) {
+                thread.join();
+            }
+        }
+
+        void submit(std::shared_ptr<NdjsonBatch> batch) {
+            {
+                std::lock_guard<std::mutex> lock { mutex_ };
+                queue_.push_back(std::move(batch));
+            }
+
+            work_available_.notify_one();
+        }
+
+        void wait(const NdjsonBatch& batch) {
+            std::unique_lock<std::mutex> lock { mutex_ };
+            batch_done_.wait(lock, [&batch] { return batch.done; });
+        }
+
+    private:
+        std::mutex mutex_;
+        std::condition_variable work_available_;
+        std::condition_variable batch_done_;
+        std::deque<std::shared_ptr<NdjsonBatch>> queue_;
+        bool stopping_;
+        std::vector<std::thread> threads_;
+
+        void run() {
+            // Reused across lines, to avoid an allocation per record
+            std::string line {};
+
+            while (true) {
+                std::shared_ptr<NdjsonBatch> batch {};
+
+                {
+                    std::unique_lock<std::mutex> lock { mutex_ };
+                    work_available_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+
+                    if (stopping_) {
+                        return;
+                    }
+
+                    batch = std::move(queue_.front());
+                    queue_.pop_front();
+                }
+
+                try {
+                    parseBatch(*batch, line);
+                } catch (...) {
+                    batch->error = std::current_exception();
+                }
+
+                {
+                    std::lock_guard<std::mutex> lock { mutex_ };
+                    batch->done = true;
+                }
+
+                batch_done_.notify_all();
+            }
+        }
+    };
+
+    }  // namespace
+
+    NdjsonReader::NdjsonReader(size_t threads, size_t batch_size)
+            : threads_(threads),
+              batch_size_(std::max(batch_size, size_t { 1 })) {
+        if (threads_ == 0) {
+            threads_ = std::max(std::thread::hardware_concurrency(), 1u);
+        }
+    }
+
+    bool NdjsonReader::read(const std::string& ndjson_txt, NdjsonCallback callback) const {
+        size_t offset = 0;
+        return read([&ndjson_txt, &offset](char* buffer, size_t size) -> size_t {
+            size = std::min(size, ndjson_txt.size() - offset);
+            ndjson_txt.copy(buffer, size, offset);
+            offset += size;
+            return size;
+        }, std::move(callback));
+    }
+
+    bool NdjsonReader::read(std::istream& input, NdjsonCallback callback) const {
+        return read([&input](char* buffer, size_t size) -> size_t {
+            input.read(buffer, size);
+            return static_cast<size_t>(input.gcount());
+        }, std::move(callback));
+    }
+
+    bool NdjsonReader::read(int fd, NdjsonCallback callback) const {
+        return read([fd](char* buffer, size_t size) -> size_t {
+            while (true) {
+#ifdef _WIN32
+                auto count = ::_read(fd, buffer, static_cast<unsigned int>(size));
+#else
+                auto count = ::read(fd, buffer, size);
+#endif
+                if (count >= 0) {
+                    return static_cast<size_t>(count);
+                }
+
+                if (errno != EINTR) {
+                    throw data_error { _("failed to read JSON input: {1}", std::strerror(errno)) };
+                }
+            }
+        }, std::move(callback));
+    }
+
+    bool NdjsonReader::read(JsonChunkSource source, NdjsonCallback callback) const {
+        // Declared first, so that the threads are joined before the
+        // batches they may be parsing are destroyed
+        std::deque<std::shared_ptr<NdjsonBatch>> in_flight {};
+        NdjsonPool pool { threads_ };
+        // Partial line ending the previous batch
+        std::string pending {};
+        size_t line = 1;
+        bool eof = false;
+
+        // Deliver the records of the oldest batch, once parsed
+        auto deliver = [&]() {
+            auto batch = std::move(in_flight.front());
+            in_flight.pop_front();
+            pool.wait(*batch);
+
+            for (auto& record : batch->records) {
+                if (!callback(record)) {
+                    return false;
+                }
+            }
+
+            if (batch->error) {
+                std::rethrow_exception(batch->error);
+            }
+
+            return true;
+        };
+
+        while (!eof || !pending.empty()) {
+            std::shared_ptr<NdjsonBatch> batch { new NdjsonBatch { {}, line, {}, {}, false } };
+            auto& text = batch->text;
+            text.swap(pending);
+            size_t scanned = 0;
+            size_t cut = std::string::npos;
+
+            // Read at least batch_size bytes, up to a newline
+            while (!eof && cut == std::string::npos) {
+                while (!eof && text.size() < std::max(batch_size_, scanned + 1)) {
+                    auto size = text.size();
+                    text.resize(size + READ_SIZE);
+                    auto count = source(&text[size], READ_SIZE);
+                    text.resize(size + count);
+                    eof = count == 0;
+                }
+
+                // Only the newly read bytes can hold a newline
+                auto last = std::find(text.rbegin(), text.rend() - scanned, '\n');
+
+                if (last != text.rend() - scanned) {
+                    cut = static_cast<size_t>(text.rend() - last);
+                }
+
+                scanned = text.size();
+            }
+
+            if (cut != std::string::npos && cut < text.size()) {
+                pending.assign(text, cut, std::string::npos);
+                text.resize(cut);
+            }
+
+            line += countLines(text);
+
+            if (text.empty()) {
+                continue;
+            }
+
+            pool.submit(batch);
+            in_flight.push_back(std::move(batch));
+
+            if (in_flight.size() >= BATCHES_PER_THREAD * threads_ && !deliver()) {
+                return false;
+            }
+        }
+
+        while (!in_flight.empty()) {
+            if (!deliver()) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+}}  // namespace leatherman::json_container
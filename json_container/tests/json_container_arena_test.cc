@@ -0,0 +1,102 @@
+#include <catch.hpp>
+#include <leatherman/json_container/json_container_arena.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace leatherman { namespace json_container {
+
+TEST_CASE("JsonContainerArena::create", "[data]") {
+    JsonContainerArena arena { 4096 };
+
+    SECTION("it creates empty objects") {
+        auto& container = arena.create();
+        REQUIRE(container.type() == DataType::Object);
+        REQUIRE(container.empty());
+        REQUIRE(arena.size() == 1u);
+    }
+
+    SECTION("it parses JSON text") {
+        auto& container = arena.create("{\"foo\" : [1, 2], \"bar\" : \"baz\"}");
+        REQUIRE(container.get<std::vector<int>>("foo") == (std::vector<int> { 1, 2 }));
+        REQUIRE(container.get<std::string>("bar") == "baz");
+    }
+
+    SECTION("it throws a data_parse_error in case of invalid JSON") {
+        REQUIRE_THROWS_AS(arena.create("{\"foo\" : "), data_parse_error);
+        REQUIRE(arena.size() == 0u);
+    }
+
+    SECTION("it creates many independent containers") {
+        std::vector<JsonArenaContainer*> containers {};
+
+        for (int i = 0; i < 1000; i++) {
+            auto& container = arena.create();
+            container.set<int>("id", i);
+            container.set<std::string>("name", "resource-" + std::to_string(i));
+            container.set<std::vector<std::string>>("tags", { "a", "b", "c" });
+            containers.push_back(&container);
+        }
+
+        REQUIRE(arena.size() == 1000u);
+        REQUIRE(arena.reserved() > 0u);
+
+        for (int i = 0; i < 1000; i++) {
+            REQUIRE(containers[i]->get<int>("id") == i);
+            REQUIRE(containers[i]->toString() ==
+                    "{\"id\":" + std::to_string(i) + ",\"name\":\"resource-" + std::to_string(i) +
+                    "\",\"tags\":[\"a\",\"b\",\"c\"]}");
+        }
+    }
+
+    SECTION("its containers can be modified") {
+        auto& container = arena.create("{\"foo\" : {\"bar\" : \"a string\"}}");
+        container.set<std::string>({ "foo", "bar" }, std::string(10000, 'x'));
+        container.set<int>({ "goo", "baz" }, 1);
+        container.set<JsonContainer>("moo", JsonContainer { "{\"a\" : [true]}" });
+
+        REQUIRE(container.get<std::string>({ "foo", "bar" }).size() == 10000u);
+        REQUIRE(container.get<int>({ "goo", "baz" }) == 1);
+        REQUIRE(container.get<JsonContainer>("moo").get<std::vector<bool>>("a") ==
+                (std::vector<bool> { true }));
+        REQUIRE(container.includes({ "goo", "baz" }));
+        REQUIRE_FALSE(container.includes({ "foo", "baz" }));
+        REQUIRE_THROWS_AS(container.set<int>({ "foo", "bar", "baz" }, 1), data_key_error);
+    }
+
+    SECTION("its containers throw like JsonContainer") {
+        auto& container = arena.create("{\"foo\" : 1}");
+        REQUIRE_THROWS_AS(container.get<int>("bar"), data_key_error);
+        REQUIRE_THROWS_AS(container.get<std::string>("foo"), data_type_error);
+        REQUIRE_THROWS_AS(container.get<int>({ "foo", "bar" }), data_type_error);
+    }
+
+    SECTION("the copies of its containers outlive it") {
+        std::unique_ptr<JsonContainerArena> scoped { new JsonContainerArena {} };
+        auto& container = scoped->create("{\"foo\" : [\"a\", \"b\"]}");
+        auto copy = container.toContainer();
+        scoped.reset();
+
+        REQUIRE(copy.get<std::vector<std::string>>("foo") == (std::vector<std::string> { "a", "b" }));
+        copy.set<int>("bar", 1);
+        REQUIRE(copy.toString() == "{\"foo\":[\"a\",\"b\"],\"bar\":1}");
+    }
+}
+
+TEST_CASE("JsonContainerArena::clear", "[data]") {
+    JsonContainerArena arena {};
+
+    for (int i = 0; i < 100; i++) {
+        arena.create().set<int>("id", i);
+    }
+
+    arena.clear();
+    REQUIRE(arena.size() == 0u);
+    REQUIRE(arena.reserved() == 0u);
+
+    auto& container = arena.create("[1, 2, 3]");
+    REQUIRE(container.size() == 3u);
+}
+
+}}  // namespace leatherman::json_container
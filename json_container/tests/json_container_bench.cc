@@ -0,0 +1,551 @@
+// Micro-benchmarks for JsonContainer.
+//
+// Each benchmark runs repeatedly for a minimum amount of time; the
+// results are printed on stdout as a JSON document, so that they can
+// be collected and compared across builds.
+//
+// Benchmarks are named group/document/operation, e.g. parse/large;
+// the documents are generated by json_container_corpus.hpp.
+//
+// Usage: json_container_bench [name_filter]
+//        Only the benchmarks whose name contains name_filter are run.
+
+#include <leatherman/json_container/json_container.hpp>
+#include <leatherman/json_container/json_container_arena.hpp>
+#include <leatherman/json_container/ndjson_reader.hpp>
+
+#include "json_container_corpus.hpp"
+
+#include <rapidjson/document.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using leatherman::json_container::JsonContainer;
+using leatherman::json_container::JsonArenaContainer;
+using leatherman::json_container::JsonContainerArena;
+using leatherman::json_container::JsonContainerKey;
+using leatherman::json_container::JsonContainerPath;
+using leatherman::json_container::NdjsonReader;
+using leatherman::json_container::ParseMode;
+namespace corpus = leatherman::json_container::corpus;
+
+namespace {
+
+    const double MIN_SECONDS { 0.5 };
+
+    struct Benchmark {
+        std::string name;
+        // Bytes of JSON processed by each run; 0 if not meaningful
+        size_t bytes;
+        // Returns a value derived from the work done, so that it
+        // cannot be optimized away
+        std::function<size_t()> run;
+    };
+
+    JsonContainer measure(const Benchmark& benchmark) {
+        using clock = std::chrono::steady_clock;
+        size_t iterations = 0;
+        size_t checksum = 0;
+        auto start = clock::now();
+        std::chrono::duration<double> elapsed {};
+
+        do {
+            checksum += benchmark.run();
+            iterations++;
+            elapsed = clock::now() - start;
+        } while (elapsed.count() < MIN_SECONDS);
+
+        JsonContainer result {};
+        result.set<std::string>("name", benchmark.name);
+        result.set<int>("iterations", static_cast<int>(iterations));
+        result.set<double>("ns_per_op", elapsed.count() * 1e9 / iterations);
+
+        if (benchmark.bytes > 0) {
+            result.set<double>("mb_per_s",
+                               benchmark.bytes * iterations / elapsed.count() / (1024.0 * 1024.0));
+        }
+
+        // Never true; keeps the checksum alive
+        if (checksum == 1) {
+            std::cerr << checksum;
+        }
+
+        return result;
+    }
+
+    std::vector<Benchmark> benchmarks() {
+        std::vector<Benchmark> result {};
+
+        auto large_text = corpus::recordsDocument(100000);
+        auto large = std::make_shared<JsonContainer>(large_text);
+
+        // Parsing documents of each size and kind of content
+        auto small_text = corpus::smallDocument();
+        auto inventory_text = corpus::inventoryDocument();
+        auto strings_text = corpus::stringsDocument(20000);
+        auto numbers_text = corpus::numbersDocument(100000);
+
+        result.push_back({ "parse/small", small_text.size(), [small_text] {
+            return JsonContainer { small_text }.size();
+        } });
+
+        result.push_back({ "parse/medium", inventory_text.size(), [inventory_text] {
+            return JsonContainer { inventory_text }.size();
+        } });
+
+        result.push_back({ "parse/large", large_text.size(), [large_text] {
+            return JsonContainer { large_text }.size();
+        } });
+
+        result.push_back({ "parse/strings", strings_text.size(), [strings_text] {
+            return JsonContainer { strings_text }.size();
+        } });
+
+        result.push_back({ "parse/numbers", numbers_text.size(), [numbers_text] {
+            return JsonContainer { numbers_text }.size();
+        } });
+
+        // Reading a few entries of a large object, eagerly or lazily
+        auto envelope_text = "{\"metadata\":" + corpus::smallDocument() +
+                             ",\"records\":" + corpus::recordsDocument(20000) +
+                             ",\"facts\":" + corpus::factsDocument(20000) + "}";
+
+        result.push_back({ "parse/envelope/eager_get", envelope_text.size(), [envelope_text] {
+            JsonContainer envelope { envelope_text };
+            return envelope.get<std::string>({ "metadata", "id" }).size();
+        } });
+
+        result.push_back({ "parse/envelope/lazy_get", envelope_text.size(), [envelope_text] {
+            JsonContainer envelope { envelope_text, ParseMode::Lazy };
+            return envelope.get<std::string>({ "metadata", "id" }).size();
+        } });
+
+        result.push_back({ "parse/envelope/lazy_toString", envelope_text.size(), [envelope_text] {
+            JsonContainer envelope { envelope_text, ParseMode::Lazy };
+            return envelope.toString().size();
+        } });
+
+        auto inventory = std::make_shared<JsonContainer>(inventory_text);
+
+        result.push_back({ "serialize/medium/toString", inventory_text.size(), [inventory] {
+            return inventory->toString().size();
+        } });
+
+        result.push_back({ "serialize/medium/toStringReserved", inventory_text.size(), [inventory] {
+            return inventory->toStringReserved().size();
+        } });
+
+        result.push_back({ "serialize/medium/toPrettyString", inventory_text.size(), [inventory] {
+            return inventory->toPrettyString().size();
+        } });
+
+        result.push_back({ "serialize/large/toString", large_text.size(), [large] {
+            return large->toString().size();
+        } });
+
+        result.push_back({ "serialize/large/toStringReserved", large_text.size(), [large] {
+            return large->toStringReserved().size();
+        } });
+
+        result.push_back({ "serialize/large/rapidjson_stringbuffer", large_text.size(), [large] {
+            rapidjson::StringBuffer buffer;
+            rapidjson::Writer<rapidjson::StringBuffer> writer { buffer };
+            large->getRaw().Accept(writer);
+            return std::string { buffer.GetString(), buffer.GetSize() }.size();
+        } });
+
+        result.push_back({ "serialize/large/write_ostream", large_text.size(), [large] {
+            std::ostringstream output {};
+            large->write(output);
+            return static_cast<size_t>(output.tellp());
+        } });
+
+        result.push_back({ "serialize/large/write_fd", large_text.size(), [large] {
+#ifdef _WIN32
+            auto fp = std::fopen("NUL", "wb");
+            large->write(_fileno(fp));
+#else
+            auto fp = std::fopen("/dev/null", "wb");
+            large->write(fileno(fp));
+#endif
+            std::fclose(fp);
+            return size_t { 1 };
+        } });
+
+        result.push_back({ "serialize/large/toPrettyString", large_text.size(), [large] {
+            return large->toPrettyString().size();
+        } });
+
+        result.push_back({ "serialize/large/toIndentedString", large_text.size(), [large] {
+            return large->toIndentedString().size();
+        } });
+
+        // Binary round trip against the text one; bytes are those of the
+        // JSON text in both cases, so that the rates compare
+        auto large_cbor = large->toCBOR();
+        std::cerr << "large document: " << large_text.size() << " bytes of JSON, "
+                  << large_cbor.size() << " bytes of CBOR" << std::endl;
+
+        result.push_back({ "cbor/large/parse_text", large_text.size(), [large_text] {
+            return JsonContainer { large_text }.size();
+        } });
+
+        result.push_back({ "cbor/large/fromCBOR", large_text.size(), [large_cbor] {
+            return JsonContainer::fromCBOR(large_cbor).size();
+        } });
+
+        result.push_back({ "cbor/large/toCBOR", large_text.size(), [large] {
+            return large->toCBOR().size();
+        } });
+
+        // The same records as newline-delimited JSON, parsed one line
+        // at a time and by the parallel reader
+        std::string records_text {};
+        for (const auto& record : large->elements()) {
+            records_text += record.toString() + "\n";
+        }
+
+        result.push_back({ "ndjson/records/per_line", records_text.size(), [records_text] {
+            std::istringstream input { records_text };
+            std::string line {};
+            size_t total = 0;
+            while (std::getline(input, line)) {
+                total += JsonContainer { line }.size();
+            }
+            return total;
+        } });
+
+        result.push_back({ "ndjson/records/NdjsonReader", records_text.size(), [records_text] {
+            size_t total = 0;
+            NdjsonReader {}.read(records_text, [&total](JsonContainer& record) {
+                total += record.size();
+                return true;
+            });
+            return total;
+        } });
+
+        // One small container per resource, built, serialized and
+        // dropped, with a heap document each or from an arena
+        auto buildResource = [](JsonContainer& resource, size_t i) {
+            resource.set<int>("id", static_cast<int>(i));
+            resource.set<std::string>("name", "resource-" + std::to_string(i));
+            resource.set<bool>("enabled", i % 2 == 0);
+            resource.set<std::vector<std::string>>("tags", { "a", "b", "c" });
+        };
+        auto buildArenaResource = [](JsonArenaContainer& resource, size_t i) {
+            resource.set<int>("id", static_cast<int>(i));
+            resource.set<std::string>("name", "resource-" + std::to_string(i));
+            resource.set<bool>("enabled", i % 2 == 0);
+            resource.set<std::vector<std::string>>("tags", { "a", "b", "c" });
+        };
+
+        result.push_back({ "arena/small/heap", 0, [buildResource] {
+            std::vector<std::unique_ptr<JsonContainer>> resources {};
+            size_t total = 0;
+            for (size_t i = 0; i < 100000; i++) {
+                resources.emplace_back(new JsonContainer {});
+                buildResource(*resources.back(), i);
+                total += resources.back()->toString().size();
+            }
+            return total;
+        } });
+
+        result.push_back({ "arena/small/arena", 0, [buildArenaResource] {
+            JsonContainerArena arena {};
+            size_t total = 0;
+            for (size_t i = 0; i < 100000; i++) {
+                auto& resource = arena.create();
+                buildArenaResource(resource, i);
+                total += resource.toString().size();
+            }
+            return total;
+        } });
+
+        // A wide and nested object, the typical input of toPrettyString
+        auto facts_text = corpus::factsDocument(10000);
+        auto facts = std::make_shared<JsonContainer>(facts_text);
+
+        result.push_back({ "serialize/facts/toPrettyString", facts_text.size(), [facts] {
+            return facts->toPrettyString().size();
+        } });
+
+        // Numeric arrays and an array of metric samples
+        auto metrics = std::make_shared<JsonContainer>();
+        std::vector<double> reals {};
+        std::vector<JsonContainer> samples {};
+
+        for (size_t i = 0; i < 100000; i++) {
+            reals.push_back(i / 3.0);
+        }
+
+        for (size_t i = 0; i < 10000; i++) {
+            JsonContainer sample {};
+            sample.set<std::string>("name", "metric-" + std::to_string(i));
+            sample.set<double>("value", i / 3.0);
+            samples.push_back(sample);
+        }
+
+        metrics->set<std::vector<double>>("reals", reals);
+        metrics->set<std::vector<JsonContainer>>("samples", samples);
+
+        result.push_back({ "bulk/reals/get_vector", 0, [metrics] {
+            return metrics->get<std::vector<double>>("reals").size();
+        } });
+
+        result.push_back({ "bulk/reals/getArray", 0, [metrics] {
+            std::vector<double> output(metrics->size("reals"));
+            return metrics->getArray<double>("reals", output.data(), output.size());
+        } });
+
+        result.push_back({ "bulk/samples/get_per_object", 0, [metrics] {
+            double sum = 0;
+            for (const auto& sample : metrics->get<std::vector<JsonContainer>>("samples")) {
+                sum += sample.get<double>("value");
+            }
+            return static_cast<size_t>(sum);
+        } });
+
+        result.push_back({ "bulk/samples/getColumn", 0, [metrics] {
+            std::vector<double> output(metrics->size("samples"));
+            metrics->getColumn<double>("samples", "value", output.data(), output.size());
+            double sum = 0;
+            for (auto value : output) {
+                sum += value;
+            }
+            return static_cast<size_t>(sum);
+        } });
+
+        // Delta between two runs differing by a single fact, against
+        // serializing both documents for an external text diff
+        auto facts_changed = std::make_shared<JsonContainer>(*facts);
+        facts_changed->set<int>({ "fact5000", "size" }, -1);
+
+        result.push_back({ "diff/facts/toString_both", facts_text.size(), [facts, facts_changed] {
+            return facts->toString().size() + facts_changed->toString().size();
+        } });
+
+        result.push_back({ "diff/facts/diff", facts_text.size(), [facts, facts_changed] {
+            return facts->diff(*facts_changed).size();
+        } });
+
+        // Content fingerprints: hashing the serialized text, hashing the
+        // DOM and, with the cache, re-hashing after a single change
+        result.push_back({ "hash/facts/toString_hash", facts_text.size(), [facts] {
+            return std::hash<std::string> {}(facts->toString());
+        } });
+
+        result.push_back({ "hash/facts/hash", facts_text.size(), [facts] {
+            return static_cast<size_t>(facts->hash());
+        } });
+
+        auto facts_cached = std::make_shared<JsonContainer>(*facts);
+        facts_cached->enableHashCache();
+        facts_cached->hash();
+        int counter = 0;
+
+        result.push_back({ "hash/facts/set_and_cached_hash", facts_text.size(), [facts_cached, counter]() mutable {
+            facts_cached->set<int>({ "fact5000", "size" }, counter++);
+            return static_cast<size_t>(facts_cached->hash());
+        } });
+
+        result.push_back({ "iterate/facts/keys_and_get",facts_text.size(), [facts] {
+            size_t total = 0;
+            for (const auto& key : facts->keys()) {
+                total += facts->get<int>({ key, "size" });
+            }
+            return total;
+        } });
+
+        result.push_back({ "iterate/facts/members", facts_text.size(), [facts] {
+            size_t total = 0;
+            for (const auto& member : facts->members()) {
+                for (const auto& field : member.value.members()) {
+                    if (field.name == "size") {
+                        total += field.value.get<int>();
+                    }
+                }
+            }
+            return total;
+        } });
+
+        // An object with many members, looked up by key
+        auto wide = std::make_shared<JsonContainer>();
+        std::vector<std::string> wide_keys {};
+
+        for (size_t i = 0; i < 1000; i++) {
+            wide_keys.push_back("member-" + std::to_string(i));
+            wide->set<int>(wide_keys.back(), static_cast<int>(i));
+        }
+
+        result.push_back({ "lookup/wide/key", 0, [wide, wide_keys] {
+            size_t sum = 0;
+            for (const auto& key : wide_keys) {
+                sum += wide->get<int>(key);
+            }
+            return sum;
+        } });
+
+        auto wide_indexed = std::make_shared<JsonContainer>(*wide);
+        wide_indexed->enableMemberIndex();
+
+        result.push_back({ "lookup/wide/member_index", 0, [wide_indexed, wide_keys] {
+            size_t sum = 0;
+            for (const auto& key : wide_keys) {
+                sum += wide_indexed->get<int>(key);
+            }
+            return sum;
+        } });
+
+        // A nested entry of a small document, looked up repeatedly
+        auto nested = std::make_shared<JsonContainer>(
+            "{\"facts\":{\"os\":{\"family\":\"Debian\",\"name\":\"Ubuntu\"}}}");
+        JsonContainerPath os_name { { "facts", "os", "name" } };
+
+        result.push_back({ "lookup/nested/keys", 0, [nested] {
+            return nested->get<std::string>({ "facts", "os", "name" }).size();
+        } });
+
+        result.push_back({ "lookup/nested/path", 0, [nested, os_name] {
+            return nested->get<std::string>(os_name).size();
+        } });
+
+        // Nested entries of the inventory, by key path
+        std::vector<JsonContainerKey> ip_keys { "networking", "interfaces", "eth3", "ip" };
+        std::vector<JsonContainerKey> mtu_keys { "networking", "interfaces", "eth3", "mtu" };
+
+        result.push_back({ "path/medium/get_nested", 0, [inventory, ip_keys] {
+            return inventory->get<std::string>(ip_keys).size();
+        } });
+
+        auto inventory_set = std::make_shared<JsonContainer>(*inventory);
+        int mtu = 0;
+
+        result.push_back({ "path/medium/set_nested", 0, [inventory_set, mtu_keys, mtu]() mutable {
+            inventory_set->set<int>(mtu_keys, mtu++);
+            return size_t { 1 };
+        } });
+
+        result.push_back({ "path/medium/set_new_nested", 0, [mtu_keys] {
+            JsonContainer entry {};
+            entry.set<int>(mtu_keys, 1500);
+            return entry.size();
+        } });
+
+        result.push_back({ "keys/medium/keys", 0, [inventory] {
+            return inventory->keys().size();
+        } });
+
+        result.push_back({ "keys/facts/keys", 0, [facts] {
+            return facts->keys().size();
+        } });
+
+        // Copying against moving a container; the rvalue constructor
+        // and the assignment of a temporary currently copy as well
+        result.push_back({ "copy/medium/copy_constructor", inventory_text.size(), [inventory] {
+            JsonContainer copy { *inventory };
+            return copy.size();
+        } });
+
+        auto inventory_cow = std::make_shared<JsonContainer>(*inventory);
+        inventory_cow->enableCopyOnWrite();
+
+        result.push_back({ "copy/medium/copy_on_write", inventory_text.size(), [inventory_cow] {
+            JsonContainer copy { *inventory_cow };
+            return copy.size();
+        } });
+
+        result.push_back({ "copy/medium/copy_on_write_and_set", inventory_text.size(), [inventory_cow] {
+            JsonContainer copy { *inventory_cow };
+            copy.set<int>("is_virtual", 0);
+            return copy.size();
+        } });
+
+        result.push_back({ "copy/medium/move_constructor", inventory_text.size(), [inventory_text] {
+            JsonContainer source { inventory_text };
+            JsonContainer moved { std::move(source) };
+            return moved.size();
+        } });
+
+        result.push_back({ "copy/medium/parse_only", inventory_text.size(), [inventory_text] {
+            JsonContainer source { inventory_text };
+            return source.size();
+        } });
+
+        result.push_back({ "copy/medium/move_assignment", inventory_text.size(), [inventory_text] {
+            JsonContainer source { inventory_text };
+            JsonContainer target {};
+            target = std::move(source);
+            return target.size();
+        } });
+
+        // Vectors set into and read from a container
+        std::vector<int> ints(100000);
+        std::vector<std::string> strings {};
+
+        for (size_t i = 0; i < ints.size(); i++) {
+            ints[i] = static_cast<int>(i);
+        }
+
+        for (size_t i = 0; i < 10000; i++) {
+            strings.push_back("string-" + std::to_string(i));
+        }
+
+        result.push_back({ "vector/ints/set", 0, [ints] {
+            JsonContainer data {};
+            data.set<std::vector<int>>("ints", ints);
+            return data.size("ints");
+        } });
+
+        auto ints_data = std::make_shared<JsonContainer>();
+        ints_data->set<std::vector<int>>("ints", ints);
+
+        result.push_back({ "vector/ints/get", 0, [ints_data] {
+            return ints_data->get<std::vector<int>>("ints").size();
+        } });
+
+        result.push_back({ "vector/strings/set", 0, [strings] {
+            JsonContainer data {};
+            data.set<std::vector<std::string>>("strings", strings);
+            return data.size("strings");
+        } });
+
+        auto strings_data = std::make_shared<JsonContainer>();
+        strings_data->set<std::vector<std::string>>("strings", strings);
+
+        result.push_back({ "vector/strings/get", 0, [strings_data] {
+            return strings_data->get<std::vector<std::string>>("strings").size();
+        } });
+
+        return result;
+    }
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    std::string filter { argc > 1 ? argv[1] : "" };
+    std::vector<JsonContainer> results {};
+
+    for (const auto& benchmark : benchmarks()) {
+        if (benchmark.name.find(filter) == std::string::npos) {
+            continue;
+        }
+
+        std::cerr << "running " << benchmark.name << std::endl;
+        results.push_back(measure(benchmark));
+    }
+
+    JsonContainer report {};
+    report.set<std::vector<JsonContainer>>("benchmarks", results);
+    report.write(std::cout);
+    std::cout << std::endl;
+    return 0;
+}
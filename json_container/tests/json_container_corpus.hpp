@@ -0,0 +1,167 @@
+// Generators of the JSON documents used by the JsonContainer benchmarks.
+//
+// The corpus is generated rather than checked in, so that it can be
+// scaled and stays reviewable. The output is deterministic: the same
+// arguments always produce the same text, so results compare across
+// builds.
+
+#pragma once
+
+#include <sstream>
+#include <string>
+
+namespace leatherman { namespace json_container { namespace corpus {
+
+    // A message of a few hundred bytes, as exchanged by agents
+    inline std::string smallDocument() {
+        return "{\"id\":\"4e1b9d2c-7f3a-4c8e-9b61-0d5e2a7c3f18\","
+               "\"message_type\":\"http://puppetlabs.com/rpc_blocking_request\","
+               "\"expires\":\"2016-05-04T12:00:00.000Z\","
+               "\"sender\":\"pcp://controller.example.com/server\","
+               "\"targets\":[\"pcp://agent01.example.com/agent\"],"
+               "\"data\":{\"transaction_id\":\"0d5e2a7c\",\"module\":\"echo\","
+               "\"action\":\"echo\",\"params\":{\"argument\":\"hello\",\"count\":3}}}";
+    }
+
+    // A facter-like inventory of a host, with the given number of
+    // network interfaces, mount points and installed packages
+    inline std::string inventoryDocument(size_t interfaces = 8,
+                                         size_t mountpoints = 16,
+                                         size_t packages = 200) {
+        std::ostringstream json {};
+        json << "{\"os\":{\"name\":\"Ubuntu\",\"family\":\"Debian\","
+             << "\"release\":{\"full\":\"16.04\",\"major\":\"16.04\"},"
+             << "\"distro\":{\"codename\":\"xenial\",\"description\":\"Ubuntu 16.04.1 LTS\"},"
+             << "\"selinux\":{\"enabled\":false}},"
+             << "\"kernel\":\"Linux\",\"kernelrelease\":\"4.4.0-31-generic\","
+             << "\"processors\":{\"count\":8,\"physicalcount\":1,\"isa\":\"x86_64\",\"models\":[";
+
+        for (size_t i = 0; i < 8; i++) {
+            json << (i ? "," : "") << "\"Intel(R) Core(TM) i7-6700 CPU @ 3.40GHz\"";
+        }
+
+        json << "]},\"memory\":{\"system\":{\"total\":\"15.56 GiB\",\"total_bytes\":16708087808,"
+             << "\"used_bytes\":4876513280,\"available_bytes\":11831574528,\"capacity\":\"29.19%\"},"
+             << "\"swap\":{\"total_bytes\":17058230272,\"used_bytes\":0,\"capacity\":\"0%\"}},"
+             << "\"networking\":{\"hostname\":\"agent01\",\"domain\":\"example.com\","
+             << "\"fqdn\":\"agent01.example.com\",\"primary\":\"eth0\",\"interfaces\":{";
+
+        for (size_t i = 0; i < interfaces; i++) {
+            json << (i ? "," : "") << "\"eth" << i << "\":{"
+                 << "\"ip\":\"10.0." << i << ".17\",\"netmask\":\"255.255.255.0\","
+                 << "\"network\":\"10.0." << i << ".0\",\"mtu\":1500,"
+                 << "\"mac\":\"52:54:00:12:34:" << (10 + i) << "\","
+                 << "\"bindings\":[{\"address\":\"10.0." << i << ".17\",\"netmask\":\"255.255.255.0\","
+                 << "\"network\":\"10.0." << i << ".0\"}],"
+                 << "\"bindings6\":[{\"address\":\"fe80::5054:ff:fe12:34" << (10 + i) << "\","
+                 << "\"netmask\":\"ffff:ffff:ffff:ffff::\",\"network\":\"fe80::\"}]}";
+        }
+
+        json << "}},\"mountpoints\":{";
+
+        for (size_t i = 0; i < mountpoints; i++) {
+            json << (i ? "," : "") << "\"/srv/volume" << i << "\":{"
+                 << "\"device\":\"/dev/sdb" << i << "\",\"filesystem\":\"ext4\","
+                 << "\"size_bytes\":" << (i + 1) * 107374182400 << ","
+                 << "\"used_bytes\":" << (i + 1) * 5368709120 << ","
+                 << "\"capacity\":\"" << (i % 100) << ".00%\","
+                 << "\"options\":[\"rw\",\"relatime\",\"errors=remount-ro\",\"data=ordered\"]}";
+        }
+
+        json << "},\"ssh\":{\"rsa\":{\"fingerprints\":{"
+             << "\"sha1\":\"SSHFP 1 1 5c7e1e3d6f0b8a4c2d9e7f1a3b5c7d9e1f3a5b7c\","
+             << "\"sha256\":\"SSHFP 1 2 0a1b2c3d4e5f60718293a4b5c6d7e8f90a1b2c3d4e5f60718293a4b5c6d7e8f9\"},"
+             << "\"key\":\"" << std::string(372, 'A') << "\"}},"
+             << "\"packages\":{";
+
+        for (size_t i = 0; i < packages; i++) {
+            json << (i ? "," : "") << "\"package-" << i << "\":{"
+                 << "\"version\":\"" << i % 7 << "." << i % 13 << "." << i << "-1ubuntu1\","
+                 << "\"provider\":\"apt\",\"installed\":" << (i % 5 ? "true" : "false") << "}";
+        }
+
+        json << "},\"system_uptime\":{\"days\":12,\"hours\":290,\"seconds\":1044653,"
+             << "\"uptime\":\"12 days\"},\"is_virtual\":true,\"virtual\":\"kvm\","
+             << "\"timezone\":\"UTC\",\"path\":\"/usr/local/sbin:/usr/local/bin:/usr/sbin:"
+             << "/usr/bin:/sbin:/bin\"}";
+        return json.str();
+    }
+
+    // An array of objects resembling inventory records
+    inline std::string recordsDocument(size_t records) {
+        std::ostringstream json {};
+        json << "[";
+
+        for (size_t i = 0; i < records; i++) {
+            json << (i ? "," : "")
+                 << "{\"id\":" << i
+                 << ",\"name\":\"resource-" << i << "\""
+                 << ",\"path\":\"/var/lib/resources/resource-" << i << "/state.json\""
+                 << ",\"size\":" << i * 4096
+                 << ",\"ratio\":" << i / 7.0
+                 << ",\"enabled\":" << (i % 2 ? "true" : "false")
+                 << ",\"tags\":[\"a\",\"b\",\"c\"]}";
+        }
+
+        json << "]";
+        return json.str();
+    }
+
+    // A wide object of small nested objects, keyed by fact name
+    inline std::string factsDocument(size_t facts) {
+        std::string json { "{" };
+
+        for (size_t i = 0; i < facts; i++) {
+            json += (i ? "," : "");
+            json += "\"fact" + std::to_string(i) + "\":{\"value\":\"v\",\"size\":" +
+                    std::to_string(i) + ",\"ratio\":0.5,\"list\":[1,2]}";
+        }
+
+        json += "}";
+        return json;
+    }
+
+    // An array of long strings, with escapes and non-ASCII characters,
+    // resembling log messages
+    inline std::string stringsDocument(size_t strings) {
+        std::ostringstream json {};
+        json << "[";
+
+        for (size_t i = 0; i < strings; i++) {
+            json << (i ? "," : "")
+                 << "\"2016-05-04 12:00:" << i % 60 << " INFO  puppetlabs.agent - "
+                 << "Applied catalog \\\"production\\\" in " << i % 97 << ".5 seconds;"
+                 << " resource File[/etc/caf\\u00e9/motd] changed from \\t\\\"absent\\\" to"
+                 << " \\\"file\\\"\\n\\u2713 done (résumé #" << i << ")\"";
+        }
+
+        json << "]";
+        return json.str();
+    }
+
+    // Arrays of integers and reals, resembling metric series
+    inline std::string numbersDocument(size_t numbers) {
+        std::ostringstream json {};
+        json << "{\"timestamps\":[";
+
+        for (size_t i = 0; i < numbers; i++) {
+            json << (i ? "," : "") << 1462363200000 + i * 1000;
+        }
+
+        json << "],\"values\":[";
+
+        for (size_t i = 0; i < numbers; i++) {
+            json << (i ? "," : "") << (i % 1000) / 7.0 - 50;
+        }
+
+        json << "],\"counts\":[";
+
+        for (size_t i = 0; i < numbers; i++) {
+            json << (i ? "," : "") << static_cast<int>(i % 4099) - 2048;
+        }
+
+        json << "]}";
+        return json.str();
+    }
+
+}}}  // namespace leatherman::json_container::corpus
@@ -1,6 +1,10 @@
 #include <catch.hpp>
 #include <leatherman/json_container/json_container.hpp>
 #include <iostream>
+#include <sstream>
+#include <cstdio>
+#include <algorithm>
+#include <thread>
 
 static const std::string JSON = "{\"foo\" : {\"bar\" : 2},"
                                 " \"goo\" : 1,"
@@ -132,6 +136,27 @@ TEST_CASE("JsonContainer::get for object entries", "[data]") {
         REQUIRE(data.get<double>("real") == 3.1415);
     }
 
+    SECTION("it can get 64-bit integer values") {
+        JsonContainer big { "{\"min\" : -9223372036854775808,"
+                            " \"max\" : 18446744073709551615,"
+                            " \"small\" : 1, \"negative\" : -1,"
+                            " \"vec\" : [1, 4294967296]}" };
+        REQUIRE(big.get<int64_t>("min") == INT64_MIN);
+        REQUIRE(big.get<uint64_t>("max") == UINT64_MAX);
+        REQUIRE(big.get<int64_t>("small") == 1);
+        REQUIRE(big.get<uint64_t>("small") == 1u);
+        REQUIRE(big.get<std::vector<int64_t>>("vec") == std::vector<int64_t>({ 1, 4294967296 }));
+        REQUIRE(big.get<std::vector<uint64_t>>("vec") == std::vector<uint64_t>({ 1, 4294967296 }));
+
+        SECTION("it throws a data_type_error if the value doesn't fit") {
+            REQUIRE_THROWS_AS(big.get<int>("min"), data_type_error);
+            REQUIRE_THROWS_AS(big.get<int64_t>("max"), data_type_error);
+            REQUIRE_THROWS_AS(big.get<uint64_t>("negative"), data_type_error);
+            REQUIRE_THROWS_AS(big.get<std::vector<int>>("vec"), data_type_error);
+            REQUIRE_THROWS_AS(data.get<int64_t>("real"), data_type_error);
+        }
+    }
+
     SECTION("it can get a vector") {
         std::vector<int> tmp { 1, 2 };
         std::vector<int> result { data.get<std::vector<int>>("vec") };
@@ -443,6 +468,99 @@ TEST_CASE("JsonContainer::getWithDefault", "[data]") {
     }
 }
 
+TEST_CASE("JsonContainer::getArray", "[data]") {
+    JsonContainer data { "{\"ints\" : [1, -2, 3], \"reals\" : [0.5, 1.5],"
+                         " \"big\" : [5000000000, 1], \"flags\" : [true, false],"
+                         " \"mixed\" : [1, 2.5], \"nested\" : {\"ints\" : [7]}}" };
+
+    SECTION("it copies the elements into the output buffer") {
+        int ints[3];
+        REQUIRE(data.getArray<int>("ints", ints, 3) == 3u);
+        REQUIRE(ints[0] == 1);
+        REQUIRE(ints[1] == -2);
+        REQUIRE(ints[2] == 3);
+
+        double reals[4];
+        REQUIRE(data.getArray<double>("reals", reals, 4) == 2u);
+        REQUIRE(reals[1] == 1.5);
+
+        int64_t big[2];
+        REQUIRE(data.getArray<int64_t>("big", big, 2) == 2u);
+        REQUIRE(big[0] == 5000000000);
+
+        bool flags[2];
+        REQUIRE(data.getArray<bool>("flags", flags, 2) == 2u);
+        REQUIRE(flags[0]);
+        REQUIRE_FALSE(flags[1]);
+
+        REQUIRE(data.getArray<int>({ "nested", "ints" }, ints, 3) == 1u);
+        REQUIRE(ints[0] == 7);
+    }
+
+    SECTION("it can copy the root array") {
+        JsonContainer root { "[1, 2]" };
+        uint64_t values[2];
+        REQUIRE(root.getArray<uint64_t>(values, 2) == 2u);
+        REQUIRE(values[1] == 2u);
+    }
+
+    SECTION("it throws a data_type_error in case of mismatching elements") {
+        int ints[2];
+        double reals[2];
+        REQUIRE_THROWS_AS(data.getArray<int>("mixed", ints, 2), data_type_error);
+        REQUIRE_THROWS_AS(data.getArray<double>("mixed", reals, 2), data_type_error);
+        REQUIRE_THROWS_AS(data.getArray<int>("big", ints, 2), data_type_error);
+        REQUIRE_THROWS_AS(data.getArray<int>("nested", ints, 2), data_type_error);
+    }
+
+    SECTION("it throws a data_index_error in case the output is too small") {
+        int ints[2];
+        REQUIRE_THROWS_AS(data.getArray<int>("ints", ints, 2), data_index_error);
+    }
+
+    SECTION("it throws a data_key_error in case of unknown keys") {
+        int ints[2];
+        REQUIRE_THROWS_AS(data.getArray<int>("unknown", ints, 2), data_key_error);
+    }
+}
+
+TEST_CASE("JsonContainer::getColumn", "[data]") {
+    JsonContainer data { "{\"samples\" : [{\"name\" : \"a\", \"value\" : 1.5, \"count\" : 1},"
+                         "               {\"name\" : \"b\", \"value\" : 2.5, \"count\" : 2}],"
+                         " \"partial\" : [{\"value\" : 1.5}, {}],"
+                         " \"scalars\" : [1, 2]}" };
+
+    SECTION("it copies the field of each object") {
+        double values[2];
+        int counts[2];
+        REQUIRE(data.getColumn<double>("samples", "value", values, 2) == 2u);
+        REQUIRE(data.getColumn<int>("samples", "count", counts, 2) == 2u);
+        REQUIRE(values[0] == 1.5);
+        REQUIRE(values[1] == 2.5);
+        REQUIRE(counts[1] == 2);
+    }
+
+    SECTION("it throws a data_key_error in case an object lacks the field") {
+        double values[2];
+        REQUIRE_THROWS_AS(data.getColumn<double>("partial", "value", values, 2),
+                          data_key_error);
+    }
+
+    SECTION("it throws a data_type_error in case of mismatching values") {
+        double values[2];
+        REQUIRE_THROWS_AS(data.getColumn<double>("samples", "count", values, 2),
+                          data_type_error);
+        REQUIRE_THROWS_AS(data.getColumn<double>("scalars", "value", values, 2),
+                          data_type_error);
+    }
+
+    SECTION("it throws a data_index_error in case the output is too small") {
+        double values[1];
+        REQUIRE_THROWS_AS(data.getColumn<double>("samples", "value", values, 1),
+                          data_index_error);
+    }
+}
+
 TEST_CASE("JsonContainer::toString", "[data]") {
     SECTION("root entry") {
         SECTION("object") {
@@ -478,6 +596,168 @@ TEST_CASE("JsonContainer::toString", "[data]") {
     }
 }
 
+TEST_CASE("JsonContainer::toStringReserved", "[data]") {
+    SECTION("it returns the same text as toString") {
+        JsonContainer data { JSON };
+        REQUIRE(data.toStringReserved() == data.toString());
+    }
+
+    SECTION("it returns text longer than its estimate") {
+        JsonContainer escaped {};
+        escaped.set<std::vector<std::string>>("strings",
+                                              std::vector<std::string>(1000, "\"\n\t\u0001"));
+        escaped.set<double>("pi", 3.14159265358979);
+        REQUIRE(escaped.toStringReserved() == escaped.toString());
+    }
+}
+
+TEST_CASE("JsonContainer::write", "[data]") {
+    JsonContainer data { JSON };
+
+    SECTION("it writes the same text as toString to a stream") {
+        std::ostringstream output {};
+        data.write(output);
+        REQUIRE(output.str() == data.toString());
+    }
+
+    SECTION("it writes documents bigger than its buffer") {
+        JsonContainer big {};
+        big.set<std::vector<std::string>>("strings",
+                                          std::vector<std::string>(10000, "some text"));
+        std::ostringstream output {};
+        big.write(output);
+        REQUIRE(output.str() == big.toString());
+    }
+
+    SECTION("it writes scalars") {
+        JsonContainer s { "\"foo\"" };
+        std::ostringstream output {};
+        s.write(output);
+        REQUIRE(output.str() == "\"foo\"");
+    }
+
+    SECTION("it writes to a file descriptor") {
+        auto fp = std::tmpfile();
+        REQUIRE(fp != nullptr);
+#ifdef _WIN32
+        data.write(_fileno(fp));
+#else
+        data.write(fileno(fp));
+#endif
+        std::rewind(fp);
+        std::string output {};
+        char buffer[256];
+        size_t count;
+        while ((count = std::fread(buffer, 1, sizeof(buffer), fp)) > 0) {
+            output.append(buffer, count);
+        }
+        std::fclose(fp);
+        REQUIRE(output == data.toString());
+    }
+
+    SECTION("it throws a data_error if the stream fails") {
+        std::ostringstream output {};
+        output.setstate(std::ios::badbit);
+        REQUIRE_THROWS_AS(data.write(output), data_error);
+    }
+}
+
+TEST_CASE("JsonContainer::toCBOR", "[data]") {
+    SECTION("it encodes scalars") {
+        REQUIRE(JsonContainer { "null" }.toCBOR() == "\xf6");
+        REQUIRE(JsonContainer { "true" }.toCBOR() == "\xf5");
+        REQUIRE(JsonContainer { "23" }.toCBOR() == "\x17");
+        REQUIRE(JsonContainer { "1000000" }.toCBOR() == std::string("\x1a\x00\x0f\x42\x40", 5));
+        REQUIRE(JsonContainer { "-1000" }.toCBOR() == "\x39\x03\xe7");
+        REQUIRE(JsonContainer { "\"IETF\"" }.toCBOR() == "\x64IETF");
+    }
+
+    SECTION("it encodes doubles in single precision when exact") {
+        REQUIRE(JsonContainer { "1.5" }.toCBOR() == std::string("\xfa\x3f\xc0\x00\x00", 5));
+        REQUIRE(JsonContainer { "1.1" }.toCBOR() == "\xfb\x3f\xf1\x99\x99\x99\x99\x99\x9a");
+    }
+
+    SECTION("it encodes containers with definite lengths") {
+        REQUIRE(JsonContainer { "{\"a\" : [1, -1]}" }.toCBOR() == "\xa1\x61" "a\x82\x01\x20");
+        REQUIRE(JsonContainer { "[]" }.toCBOR() == "\x80");
+    }
+
+    SECTION("it writes the same bytes to a stream") {
+        JsonContainer big {};
+        big.set<std::vector<std::string>>("strings",
+                                          std::vector<std::string>(10000, "some text"));
+        big.set<std::string>("long", std::string(100000, 'x'));
+        std::ostringstream output {};
+        big.writeCBOR(output);
+        REQUIRE(output.str() == big.toCBOR());
+    }
+}
+
+TEST_CASE("JsonContainer::fromCBOR", "[data]") {
+    SECTION("it round-trips all types") {
+        JsonContainer data { "{\"int\" : 42, \"negative\" : -7, \"zero\" : 0,"
+                             " \"min\" : -9223372036854775808, \"max\" : 18446744073709551615,"
+                             " \"real\" : 3.1415, \"single\" : 0.5, \"whole\" : 2.0,"
+                             " \"tiny\" : 1e-300, \"huge\" : 1e300, \"negative_zero\" : -0.0,"
+                             " \"string\" : \"a string\\u0000with null\", \"utf8\" : \"\\u00e9\\u4e2d\","
+                             " \"empty\" : \"\", \"true\" : true, \"false\" : false, \"null\" : null,"
+                             " \"vec\" : [1, [2, [3, {}]], []], \"nested\" : {\"foo\" : {\"bar\" : 1}}}" };
+        auto copy = JsonContainer::fromCBOR(data.toCBOR());
+
+        REQUIRE(copy.toString() == data.toString());
+        REQUIRE(copy.type("int") == DataType::Int);
+        REQUIRE(copy.type("min") == DataType::Int64);
+        REQUIRE(copy.type("max") == DataType::Uint64);
+        REQUIRE(copy.type("whole") == DataType::Double);
+        REQUIRE(copy.get<double>("real") == data.get<double>("real"));
+        REQUIRE(copy.get<std::string>("string") == data.get<std::string>("string"));
+        REQUIRE(copy.keys() == data.keys());
+    }
+
+    SECTION("it decodes indefinite lengths, half precision and tags") {
+        const char cbor[] = "\x9f\x01\xf9\x3c\x00\xbf\x61" "a\x7f\x62" "ab\x61" "c\xff\xff"
+                            "\xc1\x1a\x51\x4b\x67\xb0\xff";
+        auto data = JsonContainer::fromCBOR(std::string(cbor, sizeof(cbor) - 1));
+        REQUIRE(data.toString() == "[1,1.0,{\"a\":\"abc\"},1363896240]");
+    }
+
+    SECTION("it reads from a file descriptor") {
+        JsonContainer data { JSON };
+        data.set<std::string>("long", std::string(100000, 'x'));
+        auto fp = std::tmpfile();
+        REQUIRE(fp != nullptr);
+#ifdef _WIN32
+        auto fd = _fileno(fp);
+#else
+        auto fd = fileno(fp);
+#endif
+        data.writeCBOR(fd);
+        std::rewind(fp);
+        auto copy = JsonContainer::fromCBOR(fd);
+        std::fclose(fp);
+        REQUIRE(copy.toString() == data.toString());
+    }
+
+    SECTION("it throws a data_parse_error in case of invalid or unsupported CBOR") {
+        // truncated
+        REQUIRE_THROWS_AS(JsonContainer::fromCBOR(""), data_parse_error);
+        REQUIRE_THROWS_AS(JsonContainer::fromCBOR("\x82\x01"), data_parse_error);
+        REQUIRE_THROWS_AS(JsonContainer::fromCBOR("\x65" "abc"), data_parse_error);
+        // trailing data
+        REQUIRE_THROWS_AS(JsonContainer::fromCBOR("\x01\x02"), data_parse_error);
+        // byte string, non-string key, undefined
+        REQUIRE_THROWS_AS(JsonContainer::fromCBOR("\x41" "a"), data_parse_error);
+        REQUIRE_THROWS_AS(JsonContainer::fromCBOR("\xa1\x01\x02"), data_parse_error);
+        REQUIRE_THROWS_AS(JsonContainer::fromCBOR("\xf7"), data_parse_error);
+        // integer less than INT64_MIN, infinity
+        REQUIRE_THROWS_AS(JsonContainer::fromCBOR("\x3b\xff\xff\xff\xff\xff\xff\xff\xff"),
+                          data_parse_error);
+        REQUIRE_THROWS_AS(JsonContainer::fromCBOR("\xf9\x7c\x00"), data_parse_error);
+        // nesting too deep
+        REQUIRE_THROWS_AS(JsonContainer::fromCBOR(std::string(10000, '\x81')), data_parse_error);
+    }
+}
+
 TEST_CASE("JsonContainer::toPrettyString", "[data]") {
     SECTION("does not throw when the root is") {
         SECTION("a string") {
@@ -509,6 +789,51 @@ TEST_CASE("JsonContainer::toPrettyString", "[data]") {
             REQUIRE_NOTHROW(data_ooa.toPrettyString());
         }
     }
+
+    SECTION("it prints a key : value line per member") {
+        JsonContainer data { "{\"s\" : \"text\", \"i\" : -5000000000,"
+                             " \"d\" : 2.5, \"b\" : true, \"n\" : null,"
+                             " \"a\" : [1, \"x\"], \"o\" : {\"k\" : 1, \"e\" : {}}}" };
+        REQUIRE(data.toPrettyString(0) ==
+                "s : text\n"
+                "i : -5000000000\n"
+                "d : 2.500000\n"
+                "b : true\n"
+                "n : NULL\n"
+                "a : [1,\"x\"]\n"
+                "o : \n"
+                "  k : 1\n"
+                "  e : \n"
+                "{}\n"
+                "\n");
+    }
+
+    SECTION("it prints non-object roots as JSON") {
+        REQUIRE(JsonContainer { "[1, 2]" }.toPrettyString() == "[1,2]");
+        REQUIRE(JsonContainer { "\"str\"" }.toPrettyString() == "\"str\"");
+        REQUIRE(JsonContainer {}.toPrettyString() == "{}");
+    }
+}
+
+TEST_CASE("JsonContainer::toIndentedString", "[data]") {
+    SECTION("it returns indented JSON") {
+        JsonContainer data { "{\"a\" : [1, {\"b\" : \"c\"}], \"d\" : {}}" };
+        REQUIRE(data.toIndentedString(2) ==
+                "{\n"
+                "  \"a\": [\n"
+                "    1,\n"
+                "    {\n"
+                "      \"b\": \"c\"\n"
+                "    }\n"
+                "  ],\n"
+                "  \"d\": {}\n"
+                "}");
+    }
+
+    SECTION("the output can be parsed back") {
+        JsonContainer data { JSON };
+        REQUIRE(JsonContainer { data.toIndentedString() }.toString() == data.toString());
+    }
 }
 
 TEST_CASE("JsonContainer::empty", "[data]") {
@@ -649,6 +974,18 @@ TEST_CASE("JsonContainer::set", "[data]") {
         REQUIRE(msg.get<int>("i entry") == 5);
     }
 
+    SECTION("it allows setting 64-bit integer values") {
+        msg.set<int64_t>("i64 entry", INT64_MIN);
+        msg.set<uint64_t>("u64 entry", UINT64_MAX);
+        msg.set<std::vector<int64_t>>("i64 vector", { -1, 5000000000 });
+        msg.set<std::vector<uint64_t>>("u64 vector", { 1, UINT64_MAX });
+        REQUIRE(msg.get<int64_t>("i64 entry") == INT64_MIN);
+        REQUIRE(msg.get<uint64_t>("u64 entry") == UINT64_MAX);
+        REQUIRE(msg.get<std::vector<int64_t>>("i64 vector") == std::vector<int64_t>({ -1, 5000000000 }));
+        REQUIRE(msg.get<std::vector<uint64_t>>("u64 vector") == std::vector<uint64_t>({ 1, UINT64_MAX }));
+        REQUIRE(msg.toString("u64 entry") == "18446744073709551615");
+    }
+
     SECTION("it allows resetting a double value") {
         msg.set<double>("d entry", 3.14159);
         REQUIRE(msg.includes("d entry"));
@@ -751,6 +1088,478 @@ TEST_CASE("JsonContainer::set", "[data]") {
     }
 }
 
+TEST_CASE("JsonContainer::mergePatch", "[data]") {
+    JsonContainer data { "{\"a\" : \"b\", \"c\" : {\"d\" : \"e\", \"f\" : \"g\"}, \"h\" : [1, 2]}" };
+
+    SECTION("it merges objects recursively and removes null members") {
+        data.mergePatch(JsonContainer { "{\"a\" : \"z\", \"c\" : {\"f\" : null, \"x\" : {\"y\" : null}}}" });
+        REQUIRE(data.toString() == "{\"a\":\"z\",\"c\":{\"d\":\"e\",\"x\":{}},\"h\":[1,2]}");
+    }
+
+    SECTION("it replaces arrays as a whole") {
+        data.mergePatch(JsonContainer { "{\"h\" : [3]}" });
+        REQUIRE(data.get<std::vector<int>>("h") == std::vector<int>({ 3 }));
+    }
+
+    SECTION("it keeps the order of the remaining members") {
+        data.mergePatch(JsonContainer { "{\"a\" : null}" });
+        REQUIRE(data.keys() == std::vector<std::string>({ "c", "h" }));
+    }
+
+    SECTION("it replaces the root with a patch that is not an object") {
+        data.mergePatch(JsonContainer { "[\"x\"]" });
+        REQUIRE(data.toString() == "[\"x\"]");
+
+        data.mergePatch(JsonContainer { "{\"a\" : 1}" });
+        REQUIRE(data.toString() == "{\"a\":1}");
+    }
+
+    SECTION("it distinguishes integers and doubles") {
+        data.mergePatch(JsonContainer { "{\"a\" : 1}" });
+        data.mergePatch(JsonContainer { "{\"a\" : 1.0}" });
+        REQUIRE(data.type("a") == DataType::Double);
+    }
+
+    SECTION("it invalidates the member index") {
+        data.enableMemberIndex(1);
+        REQUIRE(data.get<std::string>("a") == "b");
+        data.mergePatch(JsonContainer { "{\"a\" : null, \"n\" : 1}" });
+        REQUIRE_FALSE(data.includes("a"));
+        REQUIRE(data.get<int>("n") == 1);
+    }
+}
+
+TEST_CASE("JsonContainer::diff", "[data]") {
+    JsonContainer data { "{\"a\" : 1, \"b\" : {\"c\" : \"d\", \"e/f\" : [1, 2, 3]}, \"g\" : true}" };
+
+    SECTION("it returns an empty patch for equal documents") {
+        REQUIRE(data.diff(data).toString() == "[]");
+        REQUIRE(data.diff(JsonContainer { data }).toString() == "[]");
+    }
+
+    SECTION("it ignores the order of the members") {
+        JsonContainer other { "{\"g\" : true, \"b\" : {\"e/f\" : [1, 2, 3], \"c\" : \"d\"}, \"a\" : 1}" };
+        REQUIRE(data.diff(other).toString() == "[]");
+    }
+
+    SECTION("it reports added, removed and replaced members") {
+        JsonContainer other { "{\"a\" : 1.0, \"b\" : {\"c\" : \"x\", \"e/f\" : [1, 2, 3]}, \"h~\" : null}" };
+        REQUIRE(data.diff(other).toString() ==
+                "[{\"op\":\"replace\",\"path\":\"/a\",\"value\":1.0},"
+                "{\"op\":\"replace\",\"path\":\"/b/c\",\"value\":\"x\"},"
+                "{\"op\":\"remove\",\"path\":\"/g\"},"
+                "{\"op\":\"add\",\"path\":\"/h~0\",\"value\":null}]");
+    }
+
+    SECTION("it keeps matching the members in order after a removed or added one") {
+        JsonContainer before {};
+        JsonContainer after {};
+        before.set<int>("removed", 0);
+
+        for (int i = 0; i < 100; i++) {
+            before.set<int>("k" + std::to_string(i), i);
+            after.set<int>("k" + std::to_string(i), i == 50 ? -1 : i);
+        }
+
+        after.set<int>("added", 1);
+        REQUIRE(before.diff(after).toString() ==
+                "[{\"op\":\"remove\",\"path\":\"/removed\"},"
+                "{\"op\":\"replace\",\"path\":\"/k50\",\"value\":-1},"
+                "{\"op\":\"add\",\"path\":\"/added\",\"value\":1}]");
+    }
+
+    SECTION("it compares arrays element by element") {
+        JsonContainer longer { "{\"a\" : 1, \"b\" : {\"c\" : \"d\", \"e/f\" : [1, 5, 3, 4]}, \"g\" : true}" };
+        REQUIRE(data.diff(longer).toString() ==
+                "[{\"op\":\"replace\",\"path\":\"/b/e~1f/1\",\"value\":5},"
+                "{\"op\":\"add\",\"path\":\"/b/e~1f/3\",\"value\":4}]");
+
+        JsonContainer shorter { "{\"a\" : 1, \"b\" : {\"c\" : \"d\", \"e/f\" : [1]}, \"g\" : true}" };
+        REQUIRE(data.diff(shorter).toString() ==
+                "[{\"op\":\"remove\",\"path\":\"/b/e~1f/2\"},"
+                "{\"op\":\"remove\",\"path\":\"/b/e~1f/1\"}]");
+    }
+
+    SECTION("it replaces the root when the types differ") {
+        REQUIRE(data.diff(JsonContainer { "[1]" }).toString() ==
+                "[{\"op\":\"replace\",\"path\":\"\",\"value\":[1]}]");
+    }
+}
+
+TEST_CASE("JsonContainer - using a JsonContainerPath", "[data]") {
+    JsonContainer data { JSON };
+    JsonContainerPath foo_bar { { "foo", "bar" } };
+
+    SECTION("it can get a nested value") {
+        REQUIRE(data.get<int>(foo_bar) == 2);
+        REQUIRE(data.get<int>(JsonContainerPath { { "vec" } }, 1) == 2);
+    }
+
+    SECTION("it finds keys containing null characters") {
+        JsonContainer with_null { "{\"a\\u0000b\" : 1, \"a\" : 2}" };
+        JsonContainerPath path { { std::string { "a\0b", 3 } } };
+        REQUIRE(with_null.get<int>(path) == 1);
+    }
+
+    SECTION("it can set a nested value, creating the missing keys") {
+        JsonContainerPath path { { "new", "nested", "key" } };
+        data.set<int>(path, 42);
+        data.set<int>(foo_bar, 3);
+        REQUIRE(data.get<int>({ "new", "nested", "key" }) == 42);
+        REQUIRE(data.get<int>(foo_bar) == 3);
+    }
+
+    SECTION("it supports includes, type, size, getWithDefault and toString") {
+        REQUIRE(data.includes(foo_bar));
+        REQUIRE_FALSE(data.includes(JsonContainerPath { { "foo", "baz" } }));
+        REQUIRE(data.type(foo_bar) == DataType::Int);
+        REQUIRE(data.type(JsonContainerPath { { "vec" } }, 0) == DataType::Int);
+        REQUIRE(data.size(JsonContainerPath { { "vec" } }) == 2u);
+        REQUIRE(data.getWithDefault<int>(JsonContainerPath { { "foo", "baz" } }, 7) == 7);
+        REQUIRE(data.toString(foo_bar) == "2");
+    }
+
+    SECTION("it throws a data_key_error in case of unknown keys") {
+        REQUIRE_THROWS_AS(data.get<int>(JsonContainerPath { { "foo", "baz" } }),
+                          data_key_error);
+    }
+}
+
+TEST_CASE("JsonContainer::enableMemberIndex", "[data]") {
+    JsonContainer data {};
+
+    for (int i = 0; i < 100; i++) {
+        data.set<int>("key" + std::to_string(i), i);
+    }
+
+    data.set<int>({ "nested", "a" }, 1);
+    data.enableMemberIndex(4);
+
+    SECTION("it looks up the members of indexed objects") {
+        REQUIRE(data.get<int>("key42") == 42);
+        REQUIRE(data.get<int>(JsonContainerPath { { "key99" } }) == 99);
+        REQUIRE(data.get<int>({ "nested", "a" }) == 1);
+        REQUIRE(data.includes("key0"));
+        REQUIRE_FALSE(data.includes("key100"));
+        REQUIRE_THROWS_AS(data.get<int>("key100"), data_key_error);
+    }
+
+    SECTION("it keeps finding entries after the container is modified") {
+        REQUIRE(data.get<int>("key1") == 1);
+
+        for (int i = 100; i < 200; i++) {
+            data.set<int>("key" + std::to_string(i), i);
+        }
+
+        data.set<int>("key1", -1);
+        REQUIRE(data.get<int>("key150") == 150);
+        REQUIRE(data.get<int>("key1") == -1);
+        REQUIRE(data.get<int>("key7") == 7);
+    }
+
+    SECTION("it returns the first of duplicated keys, as without index") {
+        JsonContainer duplicated { "{\"a\":1, \"b\":2, \"a\":3}" };
+        duplicated.enableMemberIndex(1);
+        REQUIRE(duplicated.get<int>("a") == 1);
+    }
+
+    SECTION("the container can be read by several threads") {
+        const JsonContainer& shared = data;
+        std::vector<std::thread> threads {};
+        std::vector<int> results(4);
+
+        for (int i = 0; i < 4; i++) {
+            threads.emplace_back([&shared, &results, i] {
+                for (int j = 0; j < 100; j++) {
+                    results[i] += shared.get<int>("key" + std::to_string(j)) +
+                                  (shared.includes({ "nested", "a" }) ? 1 : 0);
+                }
+            });
+        }
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        for (int i = 0; i < 4; i++) {
+            REQUIRE(results[i] == 4950 + 100);
+        }
+    }
+
+    SECTION("copies are indexed as well") {
+        data.get<int>("key1");
+        JsonContainer copy { data };
+        copy.set<int>("key1", 0);
+        REQUIRE(copy.get<int>("key1") == 0);
+        REQUIRE(data.get<int>("key1") == 1);
+    }
+}
+
+TEST_CASE("JsonContainer::hash", "[data]") {
+    JsonContainer data { JSON };
+
+    SECTION("equal documents have equal hashes") {
+        REQUIRE(data.hash() == JsonContainer { JSON }.hash());
+        REQUIRE(data.hash() == JsonContainer { data.toString() }.hash());
+    }
+
+    SECTION("it ignores the order of the members") {
+        REQUIRE(JsonContainer { "{\"a\" : 1, \"b\" : [true, null]}" }.hash() ==
+                JsonContainer { "{\"b\" : [true, null], \"a\" : 1}" }.hash());
+    }
+
+    SECTION("it distinguishes the values") {
+        std::vector<std::string> values { "{}", "[]", "null", "true", "false", "0", "1", "1.0",
+                                          "-1", "0.5", "\"1\"", "\"\"", "[1, 2]", "[2, 1]",
+                                          "[[1], 2]", "[1, [2]]", "{\"a\" : 1, \"b\" : 2}",
+                                          "{\"a\" : 2, \"b\" : 1}", "{\"a\" : {}}", "{\"b\" : {}}",
+                                          "18446744073709551615" };
+        std::vector<uint64_t> hashes {};
+
+        for (const auto& value : values) {
+            hashes.push_back(JsonContainer { value }.hash());
+        }
+
+        std::sort(hashes.begin(), hashes.end());
+        REQUIRE(std::unique(hashes.begin(), hashes.end()) == hashes.end());
+    }
+
+    SECTION("it can hash an entry") {
+        REQUIRE(data.hash("nested") == JsonContainer { "{\"foo\" : \"bar\"}" }.hash());
+        REQUIRE(data.hash({ "foo", "bar" }) == JsonContainer { "2" }.hash());
+        REQUIRE(data.hash(JsonContainerPath { { "foo", "bar" } }) == JsonContainer { "2" }.hash());
+        REQUIRE_THROWS_AS(data.hash("unknown"), data_key_error);
+    }
+}
+
+TEST_CASE("JsonContainer::enableHashCache", "[data]") {
+    JsonContainer data { JSON };
+    data.enableHashCache();
+    auto hash = data.hash();
+
+    SECTION("cached hashes are the same as computed ones") {
+        REQUIRE(data.hash() == hash);
+        REQUIRE(data.hash() == JsonContainer { JSON }.hash());
+    }
+
+    SECTION("set drops the hashes of the modified entries") {
+        auto nested = data.hash("nested");
+        auto vec = data.hash("vec");
+        data.set<std::string>({ "nested", "foo" }, "baz");
+        REQUIRE(data.hash() != hash);
+        REQUIRE(data.hash("nested") != nested);
+        REQUIRE(data.hash("vec") == vec);
+
+        data.set<std::string>({ "nested", "foo" }, "bar");
+        REQUIRE(data.hash() == hash);
+        REQUIRE(data.hash("nested") == nested);
+    }
+
+    SECTION("it stays consistent across replaced and added entries") {
+        JsonContainer plain { JSON };
+
+        for (int i = 0; i < 100; i++) {
+            auto key = "key" + std::to_string(i % 7);
+            data.set<std::vector<int>>({ "nested", key }, std::vector<int>(i % 5 + 1, i));
+            plain.set<std::vector<int>>({ "nested", key }, std::vector<int>(i % 5 + 1, i));
+            data.hash({ "nested", key });
+            REQUIRE(data.hash() == plain.hash());
+
+            data.set<JsonContainer>("foo", JsonContainer { "{\"a\" : [" + std::to_string(i) + "]}" });
+            plain.set<JsonContainer>("foo", JsonContainer { "{\"a\" : [" + std::to_string(i) + "]}" });
+            REQUIRE(data.hash() == plain.hash());
+        }
+    }
+
+    SECTION("mergePatch drops the cache") {
+        data.mergePatch(JsonContainer { "{\"vec\" : [3]}" });
+        REQUIRE(data.hash("vec") == JsonContainer { "[3]" }.hash());
+    }
+}
+
+TEST_CASE("JsonContainer::enableCopyOnWrite", "[data]") {
+    JsonContainer data { JSON };
+
+    SECTION("copies don't share the document by default") {
+        JsonContainer copy { data };
+        REQUIRE(&copy.getRaw() != &data.getRaw());
+    }
+
+    data.enableCopyOnWrite();
+
+    SECTION("copies share the document until modified") {
+        JsonContainer copy { data };
+        JsonContainer assigned {};
+        assigned = data;
+        REQUIRE(&copy.getRaw() == &data.getRaw());
+        REQUIRE(&assigned.getRaw() == &data.getRaw());
+
+        copy.set<int>("goo", 2);
+        REQUIRE(&copy.getRaw() != &data.getRaw());
+        REQUIRE(copy.get<int>("goo") == 2);
+        REQUIRE(data.get<int>("goo") == 1);
+        REQUIRE(assigned.get<int>("goo") == 1);
+
+        data.set<std::string>({ "nested", "foo" }, "baz");
+        REQUIRE(&assigned.getRaw() != &data.getRaw());
+        REQUIRE(data.get<std::string>({ "nested", "foo" }) == "baz");
+        REQUIRE(assigned.get<std::string>({ "nested", "foo" }) == "bar");
+        REQUIRE(copy.get<std::string>({ "nested", "foo" }) == "bar");
+    }
+
+    SECTION("copies are in copy-on-write mode") {
+        JsonContainer copy { data };
+        JsonContainer second { copy };
+        REQUIRE(&second.getRaw() == &data.getRaw());
+    }
+
+    SECTION("a container no longer shared is modified in place") {
+        auto raw = &data.getRaw();
+        {
+            JsonContainer copy { data };
+        }
+        data.set<int>("goo", 2);
+        REQUIRE(&data.getRaw() == raw);
+    }
+
+    SECTION("copies sharing the document can be used by different threads") {
+        std::vector<std::thread> threads {};
+        std::vector<int> results(4);
+
+        for (int i = 0; i < 4; i++) {
+            threads.emplace_back([&data, &results, i] {
+                JsonContainer copy { data };
+                for (int j = 0; j < 100; j++) {
+                    results[i] += copy.get<int>("goo") + copy.get<int>({ "foo", "bar" });
+                }
+                copy.set<int>("goo", i);
+                results[i] += copy.get<int>("goo");
+            });
+        }
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        for (int i = 0; i < 4; i++) {
+            REQUIRE(results[i] == 300 + i);
+        }
+        REQUIRE(data.get<int>("goo") == 1);
+    }
+
+    SECTION("mergePatch copies a shared document") {
+        JsonContainer copy { data };
+        copy.mergePatch(JsonContainer { "{\"goo\" : null}" });
+        REQUIRE_FALSE(copy.includes("goo"));
+        REQUIRE(data.includes("goo"));
+    }
+
+    SECTION("the member index and hash cache follow the copied document") {
+        data.enableMemberIndex(1);
+        data.enableHashCache();
+        JsonContainer copy { data };
+        auto hash = data.hash();
+        REQUIRE(data.get<int>("goo") == 1);
+
+        data.set<int>("goo", 2);
+        REQUIRE(data.get<int>("goo") == 2);
+        REQUIRE(data.get<int>({ "foo", "bar" }) == 2);
+        REQUIRE(data.hash() != hash);
+        REQUIRE(copy.hash() == hash);
+        REQUIRE(copy.get<int>("goo") == 1);
+    }
+}
+
+TEST_CASE("JsonContainer - lazy parsing", "[data]") {
+    JsonContainer eager { JSON };
+    JsonContainer data { JSON, ParseMode::Lazy };
+
+    SECTION("it gets the entries of the root object") {
+        REQUIRE(data.type() == DataType::Object);
+        REQUIRE(data.size() == eager.size());
+        REQUIRE(data.keys() == eager.keys());
+        REQUIRE(data.get<int>({ "foo", "bar" }) == 2);
+        REQUIRE(data.get<std::string>("string_with_null") == std::string("a string\0with\0null", 18));
+        REQUIRE(data.get<std::vector<int>>("vec") == (std::vector<int> { 1, 2 }));
+        REQUIRE(data.type("null") == DataType::Null);
+        REQUIRE(data.includes({ "nested", "foo" }));
+        REQUIRE_FALSE(data.includes("bar"));
+    }
+
+    SECTION("it serializes as the eagerly parsed container") {
+        data.get<int>("goo");
+        REQUIRE(data.toString() == eager.toString());
+        REQUIRE(data.diff(eager).empty());
+        REQUIRE(data.hash() == eager.hash());
+    }
+
+    SECTION("it gets escaped keys") {
+        JsonContainer escaped { "{\"a\\\"b\" : 1, \"caf\\u00e9\" : [ {} ] }", ParseMode::Lazy };
+        REQUIRE(escaped.get<int>("a\"b") == 1);
+        REQUIRE(escaped.size("caf\u00e9") == 1u);
+    }
+
+    SECTION("it throws a data_parse_error in case the structure is invalid") {
+        REQUIRE_THROWS_AS(JsonContainer("{\"foo\" : [1, 2}", ParseMode::Lazy), data_parse_error);
+        REQUIRE_THROWS_AS(JsonContainer("{\"foo\" : \"bar}", ParseMode::Lazy), data_parse_error);
+        REQUIRE_THROWS_AS(JsonContainer("{\"foo\" 1}", ParseMode::Lazy), data_parse_error);
+        REQUIRE_THROWS_AS(JsonContainer("{\"foo\" : 1,}", ParseMode::Lazy), data_parse_error);
+        REQUIRE_THROWS_AS(JsonContainer("{\"foo\" : 1} {}", ParseMode::Lazy), data_parse_error);
+    }
+
+    SECTION("it throws a data_parse_error when getting an invalid value") {
+        JsonContainer invalid { "{\"foo\" : 1, \"bar\" : [tru]}", ParseMode::Lazy };
+        REQUIRE(invalid.get<int>("foo") == 1);
+        REQUIRE_THROWS_AS(invalid.get<std::vector<bool>>("bar"), data_parse_error);
+        REQUIRE_THROWS_AS(invalid.toString(), data_parse_error);
+    }
+
+    SECTION("includes doesn't throw for an invalid value") {
+        JsonContainer invalid { "{\"foo\" : {\"bar\" : tru}, \"baz\" : {\"goo\" : 1}}",
+                                ParseMode::Lazy };
+        REQUIRE(invalid.includes("foo"));
+        REQUIRE(invalid.includes(std::vector<JsonContainerKey> { "foo" }));
+        REQUIRE_FALSE(invalid.includes({ "foo", "bar" }));
+        REQUIRE_FALSE(invalid.includes(JsonContainerPath { { "foo", "bar" } }));
+        REQUIRE(invalid.includes({ "baz", "goo" }));
+        REQUIRE_THROWS_AS(invalid.get<JsonContainer>("foo"), data_parse_error);
+    }
+
+    SECTION("it can be modified") {
+        data.set<int>("goo", 3);
+        data.set<int>("new", 4);
+        data.set<std::string>({ "nested", "foo" }, "baz");
+        data.mergePatch(JsonContainer { "{\"null\" : 5}" });
+        eager.set<int>("goo", 3);
+        eager.set<int>("new", 4);
+        eager.set<std::string>({ "nested", "foo" }, "baz");
+        eager.mergePatch(JsonContainer { "{\"null\" : 5}" });
+        REQUIRE(data.toString() == eager.toString());
+    }
+
+    SECTION("its copies are complete") {
+        JsonContainer copy { data };
+        JsonContainer assigned {};
+        assigned = data;
+        REQUIRE(copy.toString() == eager.toString());
+        REQUIRE(assigned.toString() == eager.toString());
+        REQUIRE(data.toString() == eager.toString());
+    }
+
+    SECTION("it works with the member index") {
+        data.enableMemberIndex(1);
+        REQUIRE(data.get<std::string>({ "nested", "foo" }) == "bar");
+        REQUIRE(data.get<double>("real") == 3.1415);
+        REQUIRE(data.toString() == eager.toString());
+    }
+
+    SECTION("it parses other types of values at once") {
+        REQUIRE(JsonContainer("[1, 2]", ParseMode::Lazy).size() == 2u);
+        REQUIRE(JsonContainer(" {}", ParseMode::Lazy).empty());
+        REQUIRE_THROWS_AS(JsonContainer("[1, 2", ParseMode::Lazy), data_parse_error);
+    }
+}
+
 TEST_CASE("JsonContainer::keys", "[data]") {
     SECTION("It returns a vector of keys") {
         JsonContainer data { "{ \"a\" : 1, "
@@ -772,6 +1581,118 @@ TEST_CASE("JsonContainer::keys", "[data]") {
     }
 }
 
+TEST_CASE("JsonContainer::members", "[data]") {
+    JsonContainer data { JSON };
+
+    SECTION("it iterates the members in document order") {
+        std::vector<std::string> names {};
+
+        for (const auto& member : data.members()) {
+            names.push_back(member.name.to_string());
+        }
+
+        REQUIRE(names == data.keys());
+        REQUIRE(data.members().size() == data.size());
+    }
+
+    SECTION("it gives access to the values") {
+        auto members = data.members("foo");
+        auto member = *members.begin();
+        REQUIRE(member.name == "bar");
+        REQUIRE(member.value.type() == DataType::Int);
+        REQUIRE(member.value.get<int>() == 2);
+        REQUIRE(++members.begin() == members.end());
+    }
+
+    SECTION("it gives views of strings containing null characters") {
+        auto value = data.view("string_with_null").get<boost::string_ref>();
+        REQUIRE(value.size() == 18u);
+        REQUIRE(value == boost::string_ref("a string\0with\0null", 18));
+    }
+
+    SECTION("it can iterate nested values") {
+        for (const auto& member : data.members("nested")) {
+            REQUIRE(member.value.get<std::string>() == "bar");
+        }
+
+        REQUIRE(data.view("foo").members().size() == 1u);
+        REQUIRE(data.view("foo").get<JsonContainer>().get<int>("bar") == 2);
+    }
+
+    SECTION("it throws a data_type_error in case the entry is not an object") {
+        REQUIRE_THROWS_AS(data.members("vec"), data_type_error);
+        REQUIRE_THROWS_AS(data.view("goo").get<std::string>(), data_type_error);
+    }
+
+    SECTION("it throws a data_key_error in case of unknown keys") {
+        REQUIRE_THROWS_AS(data.members("unknown"), data_key_error);
+    }
+}
+
+TEST_CASE("JsonContainer::elements", "[data]") {
+    JsonContainer data { "{\"vec\" : [1, 2, 3], \"objs\" : [{\"a\" : 1}, {\"a\" : 2}],"
+                         " \"nested\" : [[1], [2, 3]]}" };
+
+    SECTION("it iterates the elements") {
+        std::vector<int> values {};
+
+        for (const auto& element : data.elements("vec")) {
+            values.push_back(element.get<int>());
+        }
+
+        REQUIRE(values == std::vector<int>({ 1, 2, 3 }));
+        REQUIRE(data.elements("vec").size() == 3u);
+    }
+
+    SECTION("it can iterate nested arrays and objects") {
+        int sum = 0;
+
+        for (const auto& obj : data.elements("objs")) {
+            for (const auto& member : obj.members()) {
+                sum += member.value.get<int>();
+            }
+        }
+
+        for (const auto& array : data.elements("nested")) {
+            for (const auto& element : array.elements()) {
+                sum += element.get<int>();
+            }
+        }
+
+        REQUIRE(sum == 9);
+    }
+
+    SECTION("it throws a data_type_error in case the entry is not an array") {
+        REQUIRE_THROWS_AS(data.elements(), data_type_error);
+    }
+}
+
+TEST_CASE("JsonContainer::each", "[data]") {
+    JsonContainer data { JSON };
+
+    SECTION("it calls the callback for each member") {
+        std::vector<std::string> names {};
+        data.each([&names](boost::string_ref name, JsonContainerView value) {
+            names.push_back(name.to_string());
+        });
+        REQUIRE(names == data.keys());
+    }
+
+    SECTION("it calls the callback for each element, with an empty name") {
+        int sum = 0;
+        data.each("vec", [&sum](boost::string_ref name, JsonContainerView value) {
+            REQUIRE(name.empty());
+            sum += value.get<int>();
+        });
+        REQUIRE(sum == 3);
+    }
+
+    SECTION("it throws a data_type_error in case of scalars") {
+        REQUIRE_THROWS_AS(data.each("goo", [](boost::string_ref, JsonContainerView) {}),
+                          data_type_error);
+    }
+}
+
 TEST_CASE("JsonContainer::type", "[data]") {
     JsonContainer data {};
 
@@ -831,6 +1752,15 @@ TEST_CASE("JsonContainer::type", "[data]") {
             REQUIRE(data.type("int_entry") == DataType::Int);
         }
 
+        SECTION("it can distinguish 64-bit integer values") {
+            data.set<int64_t>("small_entry", 42);
+            data.set<int64_t>("int64_entry", -5000000000);
+            data.set<uint64_t>("uint64_entry", UINT64_MAX);
+            REQUIRE(data.type("small_entry") == DataType::Int);
+            REQUIRE(data.type("int64_entry") == DataType::Int64);
+            REQUIRE(data.type("uint64_entry") == DataType::Uint64);
+        }
+
         SECTION("it can distinguish a Double value") {
             SECTION("defined by set") {
                 data.set<double>("d_entry", 2.71828);
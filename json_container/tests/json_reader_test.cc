@@ -0,0 +1,261 @@
+#include <catch.hpp>
+#include <leatherman/json_container/json_reader.hpp>
+
+#include <cstdio>
+#include <sstream>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <unistd.h>
+#endif
+
+static const std::string JSON = "{\"foo\" : {\"bar\" : 2},"
+                                " \"goo\" : 1,"
+                                " \"bool\" : true,"
+                                " \"string\" : \"a string\","
+                                " \"null\" : null,"
+                                " \"real\" : 3.1415,"
+                                " \"big\" : 18446744073709551615,"
+                                " \"vec\" : [1, 2], "
+                                " \"objs\" : [{\"name\" : \"a\", \"n\" : 1},"
+                                "             {\"name\" : \"b\", \"n\" : 2}],"
+                                " \"a/b\" : {\"c~d\" : \"escaped\"}"
+                                "}";
+
+namespace leatherman { namespace json_container {
+
+// Records every event as a compact token, to easily compare sequences
+struct EventRecorder : JsonHandler {
+    std::vector<std::string> events;
+
+    bool match(const std::string& pointer) override {
+        events.push_back("@" + pointer);
+        return true;
+    }
+
+    bool null() override {
+        events.push_back("null");
+        return true;
+    }
+
+    bool boolean(bool value) override {
+        events.push_back(value ? "true" : "false");
+        return true;
+    }
+
+    bool integer(int64_t value) override {
+        events.push_back(std::to_string(value));
+        return true;
+    }
+
+    bool unsignedInteger(uint64_t value) override {
+        events.push_back(std::to_string(value) + "u");
+        return true;
+    }
+
+    bool real(double value) override {
+        events.push_back("r");
+        return true;
+    }
+
+    bool string(const char* value, size_t length) override {
+        events.push_back("\"" + std::string(value, length) + "\"");
+        return true;
+    }
+
+    bool startObject() override {
+        events.push_back("{");
+        return true;
+    }
+
+    bool key(const char* name, size_t length) override {
+        events.push_back(std::string(name, length) + ":");
+        return true;
+    }
+
+    bool endObject(size_t member_count) override {
+        events.push_back("}");
+        return true;
+    }
+
+    bool startArray() override {
+        events.push_back("[");
+        return true;
+    }
+
+    bool endArray(size_t element_count) override {
+        events.push_back("]");
+        return true;
+    }
+};
+
+TEST_CASE("JsonReader::parse", "[data]") {
+    JsonReader reader {};
+    EventRecorder recorder {};
+
+    SECTION("it emits the events of the whole document") {
+        REQUIRE(reader.parse("{\"a\" : [1, -2, 3.5, \"x\", null, false]}", recorder));
+        REQUIRE(recorder.events == std::vector<std::string>({
+            "{", "a:", "[", "1", "-2", "r", "\"x\"", "null", "false", "]", "}" }));
+    }
+
+    SECTION("it distinguishes integers greater than INT64_MAX") {
+        REQUIRE(reader.parse("[9223372036854775807, 18446744073709551615]", recorder));
+        REQUIRE(recorder.events == std::vector<std::string>({
+            "[", "9223372036854775807", "18446744073709551615u", "]" }));
+    }
+
+    SECTION("it can read from an input stream") {
+        std::istringstream input { JSON };
+        REQUIRE(reader.parse(input, recorder));
+
+        EventRecorder expected {};
+        reader.parse(JSON, expected);
+        REQUIRE(recorder.events.size() == 44u);
+        REQUIRE(recorder.events == expected.events);
+    }
+
+    SECTION("it can read from a chunked callback") {
+        JsonReader small_reader { 4 };
+        size_t offset = 0;
+        auto source = [&offset](char* buffer, size_t size) -> size_t {
+            // Deliver at most 3 bytes at a time to exercise refills
+            size = std::min(std::min(size, size_t { 3 }), JSON.size() - offset);
+            JSON.copy(buffer, size, offset);
+            offset += size;
+            return size;
+        };
+
+        REQUIRE(small_reader.parse(source, recorder));
+
+        EventRecorder expected {};
+        reader.parse(JSON, expected);
+        REQUIRE(recorder.events == expected.events);
+    }
+
+    SECTION("it can read from a file descriptor") {
+        int fds[2];
+#ifdef _WIN32
+        REQUIRE(_pipe(fds, 4096, _O_BINARY) == 0);
+        REQUIRE(_write(fds[1], "[1, 2]", 6) == 6);
+        _close(fds[1]);
+#else
+        REQUIRE(pipe(fds) == 0);
+        REQUIRE(write(fds[1], "[1, 2]", 6) == 6);
+        close(fds[1]);
+#endif
+        REQUIRE(reader.parse(fds[0], recorder));
+#ifdef _WIN32
+        _close(fds[0]);
+#else
+        close(fds[0]);
+#endif
+        REQUIRE(recorder.events == std::vector<std::string>({ "[", "1", "2", "]" }));
+    }
+
+    SECTION("it stops when the handler returns false") {
+        struct StopAtKey : EventRecorder {
+            bool key(const char* name, size_t length) override {
+                EventRecorder::key(name, length);
+                return false;
+            }
+        } stopper {};
+
+        REQUIRE_FALSE(reader.parse(JSON, stopper));
+        REQUIRE(stopper.events == std::vector<std::string>({ "{", "foo:" }));
+    }
+
+    SECTION("it can replay the events of a JsonContainer") {
+        JsonContainer document { JSON };
+        REQUIRE(reader.parse(document, recorder));
+
+        EventRecorder expected {};
+        reader.parse(JSON, expected);
+        REQUIRE(recorder.events == expected.events);
+    }
+
+    SECTION("it applies the filters to a JsonContainer") {
+        reader.addFilter("/objs/*/n");
+        REQUIRE(reader.parse(JsonContainer { JSON }, recorder));
+        REQUIRE(recorder.events == std::vector<std::string>({
+            "@/objs/0/n", "1", "@/objs/1/n", "2" }));
+    }
+
+    SECTION("it throws a data_parse_error in case of invalid JSON") {
+        REQUIRE_THROWS_AS(reader.parse("{\"foo\" : \"bar\", 42}", recorder),
+                          data_parse_error);
+        REQUIRE_THROWS_AS(reader.parse("", recorder), data_parse_error);
+    }
+}
+
+TEST_CASE("JsonReader::addFilter", "[data]") {
+    JsonReader reader {};
+    EventRecorder recorder {};
+
+    SECTION("it only emits the events of the selected scalar") {
+        reader.addFilter("/foo/bar");
+        REQUIRE(reader.parse(JSON, recorder));
+        REQUIRE(recorder.events == std::vector<std::string>({ "@/foo/bar", "2" }));
+    }
+
+    SECTION("it emits all the events of a selected subtree") {
+        reader.addFilter("/vec");
+        REQUIRE(reader.parse(JSON, recorder));
+        REQUIRE(recorder.events == std::vector<std::string>({ "@/vec", "[", "1", "2", "]" }));
+    }
+
+    SECTION("it can select array elements by index") {
+        reader.addFilter("/objs/1/name");
+        REQUIRE(reader.parse(JSON, recorder));
+        REQUIRE(recorder.events == std::vector<std::string>({ "@/objs/1/name", "\"b\"" }));
+    }
+
+    SECTION("it supports wildcards") {
+        reader.addFilter("/objs/*/n");
+        REQUIRE(reader.parse(JSON, recorder));
+        REQUIRE(recorder.events == std::vector<std::string>({
+            "@/objs/0/n", "1", "@/objs/1/n", "2" }));
+    }
+
+    SECTION("it supports multiple filters") {
+        reader.addFilter("/goo");
+        reader.addFilter("/string");
+        REQUIRE(reader.parse(JSON, recorder));
+        REQUIRE(recorder.events == std::vector<std::string>({
+            "@/goo", "1", "@/string", "\"a string\"" }));
+    }
+
+    SECTION("it unescapes pointer tokens") {
+        reader.addFilter("/a~1b/c~0d");
+        REQUIRE(reader.parse(JSON, recorder));
+        REQUIRE(recorder.events == std::vector<std::string>({ "@/a~1b/c~0d", "\"escaped\"" }));
+    }
+
+    SECTION("the empty pointer selects the whole document") {
+        reader.addFilter("");
+        REQUIRE(reader.parse("[1]", recorder));
+        REQUIRE(recorder.events == std::vector<std::string>({ "@", "[", "1", "]" }));
+    }
+
+    SECTION("it emits nothing if no entry matches") {
+        reader.addFilter("/foo/unknown");
+        REQUIRE(reader.parse(JSON, recorder));
+        REQUIRE(recorder.events.empty());
+    }
+
+    SECTION("it stops reading once all filters have been matched") {
+        reader.addFilter("/goo");
+        // The trailing garbage would fail the parsing if it was read
+        REQUIRE(reader.parse("{\"goo\" : 1, \"foo\" : ]]]", recorder));
+        REQUIRE(recorder.events == std::vector<std::string>({ "@/goo", "1" }));
+    }
+
+    SECTION("it throws a data_parse_error in case of an invalid pointer") {
+        REQUIRE_THROWS_AS(reader.addFilter("foo"), data_parse_error);
+        REQUIRE_THROWS_AS(reader.addFilter("/foo~2"), data_parse_error);
+    }
+}
+
+}}  // namespace leatherman::json_container
@@ -0,0 +1,152 @@
+#include <catch.hpp>
+#include <leatherman/json_container/json_schema.hpp>
+
+static const std::string SCHEMA = "{\"type\" : \"object\","
+                                  " \"required\" : [\"id\", \"action\"],"
+                                  " \"properties\" : {"
+                                  "   \"id\" : {\"type\" : \"integer\", \"minimum\" : 1},"
+                                  "   \"action\" : {\"enum\" : [\"run\", \"stop\"]},"
+                                  "   \"ratio\" : {\"type\" : \"number\", \"maximum\" : 1},"
+                                  "   \"name\" : {\"type\" : [\"string\", \"null\"], \"maxLength\" : 4},"
+                                  "   \"params\" : {\"type\" : \"array\", \"maxItems\" : 2,"
+                                  "                 \"items\" : {\"type\" : \"object\","
+                                  "                              \"required\" : [\"a/b\"]}}"
+                                  " }"
+                                  "}";
+
+namespace leatherman { namespace json_container {
+
+static std::vector<std::string> pointers(const std::vector<JsonSchemaError>& errors) {
+    std::vector<std::string> result {};
+    for (const auto& error : errors) {
+        result.push_back(error.pointer);
+    }
+    return result;
+}
+
+TEST_CASE("JsonSchema::validate", "[data]") {
+    JsonSchema schema { JsonContainer { SCHEMA } };
+
+    SECTION("it accepts a valid document") {
+        JsonContainer document { "{\"id\" : 3, \"action\" : \"run\", \"ratio\" : 0.5,"
+                                 " \"name\" : null, \"params\" : [{\"a/b\" : 1}],"
+                                 " \"other\" : [true]}" };
+        REQUIRE(schema.validate(document).empty());
+        REQUIRE_NOTHROW(schema.check(document));
+    }
+
+    SECTION("integers are numbers") {
+        JsonContainer document { "{\"id\" : 1, \"action\" : \"stop\", \"ratio\" : 1}" };
+        REQUIRE(schema.validate(document).empty());
+    }
+
+    SECTION("it collects all the errors, in document order") {
+        JsonContainer document { "{\"id\" : 0, \"action\" : \"walk\", \"ratio\" : 1.5,"
+                                 " \"name\" : \"too long\", \"params\" : [{}, 2, 3]}" };
+        auto errors = schema.validate(document);
+        REQUIRE(pointers(errors) == std::vector<std::string>({
+            "/id", "/action", "/ratio", "/name", "/params/0", "/params/1", "/params/2", "/params" }));
+    }
+
+    SECTION("it reports missing required properties") {
+        JsonContainer document { "{\"action\" : \"run\"}" };
+        auto errors = schema.validate(document);
+        REQUIRE(errors.size() == 1u);
+        REQUIRE(errors[0].pointer == "");
+        REQUIRE(errors[0].message.find("id") != std::string::npos);
+    }
+
+    SECTION("it reports type mismatches without checking the content") {
+        JsonContainer document { "[{\"id\" : \"x\"}]" };
+        auto errors = schema.validate(document);
+        REQUIRE(errors.size() == 1u);
+        REQUIRE(errors[0].pointer == "");
+    }
+
+    SECTION("it escapes the pointers") {
+        JsonContainer document { "{\"id\" : 1, \"action\" : \"run\", \"params\" : [{\"a/b\" : 1}, {\"c~d\" : 2}]}" };
+        auto errors = schema.validate(document);
+        REQUIRE(pointers(errors) == std::vector<std::string>({ "/params/1" }));
+    }
+
+    SECTION("check throws a data_validation_error listing the errors") {
+        JsonContainer document { "{\"id\" : -1}" };
+
+        try {
+            schema.check(document);
+            FAIL("no exception thrown");
+        } catch (const data_validation_error& e) {
+            REQUIRE(e.errors().size() == 2u);
+        }
+    }
+}
+
+TEST_CASE("JsonSchema enum of numbers", "[data]") {
+    SECTION("it compares 64-bit integers exactly") {
+        JsonSchema schema { JsonContainer { "{\"enum\" : [9007199254740993, -9223372036854775807,"
+                                            " 18446744073709551615]}" } };
+        REQUIRE(schema.validate(JsonContainer { "9007199254740993" }).empty());
+        REQUIRE(schema.validate(JsonContainer { "-9223372036854775807" }).empty());
+        REQUIRE(schema.validate(JsonContainer { "18446744073709551615" }).empty());
+        REQUIRE(schema.validate(JsonContainer { "9007199254740992" }).size() == 1u);
+        REQUIRE(schema.validate(JsonContainer { "-9223372036854775808" }).size() == 1u);
+        REQUIRE(schema.validate(JsonContainer { "18446744073709551614" }).size() == 1u);
+    }
+
+    SECTION("integral doubles equal the same integers") {
+        JsonSchema schema { JsonContainer { "{\"enum\" : [1.0, 2]}" } };
+        REQUIRE(schema.validate(JsonContainer { "1" }).empty());
+        REQUIRE(schema.validate(JsonContainer { "2.0" }).empty());
+        REQUIRE(schema.validate(JsonContainer { "3" }).size() == 1u);
+    }
+
+    SECTION("it compares other numbers as doubles") {
+        JsonSchema schema { JsonContainer { "{\"enum\" : [0.5]}" } };
+        REQUIRE(schema.validate(JsonContainer { "0.5" }).empty());
+        REQUIRE(schema.validate(JsonContainer { "0.25" }).size() == 1u);
+        REQUIRE(schema.validate(JsonContainer { "0" }).size() == 1u);
+    }
+}
+
+TEST_CASE("JsonSchemaValidator", "[data]") {
+    JsonSchema schema { JsonContainer { SCHEMA } };
+    JsonSchemaValidator validator { schema };
+
+    SECTION("it validates the events of a JsonReader") {
+        JsonReader {}.parse("{\"id\" : 1, \"action\" : \"run\", \"params\" : [1]}", validator);
+        REQUIRE(pointers(validator.errors()) == std::vector<std::string>({ "/params/0" }));
+    }
+
+    SECTION("it can be reset to validate another document") {
+        JsonReader {}.parse("{}", validator);
+        REQUIRE(validator.errors().size() == 2u);
+        validator.reset();
+        JsonReader {}.parse("{\"id\" : 1, \"action\" : \"run\"}", validator);
+        REQUIRE(validator.errors().empty());
+    }
+}
+
+TEST_CASE("JsonSchema::JsonSchema", "[data]") {
+    SECTION("it accepts an empty schema, which any document satisfies") {
+        JsonSchema schema { JsonContainer { "{}" } };
+        REQUIRE(schema.validate(JsonContainer { "[1, \"a\"]" }).empty());
+    }
+
+    SECTION("it throws a data_parse_error in case of an invalid schema") {
+        REQUIRE_THROWS_AS(JsonSchema { JsonContainer { "[]" } }, data_parse_error);
+        REQUIRE_THROWS_AS(JsonSchema { JsonContainer { "{\"type\" : \"text\"}" } },
+                          data_parse_error);
+        REQUIRE_THROWS_AS(JsonSchema { JsonContainer { "{\"minimum\" : \"1\"}" } },
+                          data_parse_error);
+        REQUIRE_THROWS_AS(JsonSchema { JsonContainer { "{\"maxItems\" : -1}" } },
+                          data_parse_error);
+        REQUIRE_THROWS_AS(JsonSchema { JsonContainer { "{\"enum\" : [[1]]}" } },
+                          data_parse_error);
+        REQUIRE_THROWS_AS(JsonSchema { JsonContainer { "{\"required\" : [1]}" } },
+                          data_parse_error);
+        REQUIRE_THROWS_AS(JsonSchema { JsonContainer { "{\"properties\" : {\"a\" : 1}}" } },
+                          data_parse_error);
+    }
+}
+
+}}  // namespace leatherman::json_container
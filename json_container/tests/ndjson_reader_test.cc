@@ -0,0 +1,116 @@
+#include <catch.hpp>
+#include <leatherman/json_container/ndjson_reader.hpp>
+
+#include <sstream>
+#include <vector>
+
+namespace leatherman { namespace json_container {
+
+static std::string records(size_t count) {
+    std::string ndjson {};
+    for (size_t i = 0; i < count; i++) {
+        ndjson += "{\"id\":" + std::to_string(i) + ",\"name\":\"record-" + std::to_string(i) + "\"}\n";
+    }
+    return ndjson;
+}
+
+TEST_CASE("NdjsonReader::read", "[ndjson]") {
+    SECTION("it delivers the records in input order") {
+        // Small batches, so that many are parsed concurrently
+        NdjsonReader reader { 3, 64 };
+        std::vector<int> ids {};
+
+        REQUIRE(reader.read(records(1000), [&ids](JsonContainer& record) {
+            ids.push_back(record.get<int>("id"));
+            return true;
+        }));
+
+        REQUIRE(ids.size() == 1000u);
+        for (size_t i = 0; i < ids.size(); i++) {
+            REQUIRE(ids[i] == static_cast<int>(i));
+        }
+    }
+
+    SECTION("it skips blank lines and accepts CRLF and a missing final newline") {
+        NdjsonReader reader { 2 };
+        std::vector<std::string> texts {};
+
+        REQUIRE(reader.read("1\r\n\n  \r\n[2]\n\"three\"\r\n\n{\"four\":4}", [&texts](JsonContainer& record) {
+            texts.push_back(record.toString());
+            return true;
+        }));
+
+        REQUIRE(texts == (std::vector<std::string> { "1", "[2]", "\"three\"", "{\"four\":4}" }));
+    }
+
+    SECTION("it reads lines longer than a batch") {
+        NdjsonReader reader { 2, 16 };
+        std::string name(100000, 'x');
+        std::vector<std::string> names {};
+
+        REQUIRE(reader.read("{\"name\":\"a\"}\n{\"name\":\"" + name + "\"}\n{\"name\":\"b\"}\n",
+                            [&names](JsonContainer& record) {
+            names.push_back(record.get<std::string>("name"));
+            return true;
+        }));
+
+        REQUIRE(names == (std::vector<std::string> { "a", name, "b" }));
+    }
+
+    SECTION("it does nothing for an empty input") {
+        NdjsonReader reader {};
+        size_t count = 0;
+
+        REQUIRE(reader.read("", [&count](JsonContainer&) { return ++count > 0; }));
+        REQUIRE(reader.read("\n\n", [&count](JsonContainer&) { return ++count > 0; }));
+        REQUIRE(count == 0u);
+    }
+
+    SECTION("it stops when the callback returns false") {
+        NdjsonReader reader { 2, 64 };
+        size_t count = 0;
+
+        REQUIRE_FALSE(reader.read(records(1000), [&count](JsonContainer&) {
+            return ++count < 10;
+        }));
+        REQUIRE(count == 10u);
+    }
+
+    SECTION("it throws a data_parse_error with the line of an invalid record") {
+        NdjsonReader reader { 3, 64 };
+        auto ndjson = records(100) + "{\"id\":\n" + records(10);
+        size_t count = 0;
+
+        try {
+            reader.read(ndjson, [&count](JsonContainer&) { return ++count > 0; });
+            FAIL("no exception thrown");
+        } catch (const data_parse_error& e) {
+            REQUIRE(std::string { e.what() } == "invalid JSON on line 101");
+        }
+
+        // The records before the invalid one are delivered
+        REQUIRE(count == 100u);
+    }
+
+    SECTION("it propagates the exceptions of the callback") {
+        NdjsonReader reader { 2, 64 };
+
+        REQUIRE_THROWS_AS(reader.read(records(1000), [](JsonContainer& record) -> bool {
+            throw data_key_error { record.get<std::string>("name") };
+        }), data_key_error);
+    }
+
+    SECTION("it reads from a stream") {
+        NdjsonReader reader { 2, 128 };
+        std::istringstream input { records(500) };
+        int sum = 0;
+
+        REQUIRE(reader.read(input, [&sum](JsonContainer& record) {
+            sum += record.get<int>("id");
+            return true;
+        }));
+        REQUIRE(sum == 499 * 500 / 2);
+    }
+}
+
+}}  // namespace leatherman::json_container